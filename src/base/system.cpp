@@ -38,6 +38,7 @@
 #include <netinet/in.h>
 #include <pthread.h>
 #include <sys/ioctl.h>
+#include <sys/mman.h>
 #include <sys/socket.h>
 
 #include <dirent.h>
@@ -161,6 +162,21 @@ void net_buffer_init(NETSOCKET_BUFFER *buffer);
 void net_buffer_reinit(NETSOCKET_BUFFER *buffer);
 void net_buffer_simple(NETSOCKET_BUFFER *buffer, char **buf, int *size);
 
+/* outgoing datagrams queued by net_udp_send while send batching is enabled */
+typedef struct
+{
+	int num;
+	int socks[VLEN];
+	int sizes[VLEN];
+	socklen_t addrlens[VLEN];
+#ifdef CONF_PLATFORM_LINUX
+	struct mmsghdr msgs[VLEN];
+	struct iovec iovecs[VLEN];
+#endif
+	char bufs[VLEN][PACKETSIZE];
+	struct sockaddr_storage sockaddrs[VLEN];
+} NETSOCKET_SEND_BUFFER;
+
 struct NETSOCKET_INTERNAL
 {
 	int type;
@@ -169,6 +185,7 @@ struct NETSOCKET_INTERNAL
 	int web_ipv4sock;
 
 	NETSOCKET_BUFFER buffer;
+	NETSOCKET_SEND_BUFFER *send_buffer;
 };
 static NETSOCKET_INTERNAL invalid_socket = {NETTYPE_INVALID, -1, -1, -1};
 
@@ -463,6 +480,42 @@ int io_sync(IOHANDLE io)
 #endif
 }
 
+void *io_mmap(IOHANDLE io, size_t *size)
+{
+	*size = 0;
+	const long int length = io_length(io);
+	if(length <= 0)
+		return nullptr;
+
+#if defined(CONF_FAMILY_WINDOWS)
+	HANDLE mapping = CreateFileMappingW((HANDLE)_get_osfhandle(_fileno((FILE *)io)), nullptr, PAGE_WRITECOPY, 0, 0, nullptr);
+	if(mapping == nullptr)
+		return nullptr;
+	void *data = MapViewOfFile(mapping, FILE_MAP_COPY, 0, 0, length);
+	// the view keeps the mapping alive
+	CloseHandle(mapping);
+	if(data == nullptr)
+		return nullptr;
+#else
+	void *data = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_PRIVATE, fileno((FILE *)io), 0);
+	if(data == MAP_FAILED)
+		return nullptr;
+#endif
+	*size = length;
+	return data;
+}
+
+void io_munmap(void *data, size_t size)
+{
+	if(data == nullptr)
+		return;
+#if defined(CONF_FAMILY_WINDOWS)
+	UnmapViewOfFile(data);
+#else
+	munmap(data, size);
+#endif
+}
+
 #define ASYNC_BUFSIZE (8 * 1024)
 #define ASYNC_LOCAL_BUFSIZE (64 * 1024)
 
@@ -473,6 +526,9 @@ struct ASYNCIO
 	SEMAPHORE sphore;
 	void *thread;
 
+	ASYNCIO_WRITER writer;
+	void *writer_user;
+
 	unsigned char *buffer;
 	unsigned int buffer_size;
 	unsigned int read_pos;
@@ -548,6 +604,16 @@ static void aio_thread(void *user)
 			{
 				if(aio->finish == ASYNCIO_CLOSE)
 				{
+					if(aio->writer)
+					{
+						aio->lock.unlock();
+						result_io_error = aio->writer(aio->io, nullptr, 0, 1, aio->writer_user);
+						aio->lock.lock();
+						if(result_io_error)
+						{
+							aio->error = result_io_error;
+						}
+					}
 					io_close(aio->io);
 				}
 				aio_handle_free_and_unlock(aio);
@@ -581,9 +647,16 @@ static void aio_thread(void *user)
 		aio->read_pos = (aio->read_pos + buffers.len1 + buffers.len2) % aio->buffer_size;
 		aio->lock.unlock();
 
-		io_write(aio->io, local_buffer, local_buffer_len);
-		io_flush(aio->io);
-		result_io_error = io_error(aio->io);
+		if(aio->writer)
+		{
+			result_io_error = aio->writer(aio->io, local_buffer, local_buffer_len, 0, aio->writer_user);
+		}
+		else
+		{
+			io_write(aio->io, local_buffer, local_buffer_len);
+			io_flush(aio->io);
+			result_io_error = io_error(aio->io);
+		}
 
 		aio->lock.lock();
 		aio->error = result_io_error;
@@ -591,6 +664,11 @@ static void aio_thread(void *user)
 }
 
 ASYNCIO *aio_new(IOHANDLE io)
+{
+	return aio_new_writer(io, nullptr, nullptr);
+}
+
+ASYNCIO *aio_new_writer(IOHANDLE io, ASYNCIO_WRITER writer, void *user)
 {
 	ASYNCIO *aio = new ASYNCIO;
 	if(!aio)
@@ -600,6 +678,8 @@ ASYNCIO *aio_new(IOHANDLE io)
 	aio->io = io;
 	sphore_init(&aio->sphore);
 	aio->thread = 0;
+	aio->writer = writer;
+	aio->writer_user = user;
 
 	aio->buffer = (unsigned char *)malloc(ASYNC_BUFSIZE);
 	if(!aio->buffer)
@@ -737,6 +817,12 @@ int aio_error(ASYNCIO *aio)
 	return aio->error;
 }
 
+unsigned aio_backlog(ASYNCIO *aio)
+{
+	CLockScope ls(aio->lock);
+	return buffer_len(aio);
+}
+
 void aio_free(ASYNCIO *aio)
 {
 	aio->lock.lock();
@@ -1622,10 +1708,44 @@ NETSOCKET net_udp_create(NETADDR bindaddr)
 	return sock;
 }
 
+static int priv_net_udp_queue(NETSOCKET sock, int socket, const void *sa, socklen_t sa_len, const void *data, int size)
+{
+	NETSOCKET_SEND_BUFFER *buffer = sock->send_buffer;
+	if(buffer->num == VLEN)
+		net_udp_flush(sock);
+
+	int i = buffer->num++;
+	buffer->socks[i] = socket;
+	buffer->sizes[i] = size;
+	buffer->addrlens[i] = sa_len;
+	mem_copy(buffer->bufs[i], data, size);
+	mem_copy(&buffer->sockaddrs[i], sa, sa_len);
+
+	network_stats.sent_bytes += size;
+	network_stats.sent_packets++;
+	return size;
+}
+
 int net_udp_send(NETSOCKET sock, const NETADDR *addr, const void *data, int size)
 {
 	int d = -1;
 
+	if(sock->send_buffer && size > 0 && size <= PACKETSIZE)
+	{
+		if(addr->type == NETTYPE_IPV4 && sock->ipv4sock >= 0)
+		{
+			struct sockaddr_in sa;
+			netaddr_to_sockaddr_in(addr, &sa);
+			return priv_net_udp_queue(sock, sock->ipv4sock, &sa, sizeof(sa), data, size);
+		}
+		else if(addr->type == NETTYPE_IPV6 && sock->ipv6sock >= 0)
+		{
+			struct sockaddr_in6 sa;
+			netaddr_to_sockaddr_in6(addr, &sa);
+			return priv_net_udp_queue(sock, sock->ipv6sock, &sa, sizeof(sa), data, size);
+		}
+	}
+
 	if(addr->type & NETTYPE_IPV4)
 	{
 		if(sock->ipv4sock >= 0)
@@ -1705,6 +1825,82 @@ int net_udp_send(NETSOCKET sock, const NETADDR *addr, const void *data, int size
 	return d;
 }
 
+void net_udp_set_send_batching(NETSOCKET sock, bool enabled)
+{
+	if(enabled == (sock->send_buffer != nullptr))
+		return;
+
+	if(!enabled)
+	{
+		net_udp_flush(sock);
+		free(sock->send_buffer);
+		sock->send_buffer = nullptr;
+		return;
+	}
+
+	NETSOCKET_SEND_BUFFER *buffer = (NETSOCKET_SEND_BUFFER *)malloc(sizeof(*buffer));
+	mem_zero(buffer, sizeof(*buffer));
+#if defined(CONF_PLATFORM_LINUX)
+	for(int i = 0; i < VLEN; ++i)
+	{
+		buffer->iovecs[i].iov_base = buffer->bufs[i];
+		buffer->msgs[i].msg_hdr.msg_iov = &(buffer->iovecs[i]);
+		buffer->msgs[i].msg_hdr.msg_iovlen = 1;
+		buffer->msgs[i].msg_hdr.msg_name = &(buffer->sockaddrs[i]);
+	}
+#endif
+	sock->send_buffer = buffer;
+}
+
+int net_udp_flush(NETSOCKET sock)
+{
+	NETSOCKET_SEND_BUFFER *buffer = sock->send_buffer;
+	if(!buffer || buffer->num == 0)
+		return 0;
+
+	int sent = 0;
+	int first = 0;
+	while(first < buffer->num)
+	{
+		/* consecutive datagrams for the same socket go out in one call */
+		int socket = buffer->socks[first];
+		int last = first + 1;
+		while(last < buffer->num && buffer->socks[last] == socket)
+			last++;
+
+#if defined(CONF_PLATFORM_LINUX)
+		for(int i = first; i < last; i++)
+		{
+			buffer->iovecs[i].iov_len = buffer->sizes[i];
+			buffer->msgs[i].msg_hdr.msg_namelen = buffer->addrlens[i];
+		}
+		int pos = first;
+		while(pos < last)
+		{
+			int result = sendmmsg(socket, &buffer->msgs[pos], last - pos, 0);
+			if(result <= 0)
+			{
+				/* drop the datagram that failed, like a failed sendto would */
+				pos++;
+				continue;
+			}
+			sent += result;
+			pos += result;
+		}
+#else
+		for(int i = first; i < last; i++)
+		{
+			if(sendto(socket, buffer->bufs[i], buffer->sizes[i], 0, (struct sockaddr *)&buffer->sockaddrs[i], buffer->addrlens[i]) >= 0)
+				sent++;
+		}
+#endif
+		first = last;
+	}
+
+	buffer->num = 0;
+	return sent;
+}
+
 void net_buffer_init(NETSOCKET_BUFFER *buffer)
 {
 #if defined(CONF_PLATFORM_LINUX)
@@ -1827,6 +2023,7 @@ int net_udp_recv(NETSOCKET sock, NETADDR *addr, unsigned char **data)
 
 int net_udp_close(NETSOCKET sock)
 {
+	net_udp_set_send_batching(sock, false);
 	return priv_net_close_all_sockets(sock);
 }
 
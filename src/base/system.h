@@ -394,6 +394,35 @@ int io_flush(IOHANDLE io);
  */
 int io_sync(IOHANDLE io);
 
+/**
+ * Maps the whole file into memory.
+ *
+ * @ingroup File-IO
+ *
+ * @param io Handle to the file.
+ * @param size Receives the size of the mapping.
+ *
+ * @return Pointer to the contents of the file, nullptr if the file is empty or could not be mapped.
+ *
+ * @remark The mapping is private, writes to it are not seen by other processes and are not written to the file.
+ * @remark The mapping stays valid after the file is closed, it must be released with io_munmap.
+ *
+ * @see io_munmap
+ */
+void *io_mmap(IOHANDLE io, size_t *size);
+
+/**
+ * Releases a mapping created by io_mmap.
+ *
+ * @ingroup File-IO
+ *
+ * @param data Pointer returned by io_mmap, may be nullptr.
+ * @param size Size of the mapping.
+ *
+ * @see io_mmap
+ */
+void io_munmap(void *data, size_t size);
+
 /**
  * Checks whether an error occurred during I/O with the file.
  *
@@ -443,6 +472,37 @@ typedef struct ASYNCIO ASYNCIO;
  */
 ASYNCIO *aio_new(IOHANDLE io);
 
+/**
+ * Writes a chunk of queued data to the file, called on the thread of
+ * the asynchronous handle.
+ *
+ * @ingroup File-IO
+ *
+ * @param io Handle to the file.
+ * @param buffer Pointer to the data, `nullptr` when finishing.
+ * @param size Number of bytes.
+ * @param finish Nonzero once before the file is closed, after all data
+ *               has been passed.
+ * @param user Pointer passed to @link aio_new_writer @endlink.
+ *
+ * @return 0 on success, nonzero on error.
+ */
+typedef int (*ASYNCIO_WRITER)(IOHANDLE io, const void *buffer, unsigned size, int finish, void *user);
+
+/**
+ * Wraps a @link IOHANDLE @endlink for asynchronous writing through a
+ * custom writer, e.g. to compress the data off the calling thread.
+ *
+ * @ingroup File-IO
+ *
+ * @param io Handle to the file.
+ * @param writer Function writing the queued data.
+ * @param user Pointer passed to the writer.
+ *
+ * @return The handle for asynchronous writing.
+ */
+ASYNCIO *aio_new_writer(IOHANDLE io, ASYNCIO_WRITER writer, void *user);
+
 /**
  * Locks the ASYNCIO structure so it can't be written into by
  * other threads.
@@ -525,6 +585,17 @@ void aio_write_newline_unlocked(ASYNCIO *aio);
  */
 int aio_error(ASYNCIO *aio);
 
+/**
+ * Returns the number of queued bytes that haven't been written yet.
+ *
+ * @ingroup File-IO
+ *
+ * @param aio Handle to the file.
+ *
+ * @return The number of bytes waiting to be written.
+ */
+unsigned aio_backlog(ASYNCIO *aio);
+
 /**
  * Queues file closing.
  *
@@ -945,6 +1016,32 @@ int net_udp_send(NETSOCKET sock, const NETADDR *addr, const void *data, int size
 */
 int net_udp_recv(NETSOCKET sock, NETADDR *addr, unsigned char **data);
 
+/**
+ * Enables or disables send batching on an UDP socket.
+ *
+ * @ingroup Network-UDP
+ *
+ * @param sock Socket to configure.
+ * @param enabled Whether to batch outgoing packets.
+ *
+ * @remark While enabled, @link net_udp_send @endlink only queues unicast
+ * packets, they are sent by @link net_udp_flush @endlink or once the
+ * queue is full. Disabling it flushes the queue.
+ */
+void net_udp_set_send_batching(NETSOCKET sock, bool enabled);
+
+/**
+ * Sends all packets queued on an UDP socket with send batching enabled,
+ * using as few system calls as the platform allows.
+ *
+ * @ingroup Network-UDP
+ *
+ * @param sock Socket to flush.
+ *
+ * @return The number of packets that were sent successfully.
+ */
+int net_udp_flush(NETSOCKET sock);
+
 /**
  * Closes an UDP socket.
  *
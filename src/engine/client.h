@@ -263,7 +263,8 @@ public:
 	virtual int GetCurrentRaceTime() = 0;
 
 	virtual void RaceRecord_Start(const char *pFilename) = 0;
-	virtual void RaceRecord_Stop() = 0;
+	// the demo is renamed to pTargetFilename or removed once it's written
+	virtual void RaceRecord_Stop(const char *pTargetFilename = "", bool RemoveFile = false) = 0;
 	virtual bool RaceRecord_IsRecording() = 0;
 
 	virtual void DemoSliceBegin() = 0;
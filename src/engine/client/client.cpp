@@ -772,7 +772,7 @@ void *CClient::SnapGetItem(int SnapID, int Index, CSnapItem *pItem) const
 	dbg_assert(SnapID >= 0 && SnapID < NUM_SNAPSHOT_TYPES, "invalid SnapID");
 	const CSnapshotItem *pSnapshotItem = m_aapSnapshots[g_Config.m_ClDummy][SnapID]->m_pAltSnap->GetItem(Index);
 	pItem->m_DataSize = m_aapSnapshots[g_Config.m_ClDummy][SnapID]->m_pAltSnap->GetItemSize(Index);
-	pItem->m_Type = m_aapSnapshots[g_Config.m_ClDummy][SnapID]->m_pAltSnap->GetItemType(Index);
+	pItem->m_Type = m_aapSnapshots[g_Config.m_ClDummy][SnapID]->m_pAltSnap->GetItemType(Index, m_aapSnapshots[g_Config.m_ClDummy][SnapID]->m_pAltSnapIndex);
 	pItem->m_ID = pSnapshotItem->ID();
 	return (void *)pSnapshotItem->Data();
 }
@@ -788,7 +788,7 @@ const void *CClient::SnapFindItem(int SnapID, int Type, int ID) const
 	if(!m_aapSnapshots[g_Config.m_ClDummy][SnapID])
 		return 0x0;
 
-	return m_aapSnapshots[g_Config.m_ClDummy][SnapID]->m_pAltSnap->FindItem(Type, ID);
+	return m_aapSnapshots[g_Config.m_ClDummy][SnapID]->m_pAltSnap->FindItem(Type, ID, m_aapSnapshots[g_Config.m_ClDummy][SnapID]->m_pAltSnapIndex);
 }
 
 int CClient::SnapNumItems(int SnapID) const
@@ -879,7 +879,7 @@ void CClient::DebugRender()
 		{
 			if(m_SnapshotDelta.GetDataRate(i) && m_aapSnapshots[g_Config.m_ClDummy][IClient::SNAP_CURRENT])
 			{
-				int Type = m_aapSnapshots[g_Config.m_ClDummy][IClient::SNAP_CURRENT]->m_pAltSnap->GetExternalItemType(i);
+				int Type = m_aapSnapshots[g_Config.m_ClDummy][IClient::SNAP_CURRENT]->m_pAltSnap->GetExternalItemType(i, m_aapSnapshots[g_Config.m_ClDummy][IClient::SNAP_CURRENT]->m_pAltSnapIndex);
 				if(Type == UUID_INVALID)
 				{
 					str_format(aBuffer, sizeof(aBuffer), "%5d %20s: %8d %8d %8d", i, "Unknown UUID", m_SnapshotDelta.GetDataRate(i) / 8, m_SnapshotDelta.GetDataUpdates(i),
@@ -1004,7 +1004,7 @@ const char *CClient::LoadMap(const char *pName, const char *pFilename, SHA256_DI
 	if((bool)m_MapLoadingCBFunc)
 		m_MapLoadingCBFunc();
 
-	if(!m_pMap->Load(pFilename))
+	if(!m_pMap->Load(pFilename, g_Config.m_DatafileMmap))
 	{
 		str_format(s_aErrorMsg, sizeof(s_aErrorMsg), "map '%s' not found", pFilename);
 		return s_aErrorMsg;
@@ -1031,6 +1031,9 @@ const char *CClient::LoadMap(const char *pName, const char *pFilename, SHA256_DI
 		return s_aErrorMsg;
 	}
 
+	// decompress everything at once on the job threads, the game client needs most of the data right away
+	m_pMap->PreloadData();
+
 	// stop demo recording if we loaded a new map
 	for(int i = 0; i < RECORDER_MAX; i++)
 		DemoRecorder_Stop(i, i == RECORDER_REPLAYS);
@@ -1535,7 +1538,7 @@ void CClient::ProcessServerPacket(CNetChunk *pPacket, int Conn, bool Dummy)
 						m_pMapdownloadTask = HttpGetFile(pMapUrl ? pMapUrl : aUrl, Storage(), m_aMapdownloadFilenameTemp, IStorage::TYPE_SAVE);
 						m_pMapdownloadTask->Timeout(CTimeout{g_Config.m_ClMapDownloadConnectTimeoutMs, 0, g_Config.m_ClMapDownloadLowSpeedLimit, g_Config.m_ClMapDownloadLowSpeedTime});
 						m_pMapdownloadTask->MaxResponseSize(1024 * 1024 * 1024); // 1 GiB
-						Engine()->AddJob(m_pMapdownloadTask);
+						HttpRun(m_pMapdownloadTask);
 					}
 					else
 						SendMapRequest();
@@ -1782,9 +1785,10 @@ void CClient::ProcessServerPacket(CNetChunk *pPacket, int Conn, bool Dummy)
 
 					// find snapshot that we should use as delta
 					const CSnapshot *pDeltaShot = CSnapshot::EmptySnapshot();
+					const CSnapshotIndex *pDeltaShotIndex = nullptr;
 					if(DeltaTick >= 0)
 					{
-						int DeltashotSize = m_aSnapshotStorage[Conn].Get(DeltaTick, 0, &pDeltaShot, 0);
+						int DeltashotSize = m_aSnapshotStorage[Conn].Get(DeltaTick, 0, &pDeltaShot, 0, &pDeltaShotIndex);
 
 						if(DeltashotSize < 0)
 						{
@@ -1818,7 +1822,7 @@ void CClient::ProcessServerPacket(CNetChunk *pPacket, int Conn, bool Dummy)
 					}
 
 					// unpack delta
-					const int SnapSize = m_SnapshotDelta.UnpackDelta(pDeltaShot, pTmpBuffer3, pDeltaData, DeltaSize);
+					const int SnapSize = m_SnapshotDelta.UnpackDelta(pDeltaShot, pTmpBuffer3, pDeltaData, DeltaSize, pDeltaShotIndex);
 					if(SnapSize < 0)
 					{
 						dbg_msg("client", "delta unpack failed. error=%d", SnapSize);
@@ -1909,8 +1913,8 @@ void CClient::ProcessServerPacket(CNetChunk *pPacket, int Conn, bool Dummy)
 							m_PredictedTime.UpdateMargin(PredictionMargin() * time_freq() / 1000);
 						}
 						m_aGameTime[Conn].Init((GameTick - 1) * time_freq() / 50);
-						m_aapSnapshots[Conn][SNAP_PREV] = m_aSnapshotStorage[Conn].m_pFirst;
-						m_aapSnapshots[Conn][SNAP_CURRENT] = m_aSnapshotStorage[Conn].m_pLast;
+						m_aapSnapshots[Conn][SNAP_PREV] = m_aSnapshotStorage[Conn].First();
+						m_aapSnapshots[Conn][SNAP_CURRENT] = m_aSnapshotStorage[Conn].Last();
 						if(!Dummy)
 						{
 							m_LocalStartTime = time_get();
@@ -2027,12 +2031,17 @@ int CClient::UnpackAndValidateSnapshot(CSnapshot *pFrom, CSnapshot *pTo)
 	Builder.Init();
 	CNetObjHandler *pNetObjHandler = GameClient()->GetNetObjHandler();
 
+	// resolving the extended item types needs key lookups
+	alignas(CSnapshotIndex) char aFromIndexData[CSnapshotIndex::MaxSize()];
+	CSnapshotIndex *pFromIndex = (CSnapshotIndex *)aFromIndexData;
+	pFromIndex->Build(pFrom);
+
 	int Num = pFrom->NumItems();
 	for(int Index = 0; Index < Num; Index++)
 	{
 		const CSnapshotItem *pFromItem = pFrom->GetItem(Index);
 		const int FromItemSize = pFrom->GetItemSize(Index);
-		const int ItemType = pFrom->GetItemType(Index);
+		const int ItemType = pFrom->GetItemType(Index, pFromIndex);
 		const void *pData = pFromItem->Data();
 		Unpacker.Reset(pData, FromItemSize);
 
@@ -2375,6 +2384,7 @@ void CClient::OnDemoPlayerSnapshot(void *pData, int Size)
 	std::swap(m_aapSnapshots[g_Config.m_ClDummy][SNAP_PREV], m_aapSnapshots[g_Config.m_ClDummy][SNAP_CURRENT]);
 	mem_copy(m_aapSnapshots[g_Config.m_ClDummy][SNAP_CURRENT]->m_pSnap, pData, Size);
 	mem_copy(m_aapSnapshots[g_Config.m_ClDummy][SNAP_CURRENT]->m_pAltSnap, pAltSnapBuffer, AltSnapSize);
+	m_aapSnapshots[g_Config.m_ClDummy][SNAP_CURRENT]->m_pAltSnapIndex->Build(m_aapSnapshots[g_Config.m_ClDummy][SNAP_CURRENT]->m_pAltSnap);
 
 	GameClient()->OnNewSnapshot();
 }
@@ -2470,7 +2480,7 @@ void CClient::Update()
 
 				if(TickStart < Now)
 				{
-					CSnapshotStorage::CHolder *pNext = m_aapSnapshots[!g_Config.m_ClDummy][SNAP_CURRENT]->m_pNext;
+					CSnapshotStorage::CHolder *pNext = m_aSnapshotStorage[!g_Config.m_ClDummy].Next(pCur);
 					if(pNext)
 					{
 						m_aapSnapshots[!g_Config.m_ClDummy][SNAP_PREV] = m_aapSnapshots[!g_Config.m_ClDummy][SNAP_CURRENT];
@@ -2509,7 +2519,7 @@ void CClient::Update()
 
 				if(TickStart < Now)
 				{
-					CSnapshotStorage::CHolder *pNext = m_aapSnapshots[g_Config.m_ClDummy][SNAP_CURRENT]->m_pNext;
+					CSnapshotStorage::CHolder *pNext = m_aSnapshotStorage[g_Config.m_ClDummy].Next(pCur);
 					if(pNext)
 					{
 						m_aapSnapshots[g_Config.m_ClDummy][SNAP_PREV] = m_aapSnapshots[g_Config.m_ClDummy][SNAP_CURRENT];
@@ -3126,6 +3136,7 @@ void CClient::Run()
 	}
 
 	m_Fifo.Shutdown();
+	HttpShutdown(std::chrono::milliseconds(0));
 
 	GameClient()->OnShutdown();
 	Disconnect();
@@ -3542,6 +3553,7 @@ void CClient::SaveReplay(const int Length, const char *pFilename)
 	{
 		// First we stop the recorder to slice correctly the demo after
 		DemoRecorder_Stop(RECORDER_REPLAYS);
+		m_aDemoRecorder[RECORDER_REPLAYS].WaitUntilWritten();
 
 		char aDate[64];
 		str_timestamp(aDate, sizeof(aDate));
@@ -3629,6 +3641,9 @@ const char *CClient::DemoPlayer_Play(const char *pFilename, int StorageType)
 		m_aapSnapshots[g_Config.m_ClDummy][SnapshotType] = &m_aDemorecSnapshotHolders[SnapshotType];
 		m_aapSnapshots[g_Config.m_ClDummy][SnapshotType]->m_pSnap = (CSnapshot *)&m_aaaDemorecSnapshotData[SnapshotType][0];
 		m_aapSnapshots[g_Config.m_ClDummy][SnapshotType]->m_pAltSnap = (CSnapshot *)&m_aaaDemorecSnapshotData[SnapshotType][1];
+		m_aapSnapshots[g_Config.m_ClDummy][SnapshotType]->m_pSnapIndex = nullptr;
+		m_aapSnapshots[g_Config.m_ClDummy][SnapshotType]->m_pAltSnapIndex = (CSnapshotIndex *)m_aaDemorecSnapshotIndexData[SnapshotType];
+		m_aapSnapshots[g_Config.m_ClDummy][SnapshotType]->m_pAltSnapIndex->Build(m_aapSnapshots[g_Config.m_ClDummy][SnapshotType]->m_pAltSnap);
 		m_aapSnapshots[g_Config.m_ClDummy][SnapshotType]->m_SnapSize = 0;
 		m_aapSnapshots[g_Config.m_ClDummy][SnapshotType]->m_AltSnapSize = 0;
 		m_aapSnapshots[g_Config.m_ClDummy][SnapshotType]->m_Tick = -1;
@@ -3747,16 +3762,18 @@ void CClient::DemoRecorder_StartReplayRecorder()
 
 void CClient::DemoRecorder_Stop(int Recorder, bool RemoveFile)
 {
-	m_aDemoRecorder[Recorder].Stop();
-	if(RemoveFile)
+	if(!RemoveFile)
 	{
-		const char *pFilename = m_aDemoRecorder[Recorder].GetCurrentFilename();
-		if(pFilename[0] != '\0')
-		{
-			Storage()->RemoveFile(pFilename, IStorage::TYPE_SAVE);
-			m_aDemoRecorder[Recorder].ClearCurrentFilename();
-		}
+		m_aDemoRecorder[Recorder].Stop();
+		return;
 	}
+
+	const char *pFilename = m_aDemoRecorder[Recorder].GetCurrentFilename();
+	if(m_aDemoRecorder[Recorder].IsRecording())
+		m_aDemoRecorder[Recorder].Stop(IDemoRecorder::EStopMode::REMOVE_FILE);
+	else if(pFilename[0] != '\0')
+		Storage()->RemoveFile(pFilename, IStorage::TYPE_SAVE);
+	m_aDemoRecorder[Recorder].ClearCurrentFilename();
 }
 
 void CClient::DemoRecorder_AddDemoMarker(int Recorder)
@@ -4622,10 +4639,10 @@ void CClient::RaceRecord_Start(const char *pFilename)
 		m_aDemoRecorder[RECORDER_RACE].Start(Storage(), m_pConsole, pFilename, GameClient()->NetVersion(), m_aCurrentMap, m_pMap->Sha256(), m_pMap->Crc(), "client", m_pMap->MapSize(), 0, m_pMap->File());
 }
 
-void CClient::RaceRecord_Stop()
+void CClient::RaceRecord_Stop(const char *pTargetFilename, bool RemoveFile)
 {
 	if(m_aDemoRecorder[RECORDER_RACE].IsRecording())
-		m_aDemoRecorder[RECORDER_RACE].Stop();
+		m_aDemoRecorder[RECORDER_RACE].Stop(RemoveFile ? IDemoRecorder::EStopMode::REMOVE_FILE : IDemoRecorder::EStopMode::KEEP_FILE, pTargetFilename);
 }
 
 bool CClient::RaceRecord_IsRecording()
@@ -4650,7 +4667,7 @@ void CClient::RequestDDNetInfo()
 	m_pDDNetInfoTask = HttpGetFile(aUrl, Storage(), m_aDDNetInfoTmp, IStorage::TYPE_SAVE);
 	m_pDDNetInfoTask->Timeout(CTimeout{10000, 0, 500, 10});
 	m_pDDNetInfoTask->IpResolve(IPRESOLVE::V4);
-	Engine()->AddJob(m_pDDNetInfoTask);
+	HttpRun(m_pDDNetInfoTask);
 }
 
 int CClient::GetPredictionTime()
@@ -192,6 +192,7 @@ class CClient : public IClient, public CDemoPlayer::IListener
 
 	CSnapshotStorage::CHolder m_aDemorecSnapshotHolders[NUM_SNAPSHOT_TYPES];
 	char m_aaaDemorecSnapshotData[NUM_SNAPSHOT_TYPES][2][CSnapshot::MAX_SIZE];
+	alignas(CSnapshotIndex) char m_aaDemorecSnapshotIndexData[NUM_SNAPSHOT_TYPES][CSnapshotIndex::MaxSize()];
 
 	CSnapshotDelta m_SnapshotDelta;
 
@@ -479,7 +480,7 @@ public:
 	unsigned GetCurrentMapCrc() const override;
 
 	void RaceRecord_Start(const char *pFilename) override;
-	void RaceRecord_Stop() override;
+	void RaceRecord_Stop(const char *pTargetFilename = "", bool RemoveFile = false) override;
 	bool RaceRecord_IsRecording() override;
 
 	void DemoSliceBegin() override;
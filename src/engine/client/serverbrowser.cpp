@@ -31,12 +31,12 @@ class CSortWrap
 {
 	typedef bool (CServerBrowser::*SortFunc)(int, int) const;
 	SortFunc m_pfnSort;
-	CServerBrowser *m_pThis;
+	const CServerBrowser *m_pThis;
 
 public:
-	CSortWrap(CServerBrowser *pServer, SortFunc Func) :
+	CSortWrap(const CServerBrowser *pServer, SortFunc Func) :
 		m_pfnSort(Func), m_pThis(pServer) {}
-	bool operator()(int a, int b) { return (g_Config.m_BrSortOrder ? (m_pThis->*m_pfnSort)(b, a) : (m_pThis->*m_pfnSort)(a, b)); }
+	bool operator()(int a, int b) const { return (g_Config.m_BrSortOrder ? (m_pThis->*m_pfnSort)(b, a) : (m_pThis->*m_pfnSort)(a, b)); }
 };
 
 bool matchesPart(const char *a, const char *b)
@@ -55,7 +55,6 @@ CServerBrowser::CServerBrowser() :
 	m_TypesFilter(g_Config.m_BrFilterExcludeTypes, sizeof(g_Config.m_BrFilterExcludeTypes))
 {
 	m_ppServerlist = nullptr;
-	m_pSortedServerlist = nullptr;
 
 	m_pFirstReqServer = nullptr; // request list
 	m_pLastReqServer = nullptr;
@@ -64,8 +63,6 @@ CServerBrowser::CServerBrowser() :
 	m_NeedResort = false;
 	m_Sorthash = 0;
 
-	m_NumSortedServers = 0;
-	m_NumSortedServersCapacity = 0;
 	m_NumSortedPlayers = 0;
 	m_NumServers = 0;
 	m_NumServerCapacity = 0;
@@ -81,7 +78,6 @@ CServerBrowser::CServerBrowser() :
 CServerBrowser::~CServerBrowser()
 {
 	free(m_ppServerlist);
-	free(m_pSortedServerlist);
 	json_value_free(m_pDDNetInfo);
 
 	delete m_pHttp;
@@ -186,9 +182,9 @@ int CServerBrowser::Max(const CServerInfo &Item) const
 
 const CServerInfo *CServerBrowser::SortedGet(int Index) const
 {
-	if(Index < 0 || Index >= m_NumSortedServers)
+	if(Index < 0 || Index >= m_SortedServerlist.Size())
 		return nullptr;
-	return &m_ppServerlist[m_pSortedServerlist[Index]]->m_Info;
+	return &m_ppServerlist[m_SortedServerlist[Index]]->m_Info;
 }
 
 int CServerBrowser::GenerateToken(const NETADDR &Addr) const
@@ -268,167 +264,165 @@ bool CServerBrowser::SortCompareNumPlayersAndPing(int Index1, int Index2) const
 		return pIndex1->m_Info.m_Latency > pIndex2->m_Info.m_Latency;
 }
 
-void CServerBrowser::Filter()
-{
-	m_NumSortedServers = 0;
-	m_NumSortedPlayers = 0;
-
-	// allocate the sorted list
-	if(m_NumSortedServersCapacity < m_NumServers)
-	{
-		free(m_pSortedServerlist);
-		m_NumSortedServersCapacity = m_NumServers;
-		m_pSortedServerlist = (int *)calloc(m_NumSortedServersCapacity, sizeof(int));
-	}
-
-	// filter the servers
-	for(int i = 0; i < m_NumServers; i++)
+bool CServerBrowser::IsFiltered(CServerInfo &Info) const
+{
+	bool Filtered = false;
+
+	if(g_Config.m_BrFilterEmpty && Info.m_NumFilteredPlayers == 0)
+		Filtered = true;
+	else if(g_Config.m_BrFilterFull && Players(Info) == Max(Info))
+		Filtered = true;
+	else if(g_Config.m_BrFilterPw && Info.m_Flags & SERVER_FLAG_PASSWORD)
+		Filtered = true;
+	else if(g_Config.m_BrFilterServerAddress[0] && !str_find_nocase(Info.m_aAddress, g_Config.m_BrFilterServerAddress))
+		Filtered = true;
+	else if(g_Config.m_BrFilterGametypeStrict && g_Config.m_BrFilterGametype[0] && str_comp_nocase(Info.m_aGameType, g_Config.m_BrFilterGametype))
+		Filtered = true;
+	else if(!g_Config.m_BrFilterGametypeStrict && g_Config.m_BrFilterGametype[0] && !str_utf8_find_nocase(Info.m_aGameType, g_Config.m_BrFilterGametype))
+		Filtered = true;
+	else if(g_Config.m_BrFilterUnfinishedMap && Info.m_HasRank == CServerInfo::RANK_RANKED)
+		Filtered = true;
+	else
 	{
-		CServerInfo &Info = m_ppServerlist[i]->m_Info;
-		bool Filtered = false;
-
-		if(g_Config.m_BrFilterEmpty && Info.m_NumFilteredPlayers == 0)
-			Filtered = true;
-		else if(g_Config.m_BrFilterFull && Players(Info) == Max(Info))
-			Filtered = true;
-		else if(g_Config.m_BrFilterPw && Info.m_Flags & SERVER_FLAG_PASSWORD)
-			Filtered = true;
-		else if(g_Config.m_BrFilterServerAddress[0] && !str_find_nocase(Info.m_aAddress, g_Config.m_BrFilterServerAddress))
-			Filtered = true;
-		else if(g_Config.m_BrFilterGametypeStrict && g_Config.m_BrFilterGametype[0] && str_comp_nocase(Info.m_aGameType, g_Config.m_BrFilterGametype))
-			Filtered = true;
-		else if(!g_Config.m_BrFilterGametypeStrict && g_Config.m_BrFilterGametype[0] && !str_utf8_find_nocase(Info.m_aGameType, g_Config.m_BrFilterGametype))
-			Filtered = true;
-		else if(g_Config.m_BrFilterUnfinishedMap && Info.m_HasRank == CServerInfo::RANK_RANKED)
-			Filtered = true;
-		else
+		if(m_ServerlistType == IServerBrowser::TYPE_INTERNET || m_ServerlistType == IServerBrowser::TYPE_FAVORITES)
 		{
-			if(m_ServerlistType == IServerBrowser::TYPE_INTERNET || m_ServerlistType == IServerBrowser::TYPE_FAVORITES)
-			{
-				Filtered = CommunitiesFilter().Filtered(Info.m_aCommunityId);
-				Filtered = Filtered || CountriesFilter().Filtered(Info.m_aCommunityCountry);
-				Filtered = Filtered || TypesFilter().Filtered(Info.m_aCommunityType);
-			}
+			Filtered = CommunitiesFilter().Filtered(Info.m_aCommunityId);
+			Filtered = Filtered || CountriesFilter().Filtered(Info.m_aCommunityCountry);
+			Filtered = Filtered || TypesFilter().Filtered(Info.m_aCommunityType);
+		}
 
-			if(!Filtered && g_Config.m_BrFilterCountry)
+		if(!Filtered && g_Config.m_BrFilterCountry)
+		{
+			Filtered = true;
+			// match against player country
+			for(int p = 0; p < minimum(Info.m_NumClients, (int)MAX_CLIENTS); p++)
 			{
-				Filtered = true;
-				// match against player country
-				for(int p = 0; p < minimum(Info.m_NumClients, (int)MAX_CLIENTS); p++)
+				if(Info.m_aClients[p].m_Country == g_Config.m_BrFilterCountryIndex)
 				{
-					if(Info.m_aClients[p].m_Country == g_Config.m_BrFilterCountryIndex)
-					{
-						Filtered = false;
-						break;
-					}
+					Filtered = false;
+					break;
 				}
 			}
+		}
 
-			if(!Filtered && g_Config.m_BrFilterString[0] != '\0')
-			{
-				Info.m_QuickSearchHit = 0;
+		if(!Filtered && g_Config.m_BrFilterString[0] != '\0')
+		{
+			Info.m_QuickSearchHit = 0;
 
-				const char *pStr = g_Config.m_BrFilterString;
-				char aFilterStr[sizeof(g_Config.m_BrFilterString)];
-				while((pStr = str_next_token(pStr, IServerBrowser::SEARCH_EXCLUDE_TOKEN, aFilterStr, sizeof(aFilterStr))))
+			const char *pStr = g_Config.m_BrFilterString;
+			char aFilterStr[sizeof(g_Config.m_BrFilterString)];
+			while((pStr = str_next_token(pStr, IServerBrowser::SEARCH_EXCLUDE_TOKEN, aFilterStr, sizeof(aFilterStr))))
+			{
+				if(aFilterStr[0] == '\0')
 				{
-					if(aFilterStr[0] == '\0')
-					{
-						continue;
-					}
-					auto MatchesFn = matchesPart;
-					const int FilterLen = str_length(aFilterStr);
-					if(aFilterStr[0] == '"' && aFilterStr[FilterLen - 1] == '"')
-					{
-						aFilterStr[FilterLen - 1] = '\0';
-						MatchesFn = matchesExactly;
-					}
+					continue;
+				}
+				auto MatchesFn = matchesPart;
+				const int FilterLen = str_length(aFilterStr);
+				if(aFilterStr[0] == '"' && aFilterStr[FilterLen - 1] == '"')
+				{
+					aFilterStr[FilterLen - 1] = '\0';
+					MatchesFn = matchesExactly;
+				}
 
-					// match against server name
-					if(MatchesFn(Info.m_aName, aFilterStr))
-					{
-						Info.m_QuickSearchHit |= IServerBrowser::QUICK_SERVERNAME;
-					}
+				// match against server name
+				if(MatchesFn(Info.m_aName, aFilterStr))
+				{
+					Info.m_QuickSearchHit |= IServerBrowser::QUICK_SERVERNAME;
+				}
 
-					// match against players
-					for(int p = 0; p < minimum(Info.m_NumClients, (int)MAX_CLIENTS); p++)
+				// match against players
+				for(int p = 0; p < minimum(Info.m_NumClients, (int)MAX_CLIENTS); p++)
+				{
+					if(MatchesFn(Info.m_aClients[p].m_aName, aFilterStr) ||
+						MatchesFn(Info.m_aClients[p].m_aClan, aFilterStr))
 					{
-						if(MatchesFn(Info.m_aClients[p].m_aName, aFilterStr) ||
-							MatchesFn(Info.m_aClients[p].m_aClan, aFilterStr))
+						if(g_Config.m_BrFilterConnectingPlayers &&
+							str_comp(Info.m_aClients[p].m_aName, "(connecting)") == 0 &&
+							Info.m_aClients[p].m_aClan[0] == '\0')
 						{
-							if(g_Config.m_BrFilterConnectingPlayers &&
-								str_comp(Info.m_aClients[p].m_aName, "(connecting)") == 0 &&
-								Info.m_aClients[p].m_aClan[0] == '\0')
-							{
-								continue;
-							}
-							Info.m_QuickSearchHit |= IServerBrowser::QUICK_PLAYER;
-							break;
+							continue;
 						}
-					}
-
-					// match against map
-					if(MatchesFn(Info.m_aMap, aFilterStr))
-					{
-						Info.m_QuickSearchHit |= IServerBrowser::QUICK_MAPNAME;
+						Info.m_QuickSearchHit |= IServerBrowser::QUICK_PLAYER;
+						break;
 					}
 				}
 
-				if(!Info.m_QuickSearchHit)
-					Filtered = true;
+				// match against map
+				if(MatchesFn(Info.m_aMap, aFilterStr))
+				{
+					Info.m_QuickSearchHit |= IServerBrowser::QUICK_MAPNAME;
+				}
 			}
 
-			if(!Filtered && g_Config.m_BrExcludeString[0] != '\0')
+			if(!Info.m_QuickSearchHit)
+				Filtered = true;
+		}
+
+		if(!Filtered && g_Config.m_BrExcludeString[0] != '\0')
+		{
+			const char *pStr = g_Config.m_BrExcludeString;
+			char aExcludeStr[sizeof(g_Config.m_BrExcludeString)];
+			while((pStr = str_next_token(pStr, IServerBrowser::SEARCH_EXCLUDE_TOKEN, aExcludeStr, sizeof(aExcludeStr))))
 			{
-				const char *pStr = g_Config.m_BrExcludeString;
-				char aExcludeStr[sizeof(g_Config.m_BrExcludeString)];
-				while((pStr = str_next_token(pStr, IServerBrowser::SEARCH_EXCLUDE_TOKEN, aExcludeStr, sizeof(aExcludeStr))))
+				if(aExcludeStr[0] == '\0')
 				{
-					if(aExcludeStr[0] == '\0')
-					{
-						continue;
-					}
-					auto MatchesFn = matchesPart;
-					const int FilterLen = str_length(aExcludeStr);
-					if(aExcludeStr[0] == '"' && aExcludeStr[FilterLen - 1] == '"')
-					{
-						aExcludeStr[FilterLen - 1] = '\0';
-						MatchesFn = matchesExactly;
-					}
+					continue;
+				}
+				auto MatchesFn = matchesPart;
+				const int FilterLen = str_length(aExcludeStr);
+				if(aExcludeStr[0] == '"' && aExcludeStr[FilterLen - 1] == '"')
+				{
+					aExcludeStr[FilterLen - 1] = '\0';
+					MatchesFn = matchesExactly;
+				}
 
-					// match against server name
-					if(MatchesFn(Info.m_aName, aExcludeStr))
-					{
-						Filtered = true;
-						break;
-					}
+				// match against server name
+				if(MatchesFn(Info.m_aName, aExcludeStr))
+				{
+					Filtered = true;
+					break;
+				}
 
-					// match against map
-					if(MatchesFn(Info.m_aMap, aExcludeStr))
-					{
-						Filtered = true;
-						break;
-					}
+				// match against map
+				if(MatchesFn(Info.m_aMap, aExcludeStr))
+				{
+					Filtered = true;
+					break;
+				}
 
-					// match against gametype
-					if(MatchesFn(Info.m_aGameType, aExcludeStr))
-					{
-						Filtered = true;
-						break;
-					}
+				// match against gametype
+				if(MatchesFn(Info.m_aGameType, aExcludeStr))
+				{
+					Filtered = true;
+					break;
 				}
 			}
 		}
+	}
 
-		if(!Filtered)
-		{
-			UpdateServerFriends(&Info);
+	if(Filtered)
+		return true;
 
-			if(!g_Config.m_BrFilterFriends || Info.m_FriendState != IFriends::FRIEND_NO)
-			{
-				m_NumSortedPlayers += Info.m_NumFilteredPlayers;
-				m_pSortedServerlist[m_NumSortedServers++] = i;
-			}
+	UpdateServerFriends(&Info);
+	return g_Config.m_BrFilterFriends && Info.m_FriendState == IFriends::FRIEND_NO;
+}
+
+void CServerBrowser::Filter()
+{
+	m_SortedServerlist.Clear();
+	m_NumSortedPlayers = 0;
+
+	// filter the servers
+	for(int i = 0; i < m_NumServers; i++)
+	{
+		CServerEntry *pEntry = m_ppServerlist[i];
+		pEntry->m_Sorted = !IsFiltered(pEntry->m_Info);
+		pEntry->m_SortedPlayers = pEntry->m_Sorted ? pEntry->m_Info.m_NumFilteredPlayers : 0;
+		if(pEntry->m_Sorted)
+		{
+			m_NumSortedPlayers += pEntry->m_SortedPlayers;
+			m_SortedServerlist.Add(i);
 		}
 	}
 }
@@ -449,6 +443,23 @@ int CServerBrowser::SortHash() const
 	return i;
 }
 
+CServerBrowser::FSortCompare CServerBrowser::SortCompare() const
+{
+	if(g_Config.m_BrSortOrder == 2 && (g_Config.m_BrSort == IServerBrowser::SORT_NUMPLAYERS || g_Config.m_BrSort == IServerBrowser::SORT_PING))
+		return &CServerBrowser::SortCompareNumPlayersAndPing;
+	else if(g_Config.m_BrSort == IServerBrowser::SORT_NAME)
+		return &CServerBrowser::SortCompareName;
+	else if(g_Config.m_BrSort == IServerBrowser::SORT_PING)
+		return &CServerBrowser::SortComparePing;
+	else if(g_Config.m_BrSort == IServerBrowser::SORT_MAP)
+		return &CServerBrowser::SortCompareMap;
+	else if(g_Config.m_BrSort == IServerBrowser::SORT_NUMPLAYERS)
+		return &CServerBrowser::SortCompareNumPlayers;
+	else if(g_Config.m_BrSort == IServerBrowser::SORT_GAMETYPE)
+		return &CServerBrowser::SortCompareGametype;
+	return nullptr;
+}
+
 void CServerBrowser::Sort()
 {
 	// update number of filtered players
@@ -461,22 +472,65 @@ void CServerBrowser::Sort()
 	Filter();
 
 	// sort
-	if(g_Config.m_BrSortOrder == 2 && (g_Config.m_BrSort == IServerBrowser::SORT_NUMPLAYERS || g_Config.m_BrSort == IServerBrowser::SORT_PING))
-		std::stable_sort(m_pSortedServerlist, m_pSortedServerlist + m_NumSortedServers, CSortWrap(this, &CServerBrowser::SortCompareNumPlayersAndPing));
-	else if(g_Config.m_BrSort == IServerBrowser::SORT_NAME)
-		std::stable_sort(m_pSortedServerlist, m_pSortedServerlist + m_NumSortedServers, CSortWrap(this, &CServerBrowser::SortCompareName));
-	else if(g_Config.m_BrSort == IServerBrowser::SORT_PING)
-		std::stable_sort(m_pSortedServerlist, m_pSortedServerlist + m_NumSortedServers, CSortWrap(this, &CServerBrowser::SortComparePing));
-	else if(g_Config.m_BrSort == IServerBrowser::SORT_MAP)
-		std::stable_sort(m_pSortedServerlist, m_pSortedServerlist + m_NumSortedServers, CSortWrap(this, &CServerBrowser::SortCompareMap));
-	else if(g_Config.m_BrSort == IServerBrowser::SORT_NUMPLAYERS)
-		std::stable_sort(m_pSortedServerlist, m_pSortedServerlist + m_NumSortedServers, CSortWrap(this, &CServerBrowser::SortCompareNumPlayers));
-	else if(g_Config.m_BrSort == IServerBrowser::SORT_GAMETYPE)
-		std::stable_sort(m_pSortedServerlist, m_pSortedServerlist + m_NumSortedServers, CSortWrap(this, &CServerBrowser::SortCompareGametype));
+	const FSortCompare pfnSortCompare = SortCompare();
+	if(pfnSortCompare)
+		m_SortedServerlist.Sort(CSortWrap(this, pfnSortCompare));
+
+	for(int Index : m_vChangedServers)
+		m_ppServerlist[Index]->m_Changed = false;
+	m_vChangedServers.clear();
 
 	m_Sorthash = SortHash();
 }
 
+void CServerBrowser::SortChanged()
+{
+	// moving many servers one by one is slower than sorting them all at once
+	if((int)m_vChangedServers.size() * 8 > m_NumServers)
+	{
+		Sort();
+		return;
+	}
+
+	// the changed servers aren't at their sorted places anymore, take all
+	// of them out before searching for the new places
+	for(int Index : m_vChangedServers)
+	{
+		CServerEntry *pEntry = m_ppServerlist[Index];
+		if(pEntry->m_Sorted)
+			m_NumSortedPlayers -= pEntry->m_SortedPlayers;
+	}
+	m_SortedServerlist.RemoveMany(m_vChangedServers);
+
+	const FSortCompare pfnSortCompare = SortCompare();
+	for(int Index : m_vChangedServers)
+	{
+		CServerEntry *pEntry = m_ppServerlist[Index];
+		pEntry->m_Changed = false;
+
+		UpdateServerFilteredPlayers(&pEntry->m_Info);
+		pEntry->m_Sorted = !IsFiltered(pEntry->m_Info);
+		pEntry->m_SortedPlayers = pEntry->m_Sorted ? pEntry->m_Info.m_NumFilteredPlayers : 0;
+		if(!pEntry->m_Sorted)
+			continue;
+
+		m_NumSortedPlayers += pEntry->m_SortedPlayers;
+		if(pfnSortCompare)
+			m_SortedServerlist.Insert(Index, CSortWrap(this, pfnSortCompare));
+		else
+			m_SortedServerlist.Insert(Index, [](int, int) { return false; });
+	}
+	m_vChangedServers.clear();
+}
+
+void CServerBrowser::RequestResort(CServerEntry *pEntry)
+{
+	if(pEntry->m_Changed)
+		return;
+	pEntry->m_Changed = true;
+	m_vChangedServers.push_back(pEntry->m_Info.m_ServerIndex);
+}
+
 void CServerBrowser::RemoveRequest(CServerEntry *pEntry)
 {
 	if(pEntry->m_pPrevReq || pEntry->m_pNextReq || m_pFirstReqServer == pEntry)
@@ -651,6 +705,7 @@ void CServerBrowser::SetLatency(NETADDR Addr, int Latency)
 		}
 		m_ppServerlist[i]->m_Info.m_Latency = Ping;
 		m_ppServerlist[i]->m_Info.m_LatencyIsEstimated = false;
+		RequestResort(m_ppServerlist[i]);
 	}
 }
 
@@ -769,7 +824,7 @@ void CServerBrowser::OnServerInfoUpdate(const NETADDR &Addr, int Token, const CS
 		pEntry->m_RequestTime = -1; // Request has been answered
 	}
 	RemoveRequest(pEntry);
-	RequestResort();
+	RequestResort(pEntry);
 }
 
 void CServerBrowser::Refresh(int Type)
@@ -988,7 +1043,8 @@ void CServerBrowser::CleanUp()
 	// clear out everything
 	m_ServerlistHeap.Reset();
 	m_NumServers = 0;
-	m_NumSortedServers = 0;
+	m_SortedServerlist.Clear();
+	m_vChangedServers.clear();
 	m_NumSortedPlayers = 0;
 	m_ByAddr.clear();
 	m_pFirstReqServer = nullptr;
@@ -1087,6 +1143,10 @@ void CServerBrowser::Update()
 		Sort();
 		m_NeedResort = false;
 	}
+	else if(!m_vChangedServers.empty())
+	{
+		SortChanged();
+	}
 }
 
 const json_value *CServerBrowser::LoadDDNetInfo()
@@ -9,7 +9,9 @@
 #include <engine/serverbrowser.h>
 #include <engine/shared/memheap.h>
 
+#include <algorithm>
 #include <unordered_map>
+#include <vector>
 
 typedef struct _json_value json_value;
 class CNetClient;
@@ -60,6 +62,77 @@ public:
 	void Clean(const std::vector<const char *> &vpAllowedElements);
 };
 
+/*
+	Class: CSortedServerIndices
+		Indices of the servers that pass the filters, in the order of the
+		server browser. A single server can be moved to its new place when
+		its info changed, without sorting the whole list again. Servers
+		that compare equal stay ordered by their index, like after a
+		stable sort of the ascending indices.
+*/
+class CSortedServerIndices
+{
+	std::vector<int> m_vIndices;
+
+	template<typename TLess>
+	class CIndexLess
+	{
+		const TLess &m_Less;
+
+	public:
+		CIndexLess(const TLess &Less) :
+			m_Less(Less) {}
+		bool operator()(int Index1, int Index2) const
+		{
+			if(m_Less(Index1, Index2))
+				return true;
+			if(m_Less(Index2, Index1))
+				return false;
+			return Index1 < Index2;
+		}
+	};
+
+public:
+	int Size() const { return m_vIndices.size(); }
+	int operator[](int Index) const { return m_vIndices[Index]; }
+	void Clear() { m_vIndices.clear(); }
+
+	// for building the full list, the indices must be added in ascending order
+	void Add(int Index) { m_vIndices.push_back(Index); }
+
+	template<typename TLess>
+	void Sort(const TLess &Less)
+	{
+		std::stable_sort(m_vIndices.begin(), m_vIndices.end(), Less);
+	}
+
+	template<typename TLess>
+	void Insert(int Index, const TLess &Less)
+	{
+		m_vIndices.insert(std::upper_bound(m_vIndices.begin(), m_vIndices.end(), Index, CIndexLess<TLess>(Less)), Index);
+	}
+
+	bool Remove(int Index)
+	{
+		auto It = std::find(m_vIndices.begin(), m_vIndices.end(), Index);
+		if(It == m_vIndices.end())
+			return false;
+		m_vIndices.erase(It);
+		return true;
+	}
+
+	// removes several servers at once, the keys of all of them may have
+	// changed already without breaking the order of the remaining ones
+	void RemoveMany(std::vector<int> vIndices)
+	{
+		std::sort(vIndices.begin(), vIndices.end());
+		m_vIndices.erase(std::remove_if(m_vIndices.begin(), m_vIndices.end(), [&](int Index) {
+			return std::binary_search(vIndices.begin(), vIndices.end(), Index);
+		}),
+			m_vIndices.end());
+	}
+};
+
 class CServerBrowser : public IServerBrowser
 {
 public:
@@ -71,6 +144,10 @@ public:
 		int m_GotInfo;
 		CServerInfo m_Info;
 
+		bool m_Sorted; // part of the sorted list
+		int m_SortedPlayers; // players counted in the sorted list
+		bool m_Changed; // needs to be moved in the sorted list
+
 		CServerEntry *m_pPrevReq; // request list
 		CServerEntry *m_pNextReq;
 	};
@@ -88,7 +165,7 @@ public:
 	int NumServers() const override { return m_NumServers; }
 	int Players(const CServerInfo &Item) const override;
 	int Max(const CServerInfo &Item) const override;
-	int NumSortedServers() const override { return m_NumSortedServers; }
+	int NumSortedServers() const override { return m_SortedServerlist.Size(); }
 	int NumSortedPlayers() const override { return m_NumSortedPlayers; }
 	const CServerInfo *SortedGet(int Index) const override;
 
@@ -152,7 +229,8 @@ private:
 
 	CHeap m_ServerlistHeap;
 	CServerEntry **m_ppServerlist;
-	int *m_pSortedServerlist;
+	CSortedServerIndices m_SortedServerlist;
+	std::vector<int> m_vChangedServers;
 	std::unordered_map<NETADDR, int> m_ByAddr;
 
 	std::vector<CCommunity> m_vCommunities;
@@ -177,8 +255,6 @@ private:
 	// used instead of g_Config.br_max_requests to get more servers
 	int m_CurrentMaxRequests;
 
-	int m_NumSortedServers;
-	int m_NumSortedServersCapacity;
 	int m_NumSortedPlayers;
 	int m_NumServers;
 	int m_NumServerCapacity;
@@ -192,6 +268,8 @@ private:
 	static int GetExtraToken(int Token);
 
 	// sorting criteria
+	typedef bool (CServerBrowser::*FSortCompare)(int Index1, int Index2) const;
+	FSortCompare SortCompare() const;
 	bool SortCompareName(int Index1, int Index2) const;
 	bool SortCompareMap(int Index1, int Index2) const;
 	bool SortComparePing(int Index1, int Index2) const;
@@ -201,9 +279,12 @@ private:
 	bool SortCompareNumPlayersAndPing(int Index1, int Index2) const;
 
 	//
+	bool IsFiltered(CServerInfo &Info) const;
 	void Filter();
 	void Sort();
+	void SortChanged();
 	int SortHash() const;
+	void RequestResort(CServerEntry *pEntry);
 
 	void CleanUp();
 
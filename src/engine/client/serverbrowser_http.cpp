@@ -4,15 +4,19 @@
 #include <engine/engine.h>
 #include <engine/external/json-parser/json.h>
 #include <engine/serverbrowser.h>
+#include <engine/shared/compression.h>
 #include <engine/shared/http.h>
 #include <engine/shared/jobs.h>
 #include <engine/shared/linereader.h>
+#include <engine/shared/memheap.h>
+#include <engine/shared/packer.h>
 #include <engine/shared/serverinfo.h>
 #include <engine/storage.h>
 
 #include <base/lock.h>
 #include <base/system.h>
 
+#include <limits>
 #include <memory>
 #include <vector>
 
@@ -23,7 +27,7 @@ using namespace std::chrono_literals;
 class CChooseMaster
 {
 public:
-	typedef bool (*VALIDATOR)(json_value *pJson);
+	typedef bool (*VALIDATOR)(const unsigned char *pData, size_t DataSize);
 
 	enum
 	{
@@ -53,8 +57,8 @@ private:
 	{
 		CLock m_Lock;
 		std::shared_ptr<CData> m_pData;
-		std::unique_ptr<CHttpRequest> m_pHead PT_GUARDED_BY(m_Lock);
-		std::unique_ptr<CHttpRequest> m_pGet PT_GUARDED_BY(m_Lock);
+		std::shared_ptr<CHttpRequest> m_pHead PT_GUARDED_BY(m_Lock);
+		std::shared_ptr<CHttpRequest> m_pGet PT_GUARDED_BY(m_Lock);
 		void Run() override REQUIRES(!m_Lock);
 
 	public:
@@ -171,14 +175,15 @@ void CChooseMaster::CJob::Run()
 	{
 		aTimeMs[i] = -1;
 		const char *pUrl = m_pData->m_aaUrls[aRandomized[i]];
-		CHttpRequest *pHead = HttpHead(pUrl).release();
+		std::shared_ptr<CHttpRequest> pHead = HttpHead(pUrl);
 		pHead->Timeout(Timeout);
 		pHead->LogProgress(HTTPLOG::FAILURE);
 		{
 			CLockScope ls(m_Lock);
-			m_pHead = std::unique_ptr<CHttpRequest>(pHead);
+			m_pHead = pHead;
 		}
-		IEngine::RunJobBlocking(pHead);
+		HttpRun(pHead);
+		pHead->Wait();
 		if(pHead->State() == HTTP_ABORTED)
 		{
 			dbg_msg("serverbrowse_http", "master chooser aborted");
@@ -189,14 +194,15 @@ void CChooseMaster::CJob::Run()
 			continue;
 		}
 		auto StartTime = time_get_nanoseconds();
-		CHttpRequest *pGet = HttpGet(pUrl).release();
+		std::shared_ptr<CHttpRequest> pGet = HttpGet(pUrl);
 		pGet->Timeout(Timeout);
 		pGet->LogProgress(HTTPLOG::FAILURE);
 		{
 			CLockScope ls(m_Lock);
-			m_pGet = std::unique_ptr<CHttpRequest>(pGet);
+			m_pGet = pGet;
 		}
-		IEngine::RunJobBlocking(pGet);
+		HttpRun(pGet);
+		pGet->Wait();
 		auto Time = std::chrono::duration_cast<std::chrono::milliseconds>(time_get_nanoseconds() - StartTime);
 		if(pHead->State() == HTTP_ABORTED)
 		{
@@ -207,14 +213,10 @@ void CChooseMaster::CJob::Run()
 		{
 			continue;
 		}
-		json_value *pJson = pGet->ResultJson();
-		if(!pJson)
-		{
-			continue;
-		}
-		bool ParseFailure = m_pData->m_pfnValidator(pJson);
-		json_value_free(pJson);
-		if(ParseFailure)
+		unsigned char *pResult;
+		size_t ResultLength;
+		pGet->Result(&pResult, &ResultLength);
+		if(!pResult || m_pData->m_pfnValidator(pResult, ResultLength))
 		{
 			continue;
 		}
@@ -248,7 +250,7 @@ void CChooseMaster::CJob::Run()
 class CServerBrowserHttp : public IServerBrowserHttp
 {
 public:
-	CServerBrowserHttp(IEngine *pEngine, IConsole *pConsole, const char **ppUrls, int NumUrls, int PreviousBestIndex);
+	CServerBrowserHttp(IEngine *pEngine, IConsole *pConsole, IStorage *pStorage, const char **ppUrls, int NumUrls, int PreviousBestIndex);
 	~CServerBrowserHttp() override;
 	void Update() override;
 	bool IsRefreshing() override { return m_State != STATE_DONE; }
@@ -281,25 +283,41 @@ private:
 		STATE_NO_MASTER,
 	};
 
-	static bool Validate(json_value *pJson);
-	static bool Parse(json_value *pJson, std::vector<CServerInfo> *pvServers, std::vector<NETADDR> *pvLegacyServers);
+	class CSaveCacheJob : public IJob
+	{
+		IStorage *m_pStorage;
+		std::vector<unsigned char> m_vData;
+		void Run() override;
+
+	public:
+		CSaveCacheJob(IStorage *pStorage, std::vector<unsigned char> &&vData) :
+			m_pStorage(pStorage), m_vData(std::move(vData)) {}
+	};
+
+	static bool Validate(const unsigned char *pData, size_t DataSize);
+	void LoadCache();
+	void SaveCache();
 
 	IEngine *m_pEngine;
 	IConsole *m_pConsole;
+	IStorage *m_pStorage;
 
 	int m_State = STATE_DONE;
 	std::shared_ptr<CHttpRequest> m_pGetServers;
 	std::unique_ptr<CChooseMaster> m_pChooseMaster;
+	std::shared_ptr<CSaveCacheJob> m_pSaveCacheJob;
 
 	std::vector<CServerInfo> m_vServers;
 	std::vector<NETADDR> m_vLegacyServers;
 };
 
-CServerBrowserHttp::CServerBrowserHttp(IEngine *pEngine, IConsole *pConsole, const char **ppUrls, int NumUrls, int PreviousBestIndex) :
+CServerBrowserHttp::CServerBrowserHttp(IEngine *pEngine, IConsole *pConsole, IStorage *pStorage, const char **ppUrls, int NumUrls, int PreviousBestIndex) :
 	m_pEngine(pEngine),
 	m_pConsole(pConsole),
+	m_pStorage(pStorage),
 	m_pChooseMaster(new CChooseMaster(pEngine, Validate, ppUrls, NumUrls, PreviousBestIndex))
 {
+	LoadCache();
 	m_pChooseMaster->Refresh();
 }
 
@@ -328,7 +346,7 @@ void CServerBrowserHttp::Update()
 		m_pGetServers = HttpGet(pBestUrl);
 		// 10 seconds connection timeout, lower than 8KB/s for 10 seconds to fail.
 		m_pGetServers->Timeout(CTimeout{10000, 0, 8000, 10});
-		m_pEngine->AddJob(m_pGetServers);
+		HttpRun(m_pGetServers);
 		m_State = STATE_REFRESHING;
 	}
 	else if(m_State == STATE_REFRESHING)
@@ -341,17 +359,23 @@ void CServerBrowserHttp::Update()
 		std::shared_ptr<CHttpRequest> pGetServers = nullptr;
 		std::swap(m_pGetServers, pGetServers);
 
-		bool Success = true;
-		json_value *pJson = pGetServers->ResultJson();
-		Success = Success && pJson;
-		Success = Success && !Parse(pJson, &m_vServers, &m_vLegacyServers);
-		json_value_free(pJson);
-		if(!Success)
+		unsigned char *pResult;
+		size_t ResultLength;
+		pGetServers->Result(&pResult, &ResultLength);
+		std::vector<CServerInfo> vServers;
+		std::vector<NETADDR> vLegacyServers;
+		if(!pResult || ServerbrowserParseServerList(pResult, ResultLength, &vServers, &vLegacyServers))
 		{
 			m_pConsole->Print(IConsole::OUTPUT_LEVEL_STANDARD, "serverbrowse_http", "failed getting serverlist, trying to find best URL");
 			m_pChooseMaster->Reset();
 			m_pChooseMaster->Refresh();
 		}
+		else
+		{
+			m_vServers = std::move(vServers);
+			m_vLegacyServers = std::move(vLegacyServers);
+			SaveCache();
+		}
 	}
 }
 void CServerBrowserHttp::Refresh()
@@ -370,16 +394,125 @@ bool ServerbrowserParseUrl(NETADDR *pOut, const char *pUrl)
 {
 	return net_addr_from_url(pOut, pUrl, nullptr, 0) != 0;
 }
-bool CServerBrowserHttp::Validate(json_value *pJson)
+bool CServerBrowserHttp::Validate(const unsigned char *pData, size_t DataSize)
 {
 	std::vector<CServerInfo> vServers;
 	std::vector<NETADDR> vLegacyServers;
-	return Parse(pJson, &vServers, &vLegacyServers);
+	return ServerbrowserParseServerList(pData, DataSize, &vServers, &vLegacyServers);
 }
-bool CServerBrowserHttp::Parse(json_value *pJson, std::vector<CServerInfo> *pvServers, std::vector<NETADDR> *pvLegacyServers)
+
+static const char SERVERLIST_CACHE_FILE[] = "ddnet-serverlist-cache.bin";
+
+void CServerBrowserHttp::LoadCache()
 {
-	std::vector<CServerInfo> vServers;
-	std::vector<NETADDR> vLegacyServers;
+	void *pData;
+	unsigned DataSize;
+	if(!m_pStorage->ReadFile(SERVERLIST_CACHE_FILE, IStorage::TYPE_SAVE, &pData, &DataSize))
+	{
+		return;
+	}
+	if(ServerbrowserDeserializeServerList((const unsigned char *)pData, DataSize, &m_vServers, &m_vLegacyServers))
+	{
+		m_pConsole->Print(IConsole::OUTPUT_LEVEL_STANDARD, "serverbrowse_http", "ignoring invalid serverlist cache");
+	}
+	free(pData);
+}
+
+void CServerBrowserHttp::SaveCache()
+{
+	// A slow disk just skips a refresh, the next one saves again.
+	if(m_pSaveCacheJob && m_pSaveCacheJob->Status() != IJob::STATE_DONE)
+	{
+		return;
+	}
+	std::vector<unsigned char> vData;
+	ServerbrowserSerializeServerList(m_vServers, m_vLegacyServers, &vData);
+	m_pEngine->AddJob(m_pSaveCacheJob = std::make_shared<CSaveCacheJob>(m_pStorage, std::move(vData)));
+}
+
+void CServerBrowserHttp::CSaveCacheJob::Run()
+{
+	char aTmpFile[64];
+	str_format(aTmpFile, sizeof(aTmpFile), "%s.tmp", SERVERLIST_CACHE_FILE);
+	IOHANDLE File = m_pStorage->OpenFile(aTmpFile, IOFLAG_WRITE, IStorage::TYPE_SAVE);
+	if(!File)
+	{
+		dbg_msg("serverbrowse_http", "failed to open serverlist cache for writing");
+		return;
+	}
+	bool Success = io_write(File, m_vData.data(), m_vData.size()) == m_vData.size();
+	Success = io_close(File) == 0 && Success;
+	if(!Success || !m_pStorage->RenameFile(aTmpFile, SERVERLIST_CACHE_FILE, IStorage::TYPE_SAVE))
+	{
+		dbg_msg("serverbrowse_http", "failed to write serverlist cache");
+		m_pStorage->RemoveFile(aTmpFile, IStorage::TYPE_SAVE);
+	}
+}
+
+// Bump allocator for the DOM of the server list, which is thrown away as
+// a whole after parsing.
+class CJsonArena
+{
+	enum
+	{
+		MAX_HEAP_ALLOCATION = 16 * 1024,
+	};
+	CHeap m_Heap;
+	std::vector<void *> m_vpLargeAllocations;
+
+public:
+	~CJsonArena()
+	{
+		for(void *pAllocation : m_vpLargeAllocations)
+		{
+			free(pAllocation);
+		}
+	}
+
+	static void *Alloc(size_t Size, int Zero, void *pUser)
+	{
+		CJsonArena *pArena = (CJsonArena *)pUser;
+		void *pResult;
+		if(Size > MAX_HEAP_ALLOCATION)
+		{
+			pResult = malloc(Size);
+			if(!pResult)
+			{
+				return nullptr;
+			}
+			pArena->m_vpLargeAllocations.push_back(pResult);
+		}
+		else
+		{
+			pResult = pArena->m_Heap.Allocate(maximum(Size, (size_t)1));
+		}
+		if(pResult && Zero)
+		{
+			mem_zero(pResult, Size);
+		}
+		return pResult;
+	}
+
+	static void Free(void *pPtr, void *pUser)
+	{
+	}
+};
+
+bool ServerbrowserParseServerList(const unsigned char *pData, size_t DataSize, std::vector<CServerInfo> *pvServers, std::vector<NETADDR> *pvLegacyServers)
+{
+	pvServers->clear();
+	pvLegacyServers->clear();
+
+	CJsonArena Arena;
+	json_settings Settings = {};
+	Settings.mem_alloc = CJsonArena::Alloc;
+	Settings.mem_free = CJsonArena::Free;
+	Settings.user_data = &Arena;
+	json_value *pJson = json_parse_ex(&Settings, (const json_char *)pData, DataSize, nullptr);
+	if(!pJson)
+	{
+		return true;
+	}
 
 	const json_value &Json = *pJson;
 	const json_value &Servers = Json["servers"];
@@ -388,6 +521,8 @@ bool CServerBrowserHttp::Parse(json_value *pJson, std::vector<CServerInfo> *pvSe
 	{
 		return true;
 	}
+	pvServers->reserve(Servers.u.array.length);
+	CServerInfo2 ParsedInfo;
 	for(unsigned int i = 0; i < Servers.u.array.length; i++)
 	{
 		const json_value &Server = Servers[i];
@@ -395,7 +530,6 @@ bool CServerBrowserHttp::Parse(json_value *pJson, std::vector<CServerInfo> *pvSe
 		const json_value &Info = Server["info"];
 		const json_value &Location = Server["location"];
 		int ParsedLocation = CServerInfo::LOC_UNKNOWN;
-		CServerInfo2 ParsedInfo;
 		if(Addresses.type != json_array || (Location.type != json_string && Location.type != json_none))
 		{
 			return true;
@@ -416,7 +550,7 @@ bool CServerBrowserHttp::Parse(json_value *pJson, std::vector<CServerInfo> *pvSe
 			// values.
 			continue;
 		}
-		CServerInfo SetInfo = ParsedInfo;
+		CServerInfo &SetInfo = pvServers->emplace_back(ParsedInfo);
 		SetInfo.m_Location = ParsedLocation;
 		SetInfo.m_NumAddresses = 0;
 		for(unsigned int a = 0; a < Addresses.u.array.length; a++)
@@ -424,6 +558,7 @@ bool CServerBrowserHttp::Parse(json_value *pJson, std::vector<CServerInfo> *pvSe
 			const json_value &Address = Addresses[a];
 			if(Address.type != json_string)
 			{
+				pvServers->pop_back();
 				return true;
 			}
 			NETADDR ParsedAddr;
@@ -439,9 +574,9 @@ bool CServerBrowserHttp::Parse(json_value *pJson, std::vector<CServerInfo> *pvSe
 				SetInfo.m_NumAddresses += 1;
 			}
 		}
-		if(SetInfo.m_NumAddresses > 0)
+		if(SetInfo.m_NumAddresses == 0)
 		{
-			vServers.push_back(SetInfo);
+			pvServers->pop_back();
 		}
 	}
 	if(LegacyServers.type == json_array)
@@ -454,11 +589,189 @@ bool CServerBrowserHttp::Parse(json_value *pJson, std::vector<CServerInfo> *pvSe
 			{
 				return true;
 			}
-			vLegacyServers.push_back(ParsedAddr);
+			pvLegacyServers->push_back(ParsedAddr);
+		}
+	}
+	return false;
+}
+
+// The cache stores the fields that `ServerbrowserParseServerList` fills in,
+// one by one in the format of `CPacker`, so that it can be read with
+// `CUnpacker`. Bools and enums are range checked on load.
+static const char SERVERLIST_CACHE_MAGIC[8] = {'D', 'D', 'N', 'S', 'L', 'C', 'A', 'C'};
+static const int SERVERLIST_CACHE_VERSION = 2;
+
+static void CachePackInt(std::vector<unsigned char> *pvData, int Value)
+{
+	unsigned char aBuf[CVariableInt::MAX_BYTES_PACKED];
+	const unsigned char *pEnd = CVariableInt::Pack(aBuf, Value, sizeof(aBuf));
+	pvData->insert(pvData->end(), (const unsigned char *)aBuf, pEnd);
+}
+
+static void CachePackString(std::vector<unsigned char> *pvData, const char *pStr)
+{
+	pvData->insert(pvData->end(), pStr, pStr + str_length(pStr) + 1);
+}
+
+static void CachePackAddr(std::vector<unsigned char> *pvData, const NETADDR &Addr)
+{
+	CachePackInt(pvData, Addr.type);
+	pvData->insert(pvData->end(), Addr.ip, Addr.ip + sizeof(Addr.ip));
+	CachePackInt(pvData, Addr.port);
+}
+
+void ServerbrowserSerializeServerList(const std::vector<CServerInfo> &vServers, const std::vector<NETADDR> &vLegacyServers, std::vector<unsigned char> *pvData)
+{
+	pvData->assign(std::begin(SERVERLIST_CACHE_MAGIC), std::end(SERVERLIST_CACHE_MAGIC));
+	CachePackInt(pvData, SERVERLIST_CACHE_VERSION);
+	CachePackInt(pvData, vServers.size());
+	for(const CServerInfo &Info : vServers)
+	{
+		CachePackInt(pvData, Info.m_NumAddresses);
+		for(int i = 0; i < Info.m_NumAddresses; i++)
+		{
+			CachePackAddr(pvData, Info.m_aAddresses[i]);
+		}
+		CachePackInt(pvData, Info.m_Location);
+		CachePackInt(pvData, Info.m_MaxClients);
+		CachePackInt(pvData, Info.m_NumClients);
+		CachePackInt(pvData, Info.m_MaxPlayers);
+		CachePackInt(pvData, Info.m_NumPlayers);
+		CachePackInt(pvData, Info.m_ClientScoreKind);
+		CachePackInt(pvData, Info.m_Flags);
+		CachePackString(pvData, Info.m_aGameType);
+		CachePackString(pvData, Info.m_aName);
+		CachePackString(pvData, Info.m_aMap);
+		CachePackString(pvData, Info.m_aVersion);
+		CachePackInt(pvData, Info.m_NumReceivedClients);
+		for(int i = 0; i < Info.m_NumReceivedClients; i++)
+		{
+			const CServerInfo::CClient &Client = Info.m_aClients[i];
+			CachePackString(pvData, Client.m_aName);
+			CachePackString(pvData, Client.m_aClan);
+			CachePackInt(pvData, Client.m_Country);
+			CachePackInt(pvData, Client.m_Score);
+			CachePackInt(pvData, Client.m_Player);
+			CachePackInt(pvData, Client.m_Afk);
+			CachePackString(pvData, Client.m_aSkin);
+			CachePackInt(pvData, Client.m_CustomSkinColors);
+			CachePackInt(pvData, Client.m_CustomSkinColorBody);
+			CachePackInt(pvData, Client.m_CustomSkinColorFeet);
 		}
 	}
-	*pvServers = vServers;
-	*pvLegacyServers = vLegacyServers;
+	CachePackInt(pvData, vLegacyServers.size());
+	for(const NETADDR &Addr : vLegacyServers)
+	{
+		CachePackAddr(pvData, Addr);
+	}
+}
+
+// Reads a value in [Min, Max], sets the unpacker error otherwise.
+static int CacheUnpackInt(CUnpacker *pUnpacker, int Min, int Max, bool *pError)
+{
+	int Value = pUnpacker->GetInt();
+	if(pUnpacker->Error() || Value < Min || Value > Max)
+	{
+		*pError = true;
+		return Min;
+	}
+	return Value;
+}
+
+static bool CacheUnpackBool(CUnpacker *pUnpacker, bool *pError)
+{
+	return CacheUnpackInt(pUnpacker, 0, 1, pError) == 1;
+}
+
+template<size_t N>
+static void CacheUnpackString(CUnpacker *pUnpacker, char (&aStr)[N])
+{
+	str_copy(aStr, pUnpacker->GetString(0));
+}
+
+static void CacheUnpackAddr(CUnpacker *pUnpacker, NETADDR *pAddr, bool *pError)
+{
+	*pAddr = NETADDR{};
+	pAddr->type = pUnpacker->GetInt();
+	const unsigned char *pIp = pUnpacker->GetRaw(sizeof(pAddr->ip));
+	if(pIp)
+	{
+		mem_copy(pAddr->ip, pIp, sizeof(pAddr->ip));
+	}
+	pAddr->port = CacheUnpackInt(pUnpacker, 0, 65535, pError);
+}
+
+bool ServerbrowserDeserializeServerList(const unsigned char *pData, size_t DataSize, std::vector<CServerInfo> *pvServers, std::vector<NETADDR> *pvLegacyServers)
+{
+	if(DataSize < sizeof(SERVERLIST_CACHE_MAGIC) || DataSize > (size_t)std::numeric_limits<int>::max() ||
+		mem_comp(pData, SERVERLIST_CACHE_MAGIC, sizeof(SERVERLIST_CACHE_MAGIC)) != 0)
+	{
+		return true;
+	}
+	CUnpacker Unpacker;
+	Unpacker.Reset(pData + sizeof(SERVERLIST_CACHE_MAGIC), DataSize - sizeof(SERVERLIST_CACHE_MAGIC));
+	bool Error = false;
+	if(Unpacker.GetInt() != SERVERLIST_CACHE_VERSION || Unpacker.Error())
+	{
+		return true;
+	}
+
+	std::vector<CServerInfo> vServers;
+	std::vector<NETADDR> vLegacyServers;
+	const int NumServers = CacheUnpackInt(&Unpacker, 0, std::numeric_limits<int>::max(), &Error);
+	// Don't trust the count for the allocation, every server takes up at
+	// least a few bytes.
+	vServers.reserve(minimum((size_t)NumServers, DataSize / 16));
+	for(int s = 0; s < NumServers && !Error; s++)
+	{
+		CServerInfo &Info = vServers.emplace_back();
+		Info.m_NumAddresses = CacheUnpackInt(&Unpacker, 1, MAX_SERVER_ADDRESSES, &Error);
+		for(int i = 0; i < Info.m_NumAddresses && !Error; i++)
+		{
+			CacheUnpackAddr(&Unpacker, &Info.m_aAddresses[i], &Error);
+		}
+		Info.m_Location = CacheUnpackInt(&Unpacker, CServerInfo::LOC_UNKNOWN, CServerInfo::NUM_LOCS - 1, &Error);
+		Info.m_MaxClients = Unpacker.GetInt();
+		Info.m_NumClients = Unpacker.GetInt();
+		Info.m_MaxPlayers = Unpacker.GetInt();
+		Info.m_NumPlayers = Unpacker.GetInt();
+		Info.m_ClientScoreKind = (CServerInfo::EClientScoreKind)CacheUnpackInt(&Unpacker, CServerInfo::CLIENT_SCORE_KIND_UNSPECIFIED, CServerInfo::CLIENT_SCORE_KIND_TIME_BACKCOMPAT, &Error);
+		Info.m_Flags = Unpacker.GetInt();
+		CacheUnpackString(&Unpacker, Info.m_aGameType);
+		CacheUnpackString(&Unpacker, Info.m_aName);
+		CacheUnpackString(&Unpacker, Info.m_aMap);
+		CacheUnpackString(&Unpacker, Info.m_aVersion);
+		Info.m_NumReceivedClients = CacheUnpackInt(&Unpacker, 0, SERVERINFO_MAX_CLIENTS, &Error);
+		for(int i = 0; i < Info.m_NumReceivedClients && !Error; i++)
+		{
+			CServerInfo::CClient &Client = Info.m_aClients[i];
+			CacheUnpackString(&Unpacker, Client.m_aName);
+			CacheUnpackString(&Unpacker, Client.m_aClan);
+			Client.m_Country = Unpacker.GetInt();
+			Client.m_Score = Unpacker.GetInt();
+			Client.m_Player = CacheUnpackBool(&Unpacker, &Error);
+			Client.m_Afk = CacheUnpackBool(&Unpacker, &Error);
+			CacheUnpackString(&Unpacker, Client.m_aSkin);
+			Client.m_CustomSkinColors = CacheUnpackBool(&Unpacker, &Error);
+			Client.m_CustomSkinColorBody = Unpacker.GetInt();
+			Client.m_CustomSkinColorFeet = Unpacker.GetInt();
+		}
+		Info.m_Latency = -1;
+		Error = Error || Unpacker.Error();
+	}
+	const int NumLegacyServers = CacheUnpackInt(&Unpacker, 0, std::numeric_limits<int>::max(), &Error);
+	vLegacyServers.reserve(minimum((size_t)NumLegacyServers, DataSize / 16));
+	for(int i = 0; i < NumLegacyServers && !Error; i++)
+	{
+		CacheUnpackAddr(&Unpacker, &vLegacyServers.emplace_back(), &Error);
+	}
+	if(Error || Unpacker.Error() || Unpacker.GetRaw(0) != pData + DataSize)
+	{
+		return true;
+	}
+
+	*pvServers = std::move(vServers);
+	*pvLegacyServers = std::move(vLegacyServers);
 	return false;
 }
 
@@ -506,5 +819,5 @@ IServerBrowserHttp *CreateServerBrowserHttp(IEngine *pEngine, IConsole *pConsole
 			break;
 		}
 	}
-	return new CServerBrowserHttp(pEngine, pConsole, ppUrls, NumUrls, PreviousBestIndex);
+	return new CServerBrowserHttp(pEngine, pConsole, pStorage, ppUrls, NumUrls, PreviousBestIndex);
 }
@@ -2,6 +2,8 @@
 #define ENGINE_CLIENT_SERVERBROWSER_HTTP_H
 #include <base/system.h>
 
+#include <vector>
+
 class CServerInfo;
 class IConsole;
 class IEngine;
@@ -26,4 +28,11 @@ public:
 };
 
 IServerBrowserHttp *CreateServerBrowserHttp(IEngine *pEngine, IConsole *pConsole, IStorage *pStorage, const char *pPreviousBestUrl);
+
+// Parses the JSON server list of the masters. Returns true on failure.
+bool ServerbrowserParseServerList(const unsigned char *pData, size_t DataSize, std::vector<CServerInfo> *pvServers, std::vector<NETADDR> *pvLegacyServers);
+// Binary format of the server list cache, loaded at startup before the
+// first refresh finishes. Returns true on failure.
+void ServerbrowserSerializeServerList(const std::vector<CServerInfo> &vServers, const std::vector<NETADDR> &vLegacyServers, std::vector<unsigned char> *pvData);
+bool ServerbrowserDeserializeServerList(const unsigned char *pData, size_t DataSize, std::vector<CServerInfo> *pvServers, std::vector<NETADDR> *pvLegacyServers);
 #endif // ENGINE_CLIENT_SERVERBROWSER_HTTP_H
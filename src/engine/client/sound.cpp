@@ -10,6 +10,7 @@
 #include <engine/storage.h>
 
 #include "sound.h"
+#include "sound_mix.h"
 
 #if defined(CONF_VIDEORECORDER)
 #include <engine/shared/video.h>
@@ -21,143 +22,147 @@ extern "C" {
 
 #include <cmath>
 
-void CSound::Mix(short *pFinalOut, unsigned Frames)
+void CSound::VoiceVolume(const CVoice &Voice, int CenterX, int CenterY, int *pVolumeL, int *pVolumeR)
 {
-	Frames = minimum(Frames, m_MaxFrames);
-	mem_zero(m_pMixBuffer, Frames * 2 * sizeof(int));
-
-	// acquire lock while we are mixing
-	m_SoundLock.lock();
+	int VolumeR = round_truncate(Voice.m_pChannel->m_Vol * (Voice.m_Vol / 255.0f));
+	int VolumeL = VolumeR;
 
-	const int MasterVol = m_SoundVolume.load(std::memory_order_relaxed);
-
-	for(auto &Voice : m_aVoices)
+	// volume calculation
+	if(Voice.m_Flags & ISound::FLAG_POS && Voice.m_pChannel->m_Pan)
 	{
-		if(!Voice.m_pSample)
-			continue;
-
-		// mix voice
-		int *pOut = m_pMixBuffer;
+		// TODO: we should respect the channel panning value
+		const int dx = Voice.m_X - CenterX;
+		const int dy = Voice.m_Y - CenterY;
+		float FalloffX = 0.0f;
+		float FalloffY = 0.0f;
 
-		const int Step = Voice.m_pSample->m_Channels; // setup input sources
-		short *pInL = &Voice.m_pSample->m_pData[Voice.m_Tick * Step];
-		short *pInR = &Voice.m_pSample->m_pData[Voice.m_Tick * Step + 1];
+		int RangeX = 0; // for panning
+		bool InVoiceField = false;
 
-		unsigned End = Voice.m_pSample->m_NumFrames - Voice.m_Tick;
+		switch(Voice.m_Shape)
+		{
+		case ISound::SHAPE_CIRCLE:
+		{
+			const float Radius = Voice.m_Circle.m_Radius;
+			RangeX = Radius;
 
-		int VolumeR = round_truncate(Voice.m_pChannel->m_Vol * (Voice.m_Vol / 255.0f));
-		int VolumeL = VolumeR;
+			// dx and dy can be larger than 46341 and thus the calculation would go beyond the limits of a integer,
+			// therefore we cast them into float
+			const int Dist = (int)length(vec2(dx, dy));
+			if(Dist < Radius)
+			{
+				InVoiceField = true;
 
-		// make sure that we don't go outside the sound data
-		if(Frames < End)
-			End = Frames;
+				// falloff
+				int FalloffDistance = Radius * Voice.m_Falloff;
+				if(Dist > FalloffDistance)
+					FalloffX = FalloffY = (Radius - Dist) / (Radius - FalloffDistance);
+				else
+					FalloffX = FalloffY = 1.0f;
+			}
+			else
+				InVoiceField = false;
 
-		// check if we have a mono sound
-		if(Voice.m_pSample->m_Channels == 1)
-			pInR = pInL;
+			break;
+		}
 
-		// volume calculation
-		if(Voice.m_Flags & ISound::FLAG_POS && Voice.m_pChannel->m_Pan)
+		case ISound::SHAPE_RECTANGLE:
 		{
-			// TODO: we should respect the channel panning value
-			const int dx = Voice.m_X - m_CenterX.load(std::memory_order_relaxed);
-			const int dy = Voice.m_Y - m_CenterY.load(std::memory_order_relaxed);
-			float FalloffX = 0.0f;
-			float FalloffY = 0.0f;
+			RangeX = Voice.m_Rectangle.m_Width / 2.0f;
+
+			const int abs_dx = absolute(dx);
+			const int abs_dy = absolute(dy);
 
-			int RangeX = 0; // for panning
-			bool InVoiceField = false;
+			const int w = Voice.m_Rectangle.m_Width / 2.0f;
+			const int h = Voice.m_Rectangle.m_Height / 2.0f;
 
-			switch(Voice.m_Shape)
+			if(abs_dx < w && abs_dy < h)
 			{
-			case ISound::SHAPE_CIRCLE:
+				InVoiceField = true;
+
+				// falloff
+				int fx = Voice.m_Falloff * w;
+				int fy = Voice.m_Falloff * h;
+
+				FalloffX = abs_dx > fx ? (float)(w - abs_dx) / (w - fx) : 1.0f;
+				FalloffY = abs_dy > fy ? (float)(h - abs_dy) / (h - fy) : 1.0f;
+			}
+			else
+				InVoiceField = false;
+
+			break;
+		}
+		};
+
+		if(InVoiceField)
+		{
+			// panning
+			if(!(Voice.m_Flags & ISound::FLAG_NO_PANNING))
 			{
-				const float Radius = Voice.m_Circle.m_Radius;
-				RangeX = Radius;
-
-				// dx and dy can be larger than 46341 and thus the calculation would go beyond the limits of a integer,
-				// therefore we cast them into float
-				const int Dist = (int)length(vec2(dx, dy));
-				if(Dist < Radius)
-				{
-					InVoiceField = true;
-
-					// falloff
-					int FalloffDistance = Radius * Voice.m_Falloff;
-					if(Dist > FalloffDistance)
-						FalloffX = FalloffY = (Radius - Dist) / (Radius - FalloffDistance);
-					else
-						FalloffX = FalloffY = 1.0f;
-				}
+				if(dx > 0)
+					VolumeL = ((RangeX - absolute(dx)) * VolumeL) / RangeX;
 				else
-					InVoiceField = false;
-
-				break;
+					VolumeR = ((RangeX - absolute(dx)) * VolumeR) / RangeX;
 			}
 
-			case ISound::SHAPE_RECTANGLE:
 			{
-				RangeX = Voice.m_Rectangle.m_Width / 2.0f;
+				VolumeL *= FalloffX * FalloffY;
+				VolumeR *= FalloffX * FalloffY;
+			}
+		}
+		else
+		{
+			VolumeL = 0;
+			VolumeR = 0;
+		}
+	}
 
-				const int abs_dx = absolute(dx);
-				const int abs_dy = absolute(dy);
+	*pVolumeL = VolumeL;
+	*pVolumeR = VolumeR;
+}
 
-				const int w = Voice.m_Rectangle.m_Width / 2.0f;
-				const int h = Voice.m_Rectangle.m_Height / 2.0f;
+void CSound::Mix(short *pFinalOut, unsigned Frames)
+{
+	Frames = minimum(Frames, m_MaxFrames);
+	mem_zero(m_pMixBuffer, Frames * 2 * sizeof(int));
 
-				if(abs_dx < w && abs_dy < h)
-				{
-					InVoiceField = true;
+	// keeps the sample data alive until the voices are mixed
+	const CLockScope MixLockScope(m_MixLock);
 
-					// falloff
-					int fx = Voice.m_Falloff * w;
-					int fy = Voice.m_Falloff * h;
+	// only take what is needed to mix the voices while holding the lock,
+	// the game thread must not wait for the mixing itself
+	int NumMixVoices = 0;
+	m_SoundLock.lock();
 
-					FalloffX = abs_dx > fx ? (float)(w - abs_dx) / (w - fx) : 1.0f;
-					FalloffY = abs_dy > fy ? (float)(h - abs_dy) / (h - fy) : 1.0f;
-				}
-				else
-					InVoiceField = false;
+	const int MasterVol = m_SoundVolume.load(std::memory_order_relaxed);
+	const int CenterX = m_CenterX.load(std::memory_order_relaxed);
+	const int CenterY = m_CenterY.load(std::memory_order_relaxed);
 
-				break;
-			}
-			};
+	for(auto &Voice : m_aVoices)
+	{
+		if(!Voice.m_pSample)
+			continue;
 
-			if(InVoiceField)
-			{
-				// panning
-				if(!(Voice.m_Flags & ISound::FLAG_NO_PANNING))
-				{
-					if(dx > 0)
-						VolumeL = ((RangeX - absolute(dx)) * VolumeL) / RangeX;
-					else
-						VolumeR = ((RangeX - absolute(dx)) * VolumeR) / RangeX;
-				}
-
-				{
-					VolumeL *= FalloffX * FalloffY;
-					VolumeR *= FalloffX * FalloffY;
-				}
-			}
-			else
-			{
-				VolumeL = 0;
-				VolumeR = 0;
-			}
-		}
+		// make sure that we don't go outside the sound data
+		const unsigned End = Voice.m_Tick < Voice.m_pSample->m_NumFrames ? minimum<unsigned>(Frames, Voice.m_pSample->m_NumFrames - Voice.m_Tick) : 0;
 
-		// process all frames
-		for(unsigned s = 0; s < End; s++)
+		int VolumeL, VolumeR;
+		VoiceVolume(Voice, CenterX, CenterY, &VolumeL, &VolumeR);
+
+		// voices that cannot be heard only advance
+		if(End > 0 && (VolumeL != 0 || VolumeR != 0))
 		{
-			*pOut++ += (*pInL) * VolumeL;
-			*pOut++ += (*pInR) * VolumeR;
-			pInL += Step;
-			pInR += Step;
-			Voice.m_Tick++;
+			CMixVoice &MixVoice = m_aMixVoices[NumMixVoices++];
+			MixVoice.m_pData = &Voice.m_pSample->m_pData[Voice.m_Tick * Voice.m_pSample->m_Channels];
+			MixVoice.m_Frames = End;
+			MixVoice.m_Channels = Voice.m_pSample->m_Channels;
+			MixVoice.m_VolumeL = VolumeL;
+			MixVoice.m_VolumeR = VolumeR;
 		}
+		Voice.m_Tick += End;
 
 		// free voice if not used any more
-		if(Voice.m_Tick == Voice.m_pSample->m_NumFrames)
+		if(Voice.m_Tick >= Voice.m_pSample->m_NumFrames)
 		{
 			if(Voice.m_Flags & ISound::FLAG_LOOP)
 				Voice.m_Tick = 0;
@@ -171,9 +176,19 @@ void CSound::Mix(short *pFinalOut, unsigned Frames)
 
 	m_SoundLock.unlock();
 
+	// mix voices
+	const CSoundMix *pMix = CSoundMix::Active();
+	for(int i = 0; i < NumMixVoices; i++)
+	{
+		const CMixVoice &MixVoice = m_aMixVoices[i];
+		if(MixVoice.m_Channels == 1)
+			pMix->m_pfnMixMono(m_pMixBuffer, MixVoice.m_pData, MixVoice.m_Frames, MixVoice.m_VolumeL, MixVoice.m_VolumeR);
+		else
+			pMix->m_pfnMixStereo(m_pMixBuffer, MixVoice.m_pData, MixVoice.m_Frames, MixVoice.m_VolumeL, MixVoice.m_VolumeR);
+	}
+
 	// clamp accumulated values
-	for(unsigned i = 0; i < Frames * 2; i++)
-		pFinalOut[i] = clamp<int>(((m_pMixBuffer[i] * MasterVol) / 101) >> 8, std::numeric_limits<short>::min(), std::numeric_limits<short>::max());
+	pMix->m_pfnClip(m_pMixBuffer, pFinalOut, Frames * 2, MasterVol);
 
 #if defined(CONF_ARCH_ENDIAN_BIG)
 	swap_endian(pFinalOut, sizeof(short), Frames * 2);
@@ -614,6 +629,9 @@ void CSound::UnloadSample(int SampleID)
 		return;
 
 	Stop(SampleID);
+
+	// wait for the mixer if it still uses the sample data
+	const CLockScope MixLockScope(m_MixLock);
 	free(m_aSamples[SampleID].m_pData);
 	m_aSamples[SampleID].m_pData = nullptr;
 }
@@ -56,9 +56,20 @@ class CSound : public IEngineSound
 		NUM_CHANNELS = 16,
 	};
 
+	// what the mixer needs of a voice, copied while holding the sound lock
+	struct CMixVoice
+	{
+		const short *m_pData;
+		unsigned m_Frames;
+		int m_Channels;
+		int m_VolumeL;
+		int m_VolumeR;
+	};
+
 	bool m_SoundEnabled = false;
 	SDL_AudioDeviceID m_Device = 0;
 	CLock m_SoundLock;
+	CLock m_MixLock;
 
 	CSample m_aSamples[NUM_SAMPLES] = {{0}};
 	CVoice m_aVoices[NUM_VOICES] = {{0}};
@@ -75,6 +86,7 @@ class CSound : public IEngineSound
 	IStorage *m_pStorage = nullptr;
 
 	int *m_pMixBuffer = nullptr;
+	CMixVoice m_aMixVoices[NUM_VOICES];
 
 	int AllocID();
 	void RateConvert(CSample &Sample);
@@ -83,11 +95,12 @@ class CSound : public IEngineSound
 	bool DecodeWV(CSample &Sample, const void *pData, unsigned DataSize);
 
 	void UpdateVolume();
+	static void VoiceVolume(const CVoice &Voice, int CenterX, int CenterY, int *pVolumeL, int *pVolumeR);
 
 public:
 	int Init() override;
 	int Update() override;
-	void Shutdown() override REQUIRES(!m_SoundLock);
+	void Shutdown() override REQUIRES(!m_SoundLock, !m_MixLock);
 
 	bool IsSoundEnabled() override { return m_SoundEnabled; }
 
@@ -95,7 +108,7 @@ public:
 	int LoadWV(const char *pFilename, int StorageType = IStorage::TYPE_ALL) override;
 	int LoadOpusFromMem(const void *pData, unsigned DataSize, bool FromEditor) override;
 	int LoadWVFromMem(const void *pData, unsigned DataSize, bool FromEditor) override;
-	void UnloadSample(int SampleID) override REQUIRES(!m_SoundLock);
+	void UnloadSample(int SampleID) override REQUIRES(!m_SoundLock, !m_MixLock);
 
 	float GetSampleTotalTime(int SampleID) override; // in s
 	float GetSampleCurrentTime(int SampleID) override REQUIRES(!m_SoundLock); // in s
@@ -121,7 +134,7 @@ public:
 	void StopVoice(CVoiceHandle Voice) override REQUIRES(!m_SoundLock);
 	bool IsPlaying(int SampleID) override REQUIRES(!m_SoundLock);
 
-	void Mix(short *pFinalOut, unsigned Frames) override REQUIRES(!m_SoundLock);
+	void Mix(short *pFinalOut, unsigned Frames) override REQUIRES(!m_SoundLock, !m_MixLock);
 	void PauseAudioDevice() override;
 	void UnpauseAudioDevice() override;
 };
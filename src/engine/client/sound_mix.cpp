@@ -0,0 +1,234 @@
+#include "sound_mix.h"
+
+#include <base/detect.h>
+
+#include <cstdint>
+
+#if defined(CONF_ARCH_AMD64) || defined(CONF_ARCH_IA32)
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SOUND_MIX_SSE2 1
+#endif
+#endif
+
+#if defined(CONF_ARCH_ARM64) && defined(__ARM_NEON)
+#define SOUND_MIX_NEON 1
+#endif
+
+#if defined(SOUND_MIX_SSE2)
+#include <emmintrin.h>
+#elif defined(SOUND_MIX_NEON)
+#include <arm_neon.h>
+#endif
+
+// scalar
+
+static void MixMonoScalar(int *pOut, const short *pIn, unsigned Frames, int VolumeL, int VolumeR)
+{
+	for(unsigned i = 0; i < Frames; i++)
+	{
+		pOut[i * 2] += pIn[i] * VolumeL;
+		pOut[i * 2 + 1] += pIn[i] * VolumeR;
+	}
+}
+
+static void MixStereoScalar(int *pOut, const short *pIn, unsigned Frames, int VolumeL, int VolumeR)
+{
+	for(unsigned i = 0; i < Frames; i++)
+	{
+		pOut[i * 2] += pIn[i * 2] * VolumeL;
+		pOut[i * 2 + 1] += pIn[i * 2 + 1] * VolumeR;
+	}
+}
+
+static short ClipValue(int Mix, int MasterVolume)
+{
+	// 64 bit so that many loud voices saturate instead of overflowing
+	const int64_t Value = ((int64_t)Mix * MasterVolume / 101) >> 8;
+	return Value < INT16_MIN ? INT16_MIN : (Value > INT16_MAX ? INT16_MAX : Value);
+}
+
+static void ClipScalar(const int *pMix, short *pOut, unsigned Num, int MasterVolume)
+{
+	for(unsigned i = 0; i < Num; i++)
+		pOut[i] = ClipValue(pMix[i], MasterVolume);
+}
+
+// The vector versions multiply in 16 bit, volumes outside of that range
+// fall back to the scalar loop. The clipping divides in double precision,
+// which is exact for all products of 32 bit mix values and the master volume.
+static bool VolumesFit16(int VolumeL, int VolumeR)
+{
+	return VolumeL >= INT16_MIN && VolumeL <= INT16_MAX && VolumeR >= INT16_MIN && VolumeR <= INT16_MAX;
+}
+
+#if defined(SOUND_MIX_SSE2)
+
+// SSE2
+
+// multiplies the 8 samples with the volumes and adds the 32 bit products to pOut
+static inline void MixAddSse2(int *pOut, __m128i Samples, __m128i Volume)
+{
+	const __m128i Low = _mm_mullo_epi16(Samples, Volume);
+	const __m128i High = _mm_mulhi_epi16(Samples, Volume);
+	_mm_storeu_si128((__m128i *)pOut, _mm_add_epi32(_mm_loadu_si128((const __m128i *)pOut), _mm_unpacklo_epi16(Low, High)));
+	_mm_storeu_si128((__m128i *)(pOut + 4), _mm_add_epi32(_mm_loadu_si128((const __m128i *)(pOut + 4)), _mm_unpackhi_epi16(Low, High)));
+}
+
+static void MixMonoSse2(int *pOut, const short *pIn, unsigned Frames, int VolumeL, int VolumeR)
+{
+	if(!VolumesFit16(VolumeL, VolumeR))
+	{
+		MixMonoScalar(pOut, pIn, Frames, VolumeL, VolumeR);
+		return;
+	}
+
+	const __m128i Volume = _mm_set_epi16(VolumeR, VolumeL, VolumeR, VolumeL, VolumeR, VolumeL, VolumeR, VolumeL);
+	unsigned i = 0;
+	for(; i + 8 <= Frames; i += 8)
+	{
+		const __m128i Samples = _mm_loadu_si128((const __m128i *)(pIn + i));
+		MixAddSse2(pOut + i * 2, _mm_unpacklo_epi16(Samples, Samples), Volume);
+		MixAddSse2(pOut + i * 2 + 8, _mm_unpackhi_epi16(Samples, Samples), Volume);
+	}
+	MixMonoScalar(pOut + i * 2, pIn + i, Frames - i, VolumeL, VolumeR);
+}
+
+static void MixStereoSse2(int *pOut, const short *pIn, unsigned Frames, int VolumeL, int VolumeR)
+{
+	if(!VolumesFit16(VolumeL, VolumeR))
+	{
+		MixStereoScalar(pOut, pIn, Frames, VolumeL, VolumeR);
+		return;
+	}
+
+	const __m128i Volume = _mm_set_epi16(VolumeR, VolumeL, VolumeR, VolumeL, VolumeR, VolumeL, VolumeR, VolumeL);
+	unsigned i = 0;
+	for(; i + 4 <= Frames; i += 4)
+		MixAddSse2(pOut + i * 2, _mm_loadu_si128((const __m128i *)(pIn + i * 2)), Volume);
+	MixStereoScalar(pOut + i * 2, pIn + i * 2, Frames - i, VolumeL, VolumeR);
+}
+
+// scales and truncates two values, the result is in the lower half
+static inline __m128i ClipScaleSse2(__m128i Mix, __m128d MasterVolume)
+{
+	const __m128d Limit = _mm_set1_pd(INT32_MAX);
+	__m128d Value = _mm_div_pd(_mm_mul_pd(_mm_cvtepi32_pd(Mix), MasterVolume), _mm_set1_pd(101.0));
+	Value = _mm_max_pd(_mm_min_pd(Value, Limit), _mm_sub_pd(_mm_setzero_pd(), Limit));
+	return _mm_cvttpd_epi32(Value);
+}
+
+static inline __m128i ClipFourSse2(const int *pMix, __m128d MasterVolume)
+{
+	const __m128i Mix = _mm_loadu_si128((const __m128i *)pMix);
+	const __m128i Value = _mm_unpacklo_epi64(ClipScaleSse2(Mix, MasterVolume), ClipScaleSse2(_mm_shuffle_epi32(Mix, _MM_SHUFFLE(3, 2, 3, 2)), MasterVolume));
+	return _mm_srai_epi32(Value, 8);
+}
+
+static void ClipSse2(const int *pMix, short *pOut, unsigned Num, int MasterVolume)
+{
+	const __m128d Volume = _mm_set1_pd(MasterVolume);
+	unsigned i = 0;
+	for(; i + 8 <= Num; i += 8)
+		_mm_storeu_si128((__m128i *)(pOut + i), _mm_packs_epi32(ClipFourSse2(pMix + i, Volume), ClipFourSse2(pMix + i + 4, Volume)));
+	ClipScalar(pMix + i, pOut + i, Num - i, MasterVolume);
+}
+
+#elif defined(SOUND_MIX_NEON)
+
+// NEON
+
+static void MixMonoNeon(int *pOut, const short *pIn, unsigned Frames, int VolumeL, int VolumeR)
+{
+	if(!VolumesFit16(VolumeL, VolumeR))
+	{
+		MixMonoScalar(pOut, pIn, Frames, VolumeL, VolumeR);
+		return;
+	}
+
+	const int16_t aVolume[4] = {(int16_t)VolumeL, (int16_t)VolumeR, (int16_t)VolumeL, (int16_t)VolumeR};
+	const int16x4_t Volume = vld1_s16(aVolume);
+	unsigned i = 0;
+	for(; i + 4 <= Frames; i += 4)
+	{
+		const int16x4_t Samples = vld1_s16(pIn + i);
+		const int16x4x2_t Duplicated = vzip_s16(Samples, Samples);
+		vst1q_s32(pOut + i * 2, vmlal_s16(vld1q_s32(pOut + i * 2), Duplicated.val[0], Volume));
+		vst1q_s32(pOut + i * 2 + 4, vmlal_s16(vld1q_s32(pOut + i * 2 + 4), Duplicated.val[1], Volume));
+	}
+	MixMonoScalar(pOut + i * 2, pIn + i, Frames - i, VolumeL, VolumeR);
+}
+
+static void MixStereoNeon(int *pOut, const short *pIn, unsigned Frames, int VolumeL, int VolumeR)
+{
+	if(!VolumesFit16(VolumeL, VolumeR))
+	{
+		MixStereoScalar(pOut, pIn, Frames, VolumeL, VolumeR);
+		return;
+	}
+
+	const int16_t aVolume[4] = {(int16_t)VolumeL, (int16_t)VolumeR, (int16_t)VolumeL, (int16_t)VolumeR};
+	const int16x4_t Volume = vld1_s16(aVolume);
+	unsigned i = 0;
+	for(; i + 4 <= Frames; i += 4)
+	{
+		const int16x8_t Samples = vld1q_s16(pIn + i * 2);
+		vst1q_s32(pOut + i * 2, vmlal_s16(vld1q_s32(pOut + i * 2), vget_low_s16(Samples), Volume));
+		vst1q_s32(pOut + i * 2 + 4, vmlal_s16(vld1q_s32(pOut + i * 2 + 4), vget_high_s16(Samples), Volume));
+	}
+	MixStereoScalar(pOut + i * 2, pIn + i * 2, Frames - i, VolumeL, VolumeR);
+}
+
+static inline int32x2_t ClipScaleNeon(int32x2_t Mix, float64x2_t MasterVolume)
+{
+	const float64x2_t Limit = vdupq_n_f64(INT32_MAX);
+	float64x2_t Value = vdivq_f64(vmulq_f64(vcvtq_f64_s64(vmovl_s32(Mix)), MasterVolume), vdupq_n_f64(101.0));
+	Value = vmaxq_f64(vminq_f64(Value, Limit), vnegq_f64(Limit));
+	return vmovn_s64(vcvtq_s64_f64(Value));
+}
+
+static void ClipNeon(const int *pMix, short *pOut, unsigned Num, int MasterVolume)
+{
+	const float64x2_t Volume = vdupq_n_f64(MasterVolume);
+	unsigned i = 0;
+	for(; i + 4 <= Num; i += 4)
+	{
+		const int32x4_t Mix = vld1q_s32(pMix + i);
+		const int32x4_t Value = vcombine_s32(ClipScaleNeon(vget_low_s32(Mix), Volume), ClipScaleNeon(vget_high_s32(Mix), Volume));
+		vst1_s16(pOut + i, vqmovn_s32(vshrq_n_s32(Value, 8)));
+	}
+	ClipScalar(pMix + i, pOut + i, Num - i, MasterVolume);
+}
+
+#endif
+
+static const CSoundMix s_aImpls[CSoundMix::NUM_IMPLS] = {
+	{"scalar", MixMonoScalar, MixStereoScalar, ClipScalar},
+#if defined(SOUND_MIX_SSE2)
+	{"sse2", MixMonoSse2, MixStereoSse2, ClipSse2},
+#else
+	{"sse2", nullptr, nullptr, nullptr},
+#endif
+#if defined(SOUND_MIX_NEON)
+	{"neon", MixMonoNeon, MixStereoNeon, ClipNeon},
+#else
+	{"neon", nullptr, nullptr, nullptr},
+#endif
+};
+
+const CSoundMix *CSoundMix::Get(int Impl)
+{
+	if(Impl < 0 || Impl >= NUM_IMPLS || !s_aImpls[Impl].m_pfnMixMono)
+		return nullptr;
+	return &s_aImpls[Impl];
+}
+
+const CSoundMix *CSoundMix::Active()
+{
+	static const CSoundMix *s_pActive = []() {
+		for(int Impl = NUM_IMPLS - 1; Impl > IMPL_SCALAR; Impl--)
+			if(Get(Impl))
+				return Get(Impl);
+		return Get(IMPL_SCALAR);
+	}();
+	return s_pActive;
+}
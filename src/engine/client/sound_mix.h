@@ -0,0 +1,33 @@
+#ifndef ENGINE_CLIENT_SOUND_MIX_H
+#define ENGINE_CLIENT_SOUND_MIX_H
+
+// Inner loops of the sound mixer. The output is interleaved stereo. All
+// implementations produce exactly the same results as the scalar one, the
+// fastest one supported by the CPU is selected at compile time.
+class CSoundMix
+{
+public:
+	enum
+	{
+		IMPL_SCALAR = 0,
+		IMPL_SSE2,
+		IMPL_NEON,
+		NUM_IMPLS,
+	};
+
+	// adds the frames of a mono or stereo sample scaled by the volumes (0 - 255) to pOut
+	typedef void (*FMix)(int *pOut, const short *pIn, unsigned Frames, int VolumeL, int VolumeR);
+	// scales the mixed values by the master volume (0 - 100) and clamps them to 16 bit
+	typedef void (*FClip)(const int *pMix, short *pOut, unsigned Num, int MasterVolume);
+
+	const char *m_pName;
+	FMix m_pfnMixMono;
+	FMix m_pfnMixStereo;
+	FClip m_pfnClip;
+
+	// returns nullptr if the implementation is not supported
+	static const CSoundMix *Get(int Impl);
+	static const CSoundMix *Active();
+};
+
+#endif
@@ -107,9 +107,17 @@ class IDemoRecorder : public IInterface
 {
 	MACRO_INTERFACE("demorecorder", 0)
 public:
+	enum class EStopMode
+	{
+		KEEP_FILE,
+		REMOVE_FILE,
+	};
+
 	virtual ~IDemoRecorder() {}
 	virtual bool IsRecording() const = 0;
-	virtual int Stop() = 0;
+	// the file is finished in the background, then renamed to
+	// pTargetFilename if given or removed with EStopMode::REMOVE_FILE
+	virtual int Stop(EStopMode Mode = EStopMode::KEEP_FILE, const char *pTargetFilename = "") = 0;
 	virtual int Length() const = 0;
 	virtual char *GetCurrentFilename() = 0;
 };
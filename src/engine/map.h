@@ -34,10 +34,13 @@ class IEngineMap : public IMap
 {
 	MACRO_INTERFACE("enginemap", 0)
 public:
-	virtual bool Load(const char *pMapName) = 0;
+	// Mmap maps the file into memory while loading it, see datafile_mmap
+	virtual bool Load(const char *pMapName, bool Mmap) = 0;
 	virtual void Unload() = 0;
 	virtual bool IsLoaded() const = 0;
 	virtual IOHANDLE File() const = 0;
+	// loads all data of the map in parallel, instead of when it is first requested
+	virtual void PreloadData() = 0;
 
 	virtual SHA256_DIGEST Sha256() const = 0;
 	virtual unsigned Crc() const = 0;
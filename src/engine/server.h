@@ -224,6 +224,25 @@ public:
 
 	virtual void SnapSetStaticsize(int ItemType, int Size) = 0;
 
+	/**
+	 * Returns whether the shared world snapshot has been built for the
+	 * current tick, see `IGameServer::OnSnapShared`.
+	 */
+	virtual bool SnapSharedAvailable() const = 0;
+	/**
+	 * Returns the number of items in the shared world snapshot so far.
+	 * The items created between two marks can be copied into a client
+	 * snapshot using `SnapCopySharedItems`.
+	 */
+	virtual int SnapSharedItemMark() const = 0;
+	virtual void SnapCopySharedItems(int From, int To) = 0;
+	/**
+	 * Returns whether an item didn't fit into the shared world snapshot.
+	 * The shared snapshot isn't clipped, so it can run out of space
+	 * before the client snapshots do.
+	 */
+	virtual bool SnapSharedItemsFull() const = 0;
+
 	enum
 	{
 		RCON_CID_SERV = -1,
@@ -289,6 +308,9 @@ public:
 	virtual void OnTick() = 0;
 	virtual void OnPreSnap() = 0;
 	virtual void OnSnap(int ClientID) = 0;
+	// Called once per tick before `OnSnap` if `sv_shared_snapshot` is
+	// enabled. Items created here go to the shared world snapshot.
+	virtual void OnSnapShared() = 0;
 	virtual void OnPostSnap() = 0;
 
 	virtual void OnMessage(int MsgID, CUnpacker *pUnpacker, int ClientID) = 0;
@@ -48,9 +48,12 @@ public:
 	virtual void Disconnect() = 0;
 
 	// ? for Placeholders, connection has to be established, can overwrite previous prepared statements
+	// compiled statements are cached by their text, so values should be bound instead of formatted into it
 	//
 	// returns true on failure
 	virtual bool PrepareStatement(const char *pStmt, char *pError, int ErrorSize) = 0;
+	int64_t NumStatementCacheHits() const { return m_StatementCacheHits; }
+	int64_t NumStatementCacheMisses() const { return m_StatementCacheMisses; }
 
 	// PrepareStatement has to be called beforehand,
 	virtual void BindString(int Idx, const char *pString) = 0;
@@ -88,6 +91,14 @@ private:
 	char m_aPrefix[64];
 
 protected:
+	enum
+	{
+		// the cache is cleared when it is full
+		MAX_CACHED_STATEMENTS = 64,
+	};
+	int64_t m_StatementCacheHits = 0;
+	int64_t m_StatementCacheMisses = 0;
+
 	void FormatCreateRace(char *aBuf, unsigned int BufferSize, bool Backup);
 	void FormatCreateTeamrace(char *aBuf, unsigned int BufferSize, const char *pIdType, bool Backup);
 	void FormatCreateMaps(char *aBuf, unsigned int BufferSize);
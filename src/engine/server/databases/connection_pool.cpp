@@ -1,13 +1,16 @@
 #include "connection_pool.h"
 #include "connection.h"
 
+#include <base/math.h>
 #include <base/system.h>
 #include <cstring>
 #include <engine/console.h>
+#include <engine/shared/config.h>
 
 #include <chrono>
 #include <iterator>
 #include <memory>
+#include <mutex>
 #include <thread>
 #include <vector>
 
@@ -64,6 +67,9 @@ struct CSqlExecData
 
 	std::unique_ptr<const ISqlData> m_pThreadData;
 	const char *m_pName;
+	int64_t m_SubmitTime = time_get();
+	// read queries: number of write lane queries submitted before
+	int64_t m_NumWriteLaneQueriesBefore = 0;
 };
 
 CSqlExecData::CSqlExecData(
@@ -119,23 +125,40 @@ CSqlExecData::CSqlExecData(IConsole *pConsole, CDbConnectionPool::Mode m) :
 
 void CDbConnectionPool::Print(IConsole *pConsole, Mode DatabaseMode)
 {
-	m_pShared->m_aQueries[m_InsertIdx++] = std::make_unique<CSqlExecData>(pConsole, DatabaseMode);
-	m_InsertIdx %= std::size(m_pShared->m_aQueries);
-	m_pShared->m_NumBackup.Signal();
+	if(DatabaseMode == Mode::READ)
+	{
+		AddReadQuery(std::make_unique<CSqlExecData>(pConsole, DatabaseMode));
+		return;
+	}
+	AddWriteLaneQuery(std::make_unique<CSqlExecData>(pConsole, DatabaseMode));
 }
 
 void CDbConnectionPool::RegisterSqliteDatabase(Mode DatabaseMode, const char aFileName[64])
 {
-	m_pShared->m_aQueries[m_InsertIdx++] = std::make_unique<CSqlExecData>(DatabaseMode, aFileName);
-	m_InsertIdx %= std::size(m_pShared->m_aQueries);
-	m_pShared->m_NumBackup.Signal();
+	if(DatabaseMode == Mode::READ)
+	{
+		CReadServer Server;
+		Server.m_Mysql = false;
+		mem_copy(Server.m_aSqliteFile, aFileName, sizeof(Server.m_aSqliteFile));
+		CLockScope ls(m_pShared->m_ReadLock);
+		m_pShared->m_vReadServers.push_back(Server);
+		return;
+	}
+	AddWriteLaneQuery(std::make_unique<CSqlExecData>(DatabaseMode, aFileName));
 }
 
 void CDbConnectionPool::RegisterMysqlDatabase(Mode DatabaseMode, const CMysqlConfig *pMysqlConfig)
 {
-	m_pShared->m_aQueries[m_InsertIdx++] = std::make_unique<CSqlExecData>(DatabaseMode, pMysqlConfig);
-	m_InsertIdx %= std::size(m_pShared->m_aQueries);
-	m_pShared->m_NumBackup.Signal();
+	if(DatabaseMode == Mode::READ)
+	{
+		CReadServer Server;
+		Server.m_Mysql = true;
+		mem_copy(&Server.m_MysqlConfig, pMysqlConfig, sizeof(Server.m_MysqlConfig));
+		CLockScope ls(m_pShared->m_ReadLock);
+		m_pShared->m_vReadServers.push_back(Server);
+		return;
+	}
+	AddWriteLaneQuery(std::make_unique<CSqlExecData>(DatabaseMode, pMysqlConfig));
 }
 
 void CDbConnectionPool::Execute(
@@ -143,9 +166,7 @@ void CDbConnectionPool::Execute(
 	std::unique_ptr<const ISqlData> pSqlRequestData,
 	const char *pName)
 {
-	m_pShared->m_aQueries[m_InsertIdx++] = std::make_unique<CSqlExecData>(pFunc, std::move(pSqlRequestData), pName);
-	m_InsertIdx %= std::size(m_pShared->m_aQueries);
-	m_pShared->m_NumBackup.Signal();
+	AddReadQuery(std::make_unique<CSqlExecData>(pFunc, std::move(pSqlRequestData), pName));
 }
 
 void CDbConnectionPool::ExecuteWrite(
@@ -153,7 +174,26 @@ void CDbConnectionPool::ExecuteWrite(
 	std::unique_ptr<const ISqlData> pSqlRequestData,
 	const char *pName)
 {
-	m_pShared->m_aQueries[m_InsertIdx++] = std::make_unique<CSqlExecData>(pFunc, std::move(pSqlRequestData), pName);
+	m_pShared->m_aStats[LANE_WRITE].m_Queued++;
+	AddWriteLaneQuery(std::make_unique<CSqlExecData>(pFunc, std::move(pSqlRequestData), pName));
+}
+
+void CDbConnectionPool::AddReadQuery(std::unique_ptr<CSqlExecData> pData)
+{
+	StartReadWorkers();
+	pData->m_NumWriteLaneQueriesBefore = m_NumWriteLaneQueries;
+	m_pShared->m_aStats[LANE_READ].m_Queued++;
+	{
+		CLockScope ls(m_pShared->m_ReadLock);
+		m_pShared->m_vpReadQueries.push_back(std::move(pData));
+	}
+	m_pShared->m_NumRead.Signal();
+}
+
+void CDbConnectionPool::AddWriteLaneQuery(std::unique_ptr<CSqlExecData> pData)
+{
+	m_NumWriteLaneQueries++;
+	m_pShared->m_aQueries[m_InsertIdx++] = std::move(pData);
 	m_InsertIdx %= std::size(m_pShared->m_aQueries);
 	m_pShared->m_NumBackup.Signal();
 }
@@ -163,8 +203,24 @@ void CDbConnectionPool::OnShutdown()
 	if(m_Shutdown)
 		return;
 	m_Shutdown = true;
+	{
+		// wake up read workers waiting for writes
+		std::unique_lock<std::mutex> Lock(m_pShared->m_WriteLaneDoneMutex);
+		m_pShared->m_ReadShutdown.store(true);
+	}
+	m_pShared->m_WriteLaneDoneCond.notify_all();
+	{
+		CLockScope ls(m_pShared->m_ReadLock);
+		for(size_t i = 0; i < m_vpReadThreads.size(); i++)
+			m_pShared->m_vpReadQueries.push_back(nullptr);
+	}
+	for(size_t i = 0; i < m_vpReadThreads.size(); i++)
+		m_pShared->m_NumRead.Signal();
 	m_pShared->m_Shutdown.store(true);
 	m_pShared->m_NumBackup.Signal();
+	for(void *pThread : m_vpReadThreads)
+		thread_wait(pThread);
+	m_vpReadThreads.clear();
 	int i = 0;
 	while(m_pShared->m_Shutdown.load())
 	{
@@ -234,10 +290,18 @@ void CBackup::ProcessQueries()
 	}
 }
 
-// the worker threads executes queries on mysql or sqlite. If we write on
-// a mysql server and have a backup server configured, we'll remove the
-// entry from the backup server after completing it on the write server.
-// static void Worker(void *pUser);
+// The write worker thread executes the write queries in order on mysql or
+// sqlite. If we write on a mysql server and have a backup server configured,
+// we'll remove the entry from the backup server after completing it on the
+// write server.
+//
+// There are two possible configurations
+//  * sqlite mode: There exists exactly one READ and the same WRITE server
+//                 with no WRITE_BACKUP server
+//  * mysql mode: there can exist multiple READ server, there must be at
+//                most one WRITE server. The WRITE server for all DDNet
+//                Servers must be the same (to counteract double loads).
+//                There may be one WRITE_BACKUP sqlite server.
 class CWorker
 {
 public:
@@ -249,15 +313,6 @@ public:
 private:
 	void Print(IConsole *pConsole, CDbConnectionPool::Mode DatabaseMode);
 
-	// There are two possible configurations
-	//  * sqlite mode: There exists exactly one READ and the same WRITE server
-	//                 with no WRITE_BACKUP server
-	//  * mysql mode: there can exist multiple READ server, there must be at
-	//                most one WRITE server. The WRITE server for all DDNet
-	//                Servers must be the same (to counteract double loads).
-	//                There may be one WRITE_BACKUP sqlite server.
-	// This variable should only change, before the worker threads
-	std::vector<std::unique_ptr<IDbConnection>> m_vpReadConnections;
 	std::unique_ptr<IDbConnection> m_pWriteConnection;
 	std::unique_ptr<IDbConnection> m_pWriteBackup;
 
@@ -274,10 +329,8 @@ void CWorker::Start(void *pUser)
 
 void CWorker::ProcessQueries()
 {
-	// remember last working server and try to connect to it first
-	int ReadServer = 0;
-	// enter fail mode when a sql request fails, skip read request during it and
-	// write to the backup database until all requests are handled
+	// enter fail mode when a sql request fails, write to the backup database
+	// until all requests are handled
 	bool FailMode = false;
 	for(int JobNum = 0;; JobNum++)
 	{
@@ -294,39 +347,15 @@ void CWorker::ProcessQueries()
 			return;
 		}
 		bool Success = false;
+		const int64_t StartTime = time_get();
 		switch(pThreadData->m_Mode)
 		{
 		case CSqlExecData::READ_ACCESS:
-		{
-			for(size_t i = 0; i < m_vpReadConnections.size(); i++)
-			{
-				if(m_pShared->m_Shutdown)
-				{
-					dbg_msg("sql", "[%i] %s dismissed read request during shutdown", JobNum, pThreadData->m_pName);
-					break;
-				}
-				if(FailMode)
-				{
-					dbg_msg("sql", "[%i] %s dismissed read request during FailMode", JobNum, pThreadData->m_pName);
-					break;
-				}
-				int CurServer = (ReadServer + i) % (int)m_vpReadConnections.size();
-				if(CDbConnectionPool::ExecSqlFunc(m_vpReadConnections[CurServer].get(), pThreadData.get(), Write::NORMAL))
-				{
-					ReadServer = CurServer;
-					dbg_msg("sql", "[%i] %s done on read database %d", JobNum, pThreadData->m_pName, CurServer);
-					Success = true;
-					break;
-				}
-			}
-			if(!Success)
-			{
-				FailMode = true;
-			}
-		}
-		break;
+			dbg_assert(false, "read queries are handled by the read workers");
+			break;
 		case CSqlExecData::WRITE_ACCESS:
 		{
+			m_pShared->m_aStats[CDbConnectionPool::LANE_WRITE].m_Queued--;
 			if(m_pShared->m_Shutdown && m_pWriteBackup != nullptr)
 			{
 				dbg_msg("sql", "[%i] %s skipped to backup database during shutdown", JobNum, pThreadData->m_pName);
@@ -348,6 +377,7 @@ void CWorker::ProcessQueries()
 				dbg_msg("sql", "[%i] %s done move write on backup database to non-backup table", JobNum, pThreadData->m_pName);
 				Success = true;
 			}
+			m_pShared->m_aStats[CDbConnectionPool::LANE_WRITE].Add(pThreadData->m_pName, Success, StartTime - pThreadData->m_SubmitTime, time_get() - StartTime);
 		}
 		break;
 		case CSqlExecData::ADD_MYSQL:
@@ -356,7 +386,7 @@ void CWorker::ProcessQueries()
 			switch(pThreadData->m_Ptr.m_MySql.m_Mode)
 			{
 			case CDbConnectionPool::Mode::READ:
-				m_vpReadConnections.push_back(std::move(pMysql));
+				dbg_assert(false, "read servers are added to the read workers");
 				break;
 			case CDbConnectionPool::Mode::WRITE:
 				m_pWriteConnection = std::move(pMysql);
@@ -376,7 +406,7 @@ void CWorker::ProcessQueries()
 			switch(pThreadData->m_Ptr.m_Sqlite.m_Mode)
 			{
 			case CDbConnectionPool::Mode::READ:
-				m_vpReadConnections.push_back(std::move(pSqlite));
+				dbg_assert(false, "read servers are added to the read workers");
 				break;
 			case CDbConnectionPool::Mode::WRITE:
 				m_pWriteConnection = std::move(pSqlite);
@@ -402,24 +432,23 @@ void CWorker::ProcessQueries()
 			pThreadData->m_pThreadData->m_pResult->m_Success = Success;
 			pThreadData->m_pThreadData->m_pResult->m_Completed.store(true);
 		}
+		{
+			std::unique_lock<std::mutex> Lock(m_pShared->m_WriteLaneDoneMutex);
+			m_pShared->m_NumWriteLaneDone++;
+		}
+		m_pShared->m_WriteLaneDoneCond.notify_all();
 	}
 }
 
 void CWorker::Print(IConsole *pConsole, CDbConnectionPool::Mode DatabaseMode)
 {
-	if(DatabaseMode == CDbConnectionPool::Mode::READ)
-	{
-		for(auto &pReadConnection : m_vpReadConnections)
-			pReadConnection->Print(pConsole, "Read");
-		if(m_vpReadConnections.empty())
-			pConsole->Print(IConsole::OUTPUT_LEVEL_STANDARD, "server", "There are no read databases");
-	}
-	else if(DatabaseMode == CDbConnectionPool::Mode::WRITE)
+	if(DatabaseMode == CDbConnectionPool::Mode::WRITE)
 	{
 		if(m_pWriteConnection)
 			m_pWriteConnection->Print(pConsole, "Write");
 		else
 			pConsole->Print(IConsole::OUTPUT_LEVEL_STANDARD, "server", "There are no write databases");
+		m_pShared->m_aStats[CDbConnectionPool::LANE_WRITE].Print(pConsole, "Write");
 	}
 	else if(DatabaseMode == CDbConnectionPool::Mode::WRITE_BACKUP)
 	{
@@ -430,6 +459,185 @@ void CWorker::Print(IConsole *pConsole, CDbConnectionPool::Mode DatabaseMode)
 	}
 }
 
+// The read worker threads take the read queries in submission order, but
+// since there are multiple of them, a slow query doesn't delay the other
+// read queries or the write queries. A read query still waits for the
+// write queries submitted before it.
+class CReadWorker
+{
+public:
+	CReadWorker(std::shared_ptr<CDbConnectionPool::CSharedData> pShared, int Id) :
+		m_Id(Id), m_pShared(std::move(pShared)) {}
+	static void Start(void *pUser);
+
+private:
+	void ProcessQueries();
+	// creates connections for read servers added since the last query
+	void UpdateConnections();
+	void Print(IConsole *pConsole);
+
+	int m_Id;
+	std::vector<std::unique_ptr<IDbConnection>> m_vpReadConnections;
+
+	std::shared_ptr<CDbConnectionPool::CSharedData> m_pShared;
+};
+
+/* static */
+void CReadWorker::Start(void *pUser)
+{
+	CReadWorker *pThis = (CReadWorker *)pUser;
+	pThis->ProcessQueries();
+	delete pThis;
+}
+
+void CReadWorker::ProcessQueries()
+{
+	// remember last working server and try to connect to it first
+	int ReadServer = 0;
+	for(int JobNum = 0;; JobNum++)
+	{
+		if(m_pShared->m_ReadFailMode && m_pShared->m_NumRead.GetApproximateValue() == 0)
+		{
+			m_pShared->m_ReadFailMode.store(false);
+		}
+		m_pShared->m_NumRead.Wait();
+		std::unique_ptr<CSqlExecData> pThreadData;
+		{
+			CLockScope ls(m_pShared->m_ReadLock);
+			pThreadData = std::move(m_pShared->m_vpReadQueries.front());
+			m_pShared->m_vpReadQueries.pop_front();
+		}
+		// OnShutdown adds one empty query for each read worker after all other queries
+		if(pThreadData == nullptr)
+			return;
+		m_pShared->m_aStats[CDbConnectionPool::LANE_READ].m_Queued--;
+		{
+			std::unique_lock<std::mutex> Lock(m_pShared->m_WriteLaneDoneMutex);
+			m_pShared->m_WriteLaneDoneCond.wait(Lock, [&]() {
+				return m_pShared->m_NumWriteLaneDone >= pThreadData->m_NumWriteLaneQueriesBefore || m_pShared->m_ReadShutdown;
+			});
+		}
+		UpdateConnections();
+
+		if(pThreadData->m_Mode == CSqlExecData::PRINT)
+		{
+			Print(pThreadData->m_Ptr.m_Print.m_pConsole);
+			continue;
+		}
+		dbg_assert(pThreadData->m_Mode == CSqlExecData::READ_ACCESS, "only read queries are handled by the read workers");
+
+		bool Success = false;
+		const int64_t StartTime = time_get();
+		for(size_t i = 0; i < m_vpReadConnections.size(); i++)
+		{
+			if(m_pShared->m_ReadShutdown)
+			{
+				dbg_msg("sql", "[%i:%i] %s dismissed read request during shutdown", m_Id, JobNum, pThreadData->m_pName);
+				break;
+			}
+			if(m_pShared->m_ReadFailMode)
+			{
+				dbg_msg("sql", "[%i:%i] %s dismissed read request during FailMode", m_Id, JobNum, pThreadData->m_pName);
+				break;
+			}
+			int CurServer = (ReadServer + i) % (int)m_vpReadConnections.size();
+			if(CDbConnectionPool::ExecSqlFunc(m_vpReadConnections[CurServer].get(), pThreadData.get(), Write::NORMAL))
+			{
+				ReadServer = CurServer;
+				dbg_msg("sql", "[%i:%i] %s done on read database %d", m_Id, JobNum, pThreadData->m_pName, CurServer);
+				Success = true;
+				break;
+			}
+		}
+		if(!Success)
+		{
+			m_pShared->m_ReadFailMode.store(true);
+			dbg_msg("sql", "[%i:%i] %s failed on all databases", m_Id, JobNum, pThreadData->m_pName);
+		}
+		m_pShared->m_aStats[CDbConnectionPool::LANE_READ].Add(pThreadData->m_pName, Success, StartTime - pThreadData->m_SubmitTime, time_get() - StartTime);
+		if(pThreadData->m_pThreadData != nullptr && pThreadData->m_pThreadData->m_pResult != nullptr)
+		{
+			pThreadData->m_pThreadData->m_pResult->m_Success = Success;
+			pThreadData->m_pThreadData->m_pResult->m_Completed.store(true);
+		}
+	}
+}
+
+void CReadWorker::UpdateConnections()
+{
+	CLockScope ls(m_pShared->m_ReadLock);
+	for(size_t i = m_vpReadConnections.size(); i < m_pShared->m_vReadServers.size(); i++)
+	{
+		const CDbConnectionPool::CReadServer &Server = m_pShared->m_vReadServers[i];
+		if(Server.m_Mysql)
+			m_vpReadConnections.push_back(CreateMysqlConnection(Server.m_MysqlConfig));
+		else
+			m_vpReadConnections.push_back(CreateSqliteConnection(Server.m_aSqliteFile, true));
+	}
+}
+
+void CReadWorker::Print(IConsole *pConsole)
+{
+	for(auto &pReadConnection : m_vpReadConnections)
+		pReadConnection->Print(pConsole, "Read");
+	if(m_vpReadConnections.empty())
+		pConsole->Print(IConsole::OUTPUT_LEVEL_STANDARD, "server", "There are no read databases");
+	m_pShared->m_aStats[CDbConnectionPool::LANE_READ].Print(pConsole, "Read");
+}
+
+void CDbConnectionPool::CLaneStats::Add(const char *pName, bool Success, int64_t WaitTime, int64_t ExecTime)
+{
+	CLockScope ls(m_Lock);
+	CQuery *pQuery = nullptr;
+	for(auto &Query : m_vQueries)
+	{
+		if(str_comp(Query.m_pName, pName) == 0)
+		{
+			pQuery = &Query;
+			break;
+		}
+	}
+	if(pQuery == nullptr)
+	{
+		m_vQueries.push_back({pName, 0, 0, 0, 0, 0});
+		pQuery = &m_vQueries.back();
+	}
+	pQuery->m_NumQueries++;
+	pQuery->m_NumFailed += !Success;
+	pQuery->m_WaitTime += WaitTime;
+	pQuery->m_ExecTime += ExecTime;
+	pQuery->m_MaxExecTime = maximum(pQuery->m_MaxExecTime, ExecTime);
+}
+
+void CDbConnectionPool::CLaneStats::Print(IConsole *pConsole, const char *pLane)
+{
+	char aBuf[256];
+	str_format(aBuf, sizeof(aBuf), "%s queue: %d queries waiting", pLane, m_Queued.load());
+	pConsole->Print(IConsole::OUTPUT_LEVEL_STANDARD, "server", aBuf);
+
+	CLockScope ls(m_Lock);
+	const double Ms = 1000.0 / time_freq();
+	for(const auto &Query : m_vQueries)
+	{
+		str_format(aBuf, sizeof(aBuf), "  %s: %d queries, %d failed, avg wait %.2fms, avg %.2fms, max %.2fms",
+			Query.m_pName, Query.m_NumQueries, Query.m_NumFailed,
+			Query.m_WaitTime * Ms / Query.m_NumQueries, Query.m_ExecTime * Ms / Query.m_NumQueries, Query.m_MaxExecTime * Ms);
+		pConsole->Print(IConsole::OUTPUT_LEVEL_STANDARD, "server", aBuf);
+	}
+}
+
+void CDbConnectionPool::StartReadWorkers()
+{
+	if(!m_vpReadThreads.empty() || m_Shutdown)
+		return;
+	for(int i = 0; i < g_Config.m_SvSqlReadWorkers; i++)
+	{
+		char aName[32];
+		str_format(aName, sizeof(aName), "database read worker %d", i);
+		m_vpReadThreads.push_back(thread_init(CReadWorker::Start, new CReadWorker(m_pShared, i), aName));
+	}
+}
+
 /* static */
 bool CDbConnectionPool::ExecSqlFunc(IDbConnection *pConnection, CSqlExecData *pData, Write w)
 {
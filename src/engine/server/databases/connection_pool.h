@@ -2,8 +2,12 @@
 #define ENGINE_SERVER_DATABASES_CONNECTION_POOL_H
 
 #include <atomic>
+#include <base/lock.h>
 #include <base/tl/threading.h>
+#include <condition_variable>
+#include <deque>
 #include <memory>
+#include <mutex>
 #include <vector>
 
 class IDbConnection;
@@ -76,11 +80,15 @@ public:
 		NUM_MODES,
 	};
 
+	// also prints the queue depth and query latencies of the lane serving
+	// the given mode
 	void Print(IConsole *pConsole, Mode DatabaseMode);
 
 	void RegisterSqliteDatabase(Mode DatabaseMode, const char FileName[64]);
 	void RegisterMysqlDatabase(Mode DatabaseMode, const CMysqlConfig *pMysqlConfig);
 
+	// Read queries run once the write queries submitted before them are
+	// done, so that they see e.g. the finish time that was just saved.
 	void Execute(
 		FRead pFunc,
 		std::unique_ptr<const ISqlData> pSqlRequestData,
@@ -95,14 +103,62 @@ public:
 	void OnShutdown();
 
 	friend class CWorker;
+	friend class CReadWorker;
 	friend class CBackup;
 
 private:
 	static bool ExecSqlFunc(IDbConnection *pConnection, struct CSqlExecData *pData, Write w);
 
+	// The read workers are started with the first read query, after the
+	// config is loaded.
+	void StartReadWorkers();
+	void AddReadQuery(std::unique_ptr<struct CSqlExecData> pData);
+	void AddWriteLaneQuery(std::unique_ptr<struct CSqlExecData> pData);
+
+	enum
+	{
+		LANE_READ,
+		LANE_WRITE,
+		NUM_LANES,
+	};
+
+	class CLaneStats
+	{
+	public:
+		// number of queries submitted to the lane but not yet picked up by a worker
+		std::atomic_int m_Queued{0};
+
+		void Add(const char *pName, bool Success, int64_t WaitTime, int64_t ExecTime) REQUIRES(!m_Lock);
+		void Print(IConsole *pConsole, const char *pLane) REQUIRES(!m_Lock);
+
+	private:
+		struct CQuery
+		{
+			const char *m_pName;
+			int m_NumQueries;
+			int m_NumFailed;
+			int64_t m_WaitTime;
+			int64_t m_ExecTime;
+			int64_t m_MaxExecTime;
+		};
+
+		CLock m_Lock;
+		std::vector<CQuery> m_vQueries GUARDED_BY(m_Lock);
+	};
+
+	struct CReadServer
+	{
+		bool m_Mysql;
+		CMysqlConfig m_MysqlConfig;
+		char m_aSqliteFile[64];
+	};
+
 	// Only the main thread accesses this variable. It points to the index,
 	// where the next query is added to the queue.
 	int m_InsertIdx = 0;
+	// Only the main thread accesses this variable. Number of queries added
+	// to the write lane.
+	int64_t m_NumWriteLaneQueries = 0;
 
 	bool m_Shutdown = false;
 
@@ -122,12 +178,35 @@ private:
 		CSemaphore m_NumWorker;
 
 		// spsc queue with additional backup worker to look at queries first.
+		// Only write queries and the management of the write servers go
+		// through this queue, so that they are executed in order.
 		std::unique_ptr<struct CSqlExecData> m_aQueries[512];
+
+		// Read queries are taken by the next free read worker, each read
+		// worker has its own connections to all read servers.
+		CLock m_ReadLock;
+		std::deque<std::unique_ptr<struct CSqlExecData>> m_vpReadQueries GUARDED_BY(m_ReadLock);
+		std::vector<CReadServer> m_vReadServers GUARDED_BY(m_ReadLock);
+		CSemaphore m_NumRead;
+		// Set when a read query failed on all read servers, the read workers
+		// dismiss read queries until the read queue is empty.
+		std::atomic_bool m_ReadFailMode{false};
+		// Read queries are dismissed during shutdown.
+		std::atomic_bool m_ReadShutdown{false};
+		// Number of queries the write worker finished, the read workers
+		// wait on m_WriteLaneDoneCond until the writes submitted before
+		// their query are done.
+		std::mutex m_WriteLaneDoneMutex;
+		std::condition_variable m_WriteLaneDoneCond;
+		int64_t m_NumWriteLaneDone = 0;
+
+		CLaneStats m_aStats[NUM_LANES];
 	};
 
 	std::shared_ptr<CSharedData> m_pShared;
 	void *m_pWorkerThread = nullptr;
 	void *m_pBackupThread = nullptr;
+	std::vector<void *> m_vpReadThreads;
 };
 
 #endif // ENGINE_SERVER_DATABASES_CONNECTION_POOL_H
@@ -10,6 +10,8 @@
 
 #include <atomic>
 #include <memory>
+#include <string>
+#include <unordered_map>
 #include <vector>
 
 // MySQL >= 8.0.1 removed my_bool, 8.0.2 accidentally reintroduced it: https://bugs.mysql.com/bug.php?id=87337
@@ -114,6 +116,8 @@ private:
 	void StoreErrorMysql(const char *pContext);
 	void StoreErrorStmt(const char *pContext);
 	bool ConnectImpl();
+	// selects the cached statement or prepares a new one
+	bool PrepareCached(const char *pStmt);
 	bool PrepareAndExecuteStatement(const char *pStmt);
 	//static void DeleteResult(MYSQL_RES *pResult);
 
@@ -127,7 +131,9 @@ private:
 	bool m_NewQuery = false;
 	bool m_HaveConnection = false;
 	MYSQL m_Mysql;
-	std::unique_ptr<MYSQL_STMT, CStmtDeleter> m_pStmt = nullptr;
+	// points into m_Statements
+	MYSQL_STMT *m_pStmt = nullptr;
+	std::unordered_map<std::string, std::unique_ptr<MYSQL_STMT, CStmtDeleter>> m_Statements;
 	std::vector<MYSQL_BIND> m_vStmtParameters;
 	std::vector<UParameterExtra> m_vStmtParameterExtras;
 
@@ -168,17 +174,50 @@ void CMysqlConnection::StoreErrorMysql(const char *pContext)
 
 void CMysqlConnection::StoreErrorStmt(const char *pContext)
 {
-	str_format(m_aErrorDetail, sizeof(m_aErrorDetail), "(%s:stmt:%d): %s", pContext, mysql_stmt_errno(m_pStmt.get()), mysql_stmt_error(m_pStmt.get()));
+	str_format(m_aErrorDetail, sizeof(m_aErrorDetail), "(%s:stmt:%d): %s", pContext, mysql_stmt_errno(m_pStmt), mysql_stmt_error(m_pStmt));
 }
 
-bool CMysqlConnection::PrepareAndExecuteStatement(const char *pStmt)
+bool CMysqlConnection::PrepareCached(const char *pStmt)
 {
-	if(mysql_stmt_prepare(m_pStmt.get(), pStmt, str_length(pStmt)))
+	// the results are fetched unbuffered, drop the rest of the previous
+	// result before using another statement
+	if(m_pStmt && mysql_stmt_free_result(m_pStmt))
+	{
+		StoreErrorStmt("free_result");
+		dbg_msg("mysql", "can't free last result %s", m_aErrorDetail);
+	}
+	m_pStmt = nullptr;
+
+	auto It = m_Statements.find(pStmt);
+	if(It != m_Statements.end())
+	{
+		m_StatementCacheHits++;
+		m_pStmt = It->second.get();
+		return false;
+	}
+
+	m_StatementCacheMisses++;
+	if(m_Statements.size() >= MAX_CACHED_STATEMENTS)
+		m_Statements.clear();
+	std::unique_ptr<MYSQL_STMT, CStmtDeleter> pNewStmt(mysql_stmt_init(&m_Mysql));
+	m_pStmt = pNewStmt.get();
+	if(mysql_stmt_prepare(m_pStmt, pStmt, str_length(pStmt)))
 	{
 		StoreErrorStmt("prepare");
+		m_pStmt = nullptr;
 		return true;
 	}
-	if(mysql_stmt_execute(m_pStmt.get()))
+	m_Statements.emplace(pStmt, std::move(pNewStmt));
+	return false;
+}
+
+bool CMysqlConnection::PrepareAndExecuteStatement(const char *pStmt)
+{
+	if(PrepareCached(pStmt))
+	{
+		return true;
+	}
+	if(mysql_stmt_execute(m_pStmt))
 	{
 		StoreErrorStmt("execute");
 		return true;
@@ -190,8 +229,9 @@ void CMysqlConnection::Print(IConsole *pConsole, const char *pMode)
 {
 	char aBuf[512];
 	str_format(aBuf, sizeof(aBuf),
-		"MySQL-%s: DB: '%s' Prefix: '%s' User: '%s' IP: <{'%s'}> Port: %d",
-		pMode, m_Config.m_aDatabase, GetPrefix(), m_Config.m_aUser, m_Config.m_aIp, m_Config.m_Port);
+		"MySQL-%s: DB: '%s' Prefix: '%s' User: '%s' IP: <{'%s'}> Port: %d Statements: %d cached, %" PRId64 " hits, %" PRId64 " misses",
+		pMode, m_Config.m_aDatabase, GetPrefix(), m_Config.m_aUser, m_Config.m_aIp, m_Config.m_Port,
+		(int)m_Statements.size(), m_StatementCacheHits, m_StatementCacheMisses);
 	pConsole->Print(IConsole::OUTPUT_LEVEL_STANDARD, "server", aBuf);
 }
 
@@ -221,7 +261,7 @@ bool CMysqlConnection::ConnectImpl()
 {
 	if(m_HaveConnection)
 	{
-		if(m_pStmt && mysql_stmt_free_result(m_pStmt.get()))
+		if(m_pStmt && mysql_stmt_free_result(m_pStmt))
 		{
 			StoreErrorStmt("free_result");
 			dbg_msg("mysql", "can't free last result %s", m_aErrorDetail);
@@ -238,7 +278,9 @@ bool CMysqlConnection::ConnectImpl()
 		mysql_init(&m_Mysql);
 	}
 
+	// prepared statements are bound to the connection
 	m_pStmt = nullptr;
+	m_Statements.clear();
 	unsigned int OptConnectTimeout = 60;
 	unsigned int OptReadTimeout = 60;
 	unsigned int OptWriteTimeout = 120;
@@ -260,8 +302,6 @@ bool CMysqlConnection::ConnectImpl()
 	}
 	m_HaveConnection = true;
 
-	m_pStmt = std::unique_ptr<MYSQL_STMT, CStmtDeleter>(mysql_stmt_init(&m_Mysql));
-
 	// Apparently MYSQL_SET_CHARSET_NAME is not enough
 	if(PrepareAndExecuteStatement("SET CHARACTER SET utf8mb4"))
 	{
@@ -320,14 +360,13 @@ void CMysqlConnection::Disconnect()
 
 bool CMysqlConnection::PrepareStatement(const char *pStmt, char *pError, int ErrorSize)
 {
-	if(mysql_stmt_prepare(m_pStmt.get(), pStmt, str_length(pStmt)))
+	if(PrepareCached(pStmt))
 	{
-		StoreErrorStmt("prepare");
 		str_copy(pError, m_aErrorDetail, ErrorSize);
 		return true;
 	}
 	m_NewQuery = true;
-	unsigned NumParameters = mysql_stmt_param_count(m_pStmt.get());
+	unsigned NumParameters = mysql_stmt_param_count(m_pStmt);
 	m_vStmtParameters.resize(NumParameters);
 	m_vStmtParameterExtras.resize(NumParameters);
 	mem_zero(&m_vStmtParameters[0], sizeof(m_vStmtParameters[0]) * m_vStmtParameters.size());
@@ -426,20 +465,23 @@ bool CMysqlConnection::Step(bool *pEnd, char *pError, int ErrorSize)
 	if(m_NewQuery)
 	{
 		m_NewQuery = false;
-		if(mysql_stmt_bind_param(m_pStmt.get(), &m_vStmtParameters[0]))
+		if(mysql_stmt_bind_param(m_pStmt, &m_vStmtParameters[0]))
 		{
 			StoreErrorStmt("bind_param");
 			str_copy(pError, m_aErrorDetail, ErrorSize);
 			return true;
 		}
-		if(mysql_stmt_execute(m_pStmt.get()))
+		if(mysql_stmt_execute(m_pStmt))
 		{
 			StoreErrorStmt("execute");
 			str_copy(pError, m_aErrorDetail, ErrorSize);
+			// the statements might be gone after an automatic reconnect
+			m_pStmt = nullptr;
+			m_Statements.clear();
 			return true;
 		}
 	}
-	int Result = mysql_stmt_fetch(m_pStmt.get());
+	int Result = mysql_stmt_fetch(m_pStmt);
 	if(Result == 1)
 	{
 		StoreErrorStmt("fetch");
@@ -457,19 +499,22 @@ bool CMysqlConnection::ExecuteUpdate(int *pNumUpdated, char *pError, int ErrorSi
 	if(m_NewQuery)
 	{
 		m_NewQuery = false;
-		if(mysql_stmt_bind_param(m_pStmt.get(), &m_vStmtParameters[0]))
+		if(mysql_stmt_bind_param(m_pStmt, &m_vStmtParameters[0]))
 		{
 			StoreErrorStmt("bind_param");
 			str_copy(pError, m_aErrorDetail, ErrorSize);
 			return true;
 		}
-		if(mysql_stmt_execute(m_pStmt.get()))
+		if(mysql_stmt_execute(m_pStmt))
 		{
 			StoreErrorStmt("execute");
 			str_copy(pError, m_aErrorDetail, ErrorSize);
+			// the statements might be gone after an automatic reconnect
+			m_pStmt = nullptr;
+			m_Statements.clear();
 			return true;
 		}
-		*pNumUpdated = mysql_stmt_affected_rows(m_pStmt.get());
+		*pNumUpdated = mysql_stmt_affected_rows(m_pStmt);
 		return false;
 	}
 	str_copy(pError, "tried to execute update without query", ErrorSize);
@@ -490,7 +535,7 @@ bool CMysqlConnection::IsNull(int Col)
 	Bind.is_null = &IsNull;
 	Bind.is_unsigned = false;
 	Bind.error = nullptr;
-	if(mysql_stmt_fetch_column(m_pStmt.get(), &Bind, Col, 0))
+	if(mysql_stmt_fetch_column(m_pStmt, &Bind, Col, 0))
 	{
 		StoreErrorStmt("fetch_column:null");
 		dbg_msg("mysql", "error fetching column %s", m_aErrorDetail);
@@ -514,7 +559,7 @@ float CMysqlConnection::GetFloat(int Col)
 	Bind.is_null = &IsNull;
 	Bind.is_unsigned = false;
 	Bind.error = nullptr;
-	if(mysql_stmt_fetch_column(m_pStmt.get(), &Bind, Col, 0))
+	if(mysql_stmt_fetch_column(m_pStmt, &Bind, Col, 0))
 	{
 		StoreErrorStmt("fetch_column:float");
 		dbg_msg("mysql", "error fetching column %s", m_aErrorDetail);
@@ -542,7 +587,7 @@ int CMysqlConnection::GetInt(int Col)
 	Bind.is_null = &IsNull;
 	Bind.is_unsigned = false;
 	Bind.error = nullptr;
-	if(mysql_stmt_fetch_column(m_pStmt.get(), &Bind, Col, 0))
+	if(mysql_stmt_fetch_column(m_pStmt, &Bind, Col, 0))
 	{
 		StoreErrorStmt("fetch_column:int");
 		dbg_msg("mysql", "error fetching column %s", m_aErrorDetail);
@@ -570,7 +615,7 @@ int64_t CMysqlConnection::GetInt64(int Col)
 	Bind.is_null = &IsNull;
 	Bind.is_unsigned = false;
 	Bind.error = nullptr;
-	if(mysql_stmt_fetch_column(m_pStmt.get(), &Bind, Col, 0))
+	if(mysql_stmt_fetch_column(m_pStmt, &Bind, Col, 0))
 	{
 		StoreErrorStmt("fetch_column:int64");
 		dbg_msg("mysql", "error fetching column %s", m_aErrorDetail);
@@ -605,7 +650,7 @@ void CMysqlConnection::GetString(int Col, char *pBuffer, int BufferSize)
 	Bind.is_null = &IsNull;
 	Bind.is_unsigned = false;
 	Bind.error = &Error;
-	if(mysql_stmt_fetch_column(m_pStmt.get(), &Bind, Col, 0))
+	if(mysql_stmt_fetch_column(m_pStmt, &Bind, Col, 0))
 	{
 		StoreErrorStmt("fetch_column:string");
 		dbg_msg("mysql", "error fetching column %s", m_aErrorDetail);
@@ -637,7 +682,7 @@ int CMysqlConnection::GetBlob(int Col, unsigned char *pBuffer, int BufferSize)
 	Bind.is_null = &IsNull;
 	Bind.is_unsigned = false;
 	Bind.error = &Error;
-	if(mysql_stmt_fetch_column(m_pStmt.get(), &Bind, Col, 0))
+	if(mysql_stmt_fetch_column(m_pStmt, &Bind, Col, 0))
 	{
 		StoreErrorStmt("fetch_column:blob");
 		dbg_msg("mysql", "error fetching column %s", m_aErrorDetail);
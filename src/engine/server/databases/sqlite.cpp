@@ -2,10 +2,13 @@
 
 #include <sqlite3.h>
 
+#include <base/lock.h>
 #include <base/math.h>
 #include <engine/console.h>
 
 #include <atomic>
+#include <string>
+#include <unordered_map>
 
 class CSqliteConnection : public IDbConnection
 {
@@ -61,10 +64,13 @@ private:
 	bool m_Setup;
 
 	sqlite3 *m_pDb;
+	// points into m_Statements
 	sqlite3_stmt *m_pStmt;
+	std::unordered_map<std::string, sqlite3_stmt *> m_Statements;
 	bool m_Done; // no more rows available for Step
 	// returns false, if the query succeeded
 	bool Execute(const char *pQuery, char *pError, int ErrorSize);
+	void ClearStatements();
 	// returns true on failure
 	bool ConnectImpl(char *pError, int ErrorSize);
 
@@ -88,18 +94,25 @@ CSqliteConnection::CSqliteConnection(const char *pFilename, bool Setup) :
 
 CSqliteConnection::~CSqliteConnection()
 {
-	if(m_pStmt != nullptr)
-		sqlite3_finalize(m_pStmt);
+	ClearStatements();
 	sqlite3_close(m_pDb);
 	m_pDb = nullptr;
 }
 
+void CSqliteConnection::ClearStatements()
+{
+	for(auto &Statement : m_Statements)
+		sqlite3_finalize(Statement.second);
+	m_Statements.clear();
+	m_pStmt = nullptr;
+}
+
 void CSqliteConnection::Print(IConsole *pConsole, const char *pMode)
 {
 	char aBuf[512];
 	str_format(aBuf, sizeof(aBuf),
-		"SQLite-%s: DB: '%s'",
-		pMode, m_aFilename);
+		"SQLite-%s: DB: '%s' Statements: %d cached, %" PRId64 " hits, %" PRId64 " misses",
+		pMode, m_aFilename, (int)m_Statements.size(), m_StatementCacheHits, m_StatementCacheMisses);
 	pConsole->Print(IConsole::OUTPUT_LEVEL_STANDARD, "server", aBuf);
 }
 
@@ -146,6 +159,11 @@ bool CSqliteConnection::ConnectImpl(char *pError, int ErrorSize)
 
 	if(m_Setup)
 	{
+		// The read workers and the write worker can set up the same file at
+		// the same time. Changing the journal mode doesn't wait for other
+		// connections, so only one connection may do it at a time.
+		static CLock s_SetupLock;
+		CLockScope ls(s_SetupLock);
 		if(Execute("PRAGMA journal_mode=WAL", pError, ErrorSize))
 			return true;
 		char aBuf[1024];
@@ -181,8 +199,9 @@ bool CSqliteConnection::ConnectImpl(char *pError, int ErrorSize)
 
 void CSqliteConnection::Disconnect()
 {
+	// keep the statement compiled, but end its read transaction
 	if(m_pStmt != nullptr)
-		sqlite3_finalize(m_pStmt);
+		sqlite3_reset(m_pStmt);
 	m_pStmt = nullptr;
 	m_InUse.store(false);
 }
@@ -190,18 +209,37 @@ void CSqliteConnection::Disconnect()
 bool CSqliteConnection::PrepareStatement(const char *pStmt, char *pError, int ErrorSize)
 {
 	if(m_pStmt != nullptr)
-		sqlite3_finalize(m_pStmt);
+		sqlite3_reset(m_pStmt);
 	m_pStmt = nullptr;
+
+	auto It = m_Statements.find(pStmt);
+	if(It != m_Statements.end())
+	{
+		m_StatementCacheHits++;
+		m_pStmt = It->second;
+		// the bound values might point to buffers of the previous query
+		sqlite3_clear_bindings(m_pStmt);
+		m_Done = false;
+		return false;
+	}
+
+	m_StatementCacheMisses++;
+	if(m_Statements.size() >= MAX_CACHED_STATEMENTS)
+		ClearStatements();
+	sqlite3_stmt *pNewStmt = nullptr;
 	int Result = sqlite3_prepare_v2(
 		m_pDb,
 		pStmt,
 		-1, // pStmt can be any length
-		&m_pStmt,
+		&pNewStmt,
 		NULL);
 	if(FormatError(Result, pError, ErrorSize))
 	{
+		sqlite3_finalize(pNewStmt);
 		return true;
 	}
+	m_Statements.emplace(pStmt, pNewStmt);
+	m_pStmt = pNewStmt;
 	m_Done = false;
 	return false;
 }
@@ -70,11 +70,11 @@ class CRegister : public IRegister
 			int m_Index;
 			int m_InfoSerial;
 			std::shared_ptr<CShared> m_pShared;
-			std::unique_ptr<CHttpRequest> m_pRegister;
+			std::shared_ptr<CHttpRequest> m_pRegister;
 			void Run() override;
 
 		public:
-			CJob(int Protocol, int ServerPort, int Index, int InfoSerial, std::shared_ptr<CShared> pShared, std::unique_ptr<CHttpRequest> &&pRegister) :
+			CJob(int Protocol, int ServerPort, int Index, int InfoSerial, std::shared_ptr<CShared> pShared, std::shared_ptr<CHttpRequest> &&pRegister) :
 				m_Protocol(Protocol),
 				m_ServerPort(ServerPort),
 				m_Index(Index),
@@ -271,7 +271,7 @@ void CRegister::CProtocol::SendRegister()
 		SendInfo = InfoSerial > m_pShared->m_pGlobal->m_LatestSuccessfulInfoSerial;
 	}
 
-	std::unique_ptr<CHttpRequest> pRegister;
+	std::shared_ptr<CHttpRequest> pRegister;
 	if(SendInfo)
 	{
 		pRegister = HttpPostJson(m_pParent->m_pConfig->m_SvRegisterUrl, m_pParent->m_aServerInfo);
@@ -348,7 +348,7 @@ void CRegister::CProtocol::SendDeleteIfRegistered(bool Shutdown)
 		pDelete->Timeout(CTimeout{1000, 1000, 0, 0});
 	}
 	log_info(ProtocolToSystem(m_Protocol), "deleting...");
-	m_pParent->m_pEngine->AddJob(std::move(pDelete));
+	HttpRun(std::move(pDelete));
 }
 
 CRegister::CProtocol::CProtocol(CRegister *pParent, int Protocol) :
@@ -405,7 +405,8 @@ void CRegister::CProtocol::OnToken(const char *pToken)
 
 void CRegister::CProtocol::CJob::Run()
 {
-	IEngine::RunJobBlocking(m_pRegister.get());
+	HttpRun(m_pRegister);
+	m_pRegister->Wait();
 	if(m_pRegister->State() != HTTP_DONE)
 	{
 		// TODO: log the error response content from master
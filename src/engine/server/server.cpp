@@ -324,6 +324,17 @@ CServer::CServer()
 	m_CurrentGameTick = MIN_TICK;
 	m_RunServer = UNINITIALIZED;
 
+	m_SnapshotSharedBuilding = false;
+	m_SnapshotSharedTick = -1;
+	m_SnapshotBuildTime = 0;
+	m_SnapshotBuildTicks = 0;
+	m_SnapshotDeltasCreated = 0;
+	m_SnapshotDeltasReused = 0;
+
+	m_vSnapshotPackets.resize(MAX_CLIENTS);
+	m_NumSnapshotThreads = 0;
+	sphore_init(&m_SnapshotJobsDone);
+
 	m_aShutdownReason[0] = 0;
 
 	for(int i = 0; i < NUM_MAP_TYPES; i++)
@@ -371,6 +382,9 @@ CServer::~CServer()
 	}
 	free(m_pPersistentData);
 
+	m_pSnapshotJobPool = nullptr;
+	sphore_destroy(&m_SnapshotJobsDone);
+
 	delete m_pRegister;
 	delete m_pConnectionPool;
 }
@@ -920,21 +934,44 @@ void CServer::DoSnapshot()
 {
 	GameServer()->OnPreSnap();
 
+	int64_t BuildTime = 0;
+
+	// build the world items shared by all clients once
+	m_SnapshotSharedTick = -1;
+	if(Config()->m_SvSharedSnapshot)
+	{
+		const int64_t BuildStart = time_get();
+		m_SnapshotSharedItems.Init();
+		m_SnapshotSharedBuilding = true;
+		GameServer()->OnSnapShared();
+		m_SnapshotSharedBuilding = false;
+		m_SnapshotSharedTick = Tick();
+		BuildTime += time_get() - BuildStart;
+	}
+
 	// create snapshot for demo recording
 	if(m_aDemoRecorder[MAX_CLIENTS].IsRecording())
 	{
 		char aData[CSnapshot::MAX_SIZE];
 
 		// build snap and possibly add some messages
+		const int64_t BuildStart = time_get();
 		m_SnapshotBuilder.Init();
 		GameServer()->OnSnap(-1);
 		int SnapshotSize = m_SnapshotBuilder.Finish(aData);
+		BuildTime += time_get() - BuildStart;
 
 		// write snapshot
 		m_aDemoRecorder[MAX_CLIENTS].RecordSnapshot(Tick(), aData, SnapshotSize);
 	}
 
 	// create snapshots for all clients
+	m_SnapshotDelta.SetStaticsize(protocol7::NETEVENTTYPE_SOUNDWORLD, false);
+	m_SnapshotDelta.SetStaticsize(protocol7::NETEVENTTYPE_DAMAGE, false);
+	m_SnapshotDeltaSixup.SetStaticsize(protocol7::NETEVENTTYPE_SOUNDWORLD, true);
+	m_SnapshotDeltaSixup.SetStaticsize(protocol7::NETEVENTTYPE_DAMAGE, true);
+
+	int NumPackets = 0;
 	for(int i = 0; i < MaxClients(); i++)
 	{
 		// client must be ingame to receive snapshots
@@ -950,6 +987,7 @@ void CServer::DoSnapshot()
 			continue;
 
 		{
+			const int64_t BuildStart = time_get();
 			m_SnapshotBuilder.Init(m_aClients[i].m_Sixup);
 
 			GameServer()->OnSnap(i);
@@ -958,6 +996,7 @@ void CServer::DoSnapshot()
 			char aData[CSnapshot::MAX_SIZE];
 			CSnapshot *pData = (CSnapshot *)aData; // Fix compiler warning for strict-aliasing
 			int SnapshotSize = m_SnapshotBuilder.Finish(pData);
+			BuildTime += time_get() - BuildStart;
 
 			if(m_aDemoRecorder[i].IsRecording())
 			{
@@ -965,22 +1004,32 @@ void CServer::DoSnapshot()
 				m_aDemoRecorder[i].RecordSnapshot(Tick(), aData, SnapshotSize);
 			}
 
-			int Crc = pData->Crc();
+			CSnapshotPacket &Packet = m_vSnapshotPackets[NumPackets++];
+			Packet.m_ClientID = i;
+			Packet.m_Sixup = m_aClients[i].m_Sixup;
+			Packet.m_Crc = pData->Crc();
+			Packet.m_SnapshotSize = SnapshotSize;
 
 			// remove old snapshots
 			// keep 3 seconds worth of snapshots
 			m_aClients[i].m_Snapshots.PurgeUntil(m_CurrentGameTick - SERVER_TICK_SPEED * 3);
 
-			// save the snapshot
+			// save the snapshot, the stored copy stays valid until the next tick
 			m_aClients[i].m_Snapshots.Add(m_CurrentGameTick, time_get(), SnapshotSize, pData, 0, nullptr);
+			m_aClients[i].m_Snapshots.Get(m_CurrentGameTick, nullptr, &Packet.m_pSnapshot, nullptr, &Packet.m_pSnapshotIndex);
 
 			// find snapshot that we can perform delta against
-			int DeltaTick = -1;
-			const CSnapshot *pDeltashot = CSnapshot::EmptySnapshot();
+			Packet.m_DeltaTick = -1;
+			Packet.m_DeltashotSize = 0;
+			Packet.m_pDeltashot = CSnapshot::EmptySnapshot();
+			Packet.m_pDeltashotIndex = nullptr;
 			{
-				int DeltashotSize = m_aClients[i].m_Snapshots.Get(m_aClients[i].m_LastAckedSnapshot, 0, &pDeltashot, 0);
+				int DeltashotSize = m_aClients[i].m_Snapshots.Get(m_aClients[i].m_LastAckedSnapshot, 0, &Packet.m_pDeltashot, 0, &Packet.m_pDeltashotIndex);
 				if(DeltashotSize >= 0)
-					DeltaTick = m_aClients[i].m_LastAckedSnapshot;
+				{
+					Packet.m_DeltaTick = m_aClients[i].m_LastAckedSnapshot;
+					Packet.m_DeltashotSize = DeltashotSize;
+				}
 				else
 				{
 					// no acked package found, force client to recover rate
@@ -989,63 +1038,176 @@ void CServer::DoSnapshot()
 				}
 			}
 
-			// create delta
-			m_SnapshotDelta.SetStaticsize(protocol7::NETEVENTTYPE_SOUNDWORLD, m_aClients[i].m_Sixup);
-			m_SnapshotDelta.SetStaticsize(protocol7::NETEVENTTYPE_DAMAGE, m_aClients[i].m_Sixup);
-			char aDeltaData[CSnapshot::MAX_SIZE];
-			int DeltaSize = m_SnapshotDelta.CreateDelta(pDeltashot, pData, aDeltaData);
-
-			if(DeltaSize)
+			// spectators and dummies often end up with the same view, look
+			// for a client of this tick whose delta can be sent as is
+			Packet.m_ReusePacket = -1;
+			if(Config()->m_SvSnapshotReuse)
 			{
-				// compress it
-				const int MaxSize = MAX_SNAPSHOT_PACKSIZE;
-
-				char aCompData[CSnapshot::MAX_SIZE];
-				SnapshotSize = CVariableInt::Compress(aDeltaData, DeltaSize, aCompData, sizeof(aCompData));
-				int NumPackets = (SnapshotSize + MaxSize - 1) / MaxSize;
-
-				for(int n = 0, Left = SnapshotSize; Left > 0; n++)
+				for(int p = 0; p < NumPackets - 1; p++)
 				{
-					int Chunk = Left < MaxSize ? Left : MaxSize;
-					Left -= Chunk;
-
-					if(NumPackets == 1)
-					{
-						CMsgPacker Msg(NETMSG_SNAPSINGLE, true);
-						Msg.AddInt(m_CurrentGameTick);
-						Msg.AddInt(m_CurrentGameTick - DeltaTick);
-						Msg.AddInt(Crc);
-						Msg.AddInt(Chunk);
-						Msg.AddRaw(&aCompData[n * MaxSize], Chunk);
-						SendMsg(&Msg, MSGFLAG_FLUSH, i);
-					}
-					else
+					if(m_vSnapshotPackets[p].m_ReusePacket == -1 && Packet.CanReuse(m_vSnapshotPackets[p]))
 					{
-						CMsgPacker Msg(NETMSG_SNAP, true);
-						Msg.AddInt(m_CurrentGameTick);
-						Msg.AddInt(m_CurrentGameTick - DeltaTick);
-						Msg.AddInt(NumPackets);
-						Msg.AddInt(n);
-						Msg.AddInt(Crc);
-						Msg.AddInt(Chunk);
-						Msg.AddRaw(&aCompData[n * MaxSize], Chunk);
-						SendMsg(&Msg, MSGFLAG_FLUSH, i);
+						Packet.m_ReusePacket = p;
+						break;
 					}
 				}
 			}
-			else
+		}
+	}
+
+	// create and compress the deltas, possibly on the snapshot worker threads
+	CreateSnapshotPackets(NumPackets);
+
+	// send them in client order
+	for(int p = 0; p < NumPackets; p++)
+	{
+		const int ClientID = m_vSnapshotPackets[p].m_ClientID;
+		const int DeltaTick = m_vSnapshotPackets[p].m_DeltaTick;
+		const int Crc = m_vSnapshotPackets[p].m_Crc;
+		const int ReusePacket = m_vSnapshotPackets[p].m_ReusePacket;
+		const CSnapshotPacket &Packet = m_vSnapshotPackets[ReusePacket == -1 ? p : ReusePacket];
+		if(ReusePacket == -1)
+			m_SnapshotDeltasCreated++;
+		else
+			m_SnapshotDeltasReused++;
+
+		if(Packet.m_CompressedSize)
+		{
+			const int MaxSize = MAX_SNAPSHOT_PACKSIZE;
+			const int SnapshotSize = Packet.m_CompressedSize;
+			int NumParts = (SnapshotSize + MaxSize - 1) / MaxSize;
+
+			for(int n = 0, Left = SnapshotSize; Left > 0; n++)
 			{
-				CMsgPacker Msg(NETMSG_SNAPEMPTY, true);
-				Msg.AddInt(m_CurrentGameTick);
-				Msg.AddInt(m_CurrentGameTick - DeltaTick);
-				SendMsg(&Msg, MSGFLAG_FLUSH, i);
+				int Chunk = Left < MaxSize ? Left : MaxSize;
+				Left -= Chunk;
+
+				if(NumParts == 1)
+				{
+					CMsgPacker Msg(NETMSG_SNAPSINGLE, true);
+					Msg.AddInt(m_CurrentGameTick);
+					Msg.AddInt(m_CurrentGameTick - DeltaTick);
+					Msg.AddInt(Crc);
+					Msg.AddInt(Chunk);
+					Msg.AddRaw(&Packet.m_aCompressedData[n * MaxSize], Chunk);
+					SendMsg(&Msg, MSGFLAG_FLUSH, ClientID);
+				}
+				else
+				{
+					CMsgPacker Msg(NETMSG_SNAP, true);
+					Msg.AddInt(m_CurrentGameTick);
+					Msg.AddInt(m_CurrentGameTick - DeltaTick);
+					Msg.AddInt(NumParts);
+					Msg.AddInt(n);
+					Msg.AddInt(Crc);
+					Msg.AddInt(Chunk);
+					Msg.AddRaw(&Packet.m_aCompressedData[n * MaxSize], Chunk);
+					SendMsg(&Msg, MSGFLAG_FLUSH, ClientID);
+				}
 			}
 		}
+		else
+		{
+			CMsgPacker Msg(NETMSG_SNAPEMPTY, true);
+			Msg.AddInt(m_CurrentGameTick);
+			Msg.AddInt(m_CurrentGameTick - DeltaTick);
+			SendMsg(&Msg, MSGFLAG_FLUSH, ClientID);
+		}
 	}
 
+	m_SnapshotSharedTick = -1;
+	m_SnapshotBuildTime += BuildTime;
+	m_SnapshotBuildTicks++;
+
 	GameServer()->OnPostSnap();
 }
 
+bool CServer::CSnapshotPacket::CanReuse(const CSnapshotPacket &Other) const
+{
+	// the checksum only narrows down the candidates, compare the content
+	// of both the snapshots and the delta bases to be sure
+	if(m_Crc != Other.m_Crc || m_DeltaTick != Other.m_DeltaTick || m_Sixup != Other.m_Sixup ||
+		m_SnapshotSize != Other.m_SnapshotSize || m_DeltashotSize != Other.m_DeltashotSize)
+		return false;
+	return mem_comp(m_pSnapshot, Other.m_pSnapshot, m_SnapshotSize) == 0 &&
+	       mem_comp(m_pDeltashot, Other.m_pDeltashot, m_DeltashotSize) == 0;
+}
+
+void CServer::CreateSnapshotPacket(CSnapshotPacket *pPacket) const
+{
+	if(pPacket->m_ReusePacket != -1)
+		return;
+
+	const CSnapshotDelta &SnapshotDelta = pPacket->m_Sixup ? m_SnapshotDeltaSixup : m_SnapshotDelta;
+	char aDeltaData[CSnapshot::MAX_SIZE];
+	int DeltaSize = SnapshotDelta.CreateDelta(pPacket->m_pDeltashot, pPacket->m_pSnapshot, aDeltaData, pPacket->m_pDeltashotIndex, pPacket->m_pSnapshotIndex);
+	if(DeltaSize)
+		pPacket->m_CompressedSize = CVariableInt::Compress(aDeltaData, DeltaSize, pPacket->m_aCompressedData, sizeof(pPacket->m_aCompressedData));
+	else
+		pPacket->m_CompressedSize = 0;
+}
+
+class CServer::CSnapshotPacketJob : public IJob
+{
+	CServer *m_pServer;
+	int m_First;
+	int m_Last;
+	SEMAPHORE *m_pDone;
+
+	void Run() override
+	{
+		for(int i = m_First; i < m_Last; i++)
+			m_pServer->CreateSnapshotPacket(&m_pServer->m_vSnapshotPackets[i]);
+		sphore_signal(m_pDone);
+	}
+
+public:
+	CSnapshotPacketJob(CServer *pServer, int First, int Last, SEMAPHORE *pDone) :
+		m_pServer(pServer), m_First(First), m_Last(Last), m_pDone(pDone)
+	{
+	}
+};
+
+void CServer::CreateSnapshotPackets(int NumPackets)
+{
+	const int NumThreads = Config()->m_SvSnapshotThreads;
+	if(NumThreads != m_NumSnapshotThreads)
+	{
+		m_pSnapshotJobPool = nullptr;
+		if(NumThreads > 0)
+		{
+			m_pSnapshotJobPool = std::make_unique<CJobPool>();
+			m_pSnapshotJobPool->Init(NumThreads);
+		}
+		m_NumSnapshotThreads = NumThreads;
+	}
+
+	// not worth waking up the workers for a single client
+	if(!m_pSnapshotJobPool || NumPackets < 2)
+	{
+		for(int i = 0; i < NumPackets; i++)
+			CreateSnapshotPacket(&m_vSnapshotPackets[i]);
+		return;
+	}
+
+	// split the clients evenly, the main thread takes the first share
+	const int NumShares = minimum(NumThreads + 1, NumPackets);
+	int NumJobs = 0;
+	for(int Share = 1; Share < NumShares; Share++)
+	{
+		const int First = NumPackets * Share / NumShares;
+		const int Last = NumPackets * (Share + 1) / NumShares;
+		m_pSnapshotJobPool->Add(std::make_shared<CSnapshotPacketJob>(this, First, Last, &m_SnapshotJobsDone));
+		NumJobs++;
+	}
+
+	for(int i = 0; i < NumPackets / NumShares; i++)
+		CreateSnapshotPacket(&m_vSnapshotPackets[i]);
+
+	for(int i = 0; i < NumJobs; i++)
+		sphore_wait(&m_SnapshotJobsDone);
+}
+
 int CServer::ClientRejoinCallback(int ClientID, void *pUser)
 {
 	CServer *pThis = (CServer *)pUser;
@@ -2533,7 +2695,7 @@ int CServer::LoadMap(const char *pMapName)
 	str_format(aBuf, sizeof(aBuf), "maps/%s.map", pMapName);
 	GameServer()->OnMapChange(aBuf, sizeof(aBuf));
 
-	if(!m_pMap->Load(aBuf))
+	if(!m_pMap->Load(aBuf, Config()->m_DatafileMmap))
 		return 0;
 
 	// stop recording when we change map
@@ -2542,15 +2704,8 @@ int CServer::LoadMap(const char *pMapName)
 		if(!m_aDemoRecorder[i].IsRecording())
 			continue;
 
-		m_aDemoRecorder[i].Stop();
-
 		// remove tmp demos
-		if(i < MAX_CLIENTS)
-		{
-			char aPath[256];
-			str_format(aPath, sizeof(aPath), "demos/%s_%d_%d_tmp.demo", m_aCurrentMap, m_NetServer.Address().port, i);
-			Storage()->RemoveFile(aPath, IStorage::TYPE_SAVE);
-		}
+		m_aDemoRecorder[i].Stop(i < MAX_CLIENTS ? IDemoRecorder::EStopMode::REMOVE_FILE : IDemoRecorder::EStopMode::KEEP_FILE);
 	}
 
 	// reinit snapshot ids
@@ -2978,6 +3133,9 @@ int CServer::Run()
 				}
 			}
 
+			// send everything queued during this iteration before sleeping
+			m_NetServer.Flush();
+
 			// wait for incoming data
 			if(NonActive)
 			{
@@ -3046,6 +3204,8 @@ int CServer::Run()
 	m_NetServer.Close();
 
 	m_pRegister->OnShutdown();
+	// Give the delete requests of the register time to finish.
+	HttpShutdown(std::chrono::seconds(1));
 
 	return ErrorShutdown();
 }
@@ -3440,14 +3600,10 @@ void CServer::SaveDemo(int ClientID, float Time)
 {
 	if(IsRecording(ClientID))
 	{
-		m_aDemoRecorder[ClientID].Stop();
-
-		// rename the demo
-		char aOldFilename[IO_MAX_PATH_LENGTH];
+		// rename the demo once it's written
 		char aNewFilename[IO_MAX_PATH_LENGTH];
-		str_format(aOldFilename, sizeof(aOldFilename), "demos/%s_%d_%d_tmp.demo", m_aCurrentMap, m_NetServer.Address().port, ClientID);
 		str_format(aNewFilename, sizeof(aNewFilename), "demos/%s_%s_%05.2f.demo", m_aCurrentMap, m_aClients[ClientID].m_aName, Time);
-		Storage()->RenameFile(aOldFilename, aNewFilename, IStorage::TYPE_SAVE);
+		m_aDemoRecorder[ClientID].Stop(IDemoRecorder::EStopMode::KEEP_FILE, aNewFilename);
 	}
 }
 
@@ -3465,11 +3621,7 @@ void CServer::StopRecord(int ClientID)
 {
 	if(IsRecording(ClientID))
 	{
-		m_aDemoRecorder[ClientID].Stop();
-
-		char aFilename[IO_MAX_PATH_LENGTH];
-		str_format(aFilename, sizeof(aFilename), "demos/%s_%d_%d_tmp.demo", m_aCurrentMap, m_NetServer.Address().port, ClientID);
-		Storage()->RemoveFile(aFilename, IStorage::TYPE_SAVE);
+		m_aDemoRecorder[ClientID].Stop(IDemoRecorder::EStopMode::REMOVE_FILE);
 	}
 }
 
@@ -3536,6 +3688,25 @@ void CServer::ConShowIps(IConsole::IResult *pResult, void *pUser)
 	}
 }
 
+void CServer::ConSnapshotStats(IConsole::IResult *pResult, void *pUser)
+{
+	CServer *pThis = static_cast<CServer *>(pUser);
+
+	const double TotalMs = pThis->m_SnapshotBuildTime * 1000.0 / time_freq();
+	const double AverageMs = pThis->m_SnapshotBuildTicks > 0 ? TotalMs / pThis->m_SnapshotBuildTicks : 0.0;
+	char aBuf[256];
+	str_format(aBuf, sizeof(aBuf), "mode=%s snapshots=%d build_total=%.2fms build_avg=%.3fms",
+		pThis->Config()->m_SvSharedSnapshot ? "shared" : "per-client", pThis->m_SnapshotBuildTicks, TotalMs, AverageMs);
+	pThis->Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "server", aBuf);
+	str_format(aBuf, sizeof(aBuf), "deltas_created=%d deltas_reused=%d", pThis->m_SnapshotDeltasCreated, pThis->m_SnapshotDeltasReused);
+	pThis->Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "server", aBuf);
+
+	pThis->m_SnapshotBuildTime = 0;
+	pThis->m_SnapshotBuildTicks = 0;
+	pThis->m_SnapshotDeltasCreated = 0;
+	pThis->m_SnapshotDeltasReused = 0;
+}
+
 void CServer::ConAddSqlServer(IConsole::IResult *pResult, void *pUserData)
 {
 	CServer *pSelf = (CServer *)pUserData;
@@ -3833,6 +4004,7 @@ void CServer::RegisterCommands()
 	Console()->Register("shutdown", "?r[reason]", CFGFLAG_SERVER, ConShutdown, this, "Shut down");
 	Console()->Register("logout", "", CFGFLAG_SERVER, ConLogout, this, "Logout of rcon");
 	Console()->Register("show_ips", "?i[show]", CFGFLAG_SERVER, ConShowIps, this, "Show IP addresses in rcon commands (1 = on, 0 = off)");
+	Console()->Register("snapshot_stats", "", CFGFLAG_SERVER, ConSnapshotStats, this, "Show the time spent building snapshots and the number of reused deltas since the last call");
 
 	Console()->Register("record", "?s[file]", CFGFLAG_SERVER | CFGFLAG_STORE, ConRecord, this, "Record to a file");
 	Console()->Register("stoprecord", "", CFGFLAG_SERVER, ConStopRecord, this, "Stop recording");
@@ -3893,12 +4065,38 @@ void CServer::SnapFreeID(int ID)
 void *CServer::SnapNewItem(int Type, int ID, int Size)
 {
 	dbg_assert(ID >= -1 && ID <= 0xffff, "incorrect id");
-	return ID < 0 ? 0 : m_SnapshotBuilder.NewItem(Type, ID, Size);
+	if(ID < 0)
+		return 0;
+	if(m_SnapshotSharedBuilding)
+		return m_SnapshotSharedItems.NewItem(Type, ID, Size);
+	return m_SnapshotBuilder.NewItem(Type, ID, Size);
 }
 
 void CServer::SnapSetStaticsize(int ItemType, int Size)
 {
 	m_SnapshotDelta.SetStaticsize(ItemType, Size);
+	m_SnapshotDeltaSixup.SetStaticsize(ItemType, Size);
+}
+
+bool CServer::SnapSharedAvailable() const
+{
+	return m_SnapshotSharedTick == Tick();
+}
+
+int CServer::SnapSharedItemMark() const
+{
+	return m_SnapshotSharedItems.NumItems();
+}
+
+void CServer::SnapCopySharedItems(int From, int To)
+{
+	dbg_assert(!m_SnapshotSharedBuilding, "copying shared items while building them");
+	m_SnapshotSharedItems.CopyTo(&m_SnapshotBuilder, From, To);
+}
+
+bool CServer::SnapSharedItemsFull() const
+{
+	return m_SnapshotSharedItems.Full();
 }
 
 CServer *CreateServer() { return new CServer(); }
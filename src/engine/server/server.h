@@ -11,6 +11,7 @@
 #include <engine/shared/demo.h>
 #include <engine/shared/econ.h>
 #include <engine/shared/fifo.h>
+#include <engine/shared/jobs.h>
 #include <engine/shared/netban.h>
 #include <engine/shared/network.h>
 #include <engine/shared/protocol.h>
@@ -226,7 +227,47 @@ public:
 	int m_aIdMap[MAX_CLIENTS * VANILLA_MAX_CLIENTS];
 
 	CSnapshotDelta m_SnapshotDelta;
+	CSnapshotDelta m_SnapshotDeltaSixup;
 	CSnapshotBuilder m_SnapshotBuilder;
+	CSnapshotSharedItems m_SnapshotSharedItems;
+	bool m_SnapshotSharedBuilding;
+	int m_SnapshotSharedTick;
+	// time spent building snapshots since the last `snapshot_stats`
+	int64_t m_SnapshotBuildTime;
+	int m_SnapshotBuildTicks;
+	int m_SnapshotDeltasCreated;
+	int m_SnapshotDeltasReused;
+
+	// a snapshot that is ready to be turned into a compressed delta
+	class CSnapshotPacket
+	{
+	public:
+		int m_ClientID;
+		bool m_Sixup;
+		int m_Crc;
+		int m_DeltaTick;
+		int m_SnapshotSize;
+		int m_DeltashotSize;
+		const CSnapshot *m_pSnapshot;
+		const CSnapshot *m_pDeltashot;
+		const CSnapshotIndex *m_pSnapshotIndex;
+		const CSnapshotIndex *m_pDeltashotIndex;
+
+		// packet of an earlier client with the same snapshot and delta
+		// base whose compressed delta is sent instead, -1 if none
+		int m_ReusePacket;
+
+		// 0 if the delta is empty
+		int m_CompressedSize;
+		char m_aCompressedData[CSnapshot::MAX_SIZE];
+
+		bool CanReuse(const CSnapshotPacket &Other) const;
+	};
+	class CSnapshotPacketJob;
+	std::vector<CSnapshotPacket> m_vSnapshotPackets;
+	std::unique_ptr<CJobPool> m_pSnapshotJobPool;
+	int m_NumSnapshotThreads;
+	SEMAPHORE m_SnapshotJobsDone;
 	CSnapIDPool m_IDPool;
 	CNetServer m_NetServer;
 	CEcon m_Econ;
@@ -332,6 +373,8 @@ public:
 	int SendMsg(CMsgPacker *pMsg, int Flags, int ClientID) override;
 
 	void DoSnapshot();
+	void CreateSnapshotPacket(CSnapshotPacket *pPacket) const;
+	void CreateSnapshotPackets(int NumPackets);
 
 	static int NewClientCallback(int ClientID, void *pUser, bool Sixup);
 	static int NewClientNoAuthCallback(int ClientID, void *pUser);
@@ -415,6 +458,7 @@ public:
 	static void ConMapReload(IConsole::IResult *pResult, void *pUser);
 	static void ConLogout(IConsole::IResult *pResult, void *pUser);
 	static void ConShowIps(IConsole::IResult *pResult, void *pUser);
+	static void ConSnapshotStats(IConsole::IResult *pResult, void *pUser);
 
 	static void ConAuthAdd(IConsole::IResult *pResult, void *pUser);
 	static void ConAuthAddHashed(IConsole::IResult *pResult, void *pUser);
@@ -457,6 +501,10 @@ public:
 	void SnapFreeID(int ID) override;
 	void *SnapNewItem(int Type, int ID, int Size) override;
 	void SnapSetStaticsize(int ItemType, int Size) override;
+	bool SnapSharedAvailable() const override;
+	int SnapSharedItemMark() const override;
+	void SnapCopySharedItems(int From, int To) override;
+	bool SnapSharedItemsFull() const override;
 
 	// DDRace
 
@@ -572,7 +572,7 @@ int CConsole::PossibleCommands(const char *pStr, int FlagMask, bool Temp, FPossi
 
 CConsole::CCommand *CConsole::FindCommand(const char *pName, int FlagMask)
 {
-	for(CCommand *pCommand = m_pFirstCommand; pCommand; pCommand = pCommand->m_pNext)
+	for(CCommand *pCommand = m_apCommandHash[CommandHash(pName)]; pCommand; pCommand = pCommand->m_pNextHash)
 	{
 		if(pCommand->m_Flags & FlagMask)
 		{
@@ -968,6 +968,7 @@ CConsole::CConsole(int FlagMask)
 	m_apStrokeStr[1] = "1";
 	m_ExecutionQueue.Reset();
 	m_pFirstCommand = 0;
+	mem_zero(m_apCommandHash, sizeof(m_apCommandHash));
 	m_pFirstExec = 0;
 	m_pfnTeeHistorianCommandCallback = 0;
 	m_pTeeHistorianCommandUserdata = 0;
@@ -1077,14 +1078,31 @@ void CConsole::ParseArguments(int NumArgs, const char **ppArguments)
 	}
 }
 
+unsigned CConsole::CommandHash(const char *pName)
+{
+	// same as str_quickhash, but folds the case like str_comp_nocase
+	unsigned Hash = 5381;
+	for(; *pName; pName++)
+	{
+		const unsigned char Char = *pName;
+		Hash = ((Hash << 5) + Hash) + ((Char >= 'A' && Char <= 'Z') ? Char - 'A' + 'a' : Char);
+	}
+	return Hash % COMMAND_HASH_SIZE;
+}
+
 void CConsole::AddCommandSorted(CCommand *pCommand)
 {
+	// insert in front of the first command with the same name that sorts after it, like in the list below
+	CCommand **ppSlot = &m_apCommandHash[CommandHash(pCommand->m_pName)];
+	for(; *ppSlot; ppSlot = &(*ppSlot)->m_pNextHash)
+		if(str_comp_nocase((*ppSlot)->m_pName, pCommand->m_pName) == 0 && str_comp(pCommand->m_pName, (*ppSlot)->m_pName) <= 0)
+			break;
+	pCommand->m_pNextHash = *ppSlot;
+	*ppSlot = pCommand;
+
 	if(!m_pFirstCommand || str_comp(pCommand->m_pName, m_pFirstCommand->m_pName) <= 0)
 	{
-		if(m_pFirstCommand && m_pFirstCommand->m_pNext)
-			pCommand->m_pNext = m_pFirstCommand;
-		else
-			pCommand->m_pNext = 0;
+		pCommand->m_pNext = m_pFirstCommand;
 		m_pFirstCommand = pCommand;
 	}
 	else
@@ -1101,6 +1119,19 @@ void CConsole::AddCommandSorted(CCommand *pCommand)
 	}
 }
 
+void CConsole::RemoveCommandHash(CCommand *pCommand)
+{
+	for(CCommand **ppSlot = &m_apCommandHash[CommandHash(pCommand->m_pName)]; *ppSlot; ppSlot = &(*ppSlot)->m_pNextHash)
+	{
+		if(*ppSlot == pCommand)
+		{
+			*ppSlot = pCommand->m_pNextHash;
+			pCommand->m_pNextHash = 0;
+			return;
+		}
+	}
+}
+
 void CConsole::Register(const char *pName, const char *pParams,
 	int Flags, FCommandCallback pfnFunc, void *pUser, const char *pHelp)
 {
@@ -1189,6 +1220,7 @@ void CConsole::DeregisterTemp(const char *pName)
 	// add to recycle list
 	if(pRemoved)
 	{
+		RemoveCommandHash(pRemoved);
 		pRemoved->m_pNext = m_pRecycleList;
 		m_pRecycleList = pRemoved;
 	}
@@ -1212,6 +1244,16 @@ void CConsole::DeregisterTempAll()
 		}
 	}
 
+	// remove temp entries from the hash chains
+	for(CCommand *&pChain : m_apCommandHash)
+		for(CCommand **ppSlot = &pChain; *ppSlot;)
+		{
+			if((*ppSlot)->m_Temp)
+				*ppSlot = (*ppSlot)->m_pNextHash;
+			else
+				ppSlot = &(*ppSlot)->m_pNextHash;
+		}
+
 	m_TempCommands.Reset();
 	m_pRecycleList = 0;
 }
@@ -1260,7 +1302,7 @@ void CConsole::StoreCommands(bool Store)
 
 const IConsole::CCommandInfo *CConsole::GetCommandInfo(const char *pName, int FlagMask, bool Temp)
 {
-	for(CCommand *pCommand = m_pFirstCommand; pCommand; pCommand = pCommand->m_pNext)
+	for(CCommand *pCommand = m_apCommandHash[CommandHash(pName)]; pCommand; pCommand = pCommand->m_pNextHash)
 	{
 		if(pCommand->m_Flags & FlagMask && pCommand->m_Temp == Temp)
 		{
@@ -14,6 +14,7 @@ class CConsole : public IConsole
 	{
 	public:
 		CCommand *m_pNext;
+		CCommand *m_pNextHash;
 		int m_Flags;
 		bool m_Temp;
 		FCommandCallback m_pfnCallback;
@@ -38,6 +39,13 @@ class CConsole : public IConsole
 	const char *m_apStrokeStr[2];
 	CCommand *m_pFirstCommand;
 
+	// commands by their case-insensitive name, each chain keeps the order of the sorted list
+	enum
+	{
+		COMMAND_HASH_SIZE = 1024,
+	};
+	CCommand *m_apCommandHash[COMMAND_HASH_SIZE];
+
 	class CExecFile
 	{
 	public:
@@ -188,7 +196,9 @@ class CConsole : public IConsole
 		}
 	} m_ExecutionQueue;
 
+	static unsigned CommandHash(const char *pName);
 	void AddCommandSorted(CCommand *pCommand);
+	void RemoveCommandHash(CCommand *pCommand);
 	CCommand *FindCommand(const char *pName, int FlagMask);
 
 public:
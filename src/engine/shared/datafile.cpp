@@ -7,12 +7,19 @@
 #include <base/log.h>
 #include <base/math.h>
 #include <base/system.h>
+#include <base/tl/threading.h>
+#include <engine/engine.h>
 #include <engine/storage.h>
 
+#include "jobs.h"
 #include "uuid_manager.h"
 
+#include <atomic>
+#include <cstdint>
 #include <cstdlib>
 #include <limits>
+#include <memory>
+#include <vector>
 
 static const int DEBUG = 0;
 
@@ -88,6 +95,9 @@ struct CDatafileInfo
 struct CDatafile
 {
 	IOHANDLE m_File;
+	bool m_Mmap;
+	unsigned char *m_pMapping; // the whole file while preloading, nullptr otherwise
+	size_t m_MappingSize;
 	SHA256_DIGEST m_Sha256;
 	unsigned m_Crc;
 	CDatafileInfo m_Info;
@@ -98,7 +108,7 @@ struct CDatafile
 	char *m_pData;
 };
 
-bool CDataFileReader::Open(class IStorage *pStorage, const char *pFilename, int StorageType)
+bool CDataFileReader::Open(class IStorage *pStorage, const char *pFilename, int StorageType, bool Mmap)
 {
 	log_trace("datafile", "loading. filename='%s'", pFilename);
 
@@ -109,9 +119,26 @@ bool CDataFileReader::Open(class IStorage *pStorage, const char *pFilename, int
 		return false;
 	}
 
+	// map the file for hashing and reading the items if possible. The
+	// mapping is released before returning, the items are copied, so that
+	// the file can be replaced or truncated while it's open.
+	size_t MappingSize = 0;
+	unsigned char *pMapping = Mmap ? static_cast<unsigned char *>(io_mmap(File, &MappingSize)) : nullptr;
+	if(pMapping && MappingSize > (size_t)std::numeric_limits<int>::max())
+	{
+		io_munmap(pMapping, MappingSize);
+		pMapping = nullptr;
+	}
+
 	// take the CRC of the file and store it
 	unsigned Crc = 0;
 	SHA256_DIGEST Sha256;
+	if(pMapping)
+	{
+		Crc = crc32(Crc, pMapping, MappingSize);
+		Sha256 = sha256(pMapping, MappingSize);
+	}
+	else
 	{
 		enum
 		{
@@ -137,15 +164,21 @@ bool CDataFileReader::Open(class IStorage *pStorage, const char *pFilename, int
 
 	// TODO: change this header
 	CDatafileHeader Header;
-	if(sizeof(Header) != io_read(File, &Header, sizeof(Header)))
+	if(pMapping ? MappingSize < sizeof(Header) : sizeof(Header) != io_read(File, &Header, sizeof(Header)))
 	{
+		io_munmap(pMapping, MappingSize);
+		io_close(File);
 		dbg_msg("datafile", "couldn't load header");
 		return false;
 	}
+	if(pMapping)
+		mem_copy(&Header, pMapping, sizeof(Header));
 	if(Header.m_aID[0] != 'A' || Header.m_aID[1] != 'T' || Header.m_aID[2] != 'A' || Header.m_aID[3] != 'D')
 	{
 		if(Header.m_aID[0] != 'D' || Header.m_aID[1] != 'A' || Header.m_aID[2] != 'T' || Header.m_aID[3] != 'A')
 		{
+			io_munmap(pMapping, MappingSize);
+			io_close(File);
 			dbg_msg("datafile", "wrong signature. %x %x %x %x", Header.m_aID[0], Header.m_aID[1], Header.m_aID[2], Header.m_aID[3]);
 			return false;
 		}
@@ -156,6 +189,8 @@ bool CDataFileReader::Open(class IStorage *pStorage, const char *pFilename, int
 #endif
 	if(Header.m_Version != 3 && Header.m_Version != 4)
 	{
+		io_munmap(pMapping, MappingSize);
+		io_close(File);
 		dbg_msg("datafile", "wrong version. version=%x", Header.m_Version);
 		return false;
 	}
@@ -174,6 +209,7 @@ bool CDataFileReader::Open(class IStorage *pStorage, const char *pFilename, int
 	AllocSize += Header.m_NumRawData * sizeof(int); // add space for data sizes
 	if(Size > (((int64_t)1) << 31) || Header.m_NumItemTypes < 0 || Header.m_NumItems < 0 || Header.m_NumRawData < 0 || Header.m_ItemSize < 0)
 	{
+		io_munmap(pMapping, MappingSize);
 		io_close(File);
 		dbg_msg("datafile", "unable to load file, invalid file information");
 		return false;
@@ -186,6 +222,9 @@ bool CDataFileReader::Open(class IStorage *pStorage, const char *pFilename, int
 	pTmpDataFile->m_pDataSizes = (int *)(pTmpDataFile->m_ppDataPtrs + Header.m_NumRawData);
 	pTmpDataFile->m_pData = (char *)(pTmpDataFile->m_pDataSizes + Header.m_NumRawData);
 	pTmpDataFile->m_File = File;
+	pTmpDataFile->m_Mmap = Mmap;
+	pTmpDataFile->m_pMapping = nullptr;
+	pTmpDataFile->m_MappingSize = 0;
 	pTmpDataFile->m_Sha256 = Sha256;
 	pTmpDataFile->m_Crc = Crc;
 
@@ -194,7 +233,17 @@ bool CDataFileReader::Open(class IStorage *pStorage, const char *pFilename, int
 	mem_zero(pTmpDataFile->m_pDataSizes, Header.m_NumRawData * sizeof(int));
 
 	// read types, offsets, sizes and item data
-	unsigned ReadSize = io_read(File, pTmpDataFile->m_pData, Size);
+	unsigned ReadSize;
+	if(pMapping)
+	{
+		ReadSize = minimum<size_t>(Size, MappingSize - sizeof(CDatafileHeader));
+		mem_copy(pTmpDataFile->m_pData, pMapping + sizeof(CDatafileHeader), ReadSize);
+		io_munmap(pMapping, MappingSize);
+	}
+	else
+	{
+		ReadSize = io_read(File, pTmpDataFile->m_pData, Size);
+	}
 	if(ReadSize != Size)
 	{
 		io_close(pTmpDataFile->m_File);
@@ -308,6 +357,106 @@ int CDataFileReader::GetDataSize(int Index) const
 	return Size;
 }
 
+bool CDataFileReader::ReadFileData(int Index, void *pBuffer, unsigned DataSize)
+{
+	const int64_t Offset = (int64_t)m_pDataFile->m_DataStartOffset + m_pDataFile->m_Info.m_pDataOffsets[Index];
+	if(m_pDataFile->m_pMapping)
+	{
+		if(Offset < 0 || Offset + DataSize > (int64_t)m_pDataFile->m_MappingSize)
+			return false;
+		mem_copy(pBuffer, m_pDataFile->m_pMapping + Offset, DataSize);
+		return true;
+	}
+
+	unsigned ActualDataSize = 0;
+	if(io_seek(m_pDataFile->m_File, Offset, IOSEEK_START) == 0)
+		ActualDataSize = io_read(m_pDataFile->m_File, pBuffer, DataSize);
+	return ActualDataSize == DataSize;
+}
+
+const unsigned char *CDataFileReader::MappedFileData(int Index, unsigned DataSize) const
+{
+	const int64_t Offset = (int64_t)m_pDataFile->m_DataStartOffset + m_pDataFile->m_Info.m_pDataOffsets[Index];
+	if(!m_pDataFile->m_pMapping || Offset < 0 || Offset + DataSize > (int64_t)m_pDataFile->m_MappingSize)
+		return nullptr;
+	return m_pDataFile->m_pMapping + Offset;
+}
+
+bool CDataFileReader::LoadData(int Index, bool Swap)
+{
+	// fetch the data size
+	unsigned DataSize = GetFileDataSize(Index);
+#if defined(CONF_ARCH_ENDIAN_BIG)
+	unsigned SwapSize = DataSize;
+#endif
+
+	if(m_pDataFile->m_Header.m_Version == 4)
+	{
+		// v4 has compressed data
+		const unsigned OriginalUncompressedSize = m_pDataFile->m_Info.m_pDataSizes[Index];
+		unsigned long UncompressedSize = OriginalUncompressedSize;
+
+		log_trace("datafile", "loading data. index=%d size=%u uncompressed=%u", Index, DataSize, OriginalUncompressedSize);
+
+		// read the compressed data, mapped files are decompressed in place
+		const unsigned char *pCompressedData = MappedFileData(Index, DataSize);
+		void *pReadData = nullptr;
+		if(!pCompressedData && !m_pDataFile->m_pMapping)
+		{
+			pReadData = malloc(DataSize);
+			if(ReadFileData(Index, pReadData, DataSize))
+				pCompressedData = static_cast<const unsigned char *>(pReadData);
+		}
+		if(!pCompressedData)
+		{
+			log_error("datafile", "truncation error, could not read all data. index=%d wanted=%u", Index, DataSize);
+			free(pReadData);
+			m_pDataFile->m_ppDataPtrs[Index] = nullptr;
+			m_pDataFile->m_pDataSizes[Index] = -1;
+			return false;
+		}
+
+		// decompress the data
+		m_pDataFile->m_ppDataPtrs[Index] = (char *)malloc(UncompressedSize);
+		m_pDataFile->m_pDataSizes[Index] = UncompressedSize;
+		const int Result = uncompress((Bytef *)m_pDataFile->m_ppDataPtrs[Index], &UncompressedSize, (const Bytef *)pCompressedData, DataSize);
+		free(pReadData);
+		if(Result != Z_OK || UncompressedSize != OriginalUncompressedSize)
+		{
+			log_error("datafile", "uncompress error. result=%d wanted=%u got=%lu", Result, OriginalUncompressedSize, UncompressedSize);
+			free(m_pDataFile->m_ppDataPtrs[Index]);
+			m_pDataFile->m_ppDataPtrs[Index] = nullptr;
+			m_pDataFile->m_pDataSizes[Index] = -1;
+			return false;
+		}
+
+#if defined(CONF_ARCH_ENDIAN_BIG)
+		SwapSize = UncompressedSize;
+#endif
+	}
+	else
+	{
+		// load the data
+		log_trace("datafile", "loading data. index=%d size=%d", Index, DataSize);
+		m_pDataFile->m_ppDataPtrs[Index] = static_cast<char *>(malloc(DataSize));
+		m_pDataFile->m_pDataSizes[Index] = DataSize;
+		if(!ReadFileData(Index, m_pDataFile->m_ppDataPtrs[Index], DataSize))
+		{
+			log_error("datafile", "truncation error, could not read all data. index=%d wanted=%u", Index, DataSize);
+			free(m_pDataFile->m_ppDataPtrs[Index]);
+			m_pDataFile->m_ppDataPtrs[Index] = nullptr;
+			m_pDataFile->m_pDataSizes[Index] = -1;
+			return false;
+		}
+	}
+
+#if defined(CONF_ARCH_ENDIAN_BIG)
+	if(Swap && SwapSize)
+		swap_endian(m_pDataFile->m_ppDataPtrs[Index], sizeof(int), SwapSize / sizeof(int));
+#endif
+	return true;
+}
+
 void *CDataFileReader::GetDataImpl(int Index, bool Swap)
 {
 	if(!m_pDataFile)
@@ -325,78 +474,85 @@ void *CDataFileReader::GetDataImpl(int Index, bool Swap)
 		if(m_pDataFile->m_pDataSizes[Index] < 0)
 			return nullptr;
 
-		// fetch the data size
-		unsigned DataSize = GetFileDataSize(Index);
-#if defined(CONF_ARCH_ENDIAN_BIG)
-		unsigned SwapSize = DataSize;
-#endif
+		if(!LoadData(Index, Swap))
+			return nullptr;
+	}
+
+	return m_pDataFile->m_ppDataPtrs[Index];
+}
 
-		if(m_pDataFile->m_Header.m_Version == 4)
+class CDataFileReader::CLoadDataJob : public IJob
+{
+public:
+	// shared with the jobs, they might only start running after the reader is gone
+	struct CState
+	{
+		CDataFileReader *m_pReader;
+		std::vector<int> m_vIndices;
+		std::atomic<int> m_Next{0};
+		std::atomic<int> m_NumDone{0};
+		CSemaphore m_AllDone;
+
+		void Work()
 		{
-			// v4 has compressed data
-			const unsigned OriginalUncompressedSize = m_pDataFile->m_Info.m_pDataSizes[Index];
-			unsigned long UncompressedSize = OriginalUncompressedSize;
-
-			log_trace("datafile", "loading data. index=%d size=%u uncompressed=%u", Index, DataSize, OriginalUncompressedSize);
-
-			// read the compressed data
-			void *pCompressedData = malloc(DataSize);
-			unsigned ActualDataSize = 0;
-			if(io_seek(m_pDataFile->m_File, m_pDataFile->m_DataStartOffset + m_pDataFile->m_Info.m_pDataOffsets[Index], IOSEEK_START) == 0)
-				ActualDataSize = io_read(m_pDataFile->m_File, pCompressedData, DataSize);
-			if(DataSize != ActualDataSize)
+			int Next;
+			while((Next = m_Next++) < (int)m_vIndices.size())
 			{
-				log_error("datafile", "truncation error, could not read all data. index=%d wanted=%u got=%u", Index, DataSize, ActualDataSize);
-				free(pCompressedData);
-				m_pDataFile->m_ppDataPtrs[Index] = nullptr;
-				m_pDataFile->m_pDataSizes[Index] = -1;
-				return nullptr;
+				m_pReader->LoadData(m_vIndices[Next], false);
+				if(++m_NumDone == (int)m_vIndices.size())
+					m_AllDone.Signal();
 			}
+		}
+	};
 
-			// decompress the data
-			m_pDataFile->m_ppDataPtrs[Index] = (char *)malloc(UncompressedSize);
-			m_pDataFile->m_pDataSizes[Index] = UncompressedSize;
-			const int Result = uncompress((Bytef *)m_pDataFile->m_ppDataPtrs[Index], &UncompressedSize, (Bytef *)pCompressedData, DataSize);
-			free(pCompressedData);
-			if(Result != Z_OK || UncompressedSize != OriginalUncompressedSize)
-			{
-				log_error("datafile", "uncompress error. result=%d wanted=%u got=%lu", Result, OriginalUncompressedSize, UncompressedSize);
-				free(m_pDataFile->m_ppDataPtrs[Index]);
-				m_pDataFile->m_ppDataPtrs[Index] = nullptr;
-				m_pDataFile->m_pDataSizes[Index] = -1;
-				return nullptr;
-			}
+	std::shared_ptr<CState> m_pState;
 
-#if defined(CONF_ARCH_ENDIAN_BIG)
-			SwapSize = UncompressedSize;
-#endif
-		}
-		else
+	CLoadDataJob(std::shared_ptr<CState> pState) :
+		m_pState(std::move(pState)) {}
+	void Run() override { m_pState->Work(); }
+};
+
+void CDataFileReader::PreloadData(IEngine *pEngine)
+{
+	if(!m_pDataFile)
+		return;
+
+	// which data has to be swapped is only known when it is requested
+#if !defined(CONF_ARCH_ENDIAN_BIG)
+	auto pState = std::make_shared<CLoadDataJob::CState>();
+	pState->m_pReader = this;
+	for(int i = 0; i < m_pDataFile->m_Header.m_NumRawData; i++)
+		if(!m_pDataFile->m_ppDataPtrs[i] && m_pDataFile->m_pDataSizes[i] == 0)
+			pState->m_vIndices.push_back(i);
+
+	// map the file while loading, the data is copied or decompressed from it
+	if(m_pDataFile->m_Mmap)
+	{
+		m_pDataFile->m_pMapping = static_cast<unsigned char *>(io_mmap(m_pDataFile->m_File, &m_pDataFile->m_MappingSize));
+		if(m_pDataFile->m_pMapping && m_pDataFile->m_MappingSize > (size_t)std::numeric_limits<int>::max())
 		{
-			// load the data
-			log_trace("datafile", "loading data. index=%d size=%d", Index, DataSize);
-			m_pDataFile->m_ppDataPtrs[Index] = static_cast<char *>(malloc(DataSize));
-			m_pDataFile->m_pDataSizes[Index] = DataSize;
-			unsigned ActualDataSize = 0;
-			if(io_seek(m_pDataFile->m_File, m_pDataFile->m_DataStartOffset + m_pDataFile->m_Info.m_pDataOffsets[Index], IOSEEK_START) == 0)
-				ActualDataSize = io_read(m_pDataFile->m_File, m_pDataFile->m_ppDataPtrs[Index], DataSize);
-			if(DataSize != ActualDataSize)
-			{
-				log_error("datafile", "truncation error, could not read all data. index=%d wanted=%u got=%u", Index, DataSize, ActualDataSize);
-				free(m_pDataFile->m_ppDataPtrs[Index]);
-				m_pDataFile->m_ppDataPtrs[Index] = nullptr;
-				m_pDataFile->m_pDataSizes[Index] = -1;
-				return nullptr;
-			}
+			io_munmap(m_pDataFile->m_pMapping, m_pDataFile->m_MappingSize);
+			m_pDataFile->m_pMapping = nullptr;
 		}
+	}
 
-#if defined(CONF_ARCH_ENDIAN_BIG)
-		if(Swap && SwapSize)
-			swap_endian(m_pDataFile->m_ppDataPtrs[Index], sizeof(int), SwapSize / sizeof(int));
-#endif
+	// reading the file is not thread-safe, only decompressing mapped data is done in parallel
+	if(pEngine && m_pDataFile->m_pMapping && m_pDataFile->m_Header.m_Version == 4)
+	{
+		const int NumJobs = minimum<int>(pState->m_vIndices.size() / 2, MAX_PRELOAD_JOBS);
+		for(int i = 0; i < NumJobs; i++)
+			pEngine->AddJob(std::make_shared<CLoadDataJob>(pState));
 	}
 
-	return m_pDataFile->m_ppDataPtrs[Index];
+	// help with the work and wait for the data that the jobs took
+	pState->Work();
+	if(!pState->m_vIndices.empty())
+		pState->m_AllDone.Wait();
+
+	io_munmap(m_pDataFile->m_pMapping, m_pDataFile->m_MappingSize);
+	m_pDataFile->m_pMapping = nullptr;
+	m_pDataFile->m_MappingSize = 0;
+#endif
 }
 
 void *CDataFileReader::GetData(int Index)
@@ -19,10 +19,25 @@ enum
 };
 
 // raw datafile access
+//
+// If Mmap is passed to Open, the file is only mapped into memory while opening
+// and in PreloadData. It must not be truncated during those, but can be replaced
+// while the reader is open. Data that isn't loaded yet is read from the
+// file then.
 class CDataFileReader
 {
+	enum
+	{
+		MAX_PRELOAD_JOBS = 8,
+	};
+
+	class CLoadDataJob;
+
 	struct CDatafile *m_pDataFile;
 	void *GetDataImpl(int Index, bool Swap);
+	bool LoadData(int Index, bool Swap);
+	bool ReadFileData(int Index, void *pBuffer, unsigned DataSize);
+	const unsigned char *MappedFileData(int Index, unsigned DataSize) const;
 	int GetFileDataSize(int Index) const;
 
 	int GetExternalItemType(int InternalType);
@@ -40,7 +55,7 @@ public:
 		return *this;
 	}
 
-	bool Open(class IStorage *pStorage, const char *pFilename, int StorageType);
+	bool Open(class IStorage *pStorage, const char *pFilename, int StorageType, bool Mmap = false);
 	bool Close();
 	bool IsOpen() const { return m_pDataFile != nullptr; }
 	IOHANDLE File() const;
@@ -51,6 +66,8 @@ public:
 	const char *GetDataString(int Index);
 	void ReplaceData(int Index, char *pData, size_t Size); // memory for data must have been allocated with malloc
 	void UnloadData(int Index);
+	// loads all data that is not loaded yet, decompresses it on the job pool if pEngine is set
+	void PreloadData(class IEngine *pEngine);
 	int NumData() const;
 
 	int GetItemSize(int Index) const;
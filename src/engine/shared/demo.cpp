@@ -17,10 +17,21 @@
 #include "network.h"
 #include "snapshot.h"
 
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <limits>
+#include <mutex>
+
 const double g_aSpeeds[g_DemoSpeeds] = {0.1, 0.25, 0.5, 0.75, 1.0, 1.25, 1.5, 2.0, 3.0, 4.0, 6.0, 8.0, 12.0, 16.0, 20.0, 24.0, 28.0, 32.0, 40.0, 48.0, 56.0, 64.0};
 const CUuid SHA256_EXTENSION =
 	{{0x6b, 0xe6, 0xda, 0x4a, 0xce, 0xbd, 0x38, 0x0c,
 		0x9b, 0x5b, 0x12, 0x89, 0xc8, 0x42, 0xd7, 0x80}};
+// "1d997ff8-a491-3d20-9a6f-b7477340d2d0"
+// "demoitem-keyframes@ddnet.org"
+static const CUuid KEYFRAME_INDEX_EXTENSION =
+	{{0x1d, 0x99, 0x7f, 0xf8, 0xa4, 0x91, 0x3d, 0x20,
+		0x9a, 0x6f, 0xb7, 0x47, 0x73, 0x40, 0xd2, 0xd0}};
 
 static const unsigned char gs_CurVersion = 6;
 static const unsigned char gs_OldVersion = 3;
@@ -31,9 +42,159 @@ static const int gs_NumMarkersOffset = 176;
 
 static const ColorRGBA gs_DemoPrintColor{0.75f, 0.7f, 0.7f, 1.0f};
 
+/*
+	Tickmarker
+		7	= Always set
+		6	= Keyframe flag
+		0-5	= Delta tick
+
+	Normal
+		7 = Not set
+		5-6	= Type
+		0-4	= Size
+*/
+
+enum
+{
+	CHUNKTYPEFLAG_TICKMARKER = 0x80,
+	CHUNKTICKFLAG_KEYFRAME = 0x40, // only when tickmarker is set
+	CHUNKTICKFLAG_TICK_COMPRESSED = 0x20, // when we store the tick value in the first chunk
+
+	CHUNKMASK_TICK = 0x1f,
+	CHUNKMASK_TICK_LEGACY = 0x3f,
+	CHUNKMASK_TYPE = 0x60,
+	CHUNKMASK_SIZE = 0x1f,
+
+	CHUNKTYPE_KEYFRAME_INDEX = 0, // ignored by players that don't know it
+	CHUNKTYPE_SNAPSHOT = 1,
+	CHUNKTYPE_MESSAGE = 2,
+	CHUNKTYPE_DELTA = 3,
+
+	MAX_CHUNK_HEADER_SIZE = 3,
+	MAX_CHUNK_SIZE = 0xffff,
+};
+
+/*
+	Keyframe index
+
+	Written at the end of the demo in chunks of type CHUNKTYPE_KEYFRAME_INDEX,
+	the last chunk of the file is the last index chunk. The data is an int
+	array:
+		0-3	= KEYFRAME_INDEX_EXTENSION
+		4	= First tick
+		5	= Last tick
+		6	= File offset of the previous index chunk, 0 if this is the first one
+		7	= Number of keyframes in this chunk
+		8-	= Tick and file offset of the tickmarker of each keyframe
+*/
+
+enum
+{
+	KEYFRAME_INDEX_HEADER_SIZE = 8,
+	KEYFRAME_INDEX_CHUNK_ENTRIES = 1024,
+};
+
+static int KeyFrameIndexMagic(int Index)
+{
+	return bytes_be_to_uint(&KEYFRAME_INDEX_EXTENSION.m_aData[Index * sizeof(int32_t)]);
+}
+
+// Encoding state of one recording. Its chunks are encoded and written by
+// the shared CWriterThread, which also finishes and closes the file after
+// the recording stopped.
+class CDemoRecorder::CWriter
+{
+public:
+	IOHANDLE m_File;
+	IStorage *m_pStorage;
+	char m_aFilename[IO_MAX_PATH_LENGTH];
+	const CSnapshotDelta *m_pSnapshotDelta;
+	int m_KeyFrameInterval;
+	bool m_DropSnapshots;
+
+	// protected by the mutex of the writer thread
+	int m_NumQueued = 0;
+	bool m_Closed = false;
+	CWriterStats m_Stats;
+
+	// set when stopping, used for finishing the file
+	int m_Length = 0;
+	int m_NumTimelineMarkers = 0;
+	int m_aTimelineMarkers[MAX_TIMELINE_MARKERS];
+	IDemoRecorder::EStopMode m_StopMode = IDemoRecorder::EStopMode::KEEP_FILE;
+	char m_aTargetFilename[IO_MAX_PATH_LENGTH] = "";
+
+	// only used by the writer thread
+	int m_LastTickMarker = -1;
+	int m_LastKeyFrame = -1;
+	int m_FirstTick = -1;
+	std::vector<SDemoKeyFrame> m_vKeyFrames;
+	unsigned char m_aLastSnapshotData[CSnapshot::MAX_SIZE];
+
+	CWriter(IOHANDLE File, IStorage *pStorage, const char *pFilename, const CSnapshotDelta *pSnapshotDelta, int KeyFrameInterval, bool DropSnapshots) :
+		m_File(File), m_pStorage(pStorage), m_pSnapshotDelta(pSnapshotDelta), m_KeyFrameInterval(KeyFrameInterval), m_DropSnapshots(DropSnapshots)
+	{
+		str_copy(m_aFilename, pFilename);
+	}
+
+	void WriteTickMarker(int Tick, bool Keyframe);
+	void Write(int Type, const void *pData, int Size);
+	void WriteSnapshot(int Tick, const void *pData, int Size);
+	void WriteKeyFrameIndex();
+	// writes the keyframe index and the header fields, then closes, renames
+	// or removes the file
+	void Close();
+};
+
+// Encodes and writes the chunks of all recordings in the order they were
+// recorded. The queue of each recording is bounded, recording waits or drops
+// snapshots if it's full, see demo_writer_drop.
+class CDemoRecorder::CWriterThread
+{
+	enum
+	{
+		MAX_QUEUED_CHUNKS = 256,
+		CHUNKTYPE_FINISH = -1,
+	};
+
+	struct CJob
+	{
+		std::shared_ptr<CWriter> m_pWriter;
+		int m_Type;
+		int m_Tick;
+		std::vector<unsigned char> m_vData;
+	};
+
+	std::mutex m_Mutex;
+	std::condition_variable m_QueueCondition;
+	std::condition_variable m_SpaceCondition;
+	std::condition_variable m_ClosedCondition;
+	std::deque<CJob> m_Queue;
+	std::vector<std::vector<unsigned char>> m_vvFreeBuffers;
+	bool m_Shutdown = false;
+	void *m_pThread;
+
+	static void ThreadMain(void *pUser);
+	void Run();
+
+public:
+	CWriterThread();
+	// writes the remaining chunks of all recordings before returning
+	~CWriterThread();
+
+	// the thread is started with the first recording and ends with the last
+	// recorder that used it
+	static std::shared_ptr<CWriterThread> Get();
+
+	// returns false if the queue of the recording was full
+	bool Push(const std::shared_ptr<CWriter> &pWriter, int Type, int Tick, const void *pData, int Size);
+	void Finish(const std::shared_ptr<CWriter> &pWriter);
+	void WaitClosed(const CWriter *pWriter);
+	CWriterStats Stats(const CWriter *pWriter);
+};
+
 CDemoRecorder::CDemoRecorder(class CSnapshotDelta *pSnapshotDelta, bool NoMapData)
 {
-	m_File = 0;
 	m_aCurrentFilename[0] = '\0';
 	m_pfnFilter = nullptr;
 	m_pUser = nullptr;
@@ -44,13 +205,18 @@ CDemoRecorder::CDemoRecorder(class CSnapshotDelta *pSnapshotDelta, bool NoMapDat
 
 CDemoRecorder::~CDemoRecorder()
 {
-	dbg_assert(m_File == 0, "Demo recorder was not stopped");
+	dbg_assert(m_pWriter == nullptr, "Demo recorder was not stopped");
+	WaitUntilWritten();
 }
 
 // Record
 int CDemoRecorder::Start(class IStorage *pStorage, class IConsole *pConsole, const char *pFilename, const char *pNetVersion, const char *pMap, const SHA256_DIGEST &Sha256, unsigned Crc, const char *pType, unsigned MapSize, unsigned char *pMapData, IOHANDLE MapFile, DEMOFUNC_FILTER pfnFilter, void *pUser)
 {
-	dbg_assert(m_File == 0, "Demo recorder already recording");
+	dbg_assert(m_pWriter == nullptr, "Demo recorder already recording");
+
+	// don't overwrite the file of the last recording while it's written
+	if(m_pStoppedWriter && (str_comp(m_pStoppedWriter->m_aFilename, pFilename) == 0 || str_comp(m_pStoppedWriter->m_aTargetFilename, pFilename) == 0))
+		WaitUntilWritten();
 
 	m_pfnFilter = pfnFilter;
 	m_pUser = pUser;
@@ -165,10 +331,10 @@ int CDemoRecorder::Start(class IStorage *pStorage, class IConsole *pConsole, con
 			io_seek(MapFile, 0, IOSEEK_START);
 	}
 
-	m_LastKeyFrame = -1;
 	m_LastTickMarker = -1;
 	m_FirstTick = -1;
 	m_NumTimelineMarkers = 0;
+	m_LastStats = CWriterStats();
 
 	if(m_pConsole)
 	{
@@ -176,41 +342,16 @@ int CDemoRecorder::Start(class IStorage *pStorage, class IConsole *pConsole, con
 		str_format(aBuf, sizeof(aBuf), "Recording to '%s'", pFilename);
 		m_pConsole->Print(IConsole::OUTPUT_LEVEL_STANDARD, "demo_recorder", aBuf, gs_DemoPrintColor);
 	}
-	m_File = DemoFile;
+	if(!m_pWriterThread)
+		m_pWriterThread = CWriterThread::Get();
+	m_pWriter = std::make_shared<CWriter>(DemoFile, pStorage, pFilename, m_pSnapshotDelta, g_Config.m_DemoKeyframeInterval, g_Config.m_DemoWriterDrop);
+	m_NextQueueFullReport = 0;
 	str_copy(m_aCurrentFilename, pFilename);
 
 	return 0;
 }
 
-/*
-	Tickmarker
-		7	= Always set
-		6	= Keyframe flag
-		0-5	= Delta tick
-
-	Normal
-		7 = Not set
-		5-6	= Type
-		0-4	= Size
-*/
-
-enum
-{
-	CHUNKTYPEFLAG_TICKMARKER = 0x80,
-	CHUNKTICKFLAG_KEYFRAME = 0x40, // only when tickmarker is set
-	CHUNKTICKFLAG_TICK_COMPRESSED = 0x20, // when we store the tick value in the first chunk
-
-	CHUNKMASK_TICK = 0x1f,
-	CHUNKMASK_TICK_LEGACY = 0x3f,
-	CHUNKMASK_TYPE = 0x60,
-	CHUNKMASK_SIZE = 0x1f,
-
-	CHUNKTYPE_SNAPSHOT = 1,
-	CHUNKTYPE_MESSAGE = 2,
-	CHUNKTYPE_DELTA = 3,
-};
-
-void CDemoRecorder::WriteTickMarker(int Tick, bool Keyframe)
+void CDemoRecorder::CWriter::WriteTickMarker(int Tick, bool Keyframe)
 {
 	if(m_LastTickMarker == -1 || Tick - m_LastTickMarker > CHUNKMASK_TICK || Keyframe)
 	{
@@ -235,11 +376,8 @@ void CDemoRecorder::WriteTickMarker(int Tick, bool Keyframe)
 		m_FirstTick = Tick;
 }
 
-void CDemoRecorder::Write(int Type, const void *pData, int Size)
+void CDemoRecorder::CWriter::Write(int Type, const void *pData, int Size)
 {
-	if(!m_File)
-		return;
-
 	if(Size > 64 * 1024)
 		return;
 
@@ -285,11 +423,12 @@ void CDemoRecorder::Write(int Type, const void *pData, int Size)
 	io_write(m_File, aBuffer2, Size);
 }
 
-void CDemoRecorder::RecordSnapshot(int Tick, const void *pData, int Size)
+void CDemoRecorder::CWriter::WriteSnapshot(int Tick, const void *pData, int Size)
 {
-	if(m_LastKeyFrame == -1 || (Tick - m_LastKeyFrame) > SERVER_TICK_SPEED * 5)
+	if(m_LastKeyFrame == -1 || (Tick - m_LastKeyFrame) > m_KeyFrameInterval)
 	{
 		// write full tickmarker
+		m_vKeyFrames.emplace_back(io_tell(m_File), Tick);
 		WriteTickMarker(Tick, true);
 
 		// write snapshot
@@ -315,27 +454,42 @@ void CDemoRecorder::RecordSnapshot(int Tick, const void *pData, int Size)
 	}
 }
 
-void CDemoRecorder::RecordMessage(const void *pData, int Size)
+void CDemoRecorder::CWriter::WriteKeyFrameIndex()
 {
-	if(m_pfnFilter)
+	std::vector<int> vData;
+	long PrevOffset = 0;
+	for(size_t Start = 0; Start < m_vKeyFrames.size(); Start += KEYFRAME_INDEX_CHUNK_ENTRIES)
 	{
-		if(m_pfnFilter(pData, Size, m_pUser))
-		{
+		const long Offset = io_tell(m_File);
+		if(Offset <= 0 || Offset > std::numeric_limits<int>::max())
 			return;
+
+		const size_t Num = minimum<size_t>(m_vKeyFrames.size() - Start, KEYFRAME_INDEX_CHUNK_ENTRIES);
+		vData.clear();
+		for(int i = 0; i < 4; i++)
+			vData.push_back(KeyFrameIndexMagic(i));
+		vData.push_back(m_FirstTick);
+		vData.push_back(m_LastTickMarker);
+		vData.push_back(PrevOffset);
+		vData.push_back(Num);
+		for(size_t i = Start; i < Start + Num; i++)
+		{
+			vData.push_back(m_vKeyFrames[i].m_Tick);
+			vData.push_back(m_vKeyFrames[i].m_Filepos);
 		}
+		Write(CHUNKTYPE_KEYFRAME_INDEX, vData.data(), vData.size() * sizeof(int));
+		PrevOffset = Offset;
 	}
-	Write(CHUNKTYPE_MESSAGE, pData, Size);
 }
 
-int CDemoRecorder::Stop()
+void CDemoRecorder::CWriter::Close()
 {
-	if(!m_File)
-		return -1;
+	WriteKeyFrameIndex();
 
 	// add the demo length to the header
 	io_seek(m_File, gs_LengthOffset, IOSEEK_START);
 	unsigned char aLength[sizeof(int32_t)];
-	uint_to_bytes_be(aLength, Length());
+	uint_to_bytes_be(aLength, m_Length);
 	io_write(m_File, aLength, sizeof(aLength));
 
 	// add the timeline markers to the header
@@ -351,13 +505,236 @@ int CDemoRecorder::Stop()
 	}
 
 	io_close(m_File);
-	m_File = 0;
+	m_File = nullptr;
+
+	if(m_StopMode == IDemoRecorder::EStopMode::REMOVE_FILE)
+		m_pStorage->RemoveFile(m_aFilename, IStorage::TYPE_SAVE);
+	else if(m_aTargetFilename[0] != '\0')
+		m_pStorage->RenameFile(m_aFilename, m_aTargetFilename, IStorage::TYPE_SAVE);
+}
+
+CDemoRecorder::CWriterThread::CWriterThread()
+{
+	m_pThread = thread_init(ThreadMain, this, "demo_writer");
+}
+
+CDemoRecorder::CWriterThread::~CWriterThread()
+{
+	{
+		std::unique_lock<std::mutex> Lock(m_Mutex);
+		m_Shutdown = true;
+	}
+	m_QueueCondition.notify_one();
+	thread_wait(m_pThread);
+}
+
+std::shared_ptr<CDemoRecorder::CWriterThread> CDemoRecorder::CWriterThread::Get()
+{
+	static std::mutex s_Mutex;
+	static std::weak_ptr<CWriterThread> s_pThread;
+	std::unique_lock<std::mutex> Lock(s_Mutex);
+	std::shared_ptr<CWriterThread> pThread = s_pThread.lock();
+	if(!pThread)
+	{
+		pThread = std::make_shared<CWriterThread>();
+		s_pThread = pThread;
+	}
+	return pThread;
+}
+
+bool CDemoRecorder::CWriterThread::Push(const std::shared_ptr<CWriter> &pWriter, int Type, int Tick, const void *pData, int Size)
+{
+	// copy the data outside of the lock, the buffers of written chunks are reused
+	std::vector<unsigned char> vData;
+	{
+		std::unique_lock<std::mutex> Lock(m_Mutex);
+		if(pWriter->m_NumQueued >= MAX_QUEUED_CHUNKS && pWriter->m_DropSnapshots && Type == CHUNKTYPE_SNAPSHOT)
+		{
+			// the next snapshot is encoded against the last written one
+			pWriter->m_Stats.m_NumDropped++;
+			return false;
+		}
+		if(!m_vvFreeBuffers.empty())
+		{
+			vData = std::move(m_vvFreeBuffers.back());
+			m_vvFreeBuffers.pop_back();
+		}
+	}
+	vData.assign((const unsigned char *)pData, (const unsigned char *)pData + Size);
+
+	bool Full = false;
+	{
+		std::unique_lock<std::mutex> Lock(m_Mutex);
+		if(pWriter->m_NumQueued >= MAX_QUEUED_CHUNKS)
+		{
+			// messages are never dropped
+			Full = true;
+			const int64_t WaitStart = time_get();
+			m_SpaceCondition.wait(Lock, [&]() { return pWriter->m_NumQueued < MAX_QUEUED_CHUNKS; });
+			pWriter->m_Stats.m_NumBlocked++;
+			pWriter->m_Stats.m_BlockedTime += time_get() - WaitStart;
+		}
+		m_Queue.push_back({pWriter, Type, Tick, std::move(vData)});
+		pWriter->m_NumQueued++;
+		pWriter->m_Stats.m_NumChunks++;
+		pWriter->m_Stats.m_MaxQueued = maximum(pWriter->m_Stats.m_MaxQueued, pWriter->m_NumQueued);
+	}
+	m_QueueCondition.notify_one();
+	return !Full;
+}
+
+void CDemoRecorder::CWriterThread::Finish(const std::shared_ptr<CWriter> &pWriter)
+{
+	{
+		std::unique_lock<std::mutex> Lock(m_Mutex);
+		m_Queue.push_back({pWriter, CHUNKTYPE_FINISH, -1, {}});
+	}
+	m_QueueCondition.notify_one();
+}
+
+void CDemoRecorder::CWriterThread::WaitClosed(const CWriter *pWriter)
+{
+	std::unique_lock<std::mutex> Lock(m_Mutex);
+	m_ClosedCondition.wait(Lock, [pWriter]() { return pWriter->m_Closed; });
+}
+
+CDemoRecorder::CWriterStats CDemoRecorder::CWriterThread::Stats(const CWriter *pWriter)
+{
+	std::unique_lock<std::mutex> Lock(m_Mutex);
+	return pWriter->m_Stats;
+}
+
+void CDemoRecorder::CWriterThread::Run()
+{
+	while(true)
+	{
+		CJob Job;
+		{
+			std::unique_lock<std::mutex> Lock(m_Mutex);
+			m_QueueCondition.wait(Lock, [this]() { return !m_Queue.empty() || m_Shutdown; });
+			if(m_Queue.empty())
+				break;
+			Job = std::move(m_Queue.front());
+			m_Queue.pop_front();
+			if(Job.m_Type != CHUNKTYPE_FINISH)
+				Job.m_pWriter->m_NumQueued--;
+		}
+		// recordings wait for the space of their own queue
+		m_SpaceCondition.notify_all();
+
+		CWriter *pWriter = Job.m_pWriter.get();
+		if(Job.m_Type == CHUNKTYPE_FINISH)
+		{
+			pWriter->Close();
+			{
+				std::unique_lock<std::mutex> Lock(m_Mutex);
+				pWriter->m_Closed = true;
+			}
+			m_ClosedCondition.notify_all();
+			continue;
+		}
+
+		if(Job.m_Type == CHUNKTYPE_SNAPSHOT)
+			pWriter->WriteSnapshot(Job.m_Tick, Job.m_vData.data(), Job.m_vData.size());
+		else
+			pWriter->Write(Job.m_Type, Job.m_vData.data(), Job.m_vData.size());
+
+		std::unique_lock<std::mutex> Lock(m_Mutex);
+		m_vvFreeBuffers.push_back(std::move(Job.m_vData));
+	}
+}
+
+void CDemoRecorder::CWriterThread::ThreadMain(void *pUser)
+{
+	static_cast<CWriterThread *>(pUser)->Run();
+}
+
+void CDemoRecorder::Push(int Type, int Tick, const void *pData, int Size)
+{
+	if(m_pWriterThread->Push(m_pWriter, Type, Tick, pData, Size) || !m_pConsole)
+		return;
+
+	// report a slow writer while recording, not more than every ten seconds
+	const int64_t Now = time_get();
+	if(Now < m_NextQueueFullReport)
+		return;
+	m_NextQueueFullReport = Now + 10 * time_freq();
+	const CWriterStats Stats = m_pWriterThread->Stats(m_pWriter.get());
+	char aBuf[192];
+	str_format(aBuf, sizeof(aBuf), "Writing the demo is too slow, dropped %" PRId64 " snapshots and waited %" PRId64 " times for %.2fms in total", Stats.m_NumDropped, Stats.m_NumBlocked, Stats.m_BlockedTime * 1000.0 / time_freq());
+	m_pConsole->Print(IConsole::OUTPUT_LEVEL_STANDARD, "demo_recorder", aBuf, gs_DemoPrintColor);
+}
+
+void CDemoRecorder::RecordSnapshot(int Tick, const void *pData, int Size)
+{
+	if(!m_pWriter)
+		return;
+
+	Push(CHUNKTYPE_SNAPSHOT, Tick, pData, Size);
+	m_LastTickMarker = Tick;
+	if(m_FirstTick < 0)
+		m_FirstTick = Tick;
+}
+
+void CDemoRecorder::RecordMessage(const void *pData, int Size)
+{
+	if(!m_pWriter)
+		return;
+
+	if(m_pfnFilter)
+	{
+		if(m_pfnFilter(pData, Size, m_pUser))
+		{
+			return;
+		}
+	}
+	Push(CHUNKTYPE_MESSAGE, m_LastTickMarker, pData, Size);
+}
+
+CDemoRecorder::CWriterStats CDemoRecorder::WriterStats() const
+{
+	return m_pWriter ? m_pWriterThread->Stats(m_pWriter.get()) : m_LastStats;
+}
+
+int CDemoRecorder::Stop(IDemoRecorder::EStopMode Mode, const char *pTargetFilename)
+{
+	if(!m_pWriter)
+		return -1;
+
+	// the writer thread writes the queued chunks, the keyframe index and
+	// the header fields before closing the file
+	m_pWriter->m_Length = Length();
+	m_pWriter->m_NumTimelineMarkers = m_NumTimelineMarkers;
+	mem_copy(m_pWriter->m_aTimelineMarkers, m_aTimelineMarkers, sizeof(m_aTimelineMarkers));
+	m_pWriter->m_StopMode = Mode;
+	str_copy(m_pWriter->m_aTargetFilename, pTargetFilename);
+	m_LastStats = m_pWriterThread->Stats(m_pWriter.get());
+	m_pWriterThread->Finish(m_pWriter);
+	m_pStoppedWriter = std::move(m_pWriter);
+	m_pWriter = nullptr;
+
 	if(m_pConsole)
+	{
 		m_pConsole->Print(IConsole::OUTPUT_LEVEL_STANDARD, "demo_recorder", "Stopped recording", gs_DemoPrintColor);
+		if(m_LastStats.m_NumBlocked || m_LastStats.m_NumDropped)
+		{
+			char aBuf[192];
+			str_format(aBuf, sizeof(aBuf), "Writing the demo was too slow, dropped %" PRId64 " snapshots and waited %" PRId64 " times for %.2fms in total", m_LastStats.m_NumDropped, m_LastStats.m_NumBlocked, m_LastStats.m_BlockedTime * 1000.0 / time_freq());
+			m_pConsole->Print(IConsole::OUTPUT_LEVEL_ADDINFO, "demo_recorder", aBuf, gs_DemoPrintColor);
+		}
+	}
 
 	return 0;
 }
 
+void CDemoRecorder::WaitUntilWritten()
+{
+	if(!m_pStoppedWriter)
+		return;
+	m_pWriterThread->WaitClosed(m_pStoppedWriter.get());
+	m_pStoppedWriter = nullptr;
+}
+
 void CDemoRecorder::AddDemoMarker()
 {
 	if(m_LastTickMarker < 0)
@@ -405,6 +782,7 @@ CDemoPlayer::~CDemoPlayer()
 void CDemoPlayer::Construct(class CSnapshotDelta *pSnapshotDelta, bool UseVideo)
 {
 	m_File = 0;
+	m_KeyFramesFromIndex = false;
 	m_SpeedIndex = 4;
 
 	m_pSnapshotDelta = pSnapshotDelta;
@@ -486,6 +864,132 @@ CDemoPlayer::EReadChunkHeaderResult CDemoPlayer::ReadChunkHeader(int *pType, int
 	return CHUNKHEADER_SUCCESS;
 }
 
+bool CDemoPlayer::ReadKeyFrameIndexChunk(long Offset, int *pFirstTick, int *pLastTick, long *pPrevOffset, std::vector<SDemoKeyFrame> *pvKeyFrames)
+{
+	if(io_seek(m_File, Offset, IOSEEK_START) != 0)
+		return false;
+
+	int ChunkType, ChunkSize;
+	int ChunkTick = -1;
+	if(ReadChunkHeader(&ChunkType, &ChunkSize, &ChunkTick) != CHUNKHEADER_SUCCESS || ChunkType != CHUNKTYPE_KEYFRAME_INDEX || ChunkSize == 0)
+		return false;
+	if(io_read(m_File, m_aCompressedSnapshotData, ChunkSize) != (unsigned)ChunkSize)
+		return false;
+	int DataSize = CNetBase::Decompress(m_aCompressedSnapshotData, ChunkSize, m_aDecompressedSnapshotData, sizeof(m_aDecompressedSnapshotData));
+	if(DataSize < 0)
+		return false;
+	DataSize = CVariableInt::Decompress(m_aDecompressedSnapshotData, DataSize, m_aCurrentSnapshotData, sizeof(m_aCurrentSnapshotData));
+	if(DataSize < 0)
+		return false;
+
+	const int *pData = (const int *)m_aCurrentSnapshotData;
+	const int NumInts = DataSize / sizeof(int);
+	if(NumInts < KEYFRAME_INDEX_HEADER_SIZE)
+		return false;
+	for(int i = 0; i < 4; i++)
+		if(pData[i] != KeyFrameIndexMagic(i))
+			return false;
+
+	*pFirstTick = pData[4];
+	*pLastTick = pData[5];
+	*pPrevOffset = pData[6];
+	const int Num = pData[7];
+	if(Num < 0 || Num > (NumInts - KEYFRAME_INDEX_HEADER_SIZE) / 2)
+		return false;
+
+	// the chunks are read from last to first
+	std::vector<SDemoKeyFrame> vKeyFrames;
+	vKeyFrames.reserve(Num + pvKeyFrames->size());
+	for(int i = 0; i < Num; i++)
+		vKeyFrames.emplace_back(pData[KEYFRAME_INDEX_HEADER_SIZE + i * 2 + 1], pData[KEYFRAME_INDEX_HEADER_SIZE + i * 2]);
+	vKeyFrames.insert(vKeyFrames.end(), pvKeyFrames->begin(), pvKeyFrames->end());
+	*pvKeyFrames = std::move(vKeyFrames);
+	return true;
+}
+
+bool CDemoPlayer::ReadKeyFrameIndex()
+{
+	const long DataStart = io_tell(m_File);
+	const long FileSize = io_length(m_File);
+	if(DataStart < 0 || FileSize <= DataStart)
+	{
+		io_seek(m_File, DataStart, IOSEEK_START);
+		return false;
+	}
+
+	// the index ends the file, its last chunk is found by looking for a
+	// chunk header whose size reaches exactly to the end of the file
+	const long TailSize = minimum<long>(FileSize - DataStart, MAX_CHUNK_HEADER_SIZE + MAX_CHUNK_SIZE);
+	std::vector<unsigned char> vTail(TailSize);
+	if(io_seek(m_File, FileSize - TailSize, IOSEEK_START) != 0 || io_read(m_File, vTail.data(), TailSize) != (unsigned)TailSize)
+	{
+		io_seek(m_File, DataStart, IOSEEK_START);
+		return false;
+	}
+
+	bool Found = false;
+	std::vector<SDemoKeyFrame> vKeyFrames;
+	int FirstTick = -1;
+	int LastTick = -1;
+	for(long i = 0; i < TailSize && !Found; i++)
+	{
+		if(vTail[i] & (CHUNKTYPEFLAG_TICKMARKER | CHUNKMASK_TYPE))
+			continue;
+		long Size = vTail[i] & CHUNKMASK_SIZE;
+		long HeaderSize = 1;
+		if(Size == 30)
+		{
+			if(i + 1 >= TailSize)
+				continue;
+			Size = vTail[i + 1];
+			HeaderSize = 2;
+		}
+		else if(Size == 31)
+		{
+			if(i + 2 >= TailSize)
+				continue;
+			Size = (vTail[i + 2] << 8) | vTail[i + 1];
+			HeaderSize = 3;
+		}
+		if(Size == 0 || i + HeaderSize + Size != TailSize)
+			continue;
+
+		// follow the chunks back to the first one
+		vKeyFrames.clear();
+		long Offset = FileSize - TailSize + i;
+		long PrevOffset;
+		int ChunkFirstTick, ChunkLastTick;
+		if(!ReadKeyFrameIndexChunk(Offset, &FirstTick, &LastTick, &PrevOffset, &vKeyFrames))
+			continue;
+		bool Valid = true;
+		while(Valid && PrevOffset != 0)
+		{
+			Valid = PrevOffset >= DataStart && PrevOffset < Offset;
+			Offset = PrevOffset;
+			Valid = Valid && ReadKeyFrameIndexChunk(Offset, &ChunkFirstTick, &ChunkLastTick, &PrevOffset, &vKeyFrames);
+		}
+
+		// the keyframes must be ordered and lie before the index
+		Valid = Valid && !vKeyFrames.empty() && FirstTick >= MIN_TICK && FirstTick <= LastTick && LastTick < MAX_TICK;
+		for(size_t k = 0; Valid && k < vKeyFrames.size(); k++)
+		{
+			const SDemoKeyFrame &KeyFrame = vKeyFrames[k];
+			Valid = KeyFrame.m_Filepos >= DataStart && KeyFrame.m_Filepos < Offset && KeyFrame.m_Tick >= FirstTick && KeyFrame.m_Tick <= LastTick;
+			if(Valid && k > 0)
+				Valid = KeyFrame.m_Filepos > vKeyFrames[k - 1].m_Filepos && KeyFrame.m_Tick > vKeyFrames[k - 1].m_Tick;
+		}
+		Found = Valid;
+	}
+
+	if(io_seek(m_File, DataStart, IOSEEK_START) != 0 || !Found)
+		return false;
+
+	m_vKeyFrames = std::move(vKeyFrames);
+	m_Info.m_Info.m_FirstTick = FirstTick;
+	m_Info.m_Info.m_LastTick = LastTick;
+	return true;
+}
+
 bool CDemoPlayer::ScanFile()
 {
 	const long StartPos = io_tell(m_File);
@@ -763,8 +1267,9 @@ int CDemoPlayer::Load(class IStorage *pStorage, class IConsole *pConsole, const
 		}
 	}
 
-	// scan the file for interesting points
-	if(!ScanFile())
+	// use the keyframe index if the demo has one, otherwise scan the file for interesting points
+	m_KeyFramesFromIndex = ReadKeyFrameIndex();
+	if(!m_KeyFramesFromIndex && !ScanFile())
 	{
 		Stop("Error scanning demo file");
 		return -1;
@@ -914,16 +1419,15 @@ int CDemoPlayer::SetPos(int WantedTick)
 	if(!m_File)
 		return -1;
 
+	if(m_vKeyFrames.empty())
+		return -1;
+
 	WantedTick = clamp(WantedTick, m_Info.m_Info.m_FirstTick, m_Info.m_Info.m_LastTick);
 	const int KeyFrameWantedTick = WantedTick - 5; // -5 because we have to have a current tick and previous tick when we do the playback
-	const float Percent = (KeyFrameWantedTick - m_Info.m_Info.m_FirstTick) / (float)(m_Info.m_Info.m_LastTick - m_Info.m_Info.m_FirstTick);
 
-	// get correct key frame
-	size_t KeyFrame = clamp<size_t>(m_vKeyFrames.size() * Percent, 0, m_vKeyFrames.size() - 1);
-	while(KeyFrame < m_vKeyFrames.size() - 1 && m_vKeyFrames[KeyFrame].m_Tick < KeyFrameWantedTick)
-		KeyFrame++;
-	while(KeyFrame > 0 && m_vKeyFrames[KeyFrame].m_Tick > KeyFrameWantedTick)
-		KeyFrame--;
+	// get the last key frame before the wanted tick
+	const auto It = std::upper_bound(m_vKeyFrames.begin(), m_vKeyFrames.end(), KeyFrameWantedTick, [](int Tick, const SDemoKeyFrame &KeyFrame) { return Tick < KeyFrame.m_Tick; });
+	const size_t KeyFrame = It == m_vKeyFrames.begin() ? 0 : It - m_vKeyFrames.begin() - 1;
 
 	// seek to the correct key frame
 	if(io_seek(m_File, m_vKeyFrames[KeyFrame].m_Filepos, IOSEEK_START) != 0)
@@ -932,6 +1436,25 @@ int CDemoPlayer::SetPos(int WantedTick)
 		return -1;
 	}
 
+	// the keyframe index is only checked when it's used, scan the file instead if it's wrong
+	int ChunkType, ChunkSize;
+	int ChunkTick = -1;
+	if(ReadChunkHeader(&ChunkType, &ChunkSize, &ChunkTick) != CHUNKHEADER_SUCCESS || !(ChunkType & CHUNKTICKFLAG_KEYFRAME) || ChunkTick != m_vKeyFrames[KeyFrame].m_Tick)
+	{
+		if(m_KeyFramesFromIndex && io_seek(m_File, m_MapOffset + m_MapInfo.m_Size, IOSEEK_START) == 0 && ScanFile())
+		{
+			m_KeyFramesFromIndex = false;
+			return SetPos(WantedTick);
+		}
+		Stop("Error reading keyframe");
+		return -1;
+	}
+	if(io_seek(m_File, m_vKeyFrames[KeyFrame].m_Filepos, IOSEEK_START) != 0)
+	{
+		Stop("Error seeking keyframe position");
+		return -1;
+	}
+
 	m_Info.m_NextTick = -1;
 	m_Info.m_Info.m_CurrentTick = -1;
 	m_Info.m_PreviousTick = -1;
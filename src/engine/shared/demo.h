@@ -9,32 +9,61 @@
 #include <engine/shared/protocol.h>
 
 #include <functional>
+#include <memory>
 #include <vector>
 
 #include "snapshot.h"
 
 typedef std::function<void()> TUpdateIntraTimesFunc;
 
+struct SDemoKeyFrame
+{
+	long m_Filepos;
+	int m_Tick;
+
+	SDemoKeyFrame(long Filepos, int Tick) :
+		m_Filepos(Filepos), m_Tick(Tick)
+	{
+	}
+};
+
 class CDemoRecorder : public IDemoRecorder
 {
+public:
+	class CWriterStats
+	{
+	public:
+		int64_t m_NumChunks = 0; // snapshots and messages passed to the writer thread
+		int m_MaxQueued = 0; // most chunks that were waiting to be written at once
+		int64_t m_NumBlocked = 0; // how often recording waited for a full queue
+		int64_t m_BlockedTime = 0; // how long recording waited in total
+		int64_t m_NumDropped = 0; // snapshots dropped for a full queue, see demo_writer_drop
+	};
+
+private:
+	class CWriter;
+	class CWriterThread;
+
 	class IConsole *m_pConsole;
-	IOHANDLE m_File;
+	std::shared_ptr<CWriterThread> m_pWriterThread;
+	std::shared_ptr<CWriter> m_pWriter;
+	// the last stopped recording until it's written
+	std::shared_ptr<CWriter> m_pStoppedWriter;
+	int64_t m_NextQueueFullReport;
 	char m_aCurrentFilename[IO_MAX_PATH_LENGTH];
 	int m_LastTickMarker;
-	int m_LastKeyFrame;
 	int m_FirstTick;
-	unsigned char m_aLastSnapshotData[CSnapshot::MAX_SIZE];
 	class CSnapshotDelta *m_pSnapshotDelta;
 	int m_NumTimelineMarkers;
 	int m_aTimelineMarkers[MAX_TIMELINE_MARKERS];
 	bool m_NoMapData;
 	unsigned char *m_pMapData;
+	CWriterStats m_LastStats;
 
 	DEMOFUNC_FILTER m_pfnFilter;
 	void *m_pUser;
 
-	void WriteTickMarker(int Tick, bool Keyframe);
-	void Write(int Type, const void *pData, int Size);
+	void Push(int Type, int Tick, const void *pData, int Size);
 
 public:
 	CDemoRecorder(class CSnapshotDelta *pSnapshotDelta, bool NoMapData = false);
@@ -42,7 +71,9 @@ public:
 	~CDemoRecorder() override;
 
 	int Start(class IStorage *pStorage, class IConsole *pConsole, const char *pFilename, const char *pNetversion, const char *pMap, const SHA256_DIGEST &Sha256, unsigned MapCrc, const char *pType, unsigned MapSize, unsigned char *pMapData, IOHANDLE MapFile = nullptr, DEMOFUNC_FILTER pfnFilter = nullptr, void *pUser = nullptr);
-	int Stop() override;
+	int Stop(IDemoRecorder::EStopMode Mode = IDemoRecorder::EStopMode::KEEP_FILE, const char *pTargetFilename = "") override;
+	// waits until the last stopped recording is written and closed
+	void WaitUntilWritten();
 
 	void AddDemoMarker();
 	void AddDemoMarker(int Tick);
@@ -50,11 +81,13 @@ public:
 	void RecordSnapshot(int Tick, const void *pData, int Size);
 	void RecordMessage(const void *pData, int Size);
 
-	bool IsRecording() const override { return m_File != nullptr; }
+	bool IsRecording() const override { return m_pWriter != nullptr; }
 	char *GetCurrentFilename() override { return m_aCurrentFilename; }
 	void ClearCurrentFilename() { m_aCurrentFilename[0] = '\0'; }
 
 	int Length() const override { return (m_LastTickMarker - m_FirstTick) / SERVER_TICK_SPEED; }
+	// statistics of the current recording, or of the last one if stopped
+	CWriterStats WriterStats() const;
 };
 
 class CDemoPlayer : public IDemoPlayer
@@ -92,23 +125,13 @@ private:
 	TUpdateIntraTimesFunc m_UpdateIntraTimesFunc;
 
 	// Playback
-	struct SKeyFrame
-	{
-		long m_Filepos;
-		int m_Tick;
-
-		SKeyFrame(long Filepos, int Tick) :
-			m_Filepos(Filepos), m_Tick(Tick)
-		{
-		}
-	};
-
 	class IConsole *m_pConsole;
 	IOHANDLE m_File;
 	long m_MapOffset;
 	char m_aFilename[IO_MAX_PATH_LENGTH];
 	char m_aErrorMessage[256];
-	std::vector<SKeyFrame> m_vKeyFrames;
+	std::vector<SDemoKeyFrame> m_vKeyFrames;
+	bool m_KeyFramesFromIndex;
 	CMapInfo m_MapInfo;
 	int m_SpeedIndex;
 
@@ -134,6 +157,8 @@ private:
 	};
 	EReadChunkHeaderResult ReadChunkHeader(int *pType, int *pSize, int *pTick);
 	void DoTick();
+	bool ReadKeyFrameIndexChunk(long Offset, int *pFirstTick, int *pLastTick, long *pPrevOffset, std::vector<SDemoKeyFrame> *pvKeyFrames);
+	bool ReadKeyFrameIndex();
 	bool ScanFile();
 
 	int64_t Time();
@@ -162,6 +187,8 @@ public:
 	int SeekTick(ETickOffset TickOffset) override;
 	int SetPos(int WantedTick) override;
 	const CInfo *BaseInfo() const override { return &m_Info.m_Info; }
+	const std::vector<SDemoKeyFrame> &KeyFrames() const { return m_vKeyFrames; }
+	bool KeyFramesFromIndex() const { return m_KeyFramesFromIndex; }
 	void GetDemoName(char *pBuffer, size_t BufferSize) const override;
 	bool GetDemoInfo(class IStorage *pStorage, class IConsole *pConsole, const char *pFilename, int StorageType, CDemoHeader *pDemoHeader, CTimelineMarkers *pTimelineMarkers, CMapInfo *pMapInfo, IOHANDLE *pFile = nullptr, char *pErrorMessage = nullptr, size_t ErrorMessageSize = 0) const override;
 	const char *Filename() { return m_aFilename; }
@@ -19,6 +19,7 @@
 static CURLSH *gs_pShare;
 static CLock gs_aLocks[CURL_LOCK_DATA_LAST + 1];
 static bool gs_Initialized = false;
+static CHttp gs_Http;
 
 static int GetLockIndex(int Data)
 {
@@ -90,7 +91,8 @@ bool HttpInit(IStorage *pStorage)
 
 	curl_share_setopt(gs_pShare, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
 	curl_share_setopt(gs_pShare, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
-	curl_share_setopt(gs_pShare, CURLSHOPT_SHARE, CURL_LOCK_DATA_CONNECT);
+	// Connections are cached by the multi handle of the runner, so that
+	// it can enforce its connection limits.
 	curl_share_setopt(gs_pShare, CURLSHOPT_LOCKFUNC, CurlLock);
 	curl_share_setopt(gs_pShare, CURLSHOPT_UNLOCKFUNC, CurlUnlock);
 
@@ -102,9 +104,194 @@ bool HttpInit(IStorage *pStorage)
 
 	gs_Initialized = true;
 
+	return gs_Http.Init();
+}
+
+void HttpRun(std::shared_ptr<CHttpRequest> pRequest)
+{
+	gs_Http.Run(std::move(pRequest));
+}
+
+void HttpShutdown(std::chrono::milliseconds ShutdownDelay)
+{
+	gs_Http.Shutdown(ShutdownDelay);
+}
+
+CHttp::~CHttp()
+{
+	Shutdown();
+}
+
+bool CHttp::Init()
+{
+	dbg_assert(gs_Initialized, "must initialize HTTP before starting a runner");
+	dbg_assert(!m_pMultiH, "runner initialized twice");
+	CURLM *pMultiH = curl_multi_init();
+	if(!pMultiH)
+	{
+		return true;
+	}
+	curl_multi_setopt(pMultiH, CURLMOPT_PIPELINING, CURLPIPE_MULTIPLEX);
+	curl_multi_setopt(pMultiH, CURLMOPT_MAX_HOST_CONNECTIONS, (long)MAX_HOST_CONNECTIONS);
+	curl_multi_setopt(pMultiH, CURLMOPT_MAX_TOTAL_CONNECTIONS, (long)MAX_TOTAL_CONNECTIONS);
+	m_pMultiH = pMultiH;
+	m_pThread = thread_init(ThreadMain, this, "http");
 	return false;
 }
 
+void CHttp::Run(std::shared_ptr<CHttpRequest> pRequest)
+{
+	{
+		CLockScope ls(m_Lock);
+		if(m_pThread && !m_Shutdown)
+		{
+			m_vpPendingRequests.emplace_back(std::move(pRequest));
+			curl_multi_wakeup(m_pMultiH);
+			return;
+		}
+	}
+	pRequest->Finish(HTTP_ABORTED);
+}
+
+void CHttp::Shutdown(std::chrono::milliseconds ShutdownDelay)
+{
+	void *pThread;
+	{
+		CLockScope ls(m_Lock);
+		if(!m_pThread)
+		{
+			return;
+		}
+		if(!m_Shutdown)
+		{
+			m_Shutdown = true;
+			m_ShutdownTime = time_get_nanoseconds() + ShutdownDelay;
+		}
+		curl_multi_wakeup(m_pMultiH);
+		pThread = m_pThread;
+	}
+	thread_wait(pThread);
+	{
+		CLockScope ls(m_Lock);
+		m_pThread = nullptr;
+	}
+	curl_multi_cleanup(m_pMultiH);
+	m_pMultiH = nullptr;
+}
+
+void CHttp::ThreadMain(void *pUser)
+{
+	((CHttp *)pUser)->RunLoop();
+}
+
+void CHttp::StartRequest(std::shared_ptr<CHttpRequest> pRequest)
+{
+	if(!pRequest->BeforeInit())
+	{
+		pRequest->Finish(HTTP_ERROR);
+		return;
+	}
+	CURL *pHandle = curl_easy_init();
+	if(!pHandle)
+	{
+		pRequest->Finish(HTTP_ERROR);
+		return;
+	}
+	if(!pRequest->ConfigureHandle(pHandle) || curl_multi_add_handle(m_pMultiH, pHandle) != CURLM_OK)
+	{
+		curl_easy_cleanup(pHandle);
+		pRequest->Finish(HTTP_ERROR);
+		return;
+	}
+	m_RunningRequests.emplace(pHandle, std::move(pRequest));
+}
+
+void CHttp::RunLoop()
+{
+	CURLM *pMultiH = m_pMultiH;
+	std::vector<std::shared_ptr<CHttpRequest>> vpNewRequests;
+	std::vector<std::pair<CURL *, CURLcode>> vFinished;
+	while(true)
+	{
+		bool Shutdown;
+		std::chrono::nanoseconds ShutdownTime;
+		{
+			CLockScope ls(m_Lock);
+			std::swap(vpNewRequests, m_vpPendingRequests);
+			Shutdown = m_Shutdown;
+			ShutdownTime = m_ShutdownTime;
+		}
+		for(auto &pRequest : vpNewRequests)
+		{
+			StartRequest(std::move(pRequest));
+		}
+		vpNewRequests.clear();
+
+		int NumRunning;
+		if(curl_multi_perform(pMultiH, &NumRunning) != CURLM_OK)
+		{
+			log_error("http", "curl_multi_perform failed, aborting all requests");
+			break;
+		}
+
+		// The messages don't survive removing their handle.
+		int NumMessages;
+		while(CURLMsg *pMsg = curl_multi_info_read(pMultiH, &NumMessages))
+		{
+			if(pMsg->msg == CURLMSG_DONE)
+			{
+				vFinished.emplace_back(pMsg->easy_handle, pMsg->data.result);
+			}
+		}
+		for(const auto &[pHandle, Result] : vFinished)
+		{
+			auto It = m_RunningRequests.find(pHandle);
+			dbg_assert(It != m_RunningRequests.end(), "finished unknown http request");
+			std::shared_ptr<CHttpRequest> pRequest = std::move(It->second);
+			m_RunningRequests.erase(It);
+			curl_multi_remove_handle(pMultiH, pHandle);
+			curl_easy_cleanup(pHandle);
+			pRequest->OnCompletionInternal(Result);
+		}
+		vFinished.clear();
+
+		int TimeoutMs = 1000;
+		if(Shutdown)
+		{
+			std::chrono::nanoseconds Remaining = ShutdownTime - time_get_nanoseconds();
+			if(m_RunningRequests.empty() || Remaining <= std::chrono::nanoseconds(0))
+			{
+				break;
+			}
+			TimeoutMs = std::clamp((int)std::chrono::duration_cast<std::chrono::milliseconds>(Remaining).count() + 1, 1, TimeoutMs);
+		}
+		if(curl_multi_poll(pMultiH, nullptr, 0, TimeoutMs, nullptr) != CURLM_OK)
+		{
+			log_error("http", "curl_multi_poll failed, aborting all requests");
+			break;
+		}
+	}
+
+	for(auto &[pHandle, pRequest] : m_RunningRequests)
+	{
+		curl_multi_remove_handle(pMultiH, pHandle);
+		curl_easy_cleanup(pHandle);
+		pRequest->Finish(HTTP_ABORTED);
+	}
+	m_RunningRequests.clear();
+
+	// Requests added after a failure, nothing runs them anymore.
+	{
+		CLockScope ls(m_Lock);
+		m_Shutdown = true;
+		std::swap(vpNewRequests, m_vpPendingRequests);
+	}
+	for(auto &pRequest : vpNewRequests)
+	{
+		pRequest->Finish(HTTP_ABORTED);
+	}
+}
+
 void EscapeUrl(char *pBuf, int Size, const char *pStr)
 {
 	char *pEsc = curl_easy_escape(0, pStr, 0);
@@ -122,6 +309,7 @@ bool HttpHasIpresolveBug()
 CHttpRequest::CHttpRequest(const char *pUrl)
 {
 	str_copy(m_aUrl, pUrl);
+	m_aErr[0] = '\0';
 }
 
 CHttpRequest::~CHttpRequest()
@@ -143,24 +331,6 @@ CHttpRequest::~CHttpRequest()
 	}
 }
 
-void CHttpRequest::Run()
-{
-	dbg_assert(gs_Initialized, "must initialize HTTP before running HTTP requests");
-	int FinalState;
-	if(!BeforeInit())
-	{
-		FinalState = HTTP_ERROR;
-	}
-	else
-	{
-		CURL *pHandle = curl_easy_init();
-		FinalState = RunImpl(pHandle);
-		curl_easy_cleanup(pHandle);
-	}
-
-	m_State = OnCompletion(FinalState);
-}
-
 bool CHttpRequest::BeforeInit()
 {
 	if(m_WriteToFile)
@@ -181,13 +351,9 @@ bool CHttpRequest::BeforeInit()
 	return true;
 }
 
-int CHttpRequest::RunImpl(CURL *pUser)
+bool CHttpRequest::ConfigureHandle(void *pUser)
 {
 	CURL *pHandle = (CURL *)pUser;
-	if(!pHandle)
-	{
-		return HTTP_ERROR;
-	}
 
 	if(g_Config.m_DbgCurl)
 	{
@@ -199,8 +365,9 @@ int CHttpRequest::RunImpl(CURL *pUser)
 	{
 		Protocols |= CURLPROTO_HTTP;
 	}
-	char aErr[CURL_ERROR_SIZE];
-	curl_easy_setopt(pHandle, CURLOPT_ERRORBUFFER, aErr);
+	static_assert(sizeof(m_aErr) == CURL_ERROR_SIZE, "error buffer must have the size curl expects");
+	m_aErr[0] = '\0';
+	curl_easy_setopt(pHandle, CURLOPT_ERRORBUFFER, m_aErr);
 
 	curl_easy_setopt(pHandle, CURLOPT_CONNECTTIMEOUT_MS, m_Timeout.ConnectTimeoutMs);
 	curl_easy_setopt(pHandle, CURLOPT_TIMEOUT_MS, m_Timeout.TimeoutMs);
@@ -288,19 +455,41 @@ int CHttpRequest::RunImpl(CURL *pUser)
 	if(g_Config.m_DbgCurl || m_LogProgress >= HTTPLOG::ALL)
 		dbg_msg("http", "fetching %s", m_aUrl);
 	m_State = HTTP_RUNNING;
-	int Ret = curl_easy_perform(pHandle);
-	if(Ret != CURLE_OK)
+	return true;
+}
+
+void CHttpRequest::OnCompletionInternal(unsigned int Result)
+{
+	int FinalState;
+	if(Result != CURLE_OK)
 	{
 		if(g_Config.m_DbgCurl || m_LogProgress >= HTTPLOG::FAILURE)
-			dbg_msg("http", "%s failed. libcurl error (%d): %s", m_aUrl, (int)Ret, aErr);
-		return (Ret == CURLE_ABORTED_BY_CALLBACK) ? HTTP_ABORTED : HTTP_ERROR;
+			dbg_msg("http", "%s failed. libcurl error (%d): %s", m_aUrl, (int)Result, m_aErr[0] ? m_aErr : curl_easy_strerror((CURLcode)Result));
+		FinalState = (Result == CURLE_ABORTED_BY_CALLBACK) ? HTTP_ABORTED : HTTP_ERROR;
 	}
 	else
 	{
 		if(g_Config.m_DbgCurl || m_LogProgress >= HTTPLOG::ALL)
 			dbg_msg("http", "task done %s", m_aUrl);
-		return HTTP_DONE;
+		FinalState = HTTP_DONE;
 	}
+	Finish(FinalState);
+}
+
+void CHttpRequest::Finish(int State)
+{
+	State = OnCompletion(State);
+	{
+		std::unique_lock<std::mutex> Lock(m_WaitMutex);
+		m_State = State;
+	}
+	m_WaitCondition.notify_all();
+}
+
+void CHttpRequest::Wait()
+{
+	std::unique_lock<std::mutex> Lock(m_WaitMutex);
+	m_WaitCondition.wait(Lock, [this]() { return Done(); });
 }
 
 size_t CHttpRequest::OnData(char *pData, size_t DataSize)
@@ -358,13 +547,15 @@ int CHttpRequest::OnCompletion(int State)
 	if(m_Abort)
 		State = HTTP_ABORTED;
 
-	if(m_WriteToFile)
+	// Requests aborted before they were started never opened their file.
+	if(m_WriteToFile && m_File)
 	{
-		if(m_File && io_close(m_File) != 0)
+		if(io_close(m_File) != 0)
 		{
 			dbg_msg("http", "i/o error, cannot close file: %s", m_aDest);
 			State = HTTP_ERROR;
 		}
+		m_File = nullptr;
 
 		if(State == HTTP_ERROR || State == HTTP_ABORTED)
 		{
@@ -1,9 +1,17 @@
 #ifndef ENGINE_SHARED_HTTP_H
 #define ENGINE_SHARED_HTTP_H
 
+#include <base/lock.h>
+#include <base/system.h>
+
 #include <algorithm>
 #include <atomic>
-#include <engine/shared/jobs.h>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
 
 typedef struct _json_value json_value;
 class IStorage;
@@ -39,8 +47,10 @@ struct CTimeout
 	long LowSpeedTime;
 };
 
-class CHttpRequest : public IJob
+class CHttpRequest
 {
+	friend class CHttp;
+
 	enum class REQUEST
 	{
 		GET = 0,
@@ -80,10 +90,20 @@ class CHttpRequest : public IJob
 	std::atomic<int> m_State{HTTP_QUEUED};
 	std::atomic<bool> m_Abort{false};
 
-	void Run() override;
+	std::mutex m_WaitMutex;
+	std::condition_variable m_WaitCondition;
+
+	// CURL_ERROR_SIZE
+	char m_aErr[256];
+
 	// Abort the request with an error if `BeforeInit()` returns false.
 	bool BeforeInit();
-	int RunImpl(void *pUser);
+	// Abort the request with an error if `ConfigureHandle()` returns false.
+	bool ConfigureHandle(void *pHandle);
+	// Called on the thread that finished the request, `Result` is a
+	// `CURLcode`.
+	void OnCompletionInternal(unsigned int Result);
+	void Finish(int State);
 
 	// Abort the request if `OnData()` returns something other than
 	// `DataSize`.
@@ -98,7 +118,7 @@ protected:
 
 public:
 	CHttpRequest(const char *pUrl);
-	~CHttpRequest();
+	virtual ~CHttpRequest();
 
 	void Timeout(CTimeout Timeout) { m_Timeout = Timeout; }
 	void MaxResponseSize(int64_t MaxResponseSize) { m_MaxResponseSize = MaxResponseSize; }
@@ -150,7 +170,15 @@ public:
 	double Size() const { return m_Size.load(std::memory_order_relaxed); }
 	int Progress() const { return m_Progress.load(std::memory_order_relaxed); }
 	int State() const { return m_State; }
+	bool Done() const
+	{
+		int State = m_State;
+		return State != HTTP_QUEUED && State != HTTP_RUNNING;
+	}
 	void Abort() { m_Abort = true; }
+	// Blocks until the request is done, only use on requests that were
+	// passed to a runner.
+	void Wait();
 
 	void Result(unsigned char **ppResult, size_t *pResultLength) const;
 	json_value *ResultJson() const;
@@ -192,7 +220,52 @@ inline std::unique_ptr<CHttpRequest> HttpPostJson(const char *pUrl, const char *
 	return pResult;
 }
 
+/*
+	Class: CHttp
+		Runs all requests passed to it on one thread, using a single
+		curl multi handle. Connections are kept alive and reused between
+		requests, HTTP/2 requests to the same host share one connection.
+*/
+class CHttp
+{
+public:
+	enum
+	{
+		MAX_HOST_CONNECTIONS = 4,
+		MAX_TOTAL_CONNECTIONS = 32,
+	};
+
+	~CHttp();
+
+	// Returns true on failure.
+	bool Init();
+	// The request is completed with `HTTP_ABORTED` if the runner was
+	// shut down already.
+	void Run(std::shared_ptr<CHttpRequest> pRequest);
+	// Waits at most `ShutdownDelay` for the running requests, aborts the
+	// remaining ones afterwards.
+	void Shutdown(std::chrono::milliseconds ShutdownDelay = std::chrono::milliseconds(0));
+
+private:
+	static void ThreadMain(void *pUser);
+	void RunLoop();
+	void StartRequest(std::shared_ptr<CHttpRequest> pRequest);
+
+	void *m_pThread = nullptr;
+	void *m_pMultiH = nullptr;
+	// Only used by the runner thread.
+	std::unordered_map<void *, std::shared_ptr<CHttpRequest>> m_RunningRequests;
+
+	CLock m_Lock;
+	std::vector<std::shared_ptr<CHttpRequest>> m_vpPendingRequests GUARDED_BY(m_Lock);
+	bool m_Shutdown GUARDED_BY(m_Lock) = false;
+	std::chrono::nanoseconds m_ShutdownTime GUARDED_BY(m_Lock){0};
+};
+
 bool HttpInit(IStorage *pStorage);
+// Runs the request on the runner started by `HttpInit`.
+void HttpRun(std::shared_ptr<CHttpRequest> pRequest);
+void HttpShutdown(std::chrono::milliseconds ShutdownDelay);
 void EscapeUrl(char *pBuf, int Size, const char *pStr);
 bool HttpHasIpresolveBug();
 #endif // ENGINE_SHARED_HTTP_H
@@ -94,110 +94,111 @@ void CHuffman::Init(const unsigned *pFrequencies)
 {
 	// make sure to cleanout every thing
 	mem_zero(m_aNodes, sizeof(m_aNodes));
-	mem_zero(m_apDecodeLut, sizeof(m_apDecodeLut));
+	mem_zero(m_aDecodeLut, sizeof(m_aDecodeLut));
 	m_pStartNode = 0x0;
 	m_NumNodes = 0;
 
 	// construct the tree
 	ConstructTree(pFrequencies);
 
-	// build decode LUT
+	// build decode LUT, decode as many whole symbols as fit into the bits
 	for(int i = 0; i < HUFFMAN_LUTSIZE; i++)
 	{
+		CDecodeEntry &Entry = m_aDecodeLut[i];
 		unsigned Bits = i;
-		int k;
-		CNode *pNode = m_pStartNode;
-		for(k = 0; k < HUFFMAN_LUTBITS; k++)
+		const CNode *pNode = m_pStartNode;
+		for(int k = 0; k < HUFFMAN_LUTBITS; k++)
 		{
 			pNode = &m_aNodes[pNode->m_aLeafs[Bits & 1]];
 			Bits >>= 1;
 
-			if(!pNode)
-				break;
-
 			if(pNode->m_NumBits)
 			{
-				m_apDecodeLut[i] = pNode;
-				break;
+				Entry.m_NumBits = k + 1;
+				if(pNode == &m_aNodes[HUFFMAN_EOF_SYMBOL])
+				{
+					Entry.m_Eof = true;
+					break;
+				}
+				Entry.m_aSymbols[Entry.m_NumSymbols++] = pNode->m_Symbol;
+				if(Entry.m_NumSymbols == HUFFMAN_LUT_MAX_SYMBOLS)
+					break;
+				pNode = m_pStartNode;
 			}
 		}
 
-		if(k == HUFFMAN_LUTBITS)
-			m_apDecodeLut[i] = pNode;
+		// the first symbol is longer than the LUT, walk the tree from here
+		if(Entry.m_NumSymbols == 0 && !Entry.m_Eof)
+		{
+			Entry.m_NumBits = HUFFMAN_LUTBITS;
+			Entry.m_Node = pNode - m_aNodes;
+		}
 	}
 }
 
 //***************************************************************
 int CHuffman::Compress(const void *pInput, int InputSize, void *pOutput, int OutputSize) const
 {
-	// this macro loads a symbol for a byte into bits and bitcount
-#define HUFFMAN_MACRO_LOADSYMBOL(Sym) \
-	do \
-	{ \
-		Bits |= m_aNodes[Sym].m_Bits << Bitcount; \
-		Bitcount += m_aNodes[Sym].m_NumBits; \
-	} while(0)
-
-	// this macro writes the symbol stored in bits and bitcount to the dst pointer
-#define HUFFMAN_MACRO_WRITE() \
-	do \
-	{ \
-		while(Bitcount >= 8) \
-		{ \
-			*pDst++ = (unsigned char)(Bits & 0xff); \
-			if(pDst == pDstEnd) \
-				return -1; \
-			Bits >>= 8; \
-			Bitcount -= 8; \
-		} \
-	} while(0)
-
 	// setup buffer pointers
 	const unsigned char *pSrc = (const unsigned char *)pInput;
 	const unsigned char *pSrcEnd = pSrc + InputSize;
 	unsigned char *pDst = (unsigned char *)pOutput;
 	unsigned char *pDstEnd = pDst + OutputSize;
 
-	// symbol variables
-	unsigned Bits = 0;
+	if(pDst == pDstEnd)
+		return -1;
+
+	// symbol variables, the codes are collected in a 64 bit word and
+	// written out 32 bits at a time
+	uint64_t Bits = 0;
 	unsigned Bitcount = 0;
 
-	// make sure that we have data that we want to compress
-	if(InputSize)
+	for(int i = 0; i <= InputSize; i++)
 	{
-		// {A} load the first symbol
-		int Symbol = *pSrc++;
+		const CNode &Node = m_aNodes[pSrc == pSrcEnd ? (int)HUFFMAN_EOF_SYMBOL : *pSrc++];
+		Bits |= (uint64_t)Node.m_Bits << Bitcount;
+		Bitcount += Node.m_NumBits;
 
-		while(pSrc != pSrcEnd)
+		if(Bitcount >= 32)
 		{
-			// {B} load the symbol
-			HUFFMAN_MACRO_LOADSYMBOL(Symbol);
-
-			// {C} fetch next symbol, this is done here because it will reduce dependency in the code
-			Symbol = *pSrc++;
-
-			// {B} write the symbol loaded at
-			HUFFMAN_MACRO_WRITE();
+			if(pDstEnd - pDst > 4)
+			{
+				pDst[0] = (unsigned char)Bits;
+				pDst[1] = (unsigned char)(Bits >> 8);
+				pDst[2] = (unsigned char)(Bits >> 16);
+				pDst[3] = (unsigned char)(Bits >> 24);
+				pDst += 4;
+				Bits >>= 32;
+				Bitcount -= 32;
+			}
+			else
+			{
+				// the compressed data must leave room for the final byte
+				while(Bitcount >= 8)
+				{
+					*pDst++ = (unsigned char)Bits;
+					if(pDst == pDstEnd)
+						return -1;
+					Bits >>= 8;
+					Bitcount -= 8;
+				}
+			}
 		}
-
-		// write the last symbol loaded from {C} or {A} in the case of only 1 byte input buffer
-		HUFFMAN_MACRO_LOADSYMBOL(Symbol);
-		HUFFMAN_MACRO_WRITE();
 	}
 
-	// write EOF symbol
-	HUFFMAN_MACRO_LOADSYMBOL(HUFFMAN_EOF_SYMBOL);
-	HUFFMAN_MACRO_WRITE();
-
 	// write out the last bits
-	*pDst++ = Bits;
+	while(Bitcount >= 8)
+	{
+		*pDst++ = (unsigned char)Bits;
+		if(pDst == pDstEnd)
+			return -1;
+		Bits >>= 8;
+		Bitcount -= 8;
+	}
+	*pDst++ = (unsigned char)Bits;
 
 	// return the size of the output
 	return (int)(pDst - (const unsigned char *)pOutput);
-
-	// remove macros
-#undef HUFFMAN_MACRO_LOADSYMBOL
-#undef HUFFMAN_MACRO_WRITE
 }
 
 //***************************************************************
@@ -205,77 +206,106 @@ int CHuffman::Decompress(const void *pInput, int InputSize, void *pOutput, int O
 {
 	// setup buffer pointers
 	unsigned char *pDst = (unsigned char *)pOutput;
-	unsigned char *pSrc = (unsigned char *)pInput;
+	const unsigned char *pSrc = (const unsigned char *)pInput;
 	unsigned char *pDstEnd = pDst + OutputSize;
-	unsigned char *pSrcEnd = pSrc + InputSize;
+	const unsigned char *pSrcEnd = pSrc + InputSize;
 
-	unsigned Bits = 0;
+	uint64_t Bits = 0;
 	unsigned Bitcount = 0;
-
-	const CNode *pEof = &m_aNodes[HUFFMAN_EOF_SYMBOL];
+	// bits of the input that weren't consumed yet, reading past the end
+	// decodes zero bits like earlier versions did
+	int64_t BitsLeft = (int64_t)InputSize * 8;
 
 	while(true)
 	{
-		// {A} try to load a node now, this will reduce dependency at location {D}
-		const CNode *pNode = 0;
-		if(Bitcount >= HUFFMAN_LUTBITS)
-			pNode = m_apDecodeLut[Bits & HUFFMAN_LUTMASK];
-
-		// {B} fill with new bits
-		while(Bitcount < 24 && pSrc != pSrcEnd)
+		// fill with new bits, the longest codes are shorter than 32 bits
+		if(Bitcount < 32)
 		{
-			Bits |= (*pSrc++) << Bitcount;
-			Bitcount += 8;
+			if(pSrcEnd - pSrc >= 8)
+			{
+				uint64_t Word = 0;
+				for(int i = 7; i >= 0; i--)
+					Word = (Word << 8) | pSrc[i];
+				Bits |= Word << Bitcount;
+				pSrc += (63 - Bitcount) >> 3;
+				Bitcount |= 56;
+			}
+			else
+			{
+				while(Bitcount <= 56 && pSrc != pSrcEnd)
+				{
+					Bits |= (uint64_t)(*pSrc++) << Bitcount;
+					Bitcount += 8;
+				}
+				if(pSrc == pSrcEnd)
+					Bitcount = 64;
+			}
 		}
 
-		// {C} load symbol now if we didn't that earlier at location {A}
-		if(!pNode)
-			pNode = m_apDecodeLut[Bits & HUFFMAN_LUTMASK];
-
-		if(!pNode)
-			return -1;
+		const CDecodeEntry &Entry = m_aDecodeLut[Bits & HUFFMAN_LUTMASK];
+		Bits >>= Entry.m_NumBits;
+		Bitcount -= Entry.m_NumBits;
+		BitsLeft -= Entry.m_NumBits;
 
-		// {D} check if we hit a symbol already
-		if(pNode->m_NumBits)
+		if(Entry.m_NumSymbols)
 		{
-			// remove the bits for that symbol
-			Bits >>= pNode->m_NumBits;
-			Bitcount -= pNode->m_NumBits;
+			// output characters
+			if(pDstEnd - pDst >= HUFFMAN_LUT_MAX_SYMBOLS)
+			{
+				// always write all of them, the unused ones get overwritten later
+				pDst[0] = Entry.m_aSymbols[0];
+				pDst[1] = Entry.m_aSymbols[1];
+				pDst[2] = Entry.m_aSymbols[2];
+				pDst[3] = Entry.m_aSymbols[3];
+			}
+			else if(pDstEnd - pDst >= Entry.m_NumSymbols)
+			{
+				for(int i = 0; i < Entry.m_NumSymbols; i++)
+					pDst[i] = Entry.m_aSymbols[i];
+			}
+			else
+				return -1;
+			pDst += Entry.m_NumSymbols;
 		}
-		else
+		else if(!Entry.m_Eof)
 		{
-			// remove the bits that the lut checked up for us
-			Bits >>= HUFFMAN_LUTBITS;
-			Bitcount -= HUFFMAN_LUTBITS;
+			// no more bits, decoding error
+			if(BitsLeft == 0)
+				return -1;
 
 			// walk the tree bit by bit
+			const CNode *pNode = &m_aNodes[Entry.m_Node];
 			while(true)
 			{
 				// traverse tree
 				pNode = &m_aNodes[pNode->m_aLeafs[Bits & 1]];
 
 				// remove bit
-				Bitcount--;
 				Bits >>= 1;
+				Bitcount--;
+				BitsLeft--;
 
 				// check if we hit a symbol
 				if(pNode->m_NumBits)
 					break;
 
 				// no more bits, decoding error
-				if(Bitcount == 0)
+				if(BitsLeft == 0)
 					return -1;
 			}
+
+			if(pNode == &m_aNodes[HUFFMAN_EOF_SYMBOL])
+				break;
+
+			// output character
+			if(pDst == pDstEnd)
+				return -1;
+			*pDst++ = pNode->m_Symbol;
 		}
 
 		// check for eof
-		if(pNode == pEof)
+		if(Entry.m_Eof)
 			break;
-
-		// output character
-		if(pDst == pDstEnd)
-			return -1;
-		*pDst++ = pNode->m_Symbol;
 	}
 
 	// return the size of the decompressed buffer
@@ -12,9 +12,10 @@ class CHuffman
 		HUFFMAN_MAX_SYMBOLS = HUFFMAN_EOF_SYMBOL + 1,
 		HUFFMAN_MAX_NODES = HUFFMAN_MAX_SYMBOLS * 2 - 1,
 
-		HUFFMAN_LUTBITS = 10,
+		HUFFMAN_LUTBITS = 11,
 		HUFFMAN_LUTSIZE = (1 << HUFFMAN_LUTBITS),
-		HUFFMAN_LUTMASK = (HUFFMAN_LUTSIZE - 1)
+		HUFFMAN_LUTMASK = (HUFFMAN_LUTSIZE - 1),
+		HUFFMAN_LUT_MAX_SYMBOLS = 4,
 	};
 
 	struct CNode
@@ -30,10 +31,21 @@ class CHuffman
 		unsigned char m_Symbol;
 	};
 
+	// all symbols whose codes fit completely into the looked up bits
+	struct CDecodeEntry
+	{
+		// node to continue walking the tree from if no symbol fits
+		unsigned short m_Node;
+		unsigned char m_NumBits;
+		unsigned char m_NumSymbols;
+		bool m_Eof;
+		unsigned char m_aSymbols[HUFFMAN_LUT_MAX_SYMBOLS];
+	};
+
 	static const unsigned ms_aFreqTable[HUFFMAN_MAX_SYMBOLS];
 
 	CNode m_aNodes[HUFFMAN_MAX_NODES];
-	CNode *m_apDecodeLut[HUFFMAN_LUTSIZE];
+	CDecodeEntry m_aDecodeLut[HUFFMAN_LUTSIZE];
 	CNode *m_pStartNode;
 	int m_NumNodes;
 
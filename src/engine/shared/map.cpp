@@ -4,6 +4,7 @@
 
 #include <base/log.h>
 
+#include <engine/engine.h>
 #include <engine/storage.h>
 
 #include <game/mapitems.h>
@@ -70,7 +71,7 @@ int CMap::NumItems() const
 	return m_DataFile.NumItems();
 }
 
-bool CMap::Load(const char *pMapName)
+bool CMap::Load(const char *pMapName, bool Mmap)
 {
 	IStorage *pStorage = Kernel()->RequestInterface<IStorage>();
 	if(!pStorage)
@@ -79,7 +80,7 @@ bool CMap::Load(const char *pMapName)
 	// Ensure current datafile is not left in an inconsistent state if loading fails,
 	// by loading the new datafile separately first.
 	CDataFileReader NewDataFile;
-	if(!NewDataFile.Open(pStorage, pMapName, IStorage::TYPE_ALL))
+	if(!NewDataFile.Open(pStorage, pMapName, IStorage::TYPE_ALL, Mmap))
 		return false;
 
 	// Check version
@@ -136,6 +137,11 @@ IOHANDLE CMap::File() const
 	return m_DataFile.File();
 }
 
+void CMap::PreloadData()
+{
+	m_DataFile.PreloadData(Kernel()->RequestInterface<IEngine>());
+}
+
 SHA256_DIGEST CMap::Sha256() const
 {
 	return m_DataFile.Sha256();
@@ -31,10 +31,11 @@ public:
 	void *FindItem(int Type, int ID) override;
 	int NumItems() const override;
 
-	bool Load(const char *pMapName) override;
+	bool Load(const char *pMapName, bool Mmap) override;
 	void Unload() override;
 	bool IsLoaded() const override;
 	IOHANDLE File() const override;
+	void PreloadData() override;
 
 	SHA256_DIGEST Sha256() const override;
 	unsigned Crc() const override;
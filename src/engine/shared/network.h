@@ -410,6 +410,8 @@ public:
 	int Recv(CNetChunk *pChunk, SECURITY_TOKEN *pResponseToken);
 	int Send(CNetChunk *pChunk);
 	int Update();
+	// sends out the packets queued on the socket, see sv_net_batch_send
+	int Flush();
 
 	//
 	int Drop(int ClientID, const char *pReason);
@@ -55,6 +55,8 @@ bool CNetServer::Open(NETADDR BindAddr, CNetBan *pNetBan, int MaxClients, int Ma
 	m_Address = BindAddr;
 	m_pNetBan = pNetBan;
 
+	net_udp_set_send_batching(m_Socket, g_Config.m_SvNetBatchSend);
+
 	m_MaxClients = clamp(MaxClients, 1, (int)NET_MAX_CLIENTS);
 	m_MaxClientsPerIP = MaxClientsPerIP;
 
@@ -125,6 +127,11 @@ int CNetServer::Update()
 	return 0;
 }
 
+int CNetServer::Flush()
+{
+	return net_udp_flush(m_Socket);
+}
+
 SECURITY_TOKEN CNetServer::GetGlobalToken()
 {
 	static NETADDR NullAddr = {0};
@@ -2,6 +2,7 @@
 /* If you are missing that file, acquire a complete release at teeworlds.com.                */
 #include "snapshot.h"
 #include "compression.h"
+#include "snapshot_simd.h"
 #include "uuid_manager.h"
 
 #include <climits>
@@ -28,20 +29,20 @@ int CSnapshot::GetItemSize(int Index) const
 	return (Offsets()[Index + 1] - Offsets()[Index]) - sizeof(CSnapshotItem);
 }
 
-int CSnapshot::GetItemType(int Index) const
+int CSnapshot::GetItemType(int Index, const CSnapshotIndex *pIndex) const
 {
 	int InternalType = GetItem(Index)->Type();
-	return GetExternalItemType(InternalType);
+	return GetExternalItemType(InternalType, pIndex);
 }
 
-int CSnapshot::GetExternalItemType(int InternalType) const
+int CSnapshot::GetExternalItemType(int InternalType, const CSnapshotIndex *pIndex) const
 {
 	if(InternalType < OFFSET_UUID_TYPE)
 	{
 		return InternalType;
 	}
 
-	int TypeItemIndex = GetItemIndex(InternalType); // NETOBJTYPE_EX
+	int TypeItemIndex = GetItemIndex(InternalType, pIndex); // NETOBJTYPE_EX
 	if(TypeItemIndex == -1 || GetItemSize(TypeItemIndex) < (int)sizeof(CUuid))
 	{
 		return InternalType;
@@ -54,9 +55,11 @@ int CSnapshot::GetExternalItemType(int InternalType) const
 	return g_UuidManager.LookupUuid(Uuid);
 }
 
-int CSnapshot::GetItemIndex(int Key) const
+int CSnapshot::GetItemIndex(int Key, const CSnapshotIndex *pIndex) const
 {
-	// TODO: OPT: this should not be a linear search. very bad
+	if(pIndex)
+		return pIndex->GetItemIndex(Key);
+
 	for(int i = 0; i < m_NumItems; i++)
 	{
 		if(GetItem(i)->Key() == Key)
@@ -65,7 +68,7 @@ int CSnapshot::GetItemIndex(int Key) const
 	return -1;
 }
 
-const void *CSnapshot::FindItem(int Type, int ID) const
+const void *CSnapshot::FindItem(int Type, int ID, const CSnapshotIndex *pIndex) const
 {
 	int InternalType = Type;
 	if(Type >= OFFSET_UUID)
@@ -75,9 +78,13 @@ const void *CSnapshot::FindItem(int Type, int ID) const
 		for(size_t i = 0; i < sizeof(CUuid) / sizeof(int32_t); i++)
 			aTypeUuidItem[i] = bytes_be_to_uint(&TypeUuid.m_aData[i * sizeof(int32_t)]);
 
+		// only the NETOBJTYPE_EX items have to be checked if they are indexed
+		const bool UseIndex = pIndex && pIndex->NumExTypeItems() >= 0;
+		const int NumCandidates = UseIndex ? pIndex->NumExTypeItems() : m_NumItems;
 		bool Found = false;
-		for(int i = 0; i < m_NumItems; i++)
+		for(int c = 0; c < NumCandidates; c++)
 		{
+			const int i = UseIndex ? pIndex->ExTypeItem(c) : c;
 			const CSnapshotItem *pItem = GetItem(i);
 			if(pItem->Type() == 0 && pItem->ID() >= OFFSET_UUID_TYPE) // NETOBJTYPE_EX
 			{
@@ -94,22 +101,32 @@ const void *CSnapshot::FindItem(int Type, int ID) const
 			return nullptr;
 		}
 	}
-	int Index = GetItemIndex((InternalType << 16) | ID);
+	int Index = GetItemIndex((InternalType << 16) | ID, pIndex);
 	return Index < 0 ? nullptr : GetItem(Index)->Data();
 }
 
 unsigned CSnapshot::Crc()
 {
-	unsigned int Crc = 0;
+	const CSnapshotSimd::FSum pfnSum = CSnapshotSimd::Active()->m_pfnSum;
 
-	for(int i = 0; i < m_NumItems; i++)
+	// snapshots from CSnapshotBuilder store their items back to back, in that
+	// case the checksum is the sum of the whole data minus the item keys
+	const int *pOffsets = Offsets();
+	bool Packed = m_DataSize % sizeof(int32_t) == 0 && (m_NumItems == 0 || pOffsets[0] == 0);
+	unsigned KeySum = 0;
+	for(int i = 0; i < m_NumItems && Packed; i++)
 	{
-		const CSnapshotItem *pItem = GetItem(i);
-		int Size = GetItemSize(i);
-
-		for(size_t b = 0; b < Size / sizeof(int32_t); b++)
-			Crc += pItem->Data()[b];
+		const int Size = GetItemSize(i);
+		if(Size < 0 || Size % sizeof(int32_t) != 0 || (i + 1 < m_NumItems && pOffsets[i + 1] != pOffsets[i] + (int)sizeof(CSnapshotItem) + Size))
+			Packed = false;
+		KeySum += GetItem(i)->m_TypeAndID;
 	}
+	if(Packed)
+		return pfnSum((const int *)DataStart(), m_DataSize / sizeof(int32_t)) - KeySum;
+
+	unsigned int Crc = 0;
+	for(int i = 0; i < m_NumItems; i++)
+		Crc += pfnSum(GetItem(i)->Data(), GetItemSize(i) / sizeof(int32_t));
 	return Crc;
 }
 
@@ -146,98 +163,106 @@ bool CSnapshot::IsValid(size_t ActualSize) const
 	return true;
 }
 
-// CSnapshotDelta
+// CSnapshotIndex
 
-enum
+int CSnapshotIndex::NumSlots(int NumItems)
 {
-	HASHLIST_SIZE = 256,
-	HASHLIST_BUCKET_SIZE = 64,
-};
+	// keep the load factor at or below one half
+	NumItems = minimum<int>(NumItems, CSnapshot::MAX_ITEMS);
+	int Slots = 16;
+	while(Slots < 2 * NumItems)
+		Slots *= 2;
+	return Slots;
+}
 
-struct CItemList
+size_t CSnapshotIndex::TotalSize(int NumItems)
 {
-	int m_Num;
-	int m_aKeys[HASHLIST_BUCKET_SIZE];
-	int m_aIndex[HASHLIST_BUCKET_SIZE];
-};
+	return sizeof(CSnapshotIndex) + NumSlots(NumItems) * (sizeof(int) + sizeof(short));
+}
 
-inline size_t CalcHashID(int Key)
+int CSnapshotIndex::Slot(int Key) const
 {
-	// djb2 (http://www.cse.yorku.ca/~oz/hash.html)
-	unsigned Hash = 5381;
-	for(unsigned Shift = 0; Shift < sizeof(int); Shift++)
-		Hash = ((Hash << 5) + Hash) + ((Key >> (Shift * 8)) & 0xFF);
-	return Hash % HASHLIST_SIZE;
+	// fibonacci hashing, the high bits are well distributed
+	return (int)(((unsigned)Key * 2654435769u) >> m_Shift);
 }
 
-static void GenerateHash(CItemList *pHashlist, const CSnapshot *pSnapshot)
+void CSnapshotIndex::Init(int NumItems)
 {
-	for(int i = 0; i < HASHLIST_SIZE; i++)
-		pHashlist[i].m_Num = 0;
+	m_NumSlots = NumSlots(NumItems);
+	m_Shift = 32;
+	for(int Slots = m_NumSlots; Slots > 1; Slots /= 2)
+		m_Shift--;
+	m_NumExTypeItems = 0;
 
-	for(int i = 0; i < pSnapshot->NumItems(); i++)
+	short *pIndices = Indices();
+	for(int i = 0; i < m_NumSlots; i++)
+		pIndices[i] = -1;
+}
+
+void CSnapshotIndex::Build(const CSnapshot *pSnapshot)
+{
+	// snapshots created by CSnapshotBuilder never have more items
+	const int NumItems = minimum<int>(pSnapshot->NumItems(), CSnapshot::MAX_ITEMS);
+	Init(NumItems);
+	for(int i = 0; i < NumItems; i++)
 	{
-		int Key = pSnapshot->GetItem(i)->Key();
-		size_t HashID = CalcHashID(Key);
-		if(pHashlist[HashID].m_Num < HASHLIST_BUCKET_SIZE)
+		const CSnapshotItem *pItem = pSnapshot->GetItem(i);
+		// like the linear search, duplicate keys resolve to the first item
+		if(!Insert(pItem->Key(), i))
+			continue;
+
+		if(pItem->Type() == 0 && pItem->ID() >= CSnapshot::OFFSET_UUID_TYPE) // NETOBJTYPE_EX
 		{
-			pHashlist[HashID].m_aIndex[pHashlist[HashID].m_Num] = i;
-			pHashlist[HashID].m_aKeys[pHashlist[HashID].m_Num] = Key;
-			pHashlist[HashID].m_Num++;
+			if(m_NumExTypeItems >= 0 && m_NumExTypeItems < MAX_EXTYPE_ITEMS)
+				m_aExTypeItems[m_NumExTypeItems++] = i;
+			else
+				m_NumExTypeItems = -1;
 		}
 	}
 }
 
-static int GetItemIndexHashed(int Key, const CItemList *pHashlist)
+bool CSnapshotIndex::Insert(int Key, int Index)
 {
-	size_t HashID = CalcHashID(Key);
-	for(int i = 0; i < pHashlist[HashID].m_Num; i++)
+	int *pKeys = Keys();
+	short *pIndices = Indices();
+	const int Mask = m_NumSlots - 1;
+	for(int Slot = CSnapshotIndex::Slot(Key);; Slot = (Slot + 1) & Mask)
 	{
-		if(pHashlist[HashID].m_aKeys[i] == Key)
-			return pHashlist[HashID].m_aIndex[i];
+		if(pIndices[Slot] == -1)
+		{
+			pKeys[Slot] = Key;
+			pIndices[Slot] = Index;
+			return true;
+		}
+		if(pKeys[Slot] == Key)
+			return false;
 	}
-
-	return -1;
 }
 
-int CSnapshotDelta::DiffItem(const int *pPast, const int *pCurrent, int *pOut, int Size)
+int CSnapshotIndex::GetItemIndex(int Key) const
 {
-	int Needed = 0;
-	while(Size)
+	const int *pKeys = Keys();
+	const short *pIndices = Indices();
+	const int Mask = m_NumSlots - 1;
+	for(int Slot = CSnapshotIndex::Slot(Key);; Slot = (Slot + 1) & Mask)
 	{
-		// subtraction with wrapping by casting to unsigned
-		*pOut = (unsigned)*pCurrent - (unsigned)*pPast;
-		Needed |= *pOut;
-		pOut++;
-		pPast++;
-		pCurrent++;
-		Size--;
+		if(pIndices[Slot] == -1)
+			return -1;
+		if(pKeys[Slot] == Key)
+			return pIndices[Slot];
 	}
+}
+
+// CSnapshotDelta
 
-	return Needed;
+int CSnapshotDelta::DiffItem(const int *pPast, const int *pCurrent, int *pOut, int Size)
+{
+	return CSnapshotSimd::Active()->m_pfnDiff(pPast, pCurrent, pOut, Size);
 }
 
 void CSnapshotDelta::UndiffItem(const int *pPast, const int *pDiff, int *pOut, int Size, int *pDataRate)
 {
-	while(Size)
-	{
-		// addition with wrapping by casting to unsigned
-		*pOut = (unsigned)*pPast + (unsigned)*pDiff;
-
-		if(*pDiff == 0)
-			*pDataRate += 1;
-		else
-		{
-			unsigned char aBuf[CVariableInt::MAX_BYTES_PACKED];
-			unsigned char *pEnd = CVariableInt::Pack(aBuf, *pDiff, sizeof(aBuf));
-			*pDataRate += (int)(pEnd - (unsigned char *)aBuf) * 8;
-		}
-
-		pOut++;
-		pPast++;
-		pDiff++;
-		Size--;
-	}
+	*pDataRate += CSnapshotSimd::Active()->m_pfnUndiff(pPast, pDiff, pOut, Size);
 }
 
 CSnapshotDelta::CSnapshotDelta()
@@ -268,8 +293,7 @@ const CSnapshotDelta::CData *CSnapshotDelta::EmptyDelta() const
 	return &m_Empty;
 }
 
-// TODO: OPT: this should be made much faster
-int CSnapshotDelta::CreateDelta(const CSnapshot *pFrom, CSnapshot *pTo, void *pDstData)
+int CSnapshotDelta::CreateDelta(const CSnapshot *pFrom, const CSnapshot *pTo, void *pDstData, const CSnapshotIndex *pFromIndex, const CSnapshotIndex *pToIndex) const
 {
 	CData *pDelta = (CData *)pDstData;
 	int *pData = (int *)pDelta->m_aData;
@@ -278,14 +302,27 @@ int CSnapshotDelta::CreateDelta(const CSnapshot *pFrom, CSnapshot *pTo, void *pD
 	pDelta->m_NumUpdateItems = 0;
 	pDelta->m_NumTempItems = 0;
 
-	CItemList aHashlist[HASHLIST_SIZE];
-	GenerateHash(aHashlist, pTo);
+	// index the snapshots that don't come with one
+	alignas(CSnapshotIndex) char aFromIndexData[CSnapshotIndex::MaxSize()];
+	alignas(CSnapshotIndex) char aToIndexData[CSnapshotIndex::MaxSize()];
+	if(!pFromIndex)
+	{
+		CSnapshotIndex *pIndex = (CSnapshotIndex *)aFromIndexData;
+		pIndex->Build(pFrom);
+		pFromIndex = pIndex;
+	}
+	if(!pToIndex)
+	{
+		CSnapshotIndex *pIndex = (CSnapshotIndex *)aToIndexData;
+		pIndex->Build(pTo);
+		pToIndex = pIndex;
+	}
 
 	// pack deleted stuff
 	for(int i = 0; i < pFrom->NumItems(); i++)
 	{
 		const CSnapshotItem *pFromItem = pFrom->GetItem(i);
-		if(GetItemIndexHashed(pFromItem->Key(), aHashlist) == -1)
+		if(pToIndex->GetItemIndex(pFromItem->Key()) == -1)
 		{
 			// deleted
 			pDelta->m_NumDeletedItems++;
@@ -294,23 +331,21 @@ int CSnapshotDelta::CreateDelta(const CSnapshot *pFrom, CSnapshot *pTo, void *pD
 		}
 	}
 
-	GenerateHash(aHashlist, pFrom);
-
 	// fetch previous indices
 	// we do this as a separate pass because it helps the cache
 	int aPastIndices[CSnapshot::MAX_ITEMS];
 	const int NumItems = pTo->NumItems();
 	for(int i = 0; i < NumItems; i++)
 	{
-		const CSnapshotItem *pCurItem = pTo->GetItem(i); // O(1) .. O(n)
-		aPastIndices[i] = GetItemIndexHashed(pCurItem->Key(), aHashlist); // O(n) .. O(n^n)
+		const CSnapshotItem *pCurItem = pTo->GetItem(i);
+		aPastIndices[i] = pFromIndex->GetItemIndex(pCurItem->Key());
 	}
 
 	for(int i = 0; i < NumItems; i++)
 	{
 		// do delta
-		const int ItemSize = pTo->GetItemSize(i); // O(1) .. O(n)
-		const CSnapshotItem *pCurItem = pTo->GetItem(i); // O(1) .. O(n)
+		const int ItemSize = pTo->GetItemSize(i);
+		const CSnapshotItem *pCurItem = pTo->GetItem(i);
 		const int PastIndex = aPastIndices[i];
 		const bool IncludeSize = pCurItem->Type() >= MAX_NETOBJSIZES || !m_aItemSizes[pCurItem->Type()];
 
@@ -359,7 +394,7 @@ static int RangeCheck(void *pEnd, void *pPtr, int Size)
 	return 0;
 }
 
-int CSnapshotDelta::UnpackDelta(const CSnapshot *pFrom, CSnapshot *pTo, const void *pSrcData, int DataSize)
+int CSnapshotDelta::UnpackDelta(const CSnapshot *pFrom, CSnapshot *pTo, const void *pSrcData, int DataSize, const CSnapshotIndex *pFromIndex)
 {
 	CData *pDelta = (CData *)pSrcData;
 	int *pData = (int *)pDelta->m_aData;
@@ -368,6 +403,19 @@ int CSnapshotDelta::UnpackDelta(const CSnapshot *pFrom, CSnapshot *pTo, const vo
 	CSnapshotBuilder Builder;
 	Builder.Init();
 
+	// index the keys of the new snapshot while building it
+	alignas(CSnapshotIndex) char aBuilderIndexData[CSnapshotIndex::MaxSize()];
+	CSnapshotIndex *pBuilderIndex = (CSnapshotIndex *)aBuilderIndexData;
+	pBuilderIndex->Init(CSnapshot::MAX_ITEMS);
+
+	alignas(CSnapshotIndex) char aFromIndexData[CSnapshotIndex::MaxSize()];
+	if(!pFromIndex)
+	{
+		CSnapshotIndex *pIndex = (CSnapshotIndex *)aFromIndexData;
+		pIndex->Build(pFrom);
+		pFromIndex = pIndex;
+	}
+
 	// unpack deleted stuff
 	int *pDeleted = pData;
 	if(pDelta->m_NumDeletedItems < 0)
@@ -376,18 +424,34 @@ int CSnapshotDelta::UnpackDelta(const CSnapshot *pFrom, CSnapshot *pTo, const vo
 	if(pData > pEnd)
 		return -101;
 
+	bool aDeleted[CSnapshot::MAX_ITEMS] = {false};
+	for(int d = 0; d < pDelta->m_NumDeletedItems; d++)
+	{
+		const int Index = pFromIndex->GetItemIndex(pDeleted[d]);
+		if(Index != -1)
+			aDeleted[Index] = true;
+	}
+
 	// copy all non deleted stuff
 	for(int i = 0; i < pFrom->NumItems(); i++)
 	{
 		const CSnapshotItem *pFromItem = pFrom->GetItem(i);
 		const int ItemSize = pFrom->GetItemSize(i);
 		bool Keep = true;
-		for(int d = 0; d < pDelta->m_NumDeletedItems; d++)
+		if(i < CSnapshot::MAX_ITEMS)
+		{
+			Keep = !aDeleted[i];
+		}
+		else
 		{
-			if(pDeleted[d] == pFromItem->Key())
+			// not indexed, such a snapshot can't be built anyway
+			for(int d = 0; d < pDelta->m_NumDeletedItems; d++)
 			{
-				Keep = false;
-				break;
+				if(pDeleted[d] == pFromItem->Key())
+				{
+					Keep = false;
+					break;
+				}
 			}
 		}
 
@@ -399,6 +463,7 @@ int CSnapshotDelta::UnpackDelta(const CSnapshot *pFrom, CSnapshot *pTo, const vo
 
 			// keep it
 			mem_copy(pObj, pFromItem->Data(), ItemSize);
+			pBuilderIndex->Insert(pFromItem->Key(), Builder.NumItems() - 1);
 		}
 	}
 
@@ -434,14 +499,21 @@ int CSnapshotDelta::UnpackDelta(const CSnapshot *pFrom, CSnapshot *pTo, const vo
 		const int Key = (Type << 16) | ID;
 
 		// create the item if needed
-		int *pNewData = Builder.GetItemData(Key);
-		if(!pNewData)
+		int *pNewData = nullptr;
+		const int BuilderIndex = pBuilderIndex->GetItemIndex(Key);
+		if(BuilderIndex != -1)
+			pNewData = Builder.GetItemDataByIndex(BuilderIndex);
+		else
+		{
 			pNewData = (int *)Builder.NewItem(Type, ID, ItemSize);
+			if(pNewData)
+				pBuilderIndex->Insert(Key, Builder.NumItems() - 1);
+		}
 
 		if(!pNewData)
 			return -302;
 
-		const int FromIndex = pFrom->GetItemIndex(Key);
+		const int FromIndex = pFromIndex->GetItemIndex(Key);
 		if(FromIndex != -1)
 		{
 			// we got an update so we need to apply the diff
@@ -463,116 +535,277 @@ int CSnapshotDelta::UnpackDelta(const CSnapshot *pFrom, CSnapshot *pTo, const vo
 
 // CSnapshotStorage
 
+class CSnapshotStorage::CChunk
+{
+public:
+	CChunk *m_pNext;
+	size_t m_Size;
+	size_t m_Used;
+	int m_NumHolders;
+
+	char *Data() { return (char *)(this + 1); }
+};
+
+enum
+{
+	// enough for the SERVER_TICK_SPEED * 3 ticks kept by the server
+	MIN_HOLDER_RING_SIZE = 256,
+};
+
+CSnapshotStorage::CSnapshotStorage() :
+	m_pFirstChunk(nullptr),
+	m_pLastChunk(nullptr),
+	m_pFreeChunks(nullptr),
+	m_NumFreeChunks(0),
+	m_ppHolders(nullptr),
+	m_RingSize(0),
+	m_FirstSequence(0),
+	m_NumHolders(0),
+	m_Sorted(true)
+{
+}
+
+CSnapshotStorage::~CSnapshotStorage()
+{
+	PurgeAll();
+	if(m_pLastChunk)
+		free(m_pLastChunk);
+	while(m_pFreeChunks)
+	{
+		CChunk *pNext = m_pFreeChunks->m_pNext;
+		free(m_pFreeChunks);
+		m_pFreeChunks = pNext;
+	}
+	free(m_ppHolders);
+}
+
 void CSnapshotStorage::Init()
 {
-	m_pFirst = 0;
-	m_pLast = 0;
+	PurgeAll();
 }
 
-void CSnapshotStorage::PurgeAll()
+void *CSnapshotStorage::Allocate(size_t Size, CChunk **ppChunk)
 {
-	CHolder *pHolder = m_pFirst;
+	Size = (Size + 7) & ~(size_t)7;
 
-	while(pHolder)
+	CChunk *pChunk = m_pLastChunk;
+	if(!pChunk || pChunk->m_Used + Size > pChunk->m_Size)
 	{
-		CHolder *pNext = pHolder->m_pNext;
-		free(pHolder);
-		pHolder = pNext;
+		// an empty last chunk is the only one left
+		if(pChunk && pChunk->m_NumHolders == 0)
+		{
+			m_pFirstChunk = nullptr;
+			m_pLastChunk = nullptr;
+			ReleaseChunk(pChunk);
+		}
+
+		if(Size <= CHUNK_SIZE && m_pFreeChunks)
+		{
+			pChunk = m_pFreeChunks;
+			m_pFreeChunks = pChunk->m_pNext;
+			m_NumFreeChunks--;
+		}
+		else
+		{
+			const size_t ChunkSize = maximum<size_t>(CHUNK_SIZE, Size);
+			pChunk = (CChunk *)malloc(sizeof(CChunk) + ChunkSize);
+			pChunk->m_Size = ChunkSize;
+		}
+		pChunk->m_pNext = nullptr;
+		pChunk->m_Used = 0;
+		pChunk->m_NumHolders = 0;
+
+		if(m_pLastChunk)
+			m_pLastChunk->m_pNext = pChunk;
+		else
+			m_pFirstChunk = pChunk;
+		m_pLastChunk = pChunk;
 	}
 
-	// no more snapshots in storage
-	m_pFirst = 0;
-	m_pLast = 0;
+	void *pData = pChunk->Data() + pChunk->m_Used;
+	pChunk->m_Used += Size;
+	pChunk->m_NumHolders++;
+	*ppChunk = pChunk;
+	return pData;
 }
 
-void CSnapshotStorage::PurgeUntil(int Tick)
+void CSnapshotStorage::Release(CHolder *pHolder)
 {
-	CHolder *pHolder = m_pFirst;
+	CChunk *pChunk = pHolder->m_pChunk;
+	if(--pChunk->m_NumHolders > 0)
+		return;
 
-	while(pHolder)
+	// holders are released in allocation order, so only the first chunk can
+	// become empty, keep the last one around for the next snapshots
+	if(pChunk == m_pLastChunk)
 	{
-		CHolder *pNext = pHolder->m_pNext;
-		if(pHolder->m_Tick >= Tick)
-			return; // no more to remove
-		free(pHolder);
-
-		// did we come to the end of the list?
-		if(!pNext)
-			break;
+		pChunk->m_Used = 0;
+		return;
+	}
+	dbg_assert(pChunk == m_pFirstChunk, "snapshot holders released out of order");
+	m_pFirstChunk = pChunk->m_pNext;
+	ReleaseChunk(pChunk);
+}
 
-		m_pFirst = pNext;
-		pNext->m_pPrev = 0x0;
+void CSnapshotStorage::ReleaseChunk(CChunk *pChunk)
+{
+	if(pChunk->m_Size == CHUNK_SIZE && m_NumFreeChunks < MAX_FREE_CHUNKS)
+	{
+		pChunk->m_pNext = m_pFreeChunks;
+		m_pFreeChunks = pChunk;
+		m_NumFreeChunks++;
+	}
+	else
+		free(pChunk);
+}
 
-		pHolder = pNext;
+void CSnapshotStorage::PurgeAll()
+{
+	while(m_NumHolders)
+	{
+		Release(Holder(0));
+		m_FirstSequence++;
+		m_NumHolders--;
 	}
+	m_Sorted = true;
+}
 
-	// no more snapshots in storage
-	m_pFirst = 0;
-	m_pLast = 0;
+void CSnapshotStorage::PurgeUntil(int Tick)
+{
+	while(m_NumHolders && Holder(0)->m_Tick < Tick)
+	{
+		Release(Holder(0));
+		m_FirstSequence++;
+		m_NumHolders--;
+	}
+	if(!m_NumHolders)
+		m_Sorted = true;
 }
 
 void CSnapshotStorage::Add(int Tick, int64_t Tagtime, int DataSize, const void *pData, int AltDataSize, const void *pAltData)
 {
-	// allocate memory for holder + snapshot_data
-	int TotalSize = sizeof(CHolder) + DataSize;
+	const CSnapshot *pSnap = (const CSnapshot *)pData;
+	const CSnapshot *pAltSnap = (const CSnapshot *)pAltData;
+
+	if(m_NumHolders == m_RingSize)
+	{
+		const unsigned RingSize = maximum<unsigned>(MIN_HOLDER_RING_SIZE, m_RingSize * 2);
+		CHolder **ppHolders = (CHolder **)malloc(RingSize * sizeof(CHolder *));
+		for(unsigned i = 0; i < m_NumHolders; i++)
+			ppHolders[(m_FirstSequence + i) & (RingSize - 1)] = Holder(i);
+		free(m_ppHolders);
+		m_ppHolders = ppHolders;
+		m_RingSize = RingSize;
+	}
+
+	// allocate memory for holder + indices + snapshot_data
+	const size_t IndexSize = CSnapshotIndex::TotalSize(pSnap->NumItems());
+	const size_t AltIndexSize = AltDataSize > 0 ? CSnapshotIndex::TotalSize(pAltSnap->NumItems()) : 0;
+	size_t TotalSize = sizeof(CHolder) + IndexSize + AltIndexSize + DataSize;
 
 	if(AltDataSize > 0)
 	{
 		TotalSize += AltDataSize;
 	}
 
-	CHolder *pHolder = (CHolder *)malloc(TotalSize);
+	CChunk *pChunk;
+	CHolder *pHolder = (CHolder *)Allocate(TotalSize, &pChunk);
+	pHolder->m_pChunk = pChunk;
+	pHolder->m_Sequence = m_FirstSequence + m_NumHolders;
 
 	// set data
 	pHolder->m_Tick = Tick;
 	pHolder->m_Tagtime = Tagtime;
 	pHolder->m_SnapSize = DataSize;
-	pHolder->m_pSnap = (CSnapshot *)(pHolder + 1);
+	pHolder->m_pSnapIndex = (CSnapshotIndex *)(pHolder + 1);
+	pHolder->m_pSnap = (CSnapshot *)(((char *)pHolder->m_pSnapIndex) + IndexSize + AltIndexSize);
 	mem_copy(pHolder->m_pSnap, pData, DataSize);
+	pHolder->m_pSnapIndex->Build(pHolder->m_pSnap);
 
 	if(AltDataSize > 0) // create alternative if wanted
 	{
+		pHolder->m_pAltSnapIndex = (CSnapshotIndex *)(((char *)pHolder->m_pSnapIndex) + IndexSize);
 		pHolder->m_pAltSnap = (CSnapshot *)(((char *)pHolder->m_pSnap) + DataSize);
 		mem_copy(pHolder->m_pAltSnap, pAltData, AltDataSize);
 		pHolder->m_AltSnapSize = AltDataSize;
+		pHolder->m_pAltSnapIndex->Build(pHolder->m_pAltSnap);
 	}
 	else
 	{
 		pHolder->m_pAltSnap = 0;
+		pHolder->m_pAltSnapIndex = 0;
 		pHolder->m_AltSnapSize = 0;
 	}
 
-	// link
-	pHolder->m_pNext = 0;
-	pHolder->m_pPrev = m_pLast;
-	if(m_pLast)
-		m_pLast->m_pNext = pHolder;
-	else
-		m_pFirst = pHolder;
-	m_pLast = pHolder;
+	// append to the ring
+	if(m_NumHolders && Last()->m_Tick >= Tick)
+		m_Sorted = false;
+	m_ppHolders[pHolder->m_Sequence & (m_RingSize - 1)] = pHolder;
+	m_NumHolders++;
+}
+
+CSnapshotStorage::CHolder *CSnapshotStorage::Next(const CHolder *pHolder) const
+{
+	const unsigned i = pHolder->m_Sequence - m_FirstSequence + 1;
+	return i < m_NumHolders ? Holder(i) : nullptr;
 }
 
-int CSnapshotStorage::Get(int Tick, int64_t *pTagtime, const CSnapshot **ppData, const CSnapshot **ppAltData)
+CSnapshotStorage::CHolder *CSnapshotStorage::Find(int Tick) const
 {
-	CHolder *pHolder = m_pFirst;
+	if(!m_NumHolders)
+		return nullptr;
 
-	while(pHolder)
+	if(!m_Sorted)
 	{
-		if(pHolder->m_Tick == Tick)
-		{
-			if(pTagtime)
-				*pTagtime = pHolder->m_Tagtime;
-			if(ppData)
-				*ppData = pHolder->m_pSnap;
-			if(ppAltData)
-				*ppAltData = pHolder->m_pAltSnap;
-			return pHolder->m_SnapSize;
-		}
+		for(unsigned i = 0; i < m_NumHolders; i++)
+			if(Holder(i)->m_Tick == Tick)
+				return Holder(i);
+		return nullptr;
+	}
+
+	const int FirstTick = Holder(0)->m_Tick;
+	if(Tick < FirstTick || Tick > Last()->m_Tick)
+		return nullptr;
+
+	// snapshots are usually stored for consecutive ticks
+	const unsigned Offset = (unsigned)Tick - (unsigned)FirstTick;
+	if(Offset < m_NumHolders && Holder(Offset)->m_Tick == Tick)
+		return Holder(Offset);
 
-		pHolder = pHolder->m_pNext;
+	// with gaps in between the holder can only be before that position
+	unsigned Low = 0;
+	unsigned High = minimum(Offset, m_NumHolders - 1);
+	while(Low <= High)
+	{
+		const unsigned Middle = Low + (High - Low) / 2;
+		const int MiddleTick = Holder(Middle)->m_Tick;
+		if(MiddleTick == Tick)
+			return Holder(Middle);
+		if(MiddleTick < Tick)
+			Low = Middle + 1;
+		else if(Middle == 0)
+			break;
+		else
+			High = Middle - 1;
 	}
+	return nullptr;
+}
 
-	return -1;
+int CSnapshotStorage::Get(int Tick, int64_t *pTagtime, const CSnapshot **ppData, const CSnapshot **ppAltData, const CSnapshotIndex **ppIndex)
+{
+	const CHolder *pHolder = Find(Tick);
+	if(!pHolder)
+		return -1;
+
+	if(pTagtime)
+		*pTagtime = pHolder->m_Tagtime;
+	if(ppData)
+		*ppData = pHolder->m_pSnap;
+	if(ppAltData)
+		*ppAltData = pHolder->m_pAltSnap;
+	if(ppIndex)
+		*ppIndex = pHolder->m_pSnapIndex;
+	return pHolder->m_SnapSize;
 }
 
 // CSnapshotBuilder
@@ -698,3 +931,50 @@ void *CSnapshotBuilder::NewItem(int Type, int ID, int Size)
 
 	return pObj->Data();
 }
+
+// CSnapshotSharedItems
+
+void CSnapshotSharedItems::Init()
+{
+	m_DataSize = 0;
+	m_NumItems = 0;
+	m_Full = false;
+}
+
+void *CSnapshotSharedItems::NewItem(int Type, int ID, int Size)
+{
+	if(ID == -1)
+	{
+		return nullptr;
+	}
+
+	if(m_DataSize + sizeof(CItem) + Size >= CSnapshot::MAX_SIZE ||
+		m_NumItems + 1 >= CSnapshot::MAX_ITEMS)
+	{
+		m_Full = true;
+		return nullptr;
+	}
+
+	CItem *pItem = (CItem *)(m_aData + m_DataSize);
+	mem_zero(pItem, sizeof(CItem) + Size);
+	pItem->m_Type = Type;
+	pItem->m_ID = ID;
+	pItem->m_Size = Size;
+	m_aOffsets[m_NumItems] = m_DataSize;
+	m_DataSize += sizeof(CItem) + Size;
+	m_NumItems++;
+
+	return pItem->Data();
+}
+
+void CSnapshotSharedItems::CopyTo(CSnapshotBuilder *pBuilder, int From, int To) const
+{
+	dbg_assert(0 <= From && From <= To && To <= m_NumItems, "shared item range out of bounds");
+	for(int i = From; i < To; i++)
+	{
+		const CItem *pItem = GetItem(i);
+		void *pData = pBuilder->NewItem(pItem->m_Type, pItem->m_ID, pItem->m_Size);
+		if(pData)
+			mem_copy(pData, pItem->Data(), pItem->m_Size);
+	}
+}
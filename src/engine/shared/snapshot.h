@@ -51,10 +51,11 @@ public:
 	int NumItems() const { return m_NumItems; }
 	const CSnapshotItem *GetItem(int Index) const;
 	int GetItemSize(int Index) const;
-	int GetItemIndex(int Key) const;
-	int GetItemType(int Index) const;
-	int GetExternalItemType(int InternalType) const;
-	const void *FindItem(int Type, int ID) const;
+	// the optional index must have been built for this snapshot
+	int GetItemIndex(int Key, const class CSnapshotIndex *pIndex = nullptr) const;
+	int GetItemType(int Index, const class CSnapshotIndex *pIndex = nullptr) const;
+	int GetExternalItemType(int InternalType, const class CSnapshotIndex *pIndex = nullptr) const;
+	const void *FindItem(int Type, int ID, const class CSnapshotIndex *pIndex = nullptr) const;
 
 	unsigned Crc();
 	void DebugDump();
@@ -63,6 +64,52 @@ public:
 	static const CSnapshot *EmptySnapshot() { return &ms_EmptySnapshot; }
 };
 
+// CSnapshotIndex
+
+// Maps the item keys of a snapshot to their item indices so that lookups
+// don't have to scan all items. The slots are stored behind the object,
+// use `TotalSize` to allocate enough memory.
+class CSnapshotIndex
+{
+	enum
+	{
+		MAX_EXTYPE_ITEMS = 64,
+	};
+
+	int m_NumSlots;
+	int m_Shift;
+
+	// indices of the NETOBJTYPE_EX items, -1 if there are too many of them
+	int m_NumExTypeItems;
+	short m_aExTypeItems[MAX_EXTYPE_ITEMS];
+
+	int *Keys() { return (int *)(this + 1); }
+	const int *Keys() const { return (const int *)(this + 1); }
+	short *Indices() { return (short *)(Keys() + m_NumSlots); }
+	const short *Indices() const { return (const short *)(Keys() + m_NumSlots); }
+
+	static int NumSlots(int NumItems);
+	int Slot(int Key) const;
+
+public:
+	enum
+	{
+		MAX_SLOTS = 2 * CSnapshot::MAX_ITEMS,
+	};
+
+	static size_t TotalSize(int NumItems);
+	static constexpr size_t MaxSize() { return sizeof(CSnapshotIndex) + MAX_SLOTS * (sizeof(int) + sizeof(short)); }
+
+	void Init(int NumItems);
+	void Build(const CSnapshot *pSnapshot);
+	// returns false if the key is already present
+	bool Insert(int Key, int Index);
+	int GetItemIndex(int Key) const;
+
+	int NumExTypeItems() const { return m_NumExTypeItems; }
+	int ExTypeItem(int i) const { return m_aExTypeItems[i]; }
+};
+
 // CSnapshotDelta
 
 class CSnapshotDelta
@@ -97,21 +144,30 @@ public:
 	int GetDataUpdates(int Index) const { return m_aSnapshotDataUpdates[Index]; }
 	void SetStaticsize(int ItemType, int Size);
 	const CData *EmptyDelta() const;
-	int CreateDelta(const class CSnapshot *pFrom, class CSnapshot *pTo, void *pDstData);
-	int UnpackDelta(const class CSnapshot *pFrom, class CSnapshot *pTo, const void *pSrcData, int DataSize);
+	// the optional indices must have been built for the respective snapshots
+	int CreateDelta(const class CSnapshot *pFrom, const class CSnapshot *pTo, void *pDstData, const CSnapshotIndex *pFromIndex = nullptr, const CSnapshotIndex *pToIndex = nullptr) const;
+	int UnpackDelta(const class CSnapshot *pFrom, class CSnapshot *pTo, const void *pSrcData, int DataSize, const CSnapshotIndex *pFromIndex = nullptr);
 };
 
 // CSnapshotStorage
 
+// Keeps the snapshots of the last ticks in tick order. The holders are
+// allocated from reused memory chunks and indexed by a ring, so adding and
+// purging does not hit the heap and looking up a tick is O(1) as long as the
+// stored ticks are consecutive.
 class CSnapshotStorage
 {
+	class CChunk;
+
 public:
 	class CHolder
 	{
-	public:
-		CHolder *m_pPrev;
-		CHolder *m_pNext;
+		friend class CSnapshotStorage;
+
+		CChunk *m_pChunk;
+		unsigned m_Sequence;
 
+	public:
 		int64_t m_Tagtime;
 		int m_Tick;
 
@@ -120,18 +176,54 @@ public:
 
 		CSnapshot *m_pSnap;
 		CSnapshot *m_pAltSnap;
+
+		CSnapshotIndex *m_pSnapIndex;
+		CSnapshotIndex *m_pAltSnapIndex;
 	};
 
-	CHolder *m_pFirst;
-	CHolder *m_pLast;
+private:
+	enum
+	{
+		CHUNK_SIZE = 4 * CSnapshot::MAX_SIZE,
+		MAX_FREE_CHUNKS = 2,
+	};
+
+	// chunks in allocation order, new holders come from the last one
+	CChunk *m_pFirstChunk;
+	CChunk *m_pLastChunk;
+	CChunk *m_pFreeChunks;
+	int m_NumFreeChunks;
+
+	// ring of the holders, its size is a power of two
+	CHolder **m_ppHolders;
+	unsigned m_RingSize;
+	unsigned m_FirstSequence;
+	unsigned m_NumHolders;
+	// whether the ticks are strictly increasing
+	bool m_Sorted;
+
+	CHolder *Holder(unsigned i) const { return m_ppHolders[(m_FirstSequence + i) & (m_RingSize - 1)]; }
+	void *Allocate(size_t Size, CChunk **ppChunk);
+	void Release(CHolder *pHolder);
+	void ReleaseChunk(CChunk *pChunk);
+
+public:
+	CSnapshotStorage();
+	~CSnapshotStorage();
+	CSnapshotStorage(const CSnapshotStorage &) = delete;
+	CSnapshotStorage &operator=(const CSnapshotStorage &) = delete;
 
-	CSnapshotStorage() { Init(); }
-	~CSnapshotStorage() { PurgeAll(); }
 	void Init();
 	void PurgeAll();
 	void PurgeUntil(int Tick);
 	void Add(int Tick, int64_t Tagtime, int DataSize, const void *pData, int AltDataSize, const void *pAltData);
-	int Get(int Tick, int64_t *pTagtime, const CSnapshot **ppData, const CSnapshot **ppAltData);
+	int Get(int Tick, int64_t *pTagtime, const CSnapshot **ppData, const CSnapshot **ppAltData, const CSnapshotIndex **ppIndex = nullptr);
+
+	CHolder *First() const { return m_NumHolders ? Holder(0) : nullptr; }
+	CHolder *Last() const { return m_NumHolders ? Holder(m_NumHolders - 1) : nullptr; }
+	// the holder must be in this storage, returns nullptr for the last one
+	CHolder *Next(const CHolder *pHolder) const;
+	CHolder *Find(int Tick) const;
 };
 
 class CSnapshotBuilder
@@ -163,10 +255,50 @@ public:
 
 	void *NewItem(int Type, int ID, int Size);
 
+	int NumItems() const { return m_NumItems; }
 	CSnapshotItem *GetItem(int Index);
 	int *GetItemData(int Key);
+	int *GetItemDataByIndex(int Index) { return GetItem(Index)->Data(); }
 
 	int Finish(void *pSnapdata);
 };
 
+// CSnapshotSharedItems
+
+// Items that are built once per tick and then copied into the snapshot
+// of every client that can see them, see `IServer::SnapCopySharedItems`.
+class CSnapshotSharedItems
+{
+	class CItem
+	{
+	public:
+		int m_Type;
+		int m_ID;
+		int m_Size;
+
+		int *Data() { return (int *)(this + 1); }
+		const int *Data() const { return (const int *)(this + 1); }
+	};
+
+	char m_aData[CSnapshot::MAX_SIZE];
+	int m_DataSize;
+
+	int m_aOffsets[CSnapshot::MAX_ITEMS];
+	int m_NumItems;
+	bool m_Full;
+
+	const CItem *GetItem(int Index) const { return (const CItem *)&m_aData[m_aOffsets[Index]]; }
+
+public:
+	CSnapshotSharedItems() { Init(); }
+
+	void Init();
+	int NumItems() const { return m_NumItems; }
+	// an item didn't fit since the last Init
+	bool Full() const { return m_Full; }
+
+	void *NewItem(int Type, int ID, int Size);
+	void CopyTo(CSnapshotBuilder *pBuilder, int From, int To) const;
+};
+
 #endif // ENGINE_SNAPSHOT_H
@@ -0,0 +1,318 @@
+#include "snapshot_simd.h"
+#include "compression.h"
+
+#include <base/detect.h>
+
+#if defined(CONF_ARCH_AMD64) || defined(CONF_ARCH_IA32)
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SNAPSHOT_SIMD_X86 1
+#endif
+#endif
+
+#if defined(CONF_ARCH_ARM64) && defined(__ARM_NEON)
+#define SNAPSHOT_SIMD_NEON 1
+#endif
+
+#if defined(SNAPSHOT_SIMD_X86)
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define SNAPSHOT_TARGET_AVX2
+#else
+#define SNAPSHOT_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#elif defined(SNAPSHOT_SIMD_NEON)
+#include <arm_neon.h>
+#endif
+
+// scalar
+
+static int DiffScalar(const int *pPast, const int *pCurrent, int *pOut, int Size)
+{
+	int Needed = 0;
+	while(Size)
+	{
+		// subtraction with wrapping by casting to unsigned
+		*pOut = (unsigned)*pCurrent - (unsigned)*pPast;
+		Needed |= *pOut;
+		pOut++;
+		pPast++;
+		pCurrent++;
+		Size--;
+	}
+	return Needed;
+}
+
+static int UndiffScalar(const int *pPast, const int *pDiff, int *pOut, int Size)
+{
+	unsigned DataRate = 0;
+	while(Size)
+	{
+		// addition with wrapping by casting to unsigned
+		*pOut = (unsigned)*pPast + (unsigned)*pDiff;
+
+		if(*pDiff == 0)
+			DataRate += 1;
+		else
+		{
+			unsigned char aBuf[CVariableInt::MAX_BYTES_PACKED];
+			unsigned char *pEnd = CVariableInt::Pack(aBuf, *pDiff, sizeof(aBuf));
+			DataRate += (int)(pEnd - (unsigned char *)aBuf) * 8;
+		}
+
+		pOut++;
+		pPast++;
+		pDiff++;
+		Size--;
+	}
+	return DataRate;
+}
+
+static unsigned SumScalar(const int *pData, int Size)
+{
+	unsigned Sum = 0;
+	for(int i = 0; i < Size; i++)
+		Sum += pData[i];
+	return Sum;
+}
+
+// The packed size of a value is one byte for the sign and the lowest six bits
+// plus one byte for every further seven bits, see `CVariableInt::Pack`. The
+// vector versions compute it branch-free as
+// 1 + (x > 0x3f) + (x > 0x1fff) + (x > 0xfffff) + (x > 0x7ffffff) with x being
+// the value with the sign folded away. A zero diff only counts one bit.
+enum
+{
+	PACKED_LIMIT_1 = (1 << 6) - 1,
+	PACKED_LIMIT_2 = (1 << 13) - 1,
+	PACKED_LIMIT_3 = (1 << 20) - 1,
+	PACKED_LIMIT_4 = (1 << 27) - 1,
+};
+
+#if defined(SNAPSHOT_SIMD_X86)
+
+// SSE2
+
+static inline int HorizontalOrSse2(__m128i Value)
+{
+	Value = _mm_or_si128(Value, _mm_shuffle_epi32(Value, _MM_SHUFFLE(1, 0, 3, 2)));
+	Value = _mm_or_si128(Value, _mm_shuffle_epi32(Value, _MM_SHUFFLE(2, 3, 0, 1)));
+	return _mm_cvtsi128_si32(Value);
+}
+
+static inline unsigned HorizontalSumSse2(__m128i Sum)
+{
+	Sum = _mm_add_epi32(Sum, _mm_shuffle_epi32(Sum, _MM_SHUFFLE(1, 0, 3, 2)));
+	Sum = _mm_add_epi32(Sum, _mm_shuffle_epi32(Sum, _MM_SHUFFLE(2, 3, 0, 1)));
+	return _mm_cvtsi128_si32(Sum);
+}
+
+static int DiffSse2(const int *pPast, const int *pCurrent, int *pOut, int Size)
+{
+	__m128i Needed = _mm_setzero_si128();
+	int i = 0;
+	for(; i + 4 <= Size; i += 4)
+	{
+		const __m128i Diff = _mm_sub_epi32(_mm_loadu_si128((const __m128i *)(pCurrent + i)), _mm_loadu_si128((const __m128i *)(pPast + i)));
+		_mm_storeu_si128((__m128i *)(pOut + i), Diff);
+		Needed = _mm_or_si128(Needed, Diff);
+	}
+	return HorizontalOrSse2(Needed) | DiffScalar(pPast + i, pCurrent + i, pOut + i, Size - i);
+}
+
+static inline __m128i DataRateSse2(__m128i Diff)
+{
+	const __m128i Folded = _mm_xor_si128(Diff, _mm_srai_epi32(Diff, 31));
+	__m128i Bytes = _mm_set1_epi32(1);
+	Bytes = _mm_sub_epi32(Bytes, _mm_cmpgt_epi32(Folded, _mm_set1_epi32(PACKED_LIMIT_1)));
+	Bytes = _mm_sub_epi32(Bytes, _mm_cmpgt_epi32(Folded, _mm_set1_epi32(PACKED_LIMIT_2)));
+	Bytes = _mm_sub_epi32(Bytes, _mm_cmpgt_epi32(Folded, _mm_set1_epi32(PACKED_LIMIT_3)));
+	Bytes = _mm_sub_epi32(Bytes, _mm_cmpgt_epi32(Folded, _mm_set1_epi32(PACKED_LIMIT_4)));
+	const __m128i Zero = _mm_cmpeq_epi32(Diff, _mm_setzero_si128());
+	return _mm_or_si128(_mm_and_si128(Zero, _mm_set1_epi32(1)), _mm_andnot_si128(Zero, _mm_slli_epi32(Bytes, 3)));
+}
+
+static int UndiffSse2(const int *pPast, const int *pDiff, int *pOut, int Size)
+{
+	__m128i DataRate = _mm_setzero_si128();
+	int i = 0;
+	for(; i + 4 <= Size; i += 4)
+	{
+		const __m128i Diff = _mm_loadu_si128((const __m128i *)(pDiff + i));
+		_mm_storeu_si128((__m128i *)(pOut + i), _mm_add_epi32(_mm_loadu_si128((const __m128i *)(pPast + i)), Diff));
+		DataRate = _mm_add_epi32(DataRate, DataRateSse2(Diff));
+	}
+	return HorizontalSumSse2(DataRate) + UndiffScalar(pPast + i, pDiff + i, pOut + i, Size - i);
+}
+
+static unsigned SumSse2(const int *pData, int Size)
+{
+	__m128i Sum = _mm_setzero_si128();
+	int i = 0;
+	for(; i + 4 <= Size; i += 4)
+		Sum = _mm_add_epi32(Sum, _mm_loadu_si128((const __m128i *)(pData + i)));
+	return HorizontalSumSse2(Sum) + SumScalar(pData + i, Size - i);
+}
+
+// AVX2
+
+SNAPSHOT_TARGET_AVX2 static int DiffAvx2(const int *pPast, const int *pCurrent, int *pOut, int Size)
+{
+	__m256i Needed = _mm256_setzero_si256();
+	int i = 0;
+	for(; i + 8 <= Size; i += 8)
+	{
+		const __m256i Diff = _mm256_sub_epi32(_mm256_loadu_si256((const __m256i *)(pCurrent + i)), _mm256_loadu_si256((const __m256i *)(pPast + i)));
+		_mm256_storeu_si256((__m256i *)(pOut + i), Diff);
+		Needed = _mm256_or_si256(Needed, Diff);
+	}
+	const __m128i Needed128 = _mm_or_si128(_mm256_castsi256_si128(Needed), _mm256_extracti128_si256(Needed, 1));
+	return HorizontalOrSse2(Needed128) | DiffSse2(pPast + i, pCurrent + i, pOut + i, Size - i);
+}
+
+SNAPSHOT_TARGET_AVX2 static int UndiffAvx2(const int *pPast, const int *pDiff, int *pOut, int Size)
+{
+	__m256i DataRate = _mm256_setzero_si256();
+	int i = 0;
+	for(; i + 8 <= Size; i += 8)
+	{
+		const __m256i Diff = _mm256_loadu_si256((const __m256i *)(pDiff + i));
+		_mm256_storeu_si256((__m256i *)(pOut + i), _mm256_add_epi32(_mm256_loadu_si256((const __m256i *)(pPast + i)), Diff));
+
+		const __m256i Folded = _mm256_xor_si256(Diff, _mm256_srai_epi32(Diff, 31));
+		__m256i Bytes = _mm256_set1_epi32(1);
+		Bytes = _mm256_sub_epi32(Bytes, _mm256_cmpgt_epi32(Folded, _mm256_set1_epi32(PACKED_LIMIT_1)));
+		Bytes = _mm256_sub_epi32(Bytes, _mm256_cmpgt_epi32(Folded, _mm256_set1_epi32(PACKED_LIMIT_2)));
+		Bytes = _mm256_sub_epi32(Bytes, _mm256_cmpgt_epi32(Folded, _mm256_set1_epi32(PACKED_LIMIT_3)));
+		Bytes = _mm256_sub_epi32(Bytes, _mm256_cmpgt_epi32(Folded, _mm256_set1_epi32(PACKED_LIMIT_4)));
+		const __m256i Zero = _mm256_cmpeq_epi32(Diff, _mm256_setzero_si256());
+		DataRate = _mm256_add_epi32(DataRate, _mm256_blendv_epi8(_mm256_slli_epi32(Bytes, 3), _mm256_set1_epi32(1), Zero));
+	}
+	const __m128i DataRate128 = _mm_add_epi32(_mm256_castsi256_si128(DataRate), _mm256_extracti128_si256(DataRate, 1));
+	return HorizontalSumSse2(DataRate128) + UndiffSse2(pPast + i, pDiff + i, pOut + i, Size - i);
+}
+
+SNAPSHOT_TARGET_AVX2 static unsigned SumAvx2(const int *pData, int Size)
+{
+	__m256i Sum = _mm256_setzero_si256();
+	int i = 0;
+	for(; i + 8 <= Size; i += 8)
+		Sum = _mm256_add_epi32(Sum, _mm256_loadu_si256((const __m256i *)(pData + i)));
+	const __m128i Sum128 = _mm_add_epi32(_mm256_castsi256_si128(Sum), _mm256_extracti128_si256(Sum, 1));
+	return HorizontalSumSse2(Sum128) + SumSse2(pData + i, Size - i);
+}
+
+static bool CpuSupportsAvx2()
+{
+#if defined(_MSC_VER)
+	int aInfo[4];
+	__cpuid(aInfo, 0);
+	if(aInfo[0] < 7)
+		return false;
+	__cpuid(aInfo, 1);
+	// the OS must save the ymm registers on context switches
+	const bool OsXsave = (aInfo[2] & (1 << 27)) != 0;
+	if(!OsXsave || (_xgetbv(0) & 0x6) != 0x6)
+		return false;
+	__cpuidex(aInfo, 7, 0);
+	return (aInfo[1] & (1 << 5)) != 0;
+#else
+	return __builtin_cpu_supports("avx2");
+#endif
+}
+
+#elif defined(SNAPSHOT_SIMD_NEON)
+
+// NEON
+
+static int DiffNeon(const int *pPast, const int *pCurrent, int *pOut, int Size)
+{
+	uint32x4_t Needed = vdupq_n_u32(0);
+	int i = 0;
+	for(; i + 4 <= Size; i += 4)
+	{
+		const uint32x4_t Diff = vsubq_u32(vld1q_u32((const uint32_t *)(pCurrent + i)), vld1q_u32((const uint32_t *)(pPast + i)));
+		vst1q_u32((uint32_t *)(pOut + i), Diff);
+		Needed = vorrq_u32(Needed, Diff);
+	}
+	const uint32x2_t Needed64 = vorr_u32(vget_low_u32(Needed), vget_high_u32(Needed));
+	return (int)(vget_lane_u32(Needed64, 0) | vget_lane_u32(Needed64, 1)) | DiffScalar(pPast + i, pCurrent + i, pOut + i, Size - i);
+}
+
+static int UndiffNeon(const int *pPast, const int *pDiff, int *pOut, int Size)
+{
+	uint32x4_t DataRate = vdupq_n_u32(0);
+	int i = 0;
+	for(; i + 4 <= Size; i += 4)
+	{
+		const int32x4_t Diff = vld1q_s32(pDiff + i);
+		vst1q_s32(pOut + i, vreinterpretq_s32_u32(vaddq_u32(vld1q_u32((const uint32_t *)(pPast + i)), vreinterpretq_u32_s32(Diff))));
+
+		const int32x4_t Folded = veorq_s32(Diff, vshrq_n_s32(Diff, 31));
+		uint32x4_t Bytes = vdupq_n_u32(1);
+		Bytes = vsubq_u32(Bytes, vcgtq_s32(Folded, vdupq_n_s32(PACKED_LIMIT_1)));
+		Bytes = vsubq_u32(Bytes, vcgtq_s32(Folded, vdupq_n_s32(PACKED_LIMIT_2)));
+		Bytes = vsubq_u32(Bytes, vcgtq_s32(Folded, vdupq_n_s32(PACKED_LIMIT_3)));
+		Bytes = vsubq_u32(Bytes, vcgtq_s32(Folded, vdupq_n_s32(PACKED_LIMIT_4)));
+		const uint32x4_t Zero = vceqq_s32(Diff, vdupq_n_s32(0));
+		DataRate = vaddq_u32(DataRate, vbslq_u32(Zero, vdupq_n_u32(1), vshlq_n_u32(Bytes, 3)));
+	}
+	return vaddvq_u32(DataRate) + UndiffScalar(pPast + i, pDiff + i, pOut + i, Size - i);
+}
+
+static unsigned SumNeon(const int *pData, int Size)
+{
+	uint32x4_t Sum = vdupq_n_u32(0);
+	int i = 0;
+	for(; i + 4 <= Size; i += 4)
+		Sum = vaddq_u32(Sum, vld1q_u32((const uint32_t *)(pData + i)));
+	return vaddvq_u32(Sum) + SumScalar(pData + i, Size - i);
+}
+
+#endif
+
+static const CSnapshotSimd s_aImpls[CSnapshotSimd::NUM_IMPLS] = {
+	{"scalar", DiffScalar, UndiffScalar, SumScalar},
+#if defined(SNAPSHOT_SIMD_X86)
+	{"sse2", DiffSse2, UndiffSse2, SumSse2},
+	{"avx2", DiffAvx2, UndiffAvx2, SumAvx2},
+#else
+	{"sse2", nullptr, nullptr, nullptr},
+	{"avx2", nullptr, nullptr, nullptr},
+#endif
+#if defined(SNAPSHOT_SIMD_NEON)
+	{"neon", DiffNeon, UndiffNeon, SumNeon},
+#else
+	{"neon", nullptr, nullptr, nullptr},
+#endif
+};
+
+bool CSnapshotSimd::IsSupported(int Impl)
+{
+	if(Impl < 0 || Impl >= NUM_IMPLS || !s_aImpls[Impl].m_pfnDiff)
+		return false;
+#if defined(SNAPSHOT_SIMD_X86)
+	if(Impl == IMPL_AVX2)
+	{
+		static const bool s_Avx2 = CpuSupportsAvx2();
+		return s_Avx2;
+	}
+#endif
+	return true;
+}
+
+const CSnapshotSimd *CSnapshotSimd::Get(int Impl)
+{
+	return IsSupported(Impl) ? &s_aImpls[Impl] : nullptr;
+}
+
+const CSnapshotSimd *CSnapshotSimd::Active()
+{
+	static const CSnapshotSimd *s_pActive = []() {
+		for(int Impl = NUM_IMPLS - 1; Impl > IMPL_SCALAR; Impl--)
+			if(IsSupported(Impl))
+				return &s_aImpls[Impl];
+		return &s_aImpls[IMPL_SCALAR];
+	}();
+	return s_pActive;
+}
@@ -0,0 +1,37 @@
+#ifndef ENGINE_SHARED_SNAPSHOT_SIMD_H
+#define ENGINE_SHARED_SNAPSHOT_SIMD_H
+
+// Implementations of the per-item loops of the snapshot delta code. All of
+// them produce exactly the same results as the scalar one, the fastest one
+// supported by the CPU is selected at runtime.
+class CSnapshotSimd
+{
+public:
+	enum
+	{
+		IMPL_SCALAR = 0,
+		IMPL_SSE2,
+		IMPL_AVX2,
+		IMPL_NEON,
+		NUM_IMPLS,
+	};
+
+	// writes pCurrent - pPast to pOut, returns the bitwise or of all differences
+	typedef int (*FDiff)(const int *pPast, const int *pCurrent, int *pOut, int Size);
+	// writes pPast + pDiff to pOut, returns the size of pDiff in bits as sent over the network
+	typedef int (*FUndiff)(const int *pPast, const int *pDiff, int *pOut, int Size);
+	// returns the wrapping sum of all values
+	typedef unsigned (*FSum)(const int *pData, int Size);
+
+	const char *m_pName;
+	FDiff m_pfnDiff;
+	FUndiff m_pfnUndiff;
+	FSum m_pfnSum;
+
+	static bool IsSupported(int Impl);
+	// returns nullptr if the implementation is not supported
+	static const CSnapshotSimd *Get(int Impl);
+	static const CSnapshotSimd *Active();
+};
+
+#endif
@@ -0,0 +1,723 @@
+#include "teehistorian_reader.h"
+
+#include <base/system.h>
+#include <engine/shared/compression.h>
+#include <engine/shared/packer.h>
+#include <engine/shared/teehistorian_ex.h>
+
+#include <zlib.h>
+
+#include <algorithm>
+#include <climits>
+#include <iterator>
+
+static const CUuid TEEHISTORIAN_UUID = CalculateUuid("teehistorian@ddnet.tw");
+static const CUuid TEEHISTORIAN_INDEX_UUID = CalculateUuid("teehistorian-index@ddnet.tw");
+static const int TEEHISTORIAN_INDEX_VERSION = 2;
+
+static const char *const s_apRecordNames[] = {
+	"player_diff",
+	"finish",
+	"tick_skip",
+	"player_new",
+	"player_old",
+	"input_diff",
+	"input_new",
+	"message",
+	"join",
+	"drop",
+	"console_command",
+	"ex",
+};
+static_assert(std::size(s_apRecordNames) == CTeeHistorianReader::NUM_RECORD_TYPES);
+
+static const char *const s_apEventNames[] = {
+	"join",
+	"drop",
+	"rejoin",
+	"save_success",
+	"save_failure",
+	"load_success",
+	"load_failure",
+};
+static_assert(std::size(s_apEventNames) == CTeeHistorianIndex::NUM_EVENTS);
+
+namespace {
+// reads the parts of a record, remembers if the data ended before
+class CRecordParser
+{
+public:
+	CRecordParser(const unsigned char *pData, int Size) :
+		m_pCurrent(pData), m_pEnd(pData + Size), m_Incomplete(false)
+	{
+	}
+
+	int GetInt()
+	{
+		int Value = 0;
+		if(m_Incomplete)
+			return 0;
+		const unsigned char *pNext = CVariableInt::Unpack(m_pCurrent, &Value, m_pEnd - m_pCurrent);
+		if(!pNext)
+		{
+			m_Incomplete = true;
+			return 0;
+		}
+		m_pCurrent = pNext;
+		return Value;
+	}
+
+	const char *GetString()
+	{
+		if(m_Incomplete)
+			return "";
+		const unsigned char *pNull = (const unsigned char *)memchr(m_pCurrent, 0, m_pEnd - m_pCurrent);
+		if(!pNull)
+		{
+			m_Incomplete = true;
+			return "";
+		}
+		const char *pString = (const char *)m_pCurrent;
+		m_pCurrent = pNull + 1;
+		return pString;
+	}
+
+	const unsigned char *GetRaw(int Size)
+	{
+		if(m_Incomplete || m_pEnd - m_pCurrent < Size)
+		{
+			m_Incomplete = true;
+			return nullptr;
+		}
+		const unsigned char *pRaw = m_pCurrent;
+		m_pCurrent += Size;
+		return pRaw;
+	}
+
+	const unsigned char *m_pCurrent;
+	const unsigned char *m_pEnd;
+	bool m_Incomplete;
+};
+}
+
+CTeeHistorianReader::CTeeHistorianReader() :
+	m_File(nullptr)
+{
+	Close();
+}
+
+CTeeHistorianReader::~CTeeHistorianReader()
+{
+	Close();
+}
+
+void CTeeHistorianReader::Close()
+{
+	if(m_File)
+		gzclose(m_File);
+	m_File = nullptr;
+	m_Header.clear();
+	m_Error = false;
+	m_Finished = false;
+	m_BufferOffset = 0;
+	m_Pos = 0;
+	m_Size = 0;
+	m_Eof = false;
+	mem_zero(&m_State, sizeof(m_State));
+	m_State.m_MaxClientID = MAX_CLIENTS;
+}
+
+bool CTeeHistorianReader::Open(const char *pFilename)
+{
+	Close();
+	// also reads uncompressed files, seeking in them is cheap
+	m_File = gzopen(pFilename, "rb");
+	if(!m_File)
+		return false;
+	gzbuffer(m_File, BUFFER_SIZE);
+	m_vBuffer.resize(BUFFER_SIZE);
+
+	while(true)
+	{
+		const unsigned char *pData = m_vBuffer.data() + m_Pos;
+		const int Size = m_Size - m_Pos;
+		if(Size > (int)sizeof(CUuid))
+		{
+			if(mem_comp(pData, &TEEHISTORIAN_UUID, sizeof(CUuid)) != 0)
+			{
+				m_Error = true;
+				return false;
+			}
+			const void *pNull = memchr(pData + sizeof(CUuid), 0, Size - sizeof(CUuid));
+			if(pNull)
+			{
+				m_Header.assign((const char *)pData + sizeof(CUuid), (const char *)pNull);
+				m_Pos += sizeof(CUuid) + m_Header.size() + 1;
+				m_State.m_Offset = m_BufferOffset + m_Pos;
+				return true;
+			}
+		}
+		if(!Refill())
+		{
+			m_Error = true;
+			return false;
+		}
+	}
+}
+
+bool CTeeHistorianReader::Refill()
+{
+	if(m_Eof || m_Error || !m_File)
+		return false;
+
+	if(m_Pos > 0)
+	{
+		mem_move(m_vBuffer.data(), m_vBuffer.data() + m_Pos, m_Size - m_Pos);
+		m_BufferOffset += m_Pos;
+		m_Size -= m_Pos;
+		m_Pos = 0;
+	}
+	else if(m_Size == (int)m_vBuffer.size())
+	{
+		// a record larger than the buffer
+		if(m_Size >= MAX_RECORD_SIZE)
+		{
+			m_Error = true;
+			return false;
+		}
+		m_vBuffer.resize(m_vBuffer.size() * 2);
+	}
+
+	const int Read = gzread(m_File, m_vBuffer.data() + m_Size, m_vBuffer.size() - m_Size);
+	if(Read < 0)
+	{
+		m_Error = true;
+		return false;
+	}
+	if(Read == 0)
+	{
+		// a record cut off at the end is not an error, the file might
+		// still be written
+		m_Eof = true;
+		return false;
+	}
+	m_Size += Read;
+	return true;
+}
+
+int CTeeHistorianReader::ParseRecord(CRecord *pRecord, int StopTick)
+{
+	CRecordParser Parser(m_vBuffer.data() + m_Pos, m_Size - m_Pos);
+
+	int Type = Parser.GetInt();
+	int ClientID = -1;
+	int aValues[NUM_INPUT_INTS] = {0};
+	int Dt = 0;
+	int FlagMask = 0;
+	int NumArgs = 0;
+	const char *pString = nullptr;
+	const unsigned char *pData = nullptr;
+	int DataSize = 0;
+	int ExType = UUID_UNKNOWN;
+	CUuid ExUuid = {};
+
+	if(Type >= 0)
+	{
+		ClientID = Type;
+		Type = RECORD_PLAYER_DIFF;
+	}
+	else
+	{
+		Type = -Type;
+	}
+
+	switch(Type)
+	{
+	case RECORD_PLAYER_DIFF:
+		aValues[0] = Parser.GetInt();
+		aValues[1] = Parser.GetInt();
+		break;
+	case RECORD_FINISH:
+		break;
+	case RECORD_TICK_SKIP:
+		Dt = Parser.GetInt();
+		break;
+	case RECORD_PLAYER_NEW:
+		ClientID = Parser.GetInt();
+		aValues[0] = Parser.GetInt();
+		aValues[1] = Parser.GetInt();
+		break;
+	case RECORD_PLAYER_OLD:
+	case RECORD_JOIN:
+		ClientID = Parser.GetInt();
+		break;
+	case RECORD_INPUT_DIFF:
+	case RECORD_INPUT_NEW:
+		ClientID = Parser.GetInt();
+		for(int &Value : aValues)
+			Value = Parser.GetInt();
+		break;
+	case RECORD_MESSAGE:
+		ClientID = Parser.GetInt();
+		DataSize = Parser.GetInt();
+		if(DataSize < 0 || DataSize > MAX_RECORD_SIZE)
+		{
+			m_Error = true;
+			return RESULT_END;
+		}
+		pData = Parser.GetRaw(DataSize);
+		break;
+	case RECORD_DROP:
+		ClientID = Parser.GetInt();
+		pString = Parser.GetString();
+		break;
+	case RECORD_CONSOLE_COMMAND:
+		ClientID = Parser.GetInt();
+		FlagMask = Parser.GetInt();
+		pString = Parser.GetString();
+		NumArgs = Parser.GetInt();
+		pData = Parser.m_pCurrent;
+		for(int i = 0; i < NumArgs && !Parser.m_Incomplete; i++)
+			Parser.GetString();
+		DataSize = Parser.m_pCurrent - pData;
+		break;
+	case RECORD_EX:
+	{
+		const unsigned char *pUuid = Parser.GetRaw(sizeof(ExUuid));
+		if(pUuid)
+			mem_copy(&ExUuid, pUuid, sizeof(ExUuid));
+		DataSize = Parser.GetInt();
+		if(DataSize < 0 || DataSize > MAX_RECORD_SIZE)
+		{
+			m_Error = true;
+			return RESULT_END;
+		}
+		pData = Parser.GetRaw(DataSize);
+		break;
+	}
+	default:
+		m_Error = true;
+		return RESULT_END;
+	}
+
+	if(Parser.m_Incomplete)
+		return RESULT_INCOMPLETE;
+
+	const bool PlayerRecord = Type == RECORD_PLAYER_DIFF || Type == RECORD_PLAYER_NEW || Type == RECORD_PLAYER_OLD;
+	if((PlayerRecord || Type == RECORD_INPUT_DIFF || Type == RECORD_INPUT_NEW) && (ClientID < 0 || ClientID >= MAX_CLIENTS))
+	{
+		m_Error = true;
+		return RESULT_END;
+	}
+
+	// same rules as CTeeHistorian::EnsureTickWrittenPlayerData
+	int Tick = m_State.m_Tick;
+	int MaxClientID = m_State.m_MaxClientID;
+	if(Type == RECORD_TICK_SKIP)
+	{
+		Tick += Dt + 1;
+		MaxClientID = -1;
+	}
+	else if(PlayerRecord)
+	{
+		if(ClientID <= MaxClientID)
+			Tick++;
+		MaxClientID = ClientID;
+	}
+	if(Tick >= StopTick)
+		return RESULT_STOPPED;
+
+	pRecord->m_Type = Type;
+	pRecord->m_Tick = Tick;
+	pRecord->m_Offset = m_BufferOffset + m_Pos;
+	pRecord->m_ClientID = ClientID;
+	pRecord->m_Dt = Dt;
+	pRecord->m_FlagMask = FlagMask;
+	pRecord->m_NumArgs = NumArgs;
+	pRecord->m_ExUuid = ExUuid;
+	pRecord->m_ExType = ExType;
+	pRecord->m_pString = pString;
+	pRecord->m_pData = pData;
+	pRecord->m_DataSize = DataSize;
+
+	CPlayer *pPlayer = ClientID >= 0 && ClientID < MAX_CLIENTS ? &m_State.m_aPlayers[ClientID] : nullptr;
+	switch(Type)
+	{
+	case RECORD_PLAYER_DIFF:
+		pPlayer->m_X += aValues[0];
+		pPlayer->m_Y += aValues[1];
+		break;
+	case RECORD_PLAYER_NEW:
+		pPlayer->m_Alive = true;
+		pPlayer->m_X = aValues[0];
+		pPlayer->m_Y = aValues[1];
+		break;
+	case RECORD_PLAYER_OLD:
+		pPlayer->m_Alive = false;
+		break;
+	case RECORD_INPUT_DIFF:
+		for(int i = 0; i < NUM_INPUT_INTS; i++)
+			pPlayer->m_aInput[i] += aValues[i];
+		break;
+	case RECORD_INPUT_NEW:
+		pPlayer->m_HasInput = true;
+		mem_copy(pPlayer->m_aInput, aValues, sizeof(aValues));
+		break;
+	case RECORD_FINISH:
+		m_Finished = true;
+		break;
+	case RECORD_EX:
+		pRecord->m_ExType = g_UuidManager.LookupUuid(ExUuid);
+		break;
+	}
+
+	m_Pos = Parser.m_pCurrent - m_vBuffer.data();
+	m_State.m_Offset = m_BufferOffset + m_Pos;
+	m_State.m_Tick = Tick;
+	m_State.m_MaxClientID = MaxClientID;
+	return RESULT_RECORD;
+}
+
+int CTeeHistorianReader::ReadRecord(CRecord *pRecord, int StopTick)
+{
+	if(!m_File || m_Error)
+		return RESULT_END;
+	while(true)
+	{
+		const int Result = ParseRecord(pRecord, StopTick);
+		if(Result != RESULT_INCOMPLETE)
+			return Result;
+		if(!Refill())
+			return RESULT_END;
+	}
+}
+
+bool CTeeHistorianReader::Next(CRecord *pRecord, unsigned TypeMask, int StopTick)
+{
+	while(ReadRecord(pRecord, StopTick) == RESULT_RECORD)
+	{
+		if(TypeMask & RecordMask(pRecord->m_Type))
+			return true;
+	}
+	return false;
+}
+
+bool CTeeHistorianReader::SkipTo(int Tick)
+{
+	CRecord Record;
+	int Result;
+	do
+	{
+		Result = ReadRecord(&Record, Tick);
+	} while(Result == RESULT_RECORD);
+	return Result == RESULT_STOPPED;
+}
+
+bool CTeeHistorianReader::Restore(const CState &State)
+{
+	if(!m_File)
+		return false;
+	if(gzseek(m_File, State.m_Offset, SEEK_SET) != State.m_Offset)
+	{
+		m_Error = true;
+		return false;
+	}
+	m_Error = false;
+	m_Finished = false;
+	m_BufferOffset = State.m_Offset;
+	m_Pos = 0;
+	m_Size = 0;
+	m_Eof = false;
+	m_State = State;
+	return true;
+}
+
+const char *CTeeHistorianReader::RecordName(int Type)
+{
+	if(Type < 0 || Type >= NUM_RECORD_TYPES)
+		return "unknown";
+	return s_apRecordNames[Type];
+}
+
+bool CTeeHistorianReader::ParseRecordMask(const char *pList, unsigned *pMask)
+{
+	*pMask = 0;
+	char aName[32];
+	while((pList = str_next_token(pList, ",", aName, sizeof(aName))))
+	{
+		const char *const *ppFound = std::find_if(std::begin(s_apRecordNames), std::end(s_apRecordNames), [&](const char *pName) {
+			return str_comp(pName, aName) == 0;
+		});
+		if(ppFound == std::end(s_apRecordNames))
+			return false;
+		*pMask |= RecordMask(ppFound - std::begin(s_apRecordNames));
+	}
+	return *pMask != 0;
+}
+
+static int ReadFirstInt(const CTeeHistorianReader::CRecord &Record)
+{
+	CUnpacker Unpacker;
+	Unpacker.Reset(Record.m_pData, Record.m_DataSize);
+	return Unpacker.GetInt();
+}
+
+bool CTeeHistorianIndex::Build(CTeeHistorianReader *pReader, int KeyframeInterval)
+{
+	m_vKeyframes.clear();
+	m_vEvents.clear();
+	m_HeaderSha256 = sha256(pReader->Header(), str_length(pReader->Header()));
+
+	m_vKeyframes.push_back(pReader->State());
+	int NextKeyframe = KeyframeInterval;
+
+	CTeeHistorianReader::CRecord Record;
+	while(pReader->Next(&Record))
+	{
+		int Event = -1;
+		int ID = Record.m_ClientID;
+		if(Record.m_Type == CTeeHistorianReader::RECORD_JOIN)
+			Event = EVENT_JOIN;
+		else if(Record.m_Type == CTeeHistorianReader::RECORD_DROP)
+			Event = EVENT_DROP;
+		else if(Record.m_Type == CTeeHistorianReader::RECORD_EX)
+		{
+			switch(Record.m_ExType)
+			{
+			case TEEHISTORIAN_PLAYER_REJOIN: Event = EVENT_REJOIN; break;
+			case TEEHISTORIAN_SAVE_SUCCESS: Event = EVENT_SAVE_SUCCESS; break;
+			case TEEHISTORIAN_SAVE_FAILURE: Event = EVENT_SAVE_FAILURE; break;
+			case TEEHISTORIAN_LOAD_SUCCESS: Event = EVENT_LOAD_SUCCESS; break;
+			case TEEHISTORIAN_LOAD_FAILURE: Event = EVENT_LOAD_FAILURE; break;
+			}
+			if(Event != -1)
+				ID = ReadFirstInt(Record);
+		}
+		if(Event != -1)
+			m_vEvents.push_back({Event, Record.m_Tick, Record.m_Offset, ID});
+
+		if(Record.m_Tick >= NextKeyframe)
+		{
+			m_vKeyframes.push_back(pReader->State());
+			NextKeyframe = Record.m_Tick + KeyframeInterval;
+		}
+	}
+
+	m_LastTick = pReader->State().m_Tick;
+	m_Size = pReader->State().m_Offset;
+	return !pReader->Error();
+}
+
+bool CTeeHistorianIndex::Seek(CTeeHistorianReader *pReader, int Tick) const
+{
+	if(m_vKeyframes.empty())
+		return false;
+	// the records of the tick of a keyframe can start before it
+	auto Keyframe = std::lower_bound(m_vKeyframes.begin() + 1, m_vKeyframes.end(), Tick, [](const CTeeHistorianReader::CState &State, int Value) {
+		return State.m_Tick < Value;
+	});
+	--Keyframe;
+	return pReader->Restore(*Keyframe) && pReader->SkipTo(Tick);
+}
+
+const char *CTeeHistorianIndex::EventName(int Type)
+{
+	if(Type < 0 || Type >= NUM_EVENTS)
+		return "unknown";
+	return s_apEventNames[Type];
+}
+
+// The index file starts with TEEHISTORIAN_INDEX_UUID followed by variable
+// ints: the version, the SHA256 of the teehistorian header as raw bytes,
+// the last tick, the file size, the keyframes with the present players and
+// the events. Ticks and offsets are stored relative to
+// the previous entry.
+
+namespace {
+class CIndexWriter
+{
+public:
+	void AddInt(int Value)
+	{
+		unsigned char aBuf[CVariableInt::MAX_BYTES_PACKED];
+		unsigned char *pEnd = CVariableInt::Pack(aBuf, Value, sizeof(aBuf));
+		m_vData.insert(m_vData.end(), aBuf, pEnd);
+	}
+	void AddInt64(int64_t Value)
+	{
+		AddInt(Value & 0x7fffffff);
+		AddInt(Value >> 31);
+	}
+
+	std::vector<unsigned char> m_vData;
+};
+
+int64_t GetInt64(CUnpacker *pUnpacker)
+{
+	const int64_t Low = pUnpacker->GetInt();
+	const int64_t High = pUnpacker->GetInt();
+	return Low | (High << 31);
+}
+}
+
+bool CTeeHistorianIndex::Save(const char *pFilename) const
+{
+	CIndexWriter Writer;
+	Writer.AddInt(TEEHISTORIAN_INDEX_VERSION);
+	Writer.m_vData.insert(Writer.m_vData.end(), m_HeaderSha256.data, m_HeaderSha256.data + sizeof(m_HeaderSha256.data));
+	Writer.AddInt(m_LastTick);
+	Writer.AddInt64(m_Size);
+
+	Writer.AddInt(m_vKeyframes.size());
+	int PrevTick = 0;
+	int64_t PrevOffset = 0;
+	for(const auto &Keyframe : m_vKeyframes)
+	{
+		Writer.AddInt(Keyframe.m_Tick - PrevTick);
+		Writer.AddInt64(Keyframe.m_Offset - PrevOffset);
+		Writer.AddInt(Keyframe.m_MaxClientID);
+		PrevTick = Keyframe.m_Tick;
+		PrevOffset = Keyframe.m_Offset;
+
+		int NumPlayers = 0;
+		for(const auto &Player : Keyframe.m_aPlayers)
+			NumPlayers += Player.m_Alive || Player.m_HasInput;
+		Writer.AddInt(NumPlayers);
+		for(int ClientID = 0; ClientID < MAX_CLIENTS; ClientID++)
+		{
+			const CTeeHistorianReader::CPlayer &Player = Keyframe.m_aPlayers[ClientID];
+			if(!Player.m_Alive && !Player.m_HasInput)
+				continue;
+			// the positions of dead players are kept for the next diff
+			Writer.AddInt(ClientID);
+			Writer.AddInt(Player.m_Alive | (Player.m_HasInput << 1));
+			Writer.AddInt(Player.m_X);
+			Writer.AddInt(Player.m_Y);
+			if(Player.m_HasInput)
+			{
+				for(int Value : Player.m_aInput)
+					Writer.AddInt(Value);
+			}
+		}
+	}
+
+	Writer.AddInt(m_vEvents.size());
+	PrevTick = 0;
+	PrevOffset = 0;
+	for(const auto &Event : m_vEvents)
+	{
+		Writer.AddInt(Event.m_Type);
+		Writer.AddInt(Event.m_Tick - PrevTick);
+		Writer.AddInt64(Event.m_Offset - PrevOffset);
+		Writer.AddInt(Event.m_ID);
+		PrevTick = Event.m_Tick;
+		PrevOffset = Event.m_Offset;
+	}
+
+	IOHANDLE File = io_open(pFilename, IOFLAG_WRITE);
+	if(!File)
+		return false;
+	bool Success = io_write(File, &TEEHISTORIAN_INDEX_UUID, sizeof(TEEHISTORIAN_INDEX_UUID)) == sizeof(TEEHISTORIAN_INDEX_UUID);
+	Success &= io_write(File, Writer.m_vData.data(), Writer.m_vData.size()) == Writer.m_vData.size();
+	Success &= io_close(File) == 0;
+	return Success;
+}
+
+bool CTeeHistorianIndex::Load(const char *pFilename, const CTeeHistorianReader &Reader)
+{
+	m_vKeyframes.clear();
+	m_vEvents.clear();
+
+	IOHANDLE File = io_open(pFilename, IOFLAG_READ);
+	if(!File)
+		return false;
+	void *pData;
+	unsigned DataSize;
+	io_read_all(File, &pData, &DataSize);
+	io_close(File);
+
+	if(DataSize < sizeof(TEEHISTORIAN_INDEX_UUID) || mem_comp(pData, &TEEHISTORIAN_INDEX_UUID, sizeof(TEEHISTORIAN_INDEX_UUID)) != 0)
+	{
+		free(pData);
+		return false;
+	}
+
+	CUnpacker Unpacker;
+	Unpacker.Reset((const unsigned char *)pData + sizeof(TEEHISTORIAN_INDEX_UUID), DataSize - sizeof(TEEHISTORIAN_INDEX_UUID));
+	bool Success = Unpacker.GetInt() == TEEHISTORIAN_INDEX_VERSION;
+	// an index of another file would restore garbage states
+	const unsigned char *pHeaderSha256 = Unpacker.GetRaw(sizeof(m_HeaderSha256.data));
+	const SHA256_DIGEST HeaderSha256 = sha256(Reader.Header(), str_length(Reader.Header()));
+	Success &= pHeaderSha256 && mem_comp(pHeaderSha256, HeaderSha256.data, sizeof(HeaderSha256.data)) == 0;
+	m_HeaderSha256 = HeaderSha256;
+	m_LastTick = Unpacker.GetInt();
+	m_Size = GetInt64(&Unpacker);
+
+	const int NumKeyframes = Unpacker.GetInt();
+	int PrevTick = 0;
+	int64_t PrevOffset = 0;
+	for(int i = 0; i < NumKeyframes && Success && !Unpacker.Error(); i++)
+	{
+		CTeeHistorianReader::CState Keyframe;
+		mem_zero(&Keyframe, sizeof(Keyframe));
+		const int TickDiff = Unpacker.GetInt();
+		const int64_t OffsetDiff = GetInt64(&Unpacker);
+		Keyframe.m_Tick = PrevTick + TickDiff;
+		Keyframe.m_Offset = PrevOffset + OffsetDiff;
+		Keyframe.m_MaxClientID = Unpacker.GetInt();
+		PrevTick = Keyframe.m_Tick;
+		PrevOffset = Keyframe.m_Offset;
+		if(TickDiff < 0 || OffsetDiff < 0 || Keyframe.m_Offset > m_Size || Keyframe.m_MaxClientID < -1 || Keyframe.m_MaxClientID > MAX_CLIENTS)
+		{
+			Success = false;
+			break;
+		}
+
+		const int NumPlayers = Unpacker.GetInt();
+		for(int j = 0; j < NumPlayers && !Unpacker.Error(); j++)
+		{
+			const int ClientID = Unpacker.GetInt();
+			if(ClientID < 0 || ClientID >= MAX_CLIENTS)
+			{
+				Success = false;
+				break;
+			}
+			CTeeHistorianReader::CPlayer &Player = Keyframe.m_aPlayers[ClientID];
+			const int Flags = Unpacker.GetInt();
+			Player.m_Alive = Flags & 1;
+			Player.m_HasInput = Flags & 2;
+			Player.m_X = Unpacker.GetInt();
+			Player.m_Y = Unpacker.GetInt();
+			if(Player.m_HasInput)
+			{
+				for(int &Value : Player.m_aInput)
+					Value = Unpacker.GetInt();
+			}
+		}
+		m_vKeyframes.push_back(Keyframe);
+	}
+
+	const int NumEvents = Unpacker.GetInt();
+	PrevTick = 0;
+	PrevOffset = 0;
+	for(int i = 0; i < NumEvents && Success && !Unpacker.Error(); i++)
+	{
+		CEvent Event;
+		Event.m_Type = Unpacker.GetInt();
+		Event.m_Tick = PrevTick + Unpacker.GetInt();
+		Event.m_Offset = PrevOffset + GetInt64(&Unpacker);
+		Event.m_ID = Unpacker.GetInt();
+		PrevTick = Event.m_Tick;
+		PrevOffset = Event.m_Offset;
+		m_vEvents.push_back(Event);
+	}
+	free(pData);
+
+	Success &= !Unpacker.Error() && !m_vKeyframes.empty() && m_vKeyframes[0].m_Offset > 0;
+	if(!Success)
+	{
+		m_vKeyframes.clear();
+		m_vEvents.clear();
+	}
+	return Success;
+}
@@ -0,0 +1,203 @@
+#ifndef ENGINE_SHARED_TEEHISTORIAN_READER_H
+#define ENGINE_SHARED_TEEHISTORIAN_READER_H
+
+#include <base/hash.h>
+#include <engine/shared/protocol.h>
+#include <engine/shared/uuid_manager.h>
+
+#include <climits>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Reads the records of a teehistorian file, plain or gzip compressed.
+//
+// The positions and inputs, which are stored as differences, are resolved
+// into State(). The state can be copied and restored later to continue
+// reading at the same position, see CTeeHistorianIndex.
+class CTeeHistorianReader
+{
+public:
+	enum
+	{
+		// same values as in the file
+		RECORD_PLAYER_DIFF = 0,
+		RECORD_FINISH,
+		RECORD_TICK_SKIP,
+		RECORD_PLAYER_NEW,
+		RECORD_PLAYER_OLD,
+		RECORD_INPUT_DIFF,
+		RECORD_INPUT_NEW,
+		RECORD_MESSAGE,
+		RECORD_JOIN,
+		RECORD_DROP,
+		RECORD_CONSOLE_COMMAND,
+		RECORD_EX,
+		NUM_RECORD_TYPES,
+
+		ALL_RECORDS = (1 << NUM_RECORD_TYPES) - 1,
+
+		// sizeof(CNetObj_PlayerInput) / sizeof(int32_t)
+		NUM_INPUT_INTS = 10,
+	};
+
+	struct CPlayer
+	{
+		bool m_Alive;
+		int m_X;
+		int m_Y;
+		bool m_HasInput;
+		int m_aInput[NUM_INPUT_INTS];
+	};
+
+	// everything needed to decode the records following m_Offset
+	struct CState
+	{
+		// offset of the next record in the uncompressed file
+		int64_t m_Offset;
+		int m_Tick;
+		int m_MaxClientID;
+		CPlayer m_aPlayers[MAX_CLIENTS];
+	};
+
+	struct CRecord
+	{
+		int m_Type;
+		int m_Tick;
+		// offset in the uncompressed file
+		int64_t m_Offset;
+		// -1 for records without client id
+		int m_ClientID;
+
+		// RECORD_TICK_SKIP
+		int m_Dt;
+		// RECORD_CONSOLE_COMMAND
+		int m_FlagMask;
+		int m_NumArgs;
+		// RECORD_EX
+		CUuid m_ExUuid;
+		// id registered in g_UuidManager or UUID_UNKNOWN
+		int m_ExType;
+
+		// RECORD_DROP: reason, RECORD_CONSOLE_COMMAND: command
+		const char *m_pString;
+		// RECORD_MESSAGE and RECORD_EX: payload,
+		// RECORD_CONSOLE_COMMAND: null terminated arguments
+		const unsigned char *m_pData;
+		int m_DataSize;
+	};
+
+	CTeeHistorianReader();
+	~CTeeHistorianReader();
+
+	bool Open(const char *pFilename);
+	void Close();
+
+	// JSON header of the file
+	const char *Header() const { return m_Header.c_str(); }
+	// reads the next record of one of the types in TypeMask, the data
+	// pointers of the record stay valid until the next call. Returns false
+	// without reading further at the first record of StopTick or later.
+	bool Next(CRecord *pRecord, unsigned TypeMask = ALL_RECORDS, int StopTick = INT_MAX);
+	// skips the records before Tick, returns false if the file ends before
+	bool SkipTo(int Tick);
+	// continues reading at a state saved before
+	bool Restore(const CState &State);
+
+	const CState &State() const { return m_State; }
+	bool Error() const { return m_Error; }
+	bool Finished() const { return m_Finished; }
+
+	static unsigned RecordMask(int Type) { return 1u << Type; }
+	static const char *RecordName(int Type);
+	// parses a comma separated list of record names, returns false on
+	// unknown names
+	static bool ParseRecordMask(const char *pList, unsigned *pMask);
+
+private:
+	enum
+	{
+		RESULT_RECORD,
+		RESULT_INCOMPLETE,
+		RESULT_STOPPED,
+		RESULT_END,
+
+		BUFFER_SIZE = 128 * 1024,
+		MAX_RECORD_SIZE = 64 * 1024 * 1024,
+	};
+
+	int ReadRecord(CRecord *pRecord, int StopTick);
+	int ParseRecord(CRecord *pRecord, int StopTick);
+	bool Refill();
+
+	struct gzFile_s *m_File;
+	std::string m_Header;
+	bool m_Error;
+	bool m_Finished;
+
+	std::vector<unsigned char> m_vBuffer;
+	// offset of the start of the buffer in the uncompressed file
+	int64_t m_BufferOffset;
+	int m_Pos;
+	int m_Size;
+	bool m_Eof;
+
+	CState m_State;
+};
+
+// Sidecar index of a teehistorian file with the reader state every few
+// ticks, so that reading can start at any tick, and the joins, leaves,
+// saves and loads.
+class CTeeHistorianIndex
+{
+public:
+	enum
+	{
+		EVENT_JOIN,
+		EVENT_DROP,
+		EVENT_REJOIN,
+		EVENT_SAVE_SUCCESS,
+		EVENT_SAVE_FAILURE,
+		EVENT_LOAD_SUCCESS,
+		EVENT_LOAD_FAILURE,
+		NUM_EVENTS,
+
+		DEFAULT_KEYFRAME_INTERVAL = 500,
+	};
+
+	struct CEvent
+	{
+		int m_Type;
+		int m_Tick;
+		int64_t m_Offset;
+		// client id or team
+		int m_ID;
+	};
+
+	// reads the rest of the file, the reader must be freshly opened
+	bool Build(CTeeHistorianReader *pReader, int KeyframeInterval = DEFAULT_KEYFRAME_INTERVAL);
+	bool Save(const char *pFilename) const;
+	// fails for indices of other files than the one opened by the reader
+	bool Load(const char *pFilename, const CTeeHistorianReader &Reader);
+
+	// the next record of the reader will be the first one of Tick or later
+	bool Seek(CTeeHistorianReader *pReader, int Tick) const;
+
+	const std::vector<CEvent> &Events() const { return m_vEvents; }
+	int NumKeyframes() const { return m_vKeyframes.size(); }
+	int LastTick() const { return m_LastTick; }
+	int64_t Size() const { return m_Size; }
+
+	static const char *EventName(int Type);
+
+private:
+	std::vector<CTeeHistorianReader::CState> m_vKeyframes;
+	std::vector<CEvent> m_vEvents;
+	// identifies the file, the header contains the game uuid and start time
+	SHA256_DIGEST m_HeaderSha256 = {};
+	int m_LastTick = 0;
+	// size of the uncompressed file
+	int64_t m_Size = 0;
+};
+
+#endif // ENGINE_SHARED_TEEHISTORIAN_READER_H
@@ -71,7 +71,7 @@ void CBackground::LoadBackground()
 				m_Loaded = true;
 			}
 		}
-		else if(m_pMap->Load(aBuf))
+		else if(m_pMap->Load(aBuf, g_Config.m_DatafileMmap))
 		{
 			m_pLayers->InitBackground(m_pMap);
 			NeedImageLoading = true;
@@ -67,6 +67,9 @@ void CDebugHud::RenderNetCorrections()
 	str_from_int(m_pClient->m_Snap.m_pLocalCharacter->m_Angle, aBuf);
 	RenderRow("Angle:", aBuf);
 
+	str_format(aBuf, sizeof(aBuf), "%.1f us", m_pClient->m_PredictionCopyTime * 1000000.0 / time_freq());
+	RenderRow("World copy:", aBuf);
+
 	str_from_int(m_pClient->NetobjNumCorrections(), aBuf);
 	RenderRow("Netobj corrections", aBuf);
 	RenderRow(" on:", m_pClient->NetobjCorrectedOn());
@@ -159,24 +159,25 @@ void CRaceDemo::OnMapLoad()
 
 void CRaceDemo::StopRecord(int Time)
 {
-	if(Client()->RaceRecord_IsRecording())
-		Client()->RaceRecord_Stop();
-
 	if(m_aTmpFilename[0] != '\0')
 	{
+		// save file, no new record otherwise
+		char aNewFilename[512] = "";
 		if(Time > 0 && CheckDemo(Time))
-		{
-			// save file
-			char aNewFilename[512];
 			GetPath(aNewFilename, sizeof(aNewFilename), m_Time);
 
+		// the recorder renames or removes the file once it's written
+		if(Client()->RaceRecord_IsRecording())
+			Client()->RaceRecord_Stop(aNewFilename, aNewFilename[0] == '\0');
+		else if(aNewFilename[0] != '\0')
 			Storage()->RenameFile(m_aTmpFilename, aNewFilename, IStorage::TYPE_SAVE);
-		}
-		else // no new record
+		else
 			Storage()->RemoveFile(m_aTmpFilename, IStorage::TYPE_SAVE);
 
 		m_aTmpFilename[0] = '\0';
 	}
+	else if(Client()->RaceRecord_IsRecording())
+		Client()->RaceRecord_Stop();
 
 	m_Time = 0;
 	m_RaceState = RACE_NONE;
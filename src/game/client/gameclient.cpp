@@ -529,6 +529,7 @@ void CGameClient::OnConnected()
 
 	m_GameWorld.Clear();
 	m_GameWorld.m_WorldConfig.m_InfiniteAmmo = true;
+	InvalidatePrediction();
 	mem_zero(&m_GameInfo, sizeof(m_GameInfo));
 	m_PredictedDummyID = -1;
 	Console()->ResetGameSettings();
@@ -553,6 +554,7 @@ void CGameClient::OnReset()
 	m_aReceivedTuning[1] = false;
 
 	InvalidateSnapshot();
+	InvalidatePrediction();
 
 	for(auto &Client : m_aClients)
 		Client.Reset();
@@ -908,6 +910,7 @@ void CGameClient::OnMessage(int MsgId, CUnpacker *pUnpacker, int Conn, bool Dumm
 			if(CCharacter *pChar = m_GameWorld.GetCharacterByID(pMsg->m_Victim))
 				pChar->ResetPrediction();
 			m_GameWorld.ReleaseHooked(pMsg->m_Victim);
+			InvalidatePrediction();
 		}
 
 		// if we are spectating a static id set (team 0) and somebody killed, and its not a guy in solo, we remove him from the list
@@ -1297,6 +1300,7 @@ void CGameClient::OnNewSnapshot()
 	};
 
 	InvalidateSnapshot();
+	InvalidatePrediction();
 
 	m_NewTick = true;
 
@@ -1928,21 +1932,30 @@ void CGameClient::OnPredict()
 
 	// init
 	bool Dummy = g_Config.m_ClDummy ^ m_IsDummySwapping;
-	m_PredictedWorld.CopyWorld(&m_GameWorld);
+	int PredictedTick = ReusablePredictionTick(Dummy);
+	InvalidatePrediction();
+	int64_t CopyTime = 0;
+	if(PredictedTick < 0)
+	{
+		const int64_t CopyStart = time_get();
+		m_PredictedWorld.CopyWorld(&m_GameWorld);
+		CopyTime += time_get() - CopyStart;
+		PredictedTick = Client()->GameTick(g_Config.m_ClDummy);
 
-	// don't predict inactive players, or entities from other teams
-	for(int i = 0; i < MAX_CLIENTS; i++)
-		if(CCharacter *pChar = m_PredictedWorld.GetCharacterByID(i))
-			if((!m_Snap.m_aCharacters[i].m_Active && pChar->m_SnapTicks > 10) || IsOtherTeam(i))
-				pChar->Destroy();
+		// don't predict inactive players, or entities from other teams
+		for(int i = 0; i < MAX_CLIENTS; i++)
+			if(CCharacter *pChar = m_PredictedWorld.GetCharacterByID(i))
+				if((!m_Snap.m_aCharacters[i].m_Active && pChar->m_SnapTicks > 10) || IsOtherTeam(i))
+					pChar->Destroy();
 
-	CProjectile *pProjNext = 0;
-	for(CProjectile *pProj = (CProjectile *)m_PredictedWorld.FindFirst(CGameWorld::ENTTYPE_PROJECTILE); pProj; pProj = pProjNext)
-	{
-		pProjNext = (CProjectile *)pProj->TypeNext();
-		if(IsOtherTeam(pProj->GetOwner()))
+		CProjectile *pProjNext = 0;
+		for(CProjectile *pProj = (CProjectile *)m_PredictedWorld.FindFirst(CGameWorld::ENTTYPE_PROJECTILE); pProj; pProj = pProjNext)
 		{
-			pProj->Destroy();
+			pProjNext = (CProjectile *)pProj->TypeNext();
+			if(IsOtherTeam(pProj->GetOwner()))
+			{
+				pProj->Destroy();
+			}
 		}
 	}
 
@@ -1953,13 +1966,21 @@ void CGameClient::OnPredict()
 	if(PredictDummy())
 		pDummyChar = m_PredictedWorld.GetCharacterByID(m_PredictedDummyID);
 
+	m_PredictionCache.m_BaseTick = Client()->GameTick(g_Config.m_ClDummy);
+	m_PredictionCache.m_Dummy = Dummy;
+	m_PredictionCache.m_DummySwapping = m_IsDummySwapping;
+	m_PredictionCache.m_LocalID = m_Snap.m_LocalClientID;
+	m_PredictionCache.m_DummyID = pDummyChar ? pDummyChar->GetCID() : -1;
+
 	// predict
-	for(int Tick = Client()->GameTick(g_Config.m_ClDummy) + 1; Tick <= Client()->PredGameTick(g_Config.m_ClDummy); Tick++)
+	for(int Tick = PredictedTick + 1; Tick <= Client()->PredGameTick(g_Config.m_ClDummy); Tick++)
 	{
 		// fetch the previous characters
 		if(Tick == Client()->PredGameTick(g_Config.m_ClDummy))
 		{
+			const int64_t CopyStart = time_get();
 			m_PrevPredictedWorld.CopyWorld(&m_PredictedWorld);
+			CopyTime += time_get() - CopyStart;
 			m_PredictedPrevChar = pLocalChar->GetCore();
 			for(int i = 0; i < MAX_CLIENTS; i++)
 				if(CCharacter *pChar = m_PredictedWorld.GetCharacterByID(i))
@@ -1988,6 +2009,15 @@ void CGameClient::OnPredict()
 			pDummyChar->OnPredictedInput(pDummyInputData);
 		m_PredictedWorld.Tick();
 
+		CPredictionInput &Input = m_PredictionCache.m_aInputs[Tick % std::size(m_PredictionCache.m_aInputs)];
+		Input.m_Tick = Tick;
+		Input.m_HasInput = pInputData;
+		Input.m_HasDummyInput = pDummyInputData;
+		if(pInputData)
+			Input.m_Input = *pInputData;
+		if(pDummyInputData)
+			Input.m_DummyInput = *pDummyInputData;
+
 		// fetch the current characters
 		if(Tick == Client()->PredGameTick(g_Config.m_ClDummy))
 		{
@@ -2037,6 +2067,12 @@ void CGameClient::OnPredict()
 		}
 	}
 
+	m_PredictionCopyTime = CopyTime;
+
+	// the last ticks of cl_predict_freeze 2 depend on the tick predicted to, they can't be reused
+	if(g_Config.m_ClPredictFreeze != 2 && Client()->PredGameTick(g_Config.m_ClDummy) - m_PredictionCache.m_BaseTick < (int)std::size(m_PredictionCache.m_aInputs))
+		m_PredictionCache.m_Tick = Client()->PredGameTick(g_Config.m_ClDummy);
+
 	// detect mispredictions of other players and make corrections smoother when possible
 	if(g_Config.m_ClAntiPingSmooth && Predict() && AntiPingPlayers() && m_NewTick && absolute(m_PredictedTick - Client()->PredGameTick(g_Config.m_ClDummy)) <= 1 && absolute(Client()->GameTick(g_Config.m_ClDummy) - Client()->PrevGameTick(g_Config.m_ClDummy)) <= 2)
 	{
@@ -2132,6 +2168,40 @@ void CGameClient::OnPredict()
 		m_Ghost.OnNewPredictedSnapshot();
 }
 
+static bool SamePredictionInput(bool HasStored, const CNetObj_PlayerInput &Stored, const int *pInput)
+{
+	if(HasStored != (pInput != nullptr))
+		return false;
+	return !pInput || mem_comp(&Stored, pInput, sizeof(Stored)) == 0;
+}
+
+int CGameClient::ReusablePredictionTick(bool Dummy)
+{
+	const CPredictionCache &Cache = m_PredictionCache;
+	const int PredTick = Client()->PredGameTick(g_Config.m_ClDummy);
+	if(Cache.m_Tick < 0 || Cache.m_Tick >= PredTick || Cache.m_BaseTick != Client()->GameTick(g_Config.m_ClDummy))
+		return -1;
+	if(Cache.m_Dummy != Dummy || Cache.m_DummySwapping != m_IsDummySwapping || Cache.m_LocalID != m_Snap.m_LocalClientID)
+		return -1;
+	if(!m_PredictedWorld.m_IsValidCopy || m_GameWorld.m_pChild != &m_PredictedWorld)
+		return -1;
+
+	CCharacter *pDummyChar = PredictDummy() ? m_PredictedWorld.GetCharacterByID(m_PredictedDummyID) : 0;
+	if(!m_PredictedWorld.GetCharacterByID(m_Snap.m_LocalClientID) || (pDummyChar ? pDummyChar->GetCID() : -1) != Cache.m_DummyID)
+		return -1;
+
+	// the inputs of the predicted ticks must not have changed since
+	for(int Tick = Cache.m_BaseTick + 1; Tick <= Cache.m_Tick; Tick++)
+	{
+		const CPredictionInput &Input = Cache.m_aInputs[Tick % std::size(Cache.m_aInputs)];
+		if(Input.m_Tick != Tick || !SamePredictionInput(Input.m_HasInput, Input.m_Input, Client()->GetInput(Tick, m_IsDummySwapping)))
+			return -1;
+		if(!SamePredictionInput(Input.m_HasDummyInput, Input.m_DummyInput, pDummyChar ? Client()->GetInput(Tick, m_IsDummySwapping ^ 1) : nullptr))
+			return -1;
+	}
+	return Cache.m_Tick;
+}
+
 void CGameClient::OnActivateEditor()
 {
 	OnRelease();
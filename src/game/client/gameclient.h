@@ -537,6 +537,8 @@ public:
 	CGameWorld m_GameWorld;
 	CGameWorld m_PredictedWorld;
 	CGameWorld m_PrevPredictedWorld;
+	// time spent copying worlds in the last prediction
+	int64_t m_PredictionCopyTime = 0;
 
 	std::vector<SSwitchers> &Switchers() { return m_GameWorld.m_Core.m_vSwitchers; }
 	std::vector<SSwitchers> &PredSwitchers() { return m_PredictedWorld.m_Core.m_vSwitchers; }
@@ -745,6 +747,31 @@ private:
 
 	int m_PredictedDummyID;
 	int m_IsDummySwapping;
+
+	// m_PredictedWorld is kept between calls to OnPredict and only advanced by
+	// the new ticks, as long as neither the confirmed world nor the inputs of
+	// the ticks predicted so far changed
+	struct CPredictionInput
+	{
+		int m_Tick;
+		bool m_HasInput;
+		bool m_HasDummyInput;
+		CNetObj_PlayerInput m_Input;
+		CNetObj_PlayerInput m_DummyInput;
+	};
+	struct CPredictionCache
+	{
+		int m_Tick = -1;
+		int m_BaseTick;
+		bool m_Dummy;
+		int m_DummySwapping;
+		int m_LocalID;
+		int m_DummyID;
+		CPredictionInput m_aInputs[200];
+	};
+	CPredictionCache m_PredictionCache;
+	void InvalidatePrediction() { m_PredictionCache.m_Tick = -1; }
+	int ReusablePredictionTick(bool Dummy);
 	CCharOrder m_CharOrder;
 	int m_aSwitchStateTeam[NUM_DUMMIES];
 
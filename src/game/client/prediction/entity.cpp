@@ -5,6 +5,89 @@
 
 #include <game/collision.h>
 
+namespace {
+// only used from the thread running the prediction
+class CEntityPool
+{
+	enum
+	{
+		GRANULARITY = 16,
+		NUM_SIZE_CLASSES = 256,
+		BLOCKS_PER_SLAB = 32,
+	};
+
+	struct CFreeBlock
+	{
+		CFreeBlock *m_pNext;
+	};
+
+	// slabs are never returned to the heap, the pool stays as large as the largest world
+	CFreeBlock *m_apFree[NUM_SIZE_CLASSES];
+
+	static size_t SizeClass(size_t Size) { return (Size + GRANULARITY - 1) / GRANULARITY; }
+
+public:
+	void *Allocate(size_t Size)
+	{
+		const size_t Class = SizeClass(Size);
+		if(Class >= NUM_SIZE_CLASSES)
+		{
+			void *pPtr = malloc(Size);
+			mem_zero(pPtr, Size);
+			return pPtr;
+		}
+
+		const size_t BlockSize = Class * GRANULARITY;
+		if(!m_apFree[Class])
+		{
+			char *pSlab = (char *)malloc(BlockSize * BLOCKS_PER_SLAB);
+			for(int i = BLOCKS_PER_SLAB - 1; i >= 0; i--)
+			{
+				CFreeBlock *pBlock = (CFreeBlock *)(pSlab + i * BlockSize);
+				pBlock->m_pNext = m_apFree[Class];
+				m_apFree[Class] = pBlock;
+				ASAN_POISON_MEMORY_REGION(pBlock, BlockSize);
+			}
+		}
+
+		CFreeBlock *pBlock = m_apFree[Class];
+		ASAN_UNPOISON_MEMORY_REGION(pBlock, BlockSize);
+		m_apFree[Class] = pBlock->m_pNext;
+		mem_zero(pBlock, BlockSize);
+		return pBlock;
+	}
+
+	void Free(void *pPtr, size_t Size)
+	{
+		if(!pPtr)
+			return;
+		const size_t Class = SizeClass(Size);
+		if(Class >= NUM_SIZE_CLASSES)
+		{
+			free(pPtr);
+			return;
+		}
+
+		CFreeBlock *pBlock = (CFreeBlock *)pPtr;
+		pBlock->m_pNext = m_apFree[Class];
+		m_apFree[Class] = pBlock;
+		ASAN_POISON_MEMORY_REGION(pBlock, Class * GRANULARITY);
+	}
+};
+
+CEntityPool gs_EntityPool;
+}
+
+void *CEntity::operator new(size_t Size)
+{
+	return gs_EntityPool.Allocate(Size);
+}
+
+void CEntity::operator delete(void *pPtr, size_t Size)
+{
+	gs_EntityPool.Free(pPtr, Size);
+}
+
 //////////////////////////////////////////////////
 // Entity
 //////////////////////////////////////////////////
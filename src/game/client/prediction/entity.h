@@ -11,12 +11,17 @@
 
 class CEntity
 {
-	MACRO_ALLOC_HEAP()
+public:
+	// the prediction copies all entities every tick, so their memory is
+	// recycled through per-size free lists instead of the heap
+	void *operator new(size_t Size);
+	void operator delete(void *pPtr, size_t Size);
 
 private:
 	friend CGameWorld; // entity list handling
 	CEntity *m_pPrevTypeEntity;
 	CEntity *m_pNextTypeEntity;
+	CEntityGrid<CEntity>::CLink m_GridLink;
 
 protected:
 	CGameWorld *m_pGameWorld;
@@ -57,13 +57,51 @@ CEntity *CGameWorld::FindLast(int Type)
 	return pLast;
 }
 
+void CGameWorld::UpdateGrid(CEntity *pEnt)
+{
+	m_aGrids[pEnt->m_ObjType].Move(&pEnt->m_GridLink, pEnt->m_Pos, pEnt->m_ProximityRadius);
+}
+
+void CGameWorld::UpdateGrid(int Type)
+{
+	for(CEntity *pEnt = m_apFirstEntityTypes[Type]; pEnt; pEnt = pEnt->m_pNextTypeEntity)
+		UpdateGrid(pEnt);
+}
+
+void CGameWorld::OnEntityTicked()
+{
+	// the entity might have been removed from the world while ticking
+	if(m_pTickingEntity)
+		UpdateGrid(m_pTickingEntity);
+	m_pTickingEntity = nullptr;
+}
+
+void CGameWorld::QueryGrid(int Type, vec2 From, vec2 To, float Margin)
+{
+	// outside of the world tick positions are changed by the snapshots
+	if(!m_InTick)
+		UpdateGrid(Type);
+	else if(m_pTickingEntity)
+		UpdateGrid(m_pTickingEntity);
+
+	if(m_aGrids[Type].Query(From, To, Margin, m_vpGridCandidates))
+		return;
+
+	// the area is too large for the grid, everything is a candidate
+	m_vpGridCandidates.clear();
+	for(CEntity *pEnt = m_apFirstEntityTypes[Type]; pEnt; pEnt = pEnt->m_pNextTypeEntity)
+		m_vpGridCandidates.push_back(pEnt);
+}
+
 int CGameWorld::FindEntities(vec2 Pos, float Radius, CEntity **ppEnts, int Max, int Type)
 {
 	if(Type < 0 || Type >= NUM_ENTTYPES)
 		return 0;
 
+	QueryGrid(Type, Pos, Pos, Radius);
+
 	int Num = 0;
-	for(CEntity *pEnt = m_apFirstEntityTypes[Type]; pEnt; pEnt = pEnt->m_pNextTypeEntity)
+	for(CEntity *pEnt : m_vpGridCandidates)
 	{
 		if(distance(pEnt->m_Pos, Pos) < Radius + pEnt->m_ProximityRadius)
 		{
@@ -108,6 +146,7 @@ void CGameWorld::InsertEntity(CEntity *pEnt, bool Last)
 		pEnt->m_pPrevTypeEntity = pLast;
 		pEnt->m_pNextTypeEntity = 0x0;
 	}
+	m_aGrids[pEnt->m_ObjType].Insert(pEnt, &pEnt->m_GridLink, pEnt->m_Pos, pEnt->m_ProximityRadius, Last);
 
 	if(pEnt->m_ObjType == ENTTYPE_CHARACTER)
 	{
@@ -139,10 +178,14 @@ void CGameWorld::RemoveEntity(CEntity *pEnt)
 	// keep list traversing valid
 	if(m_pNextTraverseEntity == pEnt)
 		m_pNextTraverseEntity = pEnt->m_pNextTypeEntity;
+	if(m_pTickingEntity == pEnt)
+		m_pTickingEntity = nullptr;
 
 	pEnt->m_pNextTypeEntity = 0;
 	pEnt->m_pPrevTypeEntity = 0;
 
+	m_aGrids[pEnt->m_ObjType].Remove(&pEnt->m_GridLink);
+
 	if(pEnt->m_pParent)
 	{
 		if(m_IsValidCopy && m_pParent && m_pParent->m_pChild == this)
@@ -184,6 +227,10 @@ void CGameWorld::RemoveEntities()
 
 void CGameWorld::Tick()
 {
+	for(int i = 0; i < NUM_ENTTYPES; i++)
+		UpdateGrid(i);
+	m_InTick = true;
+
 	// update all objects
 	for(int i = 0; i < NUM_ENTTYPES; i++)
 	{
@@ -195,7 +242,9 @@ void CGameWorld::Tick()
 			for(; pEnt;)
 			{
 				m_pNextTraverseEntity = pEnt->m_pNextTypeEntity;
+				m_pTickingEntity = pEnt;
 				((CCharacter *)pEnt)->PreTick();
+				OnEntityTicked();
 				pEnt = m_pNextTraverseEntity;
 			}
 		}
@@ -204,7 +253,9 @@ void CGameWorld::Tick()
 		for(; pEnt;)
 		{
 			m_pNextTraverseEntity = pEnt->m_pNextTypeEntity;
+			m_pTickingEntity = pEnt;
 			pEnt->Tick();
+			OnEntityTicked();
 			pEnt = m_pNextTraverseEntity;
 		}
 	}
@@ -213,11 +264,15 @@ void CGameWorld::Tick()
 		for(; pEnt;)
 		{
 			m_pNextTraverseEntity = pEnt->m_pNextTypeEntity;
+			m_pTickingEntity = pEnt;
 			pEnt->TickDeferred();
+			OnEntityTicked();
 			pEnt->m_SnapTicks++;
 			pEnt = m_pNextTraverseEntity;
 		}
 
+	m_InTick = false;
+
 	RemoveEntities();
 
 	// update switch state
@@ -250,9 +305,10 @@ CCharacter *CGameWorld::IntersectCharacter(vec2 Pos0, vec2 Pos1, float Radius, v
 	float ClosestLen = distance(Pos0, Pos1) * 100.0f;
 	CCharacter *pClosest = 0;
 
-	CCharacter *p = (CCharacter *)FindFirst(ENTTYPE_CHARACTER);
-	for(; p; p = (CCharacter *)p->TypeNext())
+	QueryGrid(ENTTYPE_CHARACTER, Pos0, Pos1, Radius);
+	for(CEntity *pEnt : m_vpGridCandidates)
 	{
+		CCharacter *p = (CCharacter *)pEnt;
 		if(p == pNotThis)
 			continue;
 
@@ -285,9 +341,10 @@ CCharacter *CGameWorld::IntersectCharacter(vec2 Pos0, vec2 Pos1, float Radius, v
 std::vector<CCharacter *> CGameWorld::IntersectedCharacters(vec2 Pos0, vec2 Pos1, float Radius, const CEntity *pNotThis)
 {
 	std::vector<CCharacter *> vpCharacters;
-	CCharacter *pChr = (CCharacter *)FindFirst(CGameWorld::ENTTYPE_CHARACTER);
-	for(; pChr; pChr = (CCharacter *)pChr->TypeNext())
+	QueryGrid(ENTTYPE_CHARACTER, Pos0, Pos1, Radius);
+	for(CEntity *pEnt : m_vpGridCandidates)
 	{
+		CCharacter *pChr = (CCharacter *)pEnt;
 		if(pChr == pNotThis)
 			continue;
 
@@ -3,6 +3,7 @@
 #ifndef GAME_CLIENT_PREDICTION_GAMEWORLD_H
 #define GAME_CLIENT_PREDICTION_GAMEWORLD_H
 
+#include <game/entity_grid.h>
 #include <game/gamecore.h>
 #include <game/teamscore.h>
 
@@ -110,6 +111,19 @@ private:
 	CEntity *m_pNextTraverseEntity = nullptr;
 	CEntity *m_apFirstEntityTypes[NUM_ENTTYPES];
 
+	// the grids are kept up to date after every entity callback, the
+	// entity that is currently ticking is also updated before queries
+	CEntityGrid<CEntity> m_aGrids[NUM_ENTTYPES];
+	CEntity *m_pTickingEntity = nullptr;
+	bool m_InTick = false;
+	std::vector<CEntity *> m_vpGridCandidates;
+
+	void UpdateGrid(CEntity *pEnt);
+	void UpdateGrid(int Type);
+	void OnEntityTicked();
+	// fills m_vpGridCandidates in list order
+	void QueryGrid(int Type, vec2 From, vec2 To, float Margin);
+
 	CCharacter *m_apCharacters[MAX_CLIENTS];
 };
 
@@ -36,6 +36,90 @@ vec2 ClampVel(int MoveRestriction, vec2 Vel)
 	return Vel;
 }
 
+namespace {
+/*
+	Class: CLineTileWalker
+		Visits the samples mix(Pos0, Pos1, i / Divisor) of a line tile by
+		tile. The tile of a sample is monotonic in i on both axes, so all
+		samples in one tile are consecutive and only the first one of each
+		tile has to be looked at. The next tile boundary is estimated from
+		the line and then corrected against the exact sample positions,
+		which makes the visited samples the same ones at which a loop over
+		every sample would first see a new tile.
+*/
+class CLineTileWalker
+{
+public:
+	CLineTileWalker(vec2 Pos0, vec2 Pos1, float Divisor, int NumSamples, int Width, int Height, bool Round, int OffsetX = 0, int OffsetY = 0) :
+		m_Pos0(Pos0), m_Pos1(Pos1), m_Divisor(Divisor), m_NumSamples(NumSamples), m_MaxX(maximum(Width - 1, 0)), m_MaxY(maximum(Height - 1, 0)), m_Round(Round), m_OffsetX(OffsetX), m_OffsetY(OffsetY)
+	{
+	}
+
+	vec2 Sample(int i) const { return mix(m_Pos0, m_Pos1, i / m_Divisor); }
+	vec2 Before(int i) const { return i > 0 ? Sample(i - 1) : m_Pos0; }
+
+	// returns the first sample after i that is in another tile, or the number of samples
+	int Next(int i) const
+	{
+		const CKey Current = Key(i);
+		const vec2 Dir = m_Pos1 - m_Pos0;
+		const float Bias = m_Round ? 0.5f : 0.0f;
+		float Time = -1.0f;
+		if(Dir.x > 0.0f && Current.m_X < m_MaxX)
+			Time = ((Current.m_X + 1) * 32 - Bias - m_Pos0.x) / Dir.x;
+		else if(Dir.x < 0.0f && Current.m_X > 0)
+			Time = (Current.m_X * 32 - Bias - m_Pos0.x) / Dir.x;
+		if(Dir.y > 0.0f && Current.m_Y < m_MaxY)
+			Time = MinTime(Time, ((Current.m_Y + 1) * 32 - Bias - m_Pos0.y) / Dir.y);
+		else if(Dir.y < 0.0f && Current.m_Y > 0)
+			Time = MinTime(Time, (Current.m_Y * 32 - Bias - m_Pos0.y) / Dir.y);
+
+		int Next = m_NumSamples;
+		const double Estimate = std::ceil((double)Time * m_Divisor);
+		if(Time >= 0.0f && Estimate < m_NumSamples)
+			Next = maximum((int)Estimate, i + 1);
+
+		while(Next > i + 1 && Key(Next - 1) != Current)
+			Next--;
+		while(Next < m_NumSamples && Key(Next) == Current)
+			Next++;
+		return Next;
+	}
+
+private:
+	struct CKey
+	{
+		int m_X;
+		int m_Y;
+		int m_OffsetX;
+		int m_OffsetY;
+
+		bool operator==(const CKey &Other) const { return m_X == Other.m_X && m_Y == Other.m_Y && m_OffsetX == Other.m_OffsetX && m_OffsetY == Other.m_OffsetY; }
+		bool operator!=(const CKey &Other) const { return !(*this == Other); }
+	};
+
+	vec2 m_Pos0;
+	vec2 m_Pos1;
+	float m_Divisor;
+	int m_NumSamples;
+	int m_MaxX;
+	int m_MaxY;
+	bool m_Round;
+	int m_OffsetX;
+	int m_OffsetY;
+
+	static float MinTime(float Time, float Other) { return Time < 0.0f ? Other : minimum(Time, Other); }
+
+	CKey Key(int i) const
+	{
+		const vec2 Pos = Sample(i);
+		const int x = m_Round ? round_to_int(Pos.x) : (int)Pos.x;
+		const int y = m_Round ? round_to_int(Pos.y) : (int)Pos.y;
+		return {clamp(x / 32, 0, m_MaxX), clamp(y / 32, 0, m_MaxY), clamp((x + m_OffsetX) / 32, 0, m_MaxX), clamp((y + m_OffsetY) / 32, 0, m_MaxY)};
+	}
+};
+}
+
 CCollision::CCollision()
 {
 	m_pTiles = 0;
@@ -288,16 +372,14 @@ int CCollision::GetTile(int x, int y) const
 	return 0;
 }
 
-// TODO: rewrite this smarter!
 int CCollision::IntersectLine(vec2 Pos0, vec2 Pos1, vec2 *pOutCollision, vec2 *pOutBeforeCollision) const
 {
 	float Distance = distance(Pos0, Pos1);
 	int End(Distance + 1);
-	vec2 Last = Pos0;
-	for(int i = 0; i <= End; i++)
+	const CLineTileWalker Walker(Pos0, Pos1, End, End + 1, m_Width, m_Height, true);
+	for(int i = 0; i <= End; i = Walker.Next(i))
 	{
-		float a = i / (float)End;
-		vec2 Pos = mix(Pos0, Pos1, a);
+		vec2 Pos = Walker.Sample(i);
 		// Temporary position for checking collision
 		int ix = round_to_int(Pos.x);
 		int iy = round_to_int(Pos.y);
@@ -307,11 +389,9 @@ int CCollision::IntersectLine(vec2 Pos0, vec2 Pos1, vec2 *pOutCollision, vec2 *p
 			if(pOutCollision)
 				*pOutCollision = Pos;
 			if(pOutBeforeCollision)
-				*pOutBeforeCollision = Last;
+				*pOutBeforeCollision = Walker.Before(i);
 			return GetCollisionAt(ix, iy);
 		}
-
-		Last = Pos;
 	}
 	if(pOutCollision)
 		*pOutCollision = Pos1;
@@ -324,13 +404,12 @@ int CCollision::IntersectLineTeleHook(vec2 Pos0, vec2 Pos1, vec2 *pOutCollision,
 {
 	float Distance = distance(Pos0, Pos1);
 	int End(Distance + 1);
-	vec2 Last = Pos0;
 	int dx = 0, dy = 0; // Offset for checking the "through" tile
 	ThroughOffset(Pos0, Pos1, &dx, &dy);
-	for(int i = 0; i <= End; i++)
+	const CLineTileWalker Walker(Pos0, Pos1, End, End + 1, m_Width, m_Height, true, dx, dy);
+	for(int i = 0; i <= End; i = Walker.Next(i))
 	{
-		float a = i / (float)End;
-		vec2 Pos = mix(Pos0, Pos1, a);
+		vec2 Pos = Walker.Sample(i);
 		// Temporary position for checking collision
 		int ix = round_to_int(Pos.x);
 		int iy = round_to_int(Pos.y);
@@ -345,7 +424,7 @@ int CCollision::IntersectLineTeleHook(vec2 Pos0, vec2 Pos1, vec2 *pOutCollision,
 			if(pOutCollision)
 				*pOutCollision = Pos;
 			if(pOutBeforeCollision)
-				*pOutBeforeCollision = Last;
+				*pOutBeforeCollision = Walker.Before(i);
 			return TILE_TELEINHOOK;
 		}
 
@@ -364,11 +443,9 @@ int CCollision::IntersectLineTeleHook(vec2 Pos0, vec2 Pos1, vec2 *pOutCollision,
 			if(pOutCollision)
 				*pOutCollision = Pos;
 			if(pOutBeforeCollision)
-				*pOutBeforeCollision = Last;
+				*pOutBeforeCollision = Walker.Before(i);
 			return hit;
 		}
-
-		Last = Pos;
 	}
 	if(pOutCollision)
 		*pOutCollision = Pos1;
@@ -381,11 +458,10 @@ int CCollision::IntersectLineTeleWeapon(vec2 Pos0, vec2 Pos1, vec2 *pOutCollisio
 {
 	float Distance = distance(Pos0, Pos1);
 	int End(Distance + 1);
-	vec2 Last = Pos0;
-	for(int i = 0; i <= End; i++)
+	const CLineTileWalker Walker(Pos0, Pos1, End, End + 1, m_Width, m_Height, true);
+	for(int i = 0; i <= End; i = Walker.Next(i))
 	{
-		float a = i / (float)End;
-		vec2 Pos = mix(Pos0, Pos1, a);
+		vec2 Pos = Walker.Sample(i);
 		// Temporary position for checking collision
 		int ix = round_to_int(Pos.x);
 		int iy = round_to_int(Pos.y);
@@ -400,7 +476,7 @@ int CCollision::IntersectLineTeleWeapon(vec2 Pos0, vec2 Pos1, vec2 *pOutCollisio
 			if(pOutCollision)
 				*pOutCollision = Pos;
 			if(pOutBeforeCollision)
-				*pOutBeforeCollision = Last;
+				*pOutBeforeCollision = Walker.Before(i);
 			return TILE_TELEINWEAPON;
 		}
 
@@ -409,11 +485,9 @@ int CCollision::IntersectLineTeleWeapon(vec2 Pos0, vec2 Pos1, vec2 *pOutCollisio
 			if(pOutCollision)
 				*pOutCollision = Pos;
 			if(pOutBeforeCollision)
-				*pOutBeforeCollision = Last;
+				*pOutBeforeCollision = Walker.Before(i);
 			return GetCollisionAt(ix, iy);
 		}
-
-		Last = Pos;
 	}
 	if(pOutCollision)
 		*pOutCollision = Pos1;
@@ -909,10 +983,10 @@ std::vector<int> CCollision::GetMapIndices(vec2 PrevPos, vec2 Pos, unsigned MaxI
 	else
 	{
 		int LastIndex = 0;
-		for(int i = 0; i < End; i++)
+		const CLineTileWalker Walker(PrevPos, Pos, d, End, m_Width, m_Height, false);
+		for(int i = 0; i < End; i = Walker.Next(i))
 		{
-			float a = i / d;
-			vec2 Tmp = mix(PrevPos, Pos, a);
+			vec2 Tmp = Walker.Sample(i);
 			int Nx = clamp((int)Tmp.x / 32, 0, m_Width - 1);
 			int Ny = clamp((int)Tmp.y / 32, 0, m_Height - 1);
 			int Index = Ny * m_Width + Nx;
@@ -1152,12 +1226,12 @@ void ThroughOffset(vec2 Pos0, vec2 Pos1, int *pOffsetX, int *pOffsetY)
 int CCollision::IntersectNoLaser(vec2 Pos0, vec2 Pos1, vec2 *pOutCollision, vec2 *pOutBeforeCollision) const
 {
 	float d = distance(Pos0, Pos1);
-	vec2 Last = Pos0;
+	int id = std::ceil(d);
+	const CLineTileWalker Walker(Pos0, Pos1, d, id, m_Width, m_Height, true);
 
-	for(int i = 0, id = std::ceil(d); i < id; i++)
+	for(int i = 0; i < id; i = Walker.Next(i))
 	{
-		float a = (int)i / d;
-		vec2 Pos = mix(Pos0, Pos1, a);
+		vec2 Pos = Walker.Sample(i);
 		int Nx = clamp(round_to_int(Pos.x) / 32, 0, m_Width - 1);
 		int Ny = clamp(round_to_int(Pos.y) / 32, 0, m_Height - 1);
 		if(GetIndex(Nx, Ny) == TILE_SOLID || GetIndex(Nx, Ny) == TILE_NOHOOK || GetIndex(Nx, Ny) == TILE_NOLASER || GetFIndex(Nx, Ny) == TILE_NOLASER)
@@ -1165,13 +1239,12 @@ int CCollision::IntersectNoLaser(vec2 Pos0, vec2 Pos1, vec2 *pOutCollision, vec2
 			if(pOutCollision)
 				*pOutCollision = Pos;
 			if(pOutBeforeCollision)
-				*pOutBeforeCollision = Last;
+				*pOutBeforeCollision = Walker.Before(i);
 			if(GetFIndex(Nx, Ny) == TILE_NOLASER)
 				return GetFCollisionAt(Pos.x, Pos.y);
 			else
 				return GetCollisionAt(Pos.x, Pos.y);
 		}
-		Last = Pos;
 	}
 	if(pOutCollision)
 		*pOutCollision = Pos1;
@@ -0,0 +1,211 @@
+#ifndef GAME_ENTITY_GRID_H
+#define GAME_ENTITY_GRID_H
+
+#include <base/math.h>
+#include <base/vmath.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+/*
+	Class: CEntityGrid
+		Spatial hash over the entities of one type. Every entity is
+		sorted into a square cell by its position, queries only visit
+		the cells that overlap the queried area. The candidates are
+		returned in the order of the world's entity list, so callers
+		that do their exact checks on them get the same results as a
+		walk over the full list.
+*/
+template<typename TEntity>
+class CEntityGrid
+{
+public:
+	enum
+	{
+		CELL_SIZE = 256,
+		NUM_BUCKETS = 1024,
+	};
+
+	// copies of an entity start out unlinked, assigning keeps the link
+	class CLink
+	{
+		friend class CEntityGrid;
+
+		TEntity *m_pEntity = nullptr;
+		CLink *m_pPrev = nullptr;
+		CLink *m_pNext = nullptr;
+		int m_Bucket = -1;
+		int m_CellX = 0;
+		int m_CellY = 0;
+		int64_t m_Order = 0;
+		unsigned m_QueryStamp = 0;
+
+	public:
+		CLink() = default;
+		CLink(const CLink &) {}
+		CLink &operator=(const CLink &) { return *this; }
+	};
+
+	CEntityGrid() { Clear(); }
+	CEntityGrid(const CEntityGrid &) = delete;
+	CEntityGrid &operator=(const CEntityGrid &) = delete;
+
+	void Clear()
+	{
+		std::fill(std::begin(m_apBuckets), std::end(m_apBuckets), nullptr);
+		m_NumEntities = 0;
+		m_MaxRadius = 0.0f;
+		m_FrontOrder = 0;
+		m_BackOrder = 0;
+		m_QueryStamp = 0;
+	}
+
+	int NumEntities() const { return m_NumEntities; }
+
+	// Last must match whether the entity was added to the end of the list
+	void Insert(TEntity *pEntity, CLink *pLink, vec2 Pos, float Radius, bool Last = false)
+	{
+		pLink->m_pEntity = pEntity;
+		pLink->m_Order = Last ? --m_BackOrder : ++m_FrontOrder;
+		pLink->m_QueryStamp = m_QueryStamp;
+		m_MaxRadius = maximum(m_MaxRadius, Radius);
+		Link(pLink, Cell(Pos.x), Cell(Pos.y));
+		m_NumEntities++;
+	}
+
+	void Remove(CLink *pLink)
+	{
+		if(pLink->m_Bucket < 0)
+			return;
+		Unlink(pLink);
+		pLink->m_pEntity = nullptr;
+		m_NumEntities--;
+	}
+
+	// must be called whenever the position or radius of an entity changed
+	void Move(CLink *pLink, vec2 Pos, float Radius)
+	{
+		if(pLink->m_Bucket < 0)
+			return;
+
+		m_MaxRadius = maximum(m_MaxRadius, Radius);
+		const int CellX = Cell(Pos.x);
+		const int CellY = Cell(Pos.y);
+		if(CellX == pLink->m_CellX && CellY == pLink->m_CellY)
+			return;
+		Unlink(pLink);
+		Link(pLink, CellX, CellY);
+	}
+
+	/*
+		Function: Query
+			Collects all entities that could be within Margin of
+			the rectangle spanned by From and To, counting their
+			radius.
+
+		Returns:
+			False if the area is too large for the grid to help,
+			the caller has to walk the full list then.
+	*/
+	bool Query(vec2 From, vec2 To, float Margin, std::vector<TEntity *> &vpResult)
+	{
+		vpResult.clear();
+
+		// one unit extra to stay on the safe side of rounding in the exact checks
+		Margin += m_MaxRadius + 1.0f;
+		const int MinX = Cell(minimum(From.x, To.x) - Margin);
+		const int MinY = Cell(minimum(From.y, To.y) - Margin);
+		const int MaxX = Cell(maximum(From.x, To.x) + Margin);
+		const int MaxY = Cell(maximum(From.y, To.y) + Margin);
+		const int64_t NumCells = ((int64_t)MaxX - MinX + 1) * ((int64_t)MaxY - MinY + 1);
+		if(NumCells > NUM_BUCKETS / 4 || NumCells > m_NumEntities)
+			return false;
+
+		if(++m_QueryStamp == 0)
+		{
+			// the stamps wrapped around, make sure no entity has the new one yet
+			for(CLink *pBucket : m_apBuckets)
+				for(CLink *pLink = pBucket; pLink; pLink = pLink->m_pNext)
+					pLink->m_QueryStamp = 0;
+			m_QueryStamp = 1;
+		}
+
+		m_vpCandidates.clear();
+		for(int y = MinY; y <= MaxY; y++)
+		{
+			for(int x = MinX; x <= MaxX; x++)
+			{
+				for(CLink *pLink = m_apBuckets[Bucket(x, y)]; pLink; pLink = pLink->m_pNext)
+				{
+					// cells that share the bucket and cells that were visited already
+					if(pLink->m_QueryStamp == m_QueryStamp || pLink->m_CellX < MinX || pLink->m_CellX > MaxX || pLink->m_CellY < MinY || pLink->m_CellY > MaxY)
+						continue;
+					pLink->m_QueryStamp = m_QueryStamp;
+					m_vpCandidates.push_back(pLink);
+				}
+			}
+		}
+
+		std::sort(m_vpCandidates.begin(), m_vpCandidates.end(), [](const CLink *pA, const CLink *pB) {
+			return pA->m_Order > pB->m_Order;
+		});
+		vpResult.reserve(m_vpCandidates.size());
+		for(const CLink *pLink : m_vpCandidates)
+			vpResult.push_back(pLink->m_pEntity);
+		return true;
+	}
+
+private:
+	CLink *m_apBuckets[NUM_BUCKETS];
+	std::vector<CLink *> m_vpCandidates;
+	int m_NumEntities;
+	float m_MaxRadius;
+	int64_t m_FrontOrder;
+	int64_t m_BackOrder;
+	unsigned m_QueryStamp;
+
+	static int Cell(float Value)
+	{
+		// also catches NaN, entities that far away are never found by the exact checks
+		const float Cell = std::floor(Value / CELL_SIZE);
+		if(!(Cell > -1000000.0f))
+			return -1000000;
+		if(Cell > 1000000.0f)
+			return 1000000;
+		return (int)Cell;
+	}
+
+	static int Bucket(int CellX, int CellY)
+	{
+		return (int)(((unsigned)CellX * 73856093u) ^ ((unsigned)CellY * 19349663u)) & (NUM_BUCKETS - 1);
+	}
+
+	void Link(CLink *pLink, int CellX, int CellY)
+	{
+		pLink->m_CellX = CellX;
+		pLink->m_CellY = CellY;
+		pLink->m_Bucket = Bucket(CellX, CellY);
+		pLink->m_pPrev = nullptr;
+		pLink->m_pNext = m_apBuckets[pLink->m_Bucket];
+		if(pLink->m_pNext)
+			pLink->m_pNext->m_pPrev = pLink;
+		m_apBuckets[pLink->m_Bucket] = pLink;
+	}
+
+	void Unlink(CLink *pLink)
+	{
+		if(pLink->m_pPrev)
+			pLink->m_pPrev->m_pNext = pLink->m_pNext;
+		else
+			m_apBuckets[pLink->m_Bucket] = pLink->m_pNext;
+		if(pLink->m_pNext)
+			pLink->m_pNext->m_pPrev = pLink->m_pPrev;
+		pLink->m_pPrev = nullptr;
+		pLink->m_pNext = nullptr;
+		pLink->m_Bucket = -1;
+	}
+};
+
+#endif
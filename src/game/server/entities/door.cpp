@@ -45,6 +45,14 @@ void CDoor::Reset()
 	m_MarkedForDestroy = true;
 }
 
+bool CDoor::SnapVisibility(CSnapVisibility *pVisibility)
+{
+	pVisibility->m_From = m_To;
+	pVisibility->m_To = m_Pos;
+	pVisibility->m_TeamMask = CClientMask().set();
+	return true;
+}
+
 void CDoor::Snap(int SnappingClient)
 {
 	if(NetworkClipped(SnappingClient, m_Pos) && NetworkClipped(SnappingClient, m_To))
@@ -19,6 +19,7 @@ public:
 
 	void Reset() override;
 	void Snap(int SnappingClient) override;
+	bool SnapVisibility(CSnapVisibility *pVisibility) override;
 };
 
 #endif // GAME_SERVER_ENTITIES_DOOR_H
@@ -143,6 +143,13 @@ void CGun::Reset()
 	m_MarkedForDestroy = true;
 }
 
+bool CGun::SnapVisibility(CSnapVisibility *pVisibility)
+{
+	pVisibility->m_From = pVisibility->m_To = m_Pos;
+	pVisibility->m_TeamMask = CClientMask().set();
+	return true;
+}
+
 void CGun::Snap(int SnappingClient)
 {
 	if(NetworkClipped(SnappingClient))
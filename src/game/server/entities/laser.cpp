@@ -292,6 +292,22 @@ void CLaser::TickPaused()
 	++m_EvalTick;
 }
 
+bool CLaser::SnapVisibility(CSnapVisibility *pVisibility)
+{
+	pVisibility->m_From = m_From;
+	pVisibility->m_To = m_Pos;
+
+	CCharacter *pOwnerChar = 0;
+	if(m_Owner >= 0)
+		pOwnerChar = GameServer()->GetPlayerChar(m_Owner);
+
+	if(pOwnerChar && pOwnerChar->IsAlive())
+		pVisibility->m_TeamMask = pOwnerChar->TeamMask();
+	else
+		pVisibility->m_TeamMask = CClientMask().set();
+	return true;
+}
+
 void CLaser::Snap(int SnappingClient)
 {
 	if(NetworkClipped(SnappingClient) && NetworkClipped(SnappingClient, m_From))
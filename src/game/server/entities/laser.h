@@ -14,6 +14,7 @@ public:
 	virtual void Tick() override;
 	virtual void TickPaused() override;
 	virtual void Snap(int SnappingClient) override;
+	bool SnapVisibility(CSnapVisibility *pVisibility) override;
 	virtual void SwapClients(int Client1, int Client2) override;
 
 	virtual int GetOwnerID() const override { return m_Owner; }
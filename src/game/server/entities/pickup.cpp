@@ -163,6 +163,13 @@ void CPickup::TickPaused()
 {
 }
 
+bool CPickup::SnapVisibility(CSnapVisibility *pVisibility)
+{
+	pVisibility->m_From = pVisibility->m_To = m_Pos;
+	pVisibility->m_TeamMask = CClientMask().set();
+	return true;
+}
+
 void CPickup::Snap(int SnappingClient)
 {
 	if(NetworkClipped(SnappingClient))
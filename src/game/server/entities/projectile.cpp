@@ -299,6 +299,22 @@ void CProjectile::FillInfo(CNetObj_Projectile *pProj)
 	pProj->m_Type = m_Type;
 }
 
+bool CProjectile::SnapVisibility(CSnapVisibility *pVisibility)
+{
+	float Ct = (Server()->Tick() - m_StartTick) / (float)Server()->TickSpeed();
+	pVisibility->m_From = pVisibility->m_To = GetPos(Ct);
+
+	CCharacter *pOwnerChar = 0;
+	if(m_Owner >= 0)
+		pOwnerChar = GameServer()->GetPlayerChar(m_Owner);
+
+	if(m_Owner != -1 && pOwnerChar && pOwnerChar->IsAlive())
+		pVisibility->m_TeamMask = pOwnerChar->TeamMask();
+	else
+		pVisibility->m_TeamMask = CClientMask().set();
+	return true;
+}
+
 void CProjectile::Snap(int SnappingClient)
 {
 	float Ct = (Server()->Tick() - m_StartTick) / (float)Server()->TickSpeed();
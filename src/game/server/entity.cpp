@@ -87,6 +87,14 @@ bool CEntity::GetNearestAirPosPlayer(vec2 PlayerPos, vec2 *pOutPos)
 	return false;
 }
 
+bool CSnapVisibility::IsVisible(const CGameContext *pGameServer, int SnappingClient) const
+{
+	if(SnappingClient != SERVER_DEMO_CLIENT && !m_TeamMask.test(SnappingClient))
+		return false;
+
+	return !NetworkClipped(pGameServer, SnappingClient, m_From) || !NetworkClipped(pGameServer, SnappingClient, m_To);
+}
+
 bool NetworkClipped(const CGameContext *pGameServer, int SnappingClient, vec2 CheckPos)
 {
 	if(SnappingClient == SERVER_DEMO_CLIENT || pGameServer->m_apPlayers[SnappingClient]->m_ShowAll)
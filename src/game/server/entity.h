@@ -24,6 +24,7 @@ private:
 	friend CGameWorld; // entity list handling
 	CEntity *m_pPrevTypeEntity;
 	CEntity *m_pNextTypeEntity;
+	CEntityGrid<CEntity>::CLink m_GridLink;
 
 	/* Identity */
 	CGameWorld *m_pGameWorld;
@@ -122,6 +123,22 @@ public: // TODO: Maybe make protected
 	*/
 	virtual void Snap(int SnappingClient) {}
 
+	/*
+		Function: SnapVisibility
+			Called when the shared world snapshot is being generated.
+			Entities whose snapshot items only depend on the client
+			through network clipping and team visibility can return
+			true here, they are then snapped once per tick and copied
+			into the snapshots of all clients that can see them.
+
+		Arguments:
+			pVisibility - Describes which clients can see the entity.
+
+		Returns:
+			False if the entity has to be snapped for each client.
+	*/
+	virtual bool SnapVisibility(CSnapVisibility *pVisibility) { return false; }
+
 	/*
 		Function: SwapClients
 			Called when two players have swapped their client ids.
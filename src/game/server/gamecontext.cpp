@@ -165,6 +165,7 @@ void CGameContext::TeeHistorianWrite(const void *pData, int DataSize, void *pUse
 {
 	CGameContext *pSelf = (CGameContext *)pUser;
 	aio_write(pSelf->m_pTeeHistorianFile, pData, DataSize);
+	pSelf->m_TeeHistorianBytes += DataSize;
 }
 
 void CGameContext::CommandCallback(int ClientID, int FlagMask, const char *pCmd, IConsole::IResult *pResult, void *pUser)
@@ -934,6 +935,7 @@ void CGameContext::OnTick()
 			dbg_msg("teehistorian", "error writing to file, err=%d", Error);
 			Server()->SetErrorShutdown("teehistorian io error");
 		}
+		m_TeeHistorianMaxBacklog = maximum(m_TeeHistorianMaxBacklog, aio_backlog(m_pTeeHistorianFile));
 
 		if(!m_TeeHistorian.Starting())
 		{
@@ -3600,8 +3602,19 @@ void CGameContext::OnInit(const void *pPersistentData)
 		char aGameUuid[UUID_MAXSTRSIZE];
 		FormatUuid(m_GameUuid, aGameUuid, sizeof(aGameUuid));
 
+		m_pTeeHistorianCompressor = nullptr;
+		if(g_Config.m_SvTeeHistorianCompression)
+		{
+			m_pTeeHistorianCompressor = std::make_unique<CTeeHistorianCompressor>(g_Config.m_SvTeeHistorianCompression, g_Config.m_SvTeeHistorianFlushInterval);
+			if(!m_pTeeHistorianCompressor->Init())
+			{
+				dbg_msg("teehistorian", "failed to initialize compression, recording uncompressed");
+				m_pTeeHistorianCompressor = nullptr;
+			}
+		}
+
 		char aFilename[IO_MAX_PATH_LENGTH];
-		str_format(aFilename, sizeof(aFilename), "teehistorian/%s.teehistorian", aGameUuid);
+		str_format(aFilename, sizeof(aFilename), "teehistorian/%s.teehistorian%s", aGameUuid, m_pTeeHistorianCompressor ? ".gz" : "");
 
 		IOHANDLE THFile = Storage()->OpenFile(aFilename, IOFLAG_WRITE, IStorage::TYPE_SAVE);
 		if(!THFile)
@@ -3614,7 +3627,13 @@ void CGameContext::OnInit(const void *pPersistentData)
 		{
 			dbg_msg("teehistorian", "recording to '%s'", aFilename);
 		}
-		m_pTeeHistorianFile = aio_new(THFile);
+		if(m_pTeeHistorianCompressor)
+			m_pTeeHistorianFile = aio_new_writer(THFile, CTeeHistorianCompressor::Write, m_pTeeHistorianCompressor.get());
+		else
+			m_pTeeHistorianFile = aio_new(THFile);
+		m_TeeHistorianStartTime = time_get();
+		m_TeeHistorianBytes = 0;
+		m_TeeHistorianMaxBacklog = 0;
 
 		char aVersion[128];
 		if(GIT_SHORTREV_HASH)
@@ -3939,6 +3958,21 @@ void CGameContext::OnShutdown(void *pPersistentData)
 			Server()->SetErrorShutdown("teehistorian close error");
 		}
 		aio_free(m_pTeeHistorianFile);
+
+		const float Seconds = maximum(time_get() - m_TeeHistorianStartTime, (int64_t)1) / (float)time_freq();
+		if(m_pTeeHistorianCompressor)
+		{
+			dbg_msg("teehistorian", "recorded %" PRId64 " bytes in %.0fs (%.1f KiB/s), compressed to %" PRId64 " bytes (%.1f%%) in %.0fms with %d flushes, max backlog %u bytes",
+				m_TeeHistorianBytes, Seconds, m_TeeHistorianBytes / 1024.0f / Seconds,
+				m_pTeeHistorianCompressor->BytesOut(), 100.0f * m_pTeeHistorianCompressor->BytesOut() / maximum(m_TeeHistorianBytes, (int64_t)1),
+				m_pTeeHistorianCompressor->CompressTime() * 1000.0f / time_freq(), m_pTeeHistorianCompressor->NumFlushes(), m_TeeHistorianMaxBacklog);
+			m_pTeeHistorianCompressor = nullptr;
+		}
+		else
+		{
+			dbg_msg("teehistorian", "recorded %" PRId64 " bytes in %.0fs (%.1f KiB/s), max backlog %u bytes",
+				m_TeeHistorianBytes, Seconds, m_TeeHistorianBytes / 1024.0f / Seconds, m_TeeHistorianMaxBacklog);
+		}
 	}
 
 	DeleteTempfile();
@@ -4012,6 +4046,10 @@ void CGameContext::OnSnap(int ClientID)
 	m_World.Snap(ClientID);
 	m_Events.Snap(ClientID);
 }
+void CGameContext::OnSnapShared()
+{
+	m_World.SnapShared();
+}
 void CGameContext::OnPreSnap() {}
 void CGameContext::OnPostSnap()
 {
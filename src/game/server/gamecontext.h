@@ -93,6 +93,10 @@ class CGameContext : public IGameServer
 	bool m_TeeHistorianActive;
 	CTeeHistorian m_TeeHistorian;
 	ASYNCIO *m_pTeeHistorianFile;
+	std::unique_ptr<CTeeHistorianCompressor> m_pTeeHistorianCompressor;
+	int64_t m_TeeHistorianStartTime;
+	int64_t m_TeeHistorianBytes;
+	unsigned m_TeeHistorianMaxBacklog;
 	CUuid m_GameUuid;
 	CMapBugs m_MapBugs;
 	CPrng m_Prng;
@@ -285,6 +289,7 @@ public:
 	void OnTick() override;
 	void OnPreSnap() override;
 	void OnSnap(int ClientID) override;
+	void OnSnapShared() override;
 	void OnPostSnap() override;
 
 	void UpdatePlayerMaps();
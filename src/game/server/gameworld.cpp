@@ -47,13 +47,52 @@ CEntity *CGameWorld::FindFirst(int Type)
 	return Type < 0 || Type >= NUM_ENTTYPES ? 0 : m_apFirstEntityTypes[Type];
 }
 
+void CGameWorld::UpdateGrid(CEntity *pEnt)
+{
+	m_aGrids[pEnt->m_ObjType].Move(&pEnt->m_GridLink, pEnt->m_Pos, pEnt->m_ProximityRadius);
+}
+
+void CGameWorld::UpdateGrid(int Type)
+{
+	for(CEntity *pEnt = m_apFirstEntityTypes[Type]; pEnt; pEnt = pEnt->m_pNextTypeEntity)
+		UpdateGrid(pEnt);
+}
+
+void CGameWorld::OnEntityTicked()
+{
+	// the entity might have been removed from the world while ticking
+	if(m_pTickingEntity)
+		UpdateGrid(m_pTickingEntity);
+	m_pTickingEntity = nullptr;
+}
+
+void CGameWorld::QueryGrid(int Type, vec2 From, vec2 To, float Margin)
+{
+	// outside of the world tick positions can be changed by anything,
+	// e.g. commands or loading a save
+	if(!m_InTick)
+		UpdateGrid(Type);
+	else if(m_pTickingEntity)
+		UpdateGrid(m_pTickingEntity);
+
+	if(m_aGrids[Type].Query(From, To, Margin, m_vpGridCandidates))
+		return;
+
+	// the area is too large for the grid, everything is a candidate
+	m_vpGridCandidates.clear();
+	for(CEntity *pEnt = m_apFirstEntityTypes[Type]; pEnt; pEnt = pEnt->m_pNextTypeEntity)
+		m_vpGridCandidates.push_back(pEnt);
+}
+
 int CGameWorld::FindEntities(vec2 Pos, float Radius, CEntity **ppEnts, int Max, int Type)
 {
 	if(Type < 0 || Type >= NUM_ENTTYPES)
 		return 0;
 
+	QueryGrid(Type, Pos, Pos, Radius);
+
 	int Num = 0;
-	for(CEntity *pEnt = m_apFirstEntityTypes[Type]; pEnt; pEnt = pEnt->m_pNextTypeEntity)
+	for(CEntity *pEnt : m_vpGridCandidates)
 	{
 		if(distance(pEnt->m_Pos, Pos) < Radius + pEnt->m_ProximityRadius)
 		{
@@ -81,6 +120,8 @@ void CGameWorld::InsertEntity(CEntity *pEnt)
 	pEnt->m_pNextTypeEntity = m_apFirstEntityTypes[pEnt->m_ObjType];
 	pEnt->m_pPrevTypeEntity = 0x0;
 	m_apFirstEntityTypes[pEnt->m_ObjType] = pEnt;
+
+	m_aGrids[pEnt->m_ObjType].Insert(pEnt, &pEnt->m_GridLink, pEnt->m_Pos, pEnt->m_ProximityRadius);
 }
 
 void CGameWorld::RemoveEntity(CEntity *pEnt)
@@ -100,14 +141,80 @@ void CGameWorld::RemoveEntity(CEntity *pEnt)
 	// keep list traversing valid
 	if(m_pNextTraverseEntity == pEnt)
 		m_pNextTraverseEntity = pEnt->m_pNextTypeEntity;
+	if(m_pTickingEntity == pEnt)
+		m_pTickingEntity = nullptr;
 
 	pEnt->m_pNextTypeEntity = 0;
 	pEnt->m_pPrevTypeEntity = 0;
+
+	m_aGrids[pEnt->m_ObjType].Remove(&pEnt->m_GridLink);
+}
+
+bool CGameWorld::UseSharedSnap(int SnappingClient) const
+{
+	if(!m_pServer->SnapSharedAvailable())
+		return false;
+
+	// the shared items are snapped for the demo client, only clients that
+	// would receive the same items can use them
+	if(SnappingClient == SERVER_DEMO_CLIENT)
+		return true;
+	return !m_pServer->IsSixup(SnappingClient) && m_pServer->GetClientVersion(SnappingClient) >= VERSION_DDNET_ENTITY_NETOBJS;
+}
+
+void CGameWorld::SnapShared()
+{
+	m_vSharedSnapEntities.clear();
+	m_vpPerClientSnapEntities.clear();
+
+	for(int i = -1; i < NUM_ENTTYPES; i++)
+	{
+		// characters first, like in Snap
+		const int Type = i == -1 ? (int)ENTTYPE_CHARACTER : i;
+		if(i == ENTTYPE_CHARACTER)
+			continue;
+
+		for(CEntity *pEnt = m_apFirstEntityTypes[Type]; pEnt;)
+		{
+			m_pNextTraverseEntity = pEnt->m_pNextTypeEntity;
+			CSharedSnapEntity Entity;
+			// the shared items aren't clipped and can run out of space,
+			// the client snapshots might still have room for the rest
+			if(!Server()->SnapSharedItemsFull() && pEnt->SnapVisibility(&Entity.m_Visibility))
+			{
+				Entity.m_FirstItem = Server()->SnapSharedItemMark();
+				pEnt->Snap(SERVER_DEMO_CLIENT);
+				Entity.m_LastItem = Server()->SnapSharedItemMark();
+				if(Server()->SnapSharedItemsFull())
+					m_vpPerClientSnapEntities.push_back(pEnt);
+				else if(Entity.m_LastItem > Entity.m_FirstItem)
+					m_vSharedSnapEntities.push_back(Entity);
+			}
+			else
+			{
+				m_vpPerClientSnapEntities.push_back(pEnt);
+			}
+			pEnt = m_pNextTraverseEntity;
+		}
+	}
 }
 
 //
 void CGameWorld::Snap(int SnappingClient)
 {
+	if(UseSharedSnap(SnappingClient))
+	{
+		for(CEntity *pEnt : m_vpPerClientSnapEntities)
+			pEnt->Snap(SnappingClient);
+
+		for(const CSharedSnapEntity &Entity : m_vSharedSnapEntities)
+		{
+			if(Entity.m_Visibility.IsVisible(GameServer(), SnappingClient))
+				Server()->SnapCopySharedItems(Entity.m_FirstItem, Entity.m_LastItem);
+		}
+		return;
+	}
+
 	for(CEntity *pEnt = m_apFirstEntityTypes[ENTTYPE_CHARACTER]; pEnt;)
 	{
 		m_pNextTraverseEntity = pEnt->m_pNextTypeEntity;
@@ -196,6 +303,10 @@ void CGameWorld::Tick()
 	if(m_ResetRequested)
 		Reset();
 
+	for(int i = 0; i < NUM_ENTTYPES; i++)
+		UpdateGrid(i);
+	m_InTick = true;
+
 	if(!m_Paused)
 	{
 		if(GameServer()->m_pController->IsForceBalanced())
@@ -212,7 +323,9 @@ void CGameWorld::Tick()
 				for(; pEnt;)
 				{
 					m_pNextTraverseEntity = pEnt->m_pNextTypeEntity;
+					m_pTickingEntity = pEnt;
 					((CCharacter *)pEnt)->PreTick();
+					OnEntityTicked();
 					pEnt = m_pNextTraverseEntity;
 				}
 			}
@@ -221,7 +334,9 @@ void CGameWorld::Tick()
 			for(; pEnt;)
 			{
 				m_pNextTraverseEntity = pEnt->m_pNextTypeEntity;
+				m_pTickingEntity = pEnt;
 				pEnt->Tick();
+				OnEntityTicked();
 				pEnt = m_pNextTraverseEntity;
 			}
 		}
@@ -230,7 +345,9 @@ void CGameWorld::Tick()
 			for(; pEnt;)
 			{
 				m_pNextTraverseEntity = pEnt->m_pNextTypeEntity;
+				m_pTickingEntity = pEnt;
 				pEnt->TickDeferred();
+				OnEntityTicked();
 				pEnt = m_pNextTraverseEntity;
 			}
 	}
@@ -241,11 +358,15 @@ void CGameWorld::Tick()
 			for(; pEnt;)
 			{
 				m_pNextTraverseEntity = pEnt->m_pNextTypeEntity;
+				m_pTickingEntity = pEnt;
 				pEnt->TickPaused();
+				OnEntityTicked();
 				pEnt = m_pNextTraverseEntity;
 			}
 	}
 
+	m_InTick = false;
+
 	RemoveEntities();
 
 	// find the characters' strong/weak id
@@ -276,9 +397,10 @@ CCharacter *CGameWorld::IntersectCharacter(vec2 Pos0, vec2 Pos1, float Radius, v
 	float ClosestLen = distance(Pos0, Pos1) * 100.0f;
 	CCharacter *pClosest = 0;
 
-	CCharacter *p = (CCharacter *)FindFirst(ENTTYPE_CHARACTER);
-	for(; p; p = (CCharacter *)p->TypeNext())
+	QueryGrid(ENTTYPE_CHARACTER, Pos0, Pos1, Radius);
+	for(CEntity *pEnt : m_vpGridCandidates)
 	{
+		CCharacter *p = (CCharacter *)pEnt;
 		if(p == pNotThis)
 			continue;
 
@@ -314,9 +436,10 @@ CCharacter *CGameWorld::ClosestCharacter(vec2 Pos, float Radius, const CEntity *
 	float ClosestRange = Radius * 2;
 	CCharacter *pClosest = 0;
 
-	CCharacter *p = (CCharacter *)GameServer()->m_World.FindFirst(ENTTYPE_CHARACTER);
-	for(; p; p = (CCharacter *)p->TypeNext())
+	QueryGrid(ENTTYPE_CHARACTER, Pos, Pos, Radius);
+	for(CEntity *pEnt : m_vpGridCandidates)
 	{
+		CCharacter *p = (CCharacter *)pEnt;
 		if(p == pNotThis)
 			continue;
 
@@ -337,9 +460,10 @@ CCharacter *CGameWorld::ClosestCharacter(vec2 Pos, float Radius, const CEntity *
 std::vector<CCharacter *> CGameWorld::IntersectedCharacters(vec2 Pos0, vec2 Pos1, float Radius, const CEntity *pNotThis)
 {
 	std::vector<CCharacter *> vpCharacters;
-	CCharacter *pChr = (CCharacter *)FindFirst(CGameWorld::ENTTYPE_CHARACTER);
-	for(; pChr; pChr = (CCharacter *)pChr->TypeNext())
+	QueryGrid(ENTTYPE_CHARACTER, Pos0, Pos1, Radius);
+	for(CEntity *pEnt : m_vpGridCandidates)
 	{
+		CCharacter *pChr = (CCharacter *)pEnt;
 		if(pChr == pNotThis)
 			continue;
 
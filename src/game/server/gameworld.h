@@ -3,12 +3,29 @@
 #ifndef GAME_SERVER_GAMEWORLD_H
 #define GAME_SERVER_GAMEWORLD_H
 
+#include <game/entity_grid.h>
 #include <game/gamecore.h>
 
 #include <vector>
 
 class CEntity;
 class CCharacter;
+class CGameContext;
+
+/*
+	Class: SnapVisibility
+		Describes which clients can see an entity that is snapped into
+		the shared world snapshot. The entity is visible if the client
+		is in the team mask and either position is in its view.
+*/
+struct CSnapVisibility
+{
+	vec2 m_From;
+	vec2 m_To;
+	CClientMask m_TeamMask;
+
+	bool IsVisible(const CGameContext *pGameServer, int SnappingClient) const;
+};
 
 /*
 	Class: Game World
@@ -35,6 +52,30 @@ private:
 	CEntity *m_pNextTraverseEntity = nullptr;
 	CEntity *m_apFirstEntityTypes[NUM_ENTTYPES];
 
+	// the grids are kept up to date after every entity callback, the
+	// entity that is currently ticking is also updated before queries
+	CEntityGrid<CEntity> m_aGrids[NUM_ENTTYPES];
+	CEntity *m_pTickingEntity = nullptr;
+	bool m_InTick = false;
+	std::vector<CEntity *> m_vpGridCandidates;
+
+	void UpdateGrid(CEntity *pEnt);
+	void UpdateGrid(int Type);
+	void OnEntityTicked();
+	// fills m_vpGridCandidates in list order
+	void QueryGrid(int Type, vec2 From, vec2 To, float Margin);
+
+	struct CSharedSnapEntity
+	{
+		int m_FirstItem;
+		int m_LastItem;
+		CSnapVisibility m_Visibility;
+	};
+	std::vector<CSharedSnapEntity> m_vSharedSnapEntities;
+	std::vector<CEntity *> m_vpPerClientSnapEntities;
+
+	bool UseSharedSnap(int SnappingClient) const;
+
 	class CGameContext *m_pGameServer;
 	class CConfig *m_pConfig;
 	class IServer *m_pServer;
@@ -133,6 +174,14 @@ public:
 	*/
 	void Snap(int SnappingClient);
 
+	/*
+		Function: SnapShared
+			Snaps all entities that support it into the shared
+			world snapshot, which is then filtered for each client
+			by Snap.
+	*/
+	void SnapShared();
+
 	/*
 		Function: Tick
 			Calls Tick on all the entities in the world to progress
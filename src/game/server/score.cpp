@@ -36,13 +36,75 @@ void CScore::ExecPlayerThread(
 	if(pResult == nullptr)
 		return;
 	auto Tmp = std::make_unique<CSqlPlayerRequest>(pResult);
-	str_copy(Tmp->m_aName, pName, sizeof(Tmp->m_aName));
+	FillPlayerRequest(Tmp.get(), ClientID, pName, Offset);
+
+	m_pPool->Execute(pFuncPtr, std::move(Tmp), pThreadName);
+}
+
+void CScore::FillPlayerRequest(CSqlPlayerRequest *pRequest, int ClientID, const char *pName, int Offset)
+{
+	str_copy(pRequest->m_aName, pName, sizeof(pRequest->m_aName));
+	str_copy(pRequest->m_aMap, g_Config.m_SvMap, sizeof(pRequest->m_aMap));
+	str_copy(pRequest->m_aServer, g_Config.m_SvSqlServerName, sizeof(pRequest->m_aServer));
+	str_copy(pRequest->m_aRequestingPlayer, Server()->ClientName(ClientID), sizeof(pRequest->m_aRequestingPlayer));
+	pRequest->m_Offset = Offset;
+}
+
+bool CScore::ExecCached(void (CScoreCache::*pFunc)(const CSqlPlayerRequest *, CScorePlayerResult *) const, int ClientID, const char *pName, int Offset)
+{
+	CScoreCache *pCache = Cache();
+	if(pCache == nullptr)
+		return false;
+	auto pResult = NewSqlPlayerResult(ClientID);
+	if(pResult == nullptr)
+		return true;
+	CSqlPlayerRequest Request(pResult);
+	FillPlayerRequest(&Request, ClientID, pName, Offset);
+	(pCache->*pFunc)(&Request, pResult.get());
+	pResult->m_Success = true;
+	pResult->m_Completed = true;
+	return true;
+}
+
+// Runs after the writes queued before, so finishes of the previous round
+// on this map are part of the loaded ranks.
+void CScore::LoadCache()
+{
+	m_pCacheResult = std::make_shared<CScoreCacheResult>();
+	auto Tmp = std::make_unique<CSqlScoreCacheRequest>(m_pCacheResult);
 	str_copy(Tmp->m_aMap, g_Config.m_SvMap, sizeof(Tmp->m_aMap));
 	str_copy(Tmp->m_aServer, g_Config.m_SvSqlServerName, sizeof(Tmp->m_aServer));
-	str_copy(Tmp->m_aRequestingPlayer, Server()->ClientName(ClientID), sizeof(Tmp->m_aRequestingPlayer));
-	Tmp->m_Offset = Offset;
+	m_pPool->Execute(CScoreCache::Load, std::move(Tmp), "load score cache");
+}
 
-	m_pPool->Execute(pFuncPtr, std::move(Tmp), pThreadName);
+CScoreCache *CScore::Cache()
+{
+	if(m_pCacheResult != nullptr && m_pCacheResult->m_Completed)
+	{
+		if(m_pCacheResult->m_Success)
+		{
+			m_pCache = std::make_unique<CScoreCache>(std::move(m_pCacheResult->m_Cache));
+			// the saves may already be part of the loaded ranks, applying them twice doesn't change anything
+			for(auto &Save : m_vCachePendingSaves)
+				Save(m_pCache.get());
+			dbg_msg("sql", "cached %d ranks and %d team ranks", m_pCache->NumRanks(), m_pCache->NumTeamRanks());
+		}
+		else
+		{
+			dbg_msg("sql", "failed to load score cache, using the database");
+		}
+		m_pCacheResult = nullptr;
+		m_vCachePendingSaves.clear();
+	}
+	return m_pCache.get();
+}
+
+void CScore::SaveToCache(std::function<void(CScoreCache *)> &&Save)
+{
+	if(Cache() != nullptr)
+		Save(m_pCache.get());
+	else if(m_pCacheResult != nullptr)
+		m_vCachePendingSaves.push_back(std::move(Save));
 }
 
 bool CScore::RateLimitPlayer(int ClientID)
@@ -74,6 +136,8 @@ CScore::CScore(CGameContext *pGameServer, CDbConnectionPool *pPool) :
 	m_pServer(pGameServer->Server())
 {
 	LoadBestTime();
+	if(g_Config.m_SvScoreCache)
+		LoadCache();
 
 	uint64_t aSeed[2];
 	secure_random_fill(aSeed, sizeof(aSeed));
@@ -160,6 +224,9 @@ void CScore::SaveScore(int ClientID, float Time, const char *pTimestamp, const f
 	for(int i = 0; i < NUM_CHECKPOINTS; i++)
 		Tmp->m_aCurrentTimeCp[i] = aTimeCp[i];
 
+	SaveToCache([Name = std::string(Tmp->m_aName), Server = std::string(g_Config.m_SvSqlServerName), Time](CScoreCache *pCache) {
+		pCache->SaveScore(Name.c_str(), Server.c_str(), Time);
+	});
 	m_pPool->ExecuteWrite(CScoreWorker::SaveScore, std::move(Tmp), "save score");
 }
 
@@ -183,6 +250,10 @@ void CScore::SaveTeamScore(int *pClientIDs, unsigned int Size, float Time, const
 	str_copy(Tmp->m_aMap, g_Config.m_SvMap, sizeof(Tmp->m_aMap));
 	Tmp->m_TeamrankUuid = RandomUuid();
 
+	std::vector<std::string> vNames(std::begin(Tmp->m_aaNames), std::begin(Tmp->m_aaNames) + Size);
+	SaveToCache([vNames = std::move(vNames), Time, Id = Tmp->m_TeamrankUuid](CScoreCache *pCache) {
+		pCache->SaveTeamScore(vNames, Time, Id);
+	});
 	m_pPool->ExecuteWrite(CScoreWorker::SaveTeamScore, std::move(Tmp), "save team score");
 }
 
@@ -190,6 +261,8 @@ void CScore::ShowRank(int ClientID, const char *pName)
 {
 	if(RateLimitPlayer(ClientID))
 		return;
+	if(ExecCached(&CScoreCache::ShowRank, ClientID, pName, 0))
+		return;
 	ExecPlayerThread(CScoreWorker::ShowRank, "show rank", ClientID, pName, 0);
 }
 
@@ -204,6 +277,8 @@ void CScore::ShowTop(int ClientID, int Offset)
 {
 	if(RateLimitPlayer(ClientID))
 		return;
+	if(ExecCached(&CScoreCache::ShowTop, ClientID, "", Offset))
+		return;
 	ExecPlayerThread(CScoreWorker::ShowTop, "show top5", ClientID, "", Offset);
 }
 
@@ -211,6 +286,8 @@ void CScore::ShowTeamTop5(int ClientID, int Offset)
 {
 	if(RateLimitPlayer(ClientID))
 		return;
+	if(ExecCached(&CScoreCache::ShowTeamTop5, ClientID, "", Offset))
+		return;
 	ExecPlayerThread(CScoreWorker::ShowTeamTop5, "show team top5", ClientID, "", Offset);
 }
 
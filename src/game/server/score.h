@@ -3,8 +3,12 @@
 
 #include <game/prng.h>
 
+#include "scorecache.h"
 #include "scoreworker.h"
 
+#include <functional>
+#include <memory>
+
 class CDbConnectionPool;
 class CGameContext;
 class IDbConnection;
@@ -34,10 +38,23 @@ class CScore
 		int ClientID,
 		const char *pName,
 		int Offset);
+	void FillPlayerRequest(CSqlPlayerRequest *pRequest, int ClientID, const char *pName, int Offset);
 
 	// returns true if the player should be rate limited
 	bool RateLimitPlayer(int ClientID);
 
+	// ranks of the current map if sv_score_cache is enabled and they are loaded
+	std::shared_ptr<CScoreCacheResult> m_pCacheResult;
+	std::unique_ptr<CScoreCache> m_pCache;
+	// saves submitted after the cache load, applied once it's loaded
+	std::vector<std::function<void(CScoreCache *)>> m_vCachePendingSaves;
+	void LoadCache();
+	// returns nullptr if the ranks aren't available in memory
+	CScoreCache *Cache();
+	void SaveToCache(std::function<void(CScoreCache *)> &&Save);
+	// answers a request from the cache, returns false if it has to go to the database
+	bool ExecCached(void (CScoreCache::*pFunc)(const CSqlPlayerRequest *, CScorePlayerResult *) const, int ClientID, const char *pName, int Offset);
+
 public:
 	CScore(CGameContext *pGameServer, CDbConnectionPool *pPool);
 	~CScore() {}
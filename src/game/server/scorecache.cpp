@@ -0,0 +1,289 @@
+#include "scorecache.h"
+
+#include <base/system.h>
+#include <engine/server/databases/connection.h>
+#include <engine/shared/config.h>
+
+#include <algorithm>
+#include <cmath>
+
+bool CScoreCache::Load(IDbConnection *pSqlServer, const ISqlData *pGameData, char *pError, int ErrorSize)
+{
+	const auto *pData = dynamic_cast<const CSqlScoreCacheRequest *>(pGameData);
+	auto *pResult = dynamic_cast<CScoreCacheResult *>(pGameData->m_pResult.get());
+	CScoreCache &Cache = pResult->m_Cache;
+
+	char aBuf[512];
+	// the rank queries only consider finishes with a server
+	str_format(aBuf, sizeof(aBuf),
+		"SELECT Name, Server, MIN(Time) "
+		"FROM %s_race "
+		"WHERE Map = ? AND Server IS NOT NULL "
+		"GROUP BY Name, Server",
+		pSqlServer->GetPrefix());
+	if(pSqlServer->PrepareStatement(aBuf, pError, ErrorSize))
+	{
+		return true;
+	}
+	pSqlServer->BindString(1, pData->m_aMap);
+
+	Cache.m_RegionalServer = pData->m_aServer;
+	bool End;
+	while(!pSqlServer->Step(&End, pError, ErrorSize) && !End)
+	{
+		char aName[MAX_NAME_LENGTH];
+		char aServer[32];
+		pSqlServer->GetString(1, aName, sizeof(aName));
+		pSqlServer->GetString(2, aServer, sizeof(aServer));
+		Cache.AddRank(aName, aServer, pSqlServer->GetFloat(3));
+	}
+	if(!End)
+	{
+		return true;
+	}
+
+	str_format(aBuf, sizeof(aBuf),
+		"SELECT ID, Name, Time, DDNet7 "
+		"FROM %s_teamrace "
+		"WHERE Map = ? "
+		"ORDER BY ID, Name COLLATE %s",
+		pSqlServer->GetPrefix(), pSqlServer->BinaryCollate());
+	if(pSqlServer->PrepareStatement(aBuf, pError, ErrorSize))
+	{
+		return true;
+	}
+	pSqlServer->BindString(1, pData->m_aMap);
+
+	CTeam Team;
+	while(!pSqlServer->Step(&End, pError, ErrorSize) && !End)
+	{
+		CUuid Id;
+		pSqlServer->GetBlob(1, Id.m_aData, sizeof(Id.m_aData));
+		if(!Team.m_vNames.empty() && Team.m_Id != Id)
+		{
+			Cache.AddTeam(std::move(Team));
+			Team = CTeam();
+		}
+		char aName[MAX_NAME_LENGTH];
+		pSqlServer->GetString(2, aName, sizeof(aName));
+		Team.m_Id = Id;
+		Team.m_Time = pSqlServer->GetFloat(3);
+		Team.m_DDNet7 = pSqlServer->GetInt(4) != 0;
+		Team.m_vNames.emplace_back(aName);
+	}
+	if(!End)
+	{
+		return true;
+	}
+	if(!Team.m_vNames.empty())
+	{
+		Cache.AddTeam(std::move(Team));
+	}
+	return false;
+}
+
+void CScoreCache::CRankList::Add(const char *pName, float Time)
+{
+	auto BestTime = m_BestTimes.find(pName);
+	if(BestTime != m_BestTimes.end())
+	{
+		if(BestTime->second <= Time)
+			return;
+		auto Rank = std::lower_bound(m_vRanks.begin(), m_vRanks.end(), BestTime->second, RankLess);
+		while(Rank->m_Name != pName)
+			++Rank;
+		m_vRanks.erase(Rank);
+		BestTime->second = Time;
+	}
+	else
+	{
+		m_BestTimes.emplace(pName, Time);
+	}
+	auto Pos = std::lower_bound(m_vRanks.begin(), m_vRanks.end(), Time, RankLess);
+	while(Pos != m_vRanks.end() && Pos->m_Time == Time && Pos->m_Name < pName)
+		++Pos;
+	m_vRanks.insert(Pos, {pName, Time});
+}
+
+int CScoreCache::CRankList::Rank(float Time) const
+{
+	return std::lower_bound(m_vRanks.begin(), m_vRanks.end(), Time, RankLess) - m_vRanks.begin() + 1;
+}
+
+void CScoreCache::AddRank(const char *pName, const char *pServer, float Time)
+{
+	auto ServerTime = m_ServerTimes.emplace(std::make_pair(pName, pServer), Time);
+	if(!ServerTime.second && Time < ServerTime.first->second)
+		ServerTime.first->second = Time;
+
+	m_Ranks.Add(pName, Time);
+	if(str_find_nocase(pServer, m_RegionalServer.c_str()))
+		m_Regional.Add(pName, Time);
+}
+
+void CScoreCache::AddTeam(CTeam &&Team)
+{
+	auto Pos = std::lower_bound(m_vTeams.begin(), m_vTeams.end(), Team.m_Time, TeamLess);
+	while(Pos != m_vTeams.end() && Pos->m_Time == Team.m_Time && Pos->m_Id < Team.m_Id)
+		++Pos;
+	m_vTeams.insert(Pos, std::move(Team));
+}
+
+// the times are stored rounded to centiseconds
+static float RoundTime(float Time)
+{
+	return std::round(Time * 100.0) / 100.0;
+}
+
+void CScoreCache::SaveScore(const char *pName, const char *pServer, float Time)
+{
+	AddRank(pName, pServer, RoundTime(Time));
+}
+
+void CScoreCache::SaveTeamScore(std::vector<std::string> vNames, float Time, CUuid TeamrankUuid)
+{
+	std::sort(vNames.begin(), vNames.end());
+	vNames.erase(std::unique(vNames.begin(), vNames.end()), vNames.end());
+	Time = RoundTime(Time);
+
+	// same team as CScoreWorker::SaveTeamScore would update
+	auto Found = m_vTeams.end();
+	for(auto Team = m_vTeams.begin(); Team != m_vTeams.end(); ++Team)
+	{
+		if(!Team->m_DDNet7 && Team->m_vNames == vNames && (Found == m_vTeams.end() || Team->m_Id < Found->m_Id))
+			Found = Team;
+	}
+	if(Found != m_vTeams.end())
+	{
+		if(Found->m_Time <= Time)
+			return;
+		CTeam Team = std::move(*Found);
+		m_vTeams.erase(Found);
+		Team.m_Time = Time;
+		AddTeam(std::move(Team));
+		return;
+	}
+	AddTeam({TeamrankUuid, Time, false, std::move(vNames)});
+}
+
+CScoreCache::CRankList CScoreCache::RegionalRanks(const char *pServer) const
+{
+	// the entries of a player are next to each other
+	CRankList Ranks;
+	std::vector<CRank> &vRanks = Ranks.m_vRanks;
+	for(const auto &ServerTime : m_ServerTimes)
+	{
+		if(!str_find_nocase(ServerTime.first.second.c_str(), pServer))
+			continue;
+		if(!vRanks.empty() && vRanks.back().m_Name == ServerTime.first.first)
+			vRanks.back().m_Time = minimum(vRanks.back().m_Time, ServerTime.second);
+		else
+			vRanks.push_back({ServerTime.first.first, ServerTime.second});
+	}
+	std::sort(vRanks.begin(), vRanks.end(), [](const CRank &a, const CRank &b) {
+		return a.m_Time < b.m_Time || (a.m_Time == b.m_Time && a.m_Name < b.m_Name);
+	});
+	for(const auto &Rank : vRanks)
+		Ranks.m_BestTimes.emplace(Rank.m_Name, Rank.m_Time);
+	return Ranks;
+}
+
+void CScoreCache::ShowRank(const CSqlPlayerRequest *pData, CScorePlayerResult *pResult) const
+{
+	auto BestTime = m_Ranks.m_BestTimes.find(pData->m_aName);
+	if(BestTime == m_Ranks.m_BestTimes.end())
+	{
+		CScoreWorker::RankMessage(pData, pResult, 0, 0.0f, 0.0f, "");
+		return;
+	}
+
+	char aRegionalRank[16];
+	str_copy(aRegionalRank, "unranked", sizeof(aRegionalRank));
+	if(g_Config.m_SvRegionalRankings)
+	{
+		CRankList Other;
+		const CRankList &Regional = str_comp(pData->m_aServer, m_RegionalServer.c_str()) == 0 ? m_Regional : (Other = RegionalRanks(pData->m_aServer));
+		auto Own = Regional.m_BestTimes.find(pData->m_aName);
+		if(Own != Regional.m_BestTimes.end())
+			str_format(aRegionalRank, sizeof(aRegionalRank), "rank %d", Regional.Rank(Own->second));
+	}
+
+	// same as RANK() and PERCENT_RANK() of the database
+	const int NumRanks = m_Ranks.m_vRanks.size();
+	const int Rank = m_Ranks.Rank(BestTime->second);
+	const float PercentRank = NumRanks > 1 ? (double)(Rank - 1) / (NumRanks - 1) : 0.0;
+	CScoreWorker::RankMessage(pData, pResult, Rank, BestTime->second, PercentRank, aRegionalRank);
+}
+
+void CScoreCache::TopLines(const CRankList &Ranks, int Offset, int Num, CScorePlayerResult *pResult, int *pLine)
+{
+	const std::vector<CRank> &vRanks = Ranks.m_vRanks;
+	const int Start = maximum(absolute(Offset) - 1, 0);
+	const int Size = vRanks.size();
+	for(int i = Start; i < minimum(Start + Num, Size); i++)
+	{
+		// negative offsets count from the end
+		const int Index = Offset >= 0 ? i : Size - 1 - i;
+		const int Rank = Ranks.Rank(vRanks[Index].m_Time);
+		char aTime[32];
+		str_time_float(vRanks[Index].m_Time, TIME_HOURS_CENTISECS, aTime, sizeof(aTime));
+		str_format(pResult->m_Data.m_aaMessages[*pLine], sizeof(pResult->m_Data.m_aaMessages[*pLine]),
+			"%d. %s Time: %s", Rank, vRanks[Index].m_Name.c_str(), aTime);
+		(*pLine)++;
+	}
+}
+
+void CScoreCache::ShowTop(const CSqlPlayerRequest *pData, CScorePlayerResult *pResult) const
+{
+	int Line = 0;
+	str_copy(pResult->m_Data.m_aaMessages[Line], "------------ Global Top ------------", sizeof(pResult->m_Data.m_aaMessages[Line]));
+	Line++;
+	TopLines(m_Ranks, pData->m_Offset, 5, pResult, &Line);
+
+	if(!g_Config.m_SvRegionalRankings)
+	{
+		str_copy(pResult->m_Data.m_aaMessages[Line], "----------------------------------------", sizeof(pResult->m_Data.m_aaMessages[Line]));
+		return;
+	}
+
+	str_format(pResult->m_Data.m_aaMessages[Line], sizeof(pResult->m_Data.m_aaMessages[Line]),
+		"------------ %s Top ------------", pData->m_aServer);
+	Line++;
+	if(str_comp(pData->m_aServer, m_RegionalServer.c_str()) == 0)
+		TopLines(m_Regional, pData->m_Offset, 3, pResult, &Line);
+	else
+		TopLines(RegionalRanks(pData->m_aServer), pData->m_Offset, 3, pResult, &Line);
+}
+
+void CScoreCache::ShowTeamTop5(const CSqlPlayerRequest *pData, CScorePlayerResult *pResult) const
+{
+	auto *paMessages = pResult->m_Data.m_aaMessages;
+
+	const int Start = maximum(absolute(pData->m_Offset) - 1, 0);
+	const int Size = m_vTeams.size();
+
+	int Line = 0;
+	str_copy(paMessages[Line++], "------- Team Top 5 -------", sizeof(paMessages[Line]));
+	for(int i = Start; i < minimum(Start + 5, Size); i++)
+	{
+		const CTeam &Team = m_vTeams[pData->m_Offset >= 0 ? i : Size - 1 - i];
+		const int Rank = std::lower_bound(m_vTeams.begin(), m_vTeams.end(), Team.m_Time, TeamLess) - m_vTeams.begin() + 1;
+		char aTime[32];
+		str_time_float(Team.m_Time, TIME_HOURS_CENTISECS, aTime, sizeof(aTime));
+
+		const int TeamSize = Team.m_vNames.size();
+		char aNames[2300] = {0};
+		for(int j = 0; j < TeamSize; j++)
+		{
+			str_append(aNames, Team.m_vNames[j].c_str());
+			if(j < TeamSize - 2)
+				str_append(aNames, ", ");
+			else if(j == TeamSize - 2)
+				str_append(aNames, " & ");
+		}
+		str_format(paMessages[Line], sizeof(paMessages[Line]), "%d. %s Team Time: %s",
+			Rank, aNames, aTime);
+		Line++;
+	}
+	str_copy(paMessages[Line], "-------------------------------", sizeof(paMessages[Line]));
+}
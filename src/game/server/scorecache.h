@@ -0,0 +1,103 @@
+#ifndef GAME_SERVER_SCORECACHE_H
+#define GAME_SERVER_SCORECACHE_H
+
+#include "scoreworker.h"
+
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Ranks and team ranks of the current map, so that rank and top queries
+// can be answered without the database. It is loaded once with Load and
+// kept up to date by applying the same changes as SaveScore and
+// SaveTeamScore. The answers are the same as the ones of the corresponding
+// CScoreWorker functions.
+class CScoreCache
+{
+public:
+	CScoreCache() = default;
+	CScoreCache(const CScoreCache &) = delete;
+	CScoreCache(CScoreCache &&) = default;
+	CScoreCache &operator=(CScoreCache &&) = default;
+
+	// fills the CScoreCacheResult of a CSqlScoreCacheRequest
+	static bool Load(IDbConnection *pSqlServer, const ISqlData *pGameData, char *pError, int ErrorSize);
+
+	void SaveScore(const char *pName, const char *pServer, float Time);
+	void SaveTeamScore(std::vector<std::string> vNames, float Time, CUuid TeamrankUuid);
+
+	void ShowRank(const CSqlPlayerRequest *pData, CScorePlayerResult *pResult) const;
+	void ShowTop(const CSqlPlayerRequest *pData, CScorePlayerResult *pResult) const;
+	void ShowTeamTop5(const CSqlPlayerRequest *pData, CScorePlayerResult *pResult) const;
+
+	int NumRanks() const { return m_Ranks.m_vRanks.size(); }
+	int NumTeamRanks() const { return m_vTeams.size(); }
+
+private:
+	struct CRank
+	{
+		std::string m_Name;
+		float m_Time;
+	};
+	struct CTeam
+	{
+		CUuid m_Id;
+		float m_Time;
+		bool m_DDNet7;
+		// sorted
+		std::vector<std::string> m_vNames;
+	};
+
+	// best time of each player, sorted by time and name
+	struct CRankList
+	{
+		std::vector<CRank> m_vRanks;
+		std::unordered_map<std::string, float> m_BestTimes;
+
+		void Add(const char *pName, float Time);
+		// same as RANK() of the database
+		int Rank(float Time) const;
+	};
+
+	static bool RankLess(const CRank &Rank, float Time) { return Rank.m_Time < Time; }
+	static bool TeamLess(const CTeam &Team, float Time) { return Team.m_Time < Time; }
+
+	void AddRank(const char *pName, const char *pServer, float Time);
+	void AddTeam(CTeam &&Team);
+	// best time of each player on servers matching the server name like the
+	// regional rankings, for other server names than the one of m_Regional
+	CRankList RegionalRanks(const char *pServer) const;
+	// appends the lines of a top list with the ranks of the database
+	static void TopLines(const CRankList &Ranks, int Offset, int Num, CScorePlayerResult *pResult, int *pLine);
+
+	CRankList m_Ranks;
+	// ranks on the servers matching m_RegionalServer, the server name of
+	// this server when the cache was loaded
+	std::string m_RegionalServer;
+	CRankList m_Regional;
+	// best time of each player on each server
+	std::map<std::pair<std::string, std::string>, float> m_ServerTimes;
+	// sorted by time and id
+	std::vector<CTeam> m_vTeams;
+};
+
+struct CScoreCacheResult : ISqlResult
+{
+	CScoreCache m_Cache;
+};
+
+struct CSqlScoreCacheRequest : ISqlData
+{
+	CSqlScoreCacheRequest(std::shared_ptr<CScoreCacheResult> pResult) :
+		ISqlData(std::move(pResult))
+	{
+	}
+
+	// current map
+	char m_aMap[MAX_MAP_LENGTH];
+	// server name for the regional rankings
+	char m_aServer[5];
+};
+
+#endif // GAME_SERVER_SCORECACHE_H
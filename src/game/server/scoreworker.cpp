@@ -518,23 +518,14 @@ bool CScoreWorker::SaveScore(IDbConnection *pSqlServer, const ISqlData *pGameDat
 		"	cp1, cp2, cp3, cp4, cp5, cp6, cp7, cp8, cp9, cp10, cp11, cp12, cp13, "
 		"	cp14, cp15, cp16, cp17, cp18, cp19, cp20, cp21, cp22, cp23, cp24, cp25, "
 		"	GameID, DDNet7) "
-		"VALUES (?, ?, %s, %.2f, ?, "
-		"	%.2f, %.2f, %.2f, %.2f, %.2f, %.2f, %.2f, %.2f, %.2f, "
-		"	%.2f, %.2f, %.2f, %.2f, %.2f, %.2f, %.2f, %.2f, %.2f, "
-		"	%.2f, %.2f, %.2f, %.2f, %.2f, %.2f, %.2f, "
+		"VALUES (?, ?, %s, ROUND(?, 2), ?, "
+		"	ROUND(?, 2), ROUND(?, 2), ROUND(?, 2), ROUND(?, 2), ROUND(?, 2), ROUND(?, 2), ROUND(?, 2), ROUND(?, 2), ROUND(?, 2), "
+		"	ROUND(?, 2), ROUND(?, 2), ROUND(?, 2), ROUND(?, 2), ROUND(?, 2), ROUND(?, 2), ROUND(?, 2), ROUND(?, 2), ROUND(?, 2), "
+		"	ROUND(?, 2), ROUND(?, 2), ROUND(?, 2), ROUND(?, 2), ROUND(?, 2), ROUND(?, 2), ROUND(?, 2), "
 		"	?, %s)",
 		pSqlServer->InsertIgnore(), pSqlServer->GetPrefix(),
 		w == Write::NORMAL ? "" : "_backup",
-		pSqlServer->InsertTimestampAsUtc(), pData->m_Time,
-		pData->m_aCurrentTimeCp[0], pData->m_aCurrentTimeCp[1], pData->m_aCurrentTimeCp[2],
-		pData->m_aCurrentTimeCp[3], pData->m_aCurrentTimeCp[4], pData->m_aCurrentTimeCp[5],
-		pData->m_aCurrentTimeCp[6], pData->m_aCurrentTimeCp[7], pData->m_aCurrentTimeCp[8],
-		pData->m_aCurrentTimeCp[9], pData->m_aCurrentTimeCp[10], pData->m_aCurrentTimeCp[11],
-		pData->m_aCurrentTimeCp[12], pData->m_aCurrentTimeCp[13], pData->m_aCurrentTimeCp[14],
-		pData->m_aCurrentTimeCp[15], pData->m_aCurrentTimeCp[16], pData->m_aCurrentTimeCp[17],
-		pData->m_aCurrentTimeCp[18], pData->m_aCurrentTimeCp[19], pData->m_aCurrentTimeCp[20],
-		pData->m_aCurrentTimeCp[21], pData->m_aCurrentTimeCp[22], pData->m_aCurrentTimeCp[23],
-		pData->m_aCurrentTimeCp[24], pSqlServer->False());
+		pSqlServer->InsertTimestampAsUtc(), pSqlServer->False());
 	if(pSqlServer->PrepareStatement(aBuf, pError, ErrorSize))
 	{
 		return true;
@@ -542,8 +533,11 @@ bool CScoreWorker::SaveScore(IDbConnection *pSqlServer, const ISqlData *pGameDat
 	pSqlServer->BindString(1, pData->m_aMap);
 	pSqlServer->BindString(2, pData->m_aName);
 	pSqlServer->BindString(3, pData->m_aTimestamp);
-	pSqlServer->BindString(4, g_Config.m_SvSqlServerName);
-	pSqlServer->BindString(5, pData->m_aGameUuid);
+	pSqlServer->BindFloat(4, pData->m_Time);
+	pSqlServer->BindString(5, g_Config.m_SvSqlServerName);
+	for(int i = 0; i < NUM_CHECKPOINTS; i++)
+		pSqlServer->BindFloat(6 + i, pData->m_aCurrentTimeCp[i]);
+	pSqlServer->BindString(6 + NUM_CHECKPOINTS, pData->m_aGameUuid);
 	pSqlServer->Print();
 	int NumInserted;
 	return pSqlServer->ExecuteUpdate(&NumInserted, pError, ErrorSize);
@@ -666,15 +660,16 @@ bool CScoreWorker::SaveTeamScore(IDbConnection *pSqlServer, const ISqlData *pGam
 			if(pData->m_Time < Time)
 			{
 				str_format(aBuf, sizeof(aBuf),
-					"UPDATE %s_teamrace SET Time=%.2f, Timestamp=%s, DDNet7=%s, GameID=? WHERE ID = ?",
-					pSqlServer->GetPrefix(), pData->m_Time, pSqlServer->InsertTimestampAsUtc(), pSqlServer->False());
+					"UPDATE %s_teamrace SET Time=ROUND(?, 2), Timestamp=%s, DDNet7=%s, GameID=? WHERE ID = ?",
+					pSqlServer->GetPrefix(), pSqlServer->InsertTimestampAsUtc(), pSqlServer->False());
 				if(pSqlServer->PrepareStatement(aBuf, pError, ErrorSize))
 				{
 					return true;
 				}
-				pSqlServer->BindString(1, pData->m_aTimestamp);
-				pSqlServer->BindString(2, pData->m_aGameUuid);
-				pSqlServer->BindBlob(3, Teamrank.m_TeamID.m_aData, sizeof(Teamrank.m_TeamID.m_aData));
+				pSqlServer->BindFloat(1, pData->m_Time);
+				pSqlServer->BindString(2, pData->m_aTimestamp);
+				pSqlServer->BindString(3, pData->m_aGameUuid);
+				pSqlServer->BindBlob(4, Teamrank.m_TeamID.m_aData, sizeof(Teamrank.m_TeamID.m_aData));
 				pSqlServer->Print();
 				int NumUpdated;
 				if(pSqlServer->ExecuteUpdate(&NumUpdated, pError, ErrorSize))
@@ -693,10 +688,10 @@ bool CScoreWorker::SaveTeamScore(IDbConnection *pSqlServer, const ISqlData *pGam
 		// if no entry found... create a new one
 		str_format(aBuf, sizeof(aBuf),
 			"%s INTO %s_teamrace%s(Map, Name, Timestamp, Time, ID, GameID, DDNet7) "
-			"VALUES (?, ?, %s, %.2f, ?, ?, %s)",
+			"VALUES (?, ?, %s, ROUND(?, 2), ?, ?, %s)",
 			pSqlServer->InsertIgnore(), pSqlServer->GetPrefix(),
 			w == Write::NORMAL ? "" : "_backup",
-			pSqlServer->InsertTimestampAsUtc(), pData->m_Time, pSqlServer->False());
+			pSqlServer->InsertTimestampAsUtc(), pSqlServer->False());
 		if(pSqlServer->PrepareStatement(aBuf, pError, ErrorSize))
 		{
 			return true;
@@ -704,10 +699,11 @@ bool CScoreWorker::SaveTeamScore(IDbConnection *pSqlServer, const ISqlData *pGam
 		pSqlServer->BindString(1, pData->m_aMap);
 		pSqlServer->BindString(2, pData->m_aaNames[i]);
 		pSqlServer->BindString(3, pData->m_aTimestamp);
+		pSqlServer->BindFloat(4, pData->m_Time);
 		// copy uuid, because mysql BindBlob doesn't support const buffers
 		CUuid TeamrankId = pData->m_TeamrankUuid;
-		pSqlServer->BindBlob(4, TeamrankId.m_aData, sizeof(TeamrankId.m_aData));
-		pSqlServer->BindString(5, pData->m_aGameUuid);
+		pSqlServer->BindBlob(5, TeamrankId.m_aData, sizeof(TeamrankId.m_aData));
+		pSqlServer->BindString(6, pData->m_aGameUuid);
 		pSqlServer->Print();
 		int NumInserted;
 		if(pSqlServer->ExecuteUpdate(&NumInserted, pError, ErrorSize))
@@ -718,6 +714,54 @@ bool CScoreWorker::SaveTeamScore(IDbConnection *pSqlServer, const ISqlData *pGam
 	return false;
 }
 
+void CScoreWorker::RankMessage(const CSqlPlayerRequest *pData, CScorePlayerResult *pResult, int Rank, float Time, float PercentRank, const char *pRegionalRank)
+{
+	if(Rank == 0)
+	{
+		str_format(pResult->m_Data.m_aaMessages[0], sizeof(pResult->m_Data.m_aaMessages[0]),
+			"%s is not ranked", pData->m_aName);
+		return;
+	}
+
+	// CEIL and FLOOR are not supported in SQLite
+	int BetterThanPercent = std::floor(100.0f - 100.0f * PercentRank);
+	char aTime[32];
+	str_time_float(Time, TIME_HOURS_CENTISECS, aTime, sizeof(aTime));
+	if(g_Config.m_SvHideScore)
+	{
+		str_format(pResult->m_Data.m_aaMessages[0], sizeof(pResult->m_Data.m_aaMessages[0]),
+			"Your time: %s, better than %d%%", aTime, BetterThanPercent);
+		return;
+	}
+
+	pResult->m_MessageKind = CScorePlayerResult::ALL;
+
+	if(str_comp_nocase(pData->m_aRequestingPlayer, pData->m_aName) == 0)
+	{
+		str_format(pResult->m_Data.m_aaMessages[0], sizeof(pResult->m_Data.m_aaMessages[0]),
+			"%s - %s - better than %d%%",
+			pData->m_aName, aTime, BetterThanPercent);
+	}
+	else
+	{
+		str_format(pResult->m_Data.m_aaMessages[0], sizeof(pResult->m_Data.m_aaMessages[0]),
+			"%s - %s - better than %d%% - requested by %s",
+			pData->m_aName, aTime, BetterThanPercent, pData->m_aRequestingPlayer);
+	}
+
+	if(g_Config.m_SvRegionalRankings)
+	{
+		str_format(pResult->m_Data.m_aaMessages[1], sizeof(pResult->m_Data.m_aaMessages[1]),
+			"Global rank %d - %s %s",
+			Rank, pData->m_aServer, pRegionalRank);
+	}
+	else
+	{
+		str_format(pResult->m_Data.m_aaMessages[1], sizeof(pResult->m_Data.m_aaMessages[1]),
+			"Global rank %d", Rank);
+	}
+}
+
 bool CScoreWorker::ShowRank(IDbConnection *pSqlServer, const ISqlData *pGameData, char *pError, int ErrorSize)
 {
 	const auto *pData = dynamic_cast<const CSqlPlayerRequest *>(pGameData);
@@ -780,52 +824,13 @@ bool CScoreWorker::ShowRank(IDbConnection *pSqlServer, const ISqlData *pGameData
 		return true;
 	}
 
-	if(!End)
+	if(End)
 	{
-		int Rank = pSqlServer->GetInt(1);
-		float Time = pSqlServer->GetFloat(2);
-		// CEIL and FLOOR are not supported in SQLite
-		int BetterThanPercent = std::floor(100.0f - 100.0f * pSqlServer->GetFloat(3));
-		str_time_float(Time, TIME_HOURS_CENTISECS, aBuf, sizeof(aBuf));
-		if(g_Config.m_SvHideScore)
-		{
-			str_format(pResult->m_Data.m_aaMessages[0], sizeof(pResult->m_Data.m_aaMessages[0]),
-				"Your time: %s, better than %d%%", aBuf, BetterThanPercent);
-		}
-		else
-		{
-			pResult->m_MessageKind = CScorePlayerResult::ALL;
-
-			if(str_comp_nocase(pData->m_aRequestingPlayer, pData->m_aName) == 0)
-			{
-				str_format(pResult->m_Data.m_aaMessages[0], sizeof(pResult->m_Data.m_aaMessages[0]),
-					"%s - %s - better than %d%%",
-					pData->m_aName, aBuf, BetterThanPercent);
-			}
-			else
-			{
-				str_format(pResult->m_Data.m_aaMessages[0], sizeof(pResult->m_Data.m_aaMessages[0]),
-					"%s - %s - better than %d%% - requested by %s",
-					pData->m_aName, aBuf, BetterThanPercent, pData->m_aRequestingPlayer);
-			}
-
-			if(g_Config.m_SvRegionalRankings)
-			{
-				str_format(pResult->m_Data.m_aaMessages[1], sizeof(pResult->m_Data.m_aaMessages[1]),
-					"Global rank %d - %s %s",
-					Rank, pData->m_aServer, aRegionalRank);
-			}
-			else
-			{
-				str_format(pResult->m_Data.m_aaMessages[1], sizeof(pResult->m_Data.m_aaMessages[1]),
-					"Global rank %d", Rank);
-			}
-		}
+		RankMessage(pData, pResult, 0, 0.0f, 0.0f, aRegionalRank);
 	}
 	else
 	{
-		str_format(pResult->m_Data.m_aaMessages[0], sizeof(pResult->m_Data.m_aaMessages[0]),
-			"%s is not ranked", pData->m_aName);
+		RankMessage(pData, pResult, pSqlServer->GetInt(1), pSqlServer->GetFloat(2), pSqlServer->GetFloat(3), aRegionalRank);
 	}
 	return false;
 }
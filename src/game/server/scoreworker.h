@@ -293,6 +293,8 @@ struct CScoreWorker
 	static bool ShowTimes(IDbConnection *pSqlServer, const ISqlData *pGameData, char *pError, int ErrorSize);
 	static bool ShowPoints(IDbConnection *pSqlServer, const ISqlData *pGameData, char *pError, int ErrorSize);
 	static bool ShowTopPoints(IDbConnection *pSqlServer, const ISqlData *pGameData, char *pError, int ErrorSize);
+	// fills the answer of ShowRank, Rank is 0 if the player has no time
+	static void RankMessage(const CSqlPlayerRequest *pData, CScorePlayerResult *pResult, int Rank, float Time, float PercentRank, const char *pRegionalRank);
 	static bool GetSaves(IDbConnection *pSqlServer, const ISqlData *pGameData, char *pError, int ErrorSize);
 
 	static bool SaveTeam(IDbConnection *pSqlServer, const ISqlData *pGameData, Write w, char *pError, int ErrorSize);
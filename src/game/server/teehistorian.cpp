@@ -4,8 +4,11 @@
 #include <engine/shared/config.h>
 #include <engine/shared/json.h>
 #include <engine/shared/snapshot.h>
+#include <engine/shared/teehistorian_reader.h>
 #include <game/gamecore.h>
 
+#include <zlib.h>
+
 static const char TEEHISTORIAN_NAME[] = "teehistorian@ddnet.tw";
 static const CUuid TEEHISTORIAN_UUID = CalculateUuid(TEEHISTORIAN_NAME);
 static const char TEEHISTORIAN_VERSION[] = "2";
@@ -31,6 +34,9 @@ enum
 	TEEHISTORIAN_EX,
 };
 
+static_assert((int)TEEHISTORIAN_EX == (int)CTeeHistorianReader::RECORD_EX, "the reader must know the record types");
+static_assert(sizeof(CNetObj_PlayerInput) / sizeof(int32_t) == CTeeHistorianReader::NUM_INPUT_INTS, "the reader must know the input size");
+
 CTeeHistorian::CTeeHistorian()
 {
 	m_State = STATE_START;
@@ -818,3 +824,76 @@ void CTeeHistorian::Finish()
 
 	Write(Buffer.Data(), Buffer.Size());
 }
+
+CTeeHistorianCompressor::CTeeHistorianCompressor(int Level, int FlushInterval) :
+	m_pStream(std::make_unique<z_stream>()),
+	m_Initialized(false),
+	m_Level(Level),
+	m_FlushInterval((int64_t)FlushInterval * time_freq()),
+	m_LastFlush(0)
+{
+}
+
+CTeeHistorianCompressor::~CTeeHistorianCompressor()
+{
+	if(m_Initialized)
+	{
+		deflateEnd(m_pStream.get());
+	}
+}
+
+bool CTeeHistorianCompressor::Init()
+{
+	// 16 added to the window bits selects the gzip format
+	m_Initialized = deflateInit2(m_pStream.get(), m_Level, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) == Z_OK;
+	m_LastFlush = time_get();
+	return m_Initialized;
+}
+
+int CTeeHistorianCompressor::Write(IOHANDLE File, const void *pData, unsigned Size, int Finish, void *pUser)
+{
+	return ((CTeeHistorianCompressor *)pUser)->Compress(File, pData, Size, Finish);
+}
+
+int CTeeHistorianCompressor::Compress(IOHANDLE File, const void *pData, unsigned Size, bool Finish)
+{
+	const int64_t Start = time_get();
+	int Flush = Z_NO_FLUSH;
+	if(Finish)
+	{
+		Flush = Z_FINISH;
+	}
+	else if(Start - m_LastFlush >= m_FlushInterval)
+	{
+		Flush = Z_SYNC_FLUSH;
+		m_LastFlush = Start;
+		m_NumFlushes++;
+	}
+
+	m_pStream->next_in = (Bytef *)pData;
+	m_pStream->avail_in = Size;
+	unsigned char aOut[16 * 1024];
+	do
+	{
+		m_pStream->next_out = aOut;
+		m_pStream->avail_out = sizeof(aOut);
+		if(deflate(m_pStream.get(), Flush) == Z_STREAM_ERROR)
+		{
+			return 1;
+		}
+		const unsigned Have = sizeof(aOut) - m_pStream->avail_out;
+		if(Have > 0)
+		{
+			io_write(File, aOut, Have);
+			m_BytesOut += Have;
+		}
+	} while(m_pStream->avail_out == 0);
+	m_BytesIn += Size;
+
+	if(Flush != Z_NO_FLUSH)
+	{
+		io_flush(File);
+	}
+	m_CompressTime += time_get() - Start;
+	return io_error(File);
+}
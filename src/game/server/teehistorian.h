@@ -6,7 +6,9 @@
 #include <engine/shared/protocol.h>
 #include <game/generated/protocol.h>
 
+#include <atomic>
 #include <ctime>
+#include <memory>
 
 class CConfig;
 class CTuningParams;
@@ -144,4 +146,40 @@ private:
 	CTeam m_aPrevTeams[MAX_CLIENTS];
 };
 
+// Compresses the teehistorian into the gzip format, used as writer of the
+// asynchronous file so that the compression runs on its thread. The stream
+// is flushed at least every flush interval, a file that is cut off by a
+// crash can be decompressed up to the last flush.
+class CTeeHistorianCompressor
+{
+public:
+	// FlushInterval in seconds, 0 flushes every write
+	CTeeHistorianCompressor(int Level, int FlushInterval);
+	~CTeeHistorianCompressor();
+
+	bool Init();
+	// ASYNCIO_WRITER
+	static int Write(IOHANDLE File, const void *pData, unsigned Size, int Finish, void *pUser);
+
+	int64_t BytesIn() const { return m_BytesIn; }
+	int64_t BytesOut() const { return m_BytesOut; }
+	int NumFlushes() const { return m_NumFlushes; }
+	// in time_get() units
+	int64_t CompressTime() const { return m_CompressTime; }
+
+private:
+	int Compress(IOHANDLE File, const void *pData, unsigned Size, bool Finish);
+
+	std::unique_ptr<struct z_stream_s> m_pStream;
+	bool m_Initialized;
+	int m_Level;
+	int64_t m_FlushInterval;
+	int64_t m_LastFlush;
+
+	std::atomic<int64_t> m_BytesIn{0};
+	std::atomic<int64_t> m_BytesOut{0};
+	std::atomic<int> m_NumFlushes{0};
+	std::atomic<int64_t> m_CompressTime{0};
+};
+
 #endif // GAME_SERVER_TEEHISTORIAN_H
@@ -144,3 +144,39 @@ TEST_F(Async, Transaction)
 	}
 	Expect(aText);
 }
+
+static int UpperWriter(IOHANDLE io, const void *buffer, unsigned size, int finish, void *user)
+{
+	if(finish)
+	{
+		(*(int *)user)++;
+		return io_write(io, "!", 1) != 1;
+	}
+	char aBuf[BUF_SIZE];
+	for(unsigned i = 0; i < size; i++)
+		aBuf[i] = str_uppercase(((const char *)buffer)[i]);
+	return io_write(io, aBuf, size) != size;
+}
+
+TEST_F(Async, Writer)
+{
+	aio_close(m_pAio);
+	aio_wait(m_pAio);
+	aio_free(m_pAio);
+
+	int NumFinished = 0;
+	IOHANDLE File = io_open(m_Info.m_aFilename, IOFLAG_WRITE);
+	ASSERT_TRUE(File);
+	m_pAio = aio_new_writer(File, UpperWriter, &NumFinished);
+	for(int i = 0; i < 1000; i++)
+		Write("abc");
+	EXPECT_LE(aio_backlog(m_pAio), 3000u);
+
+	char aText[3000 + 2];
+	for(int i = 0; i < 3000; i++)
+		aText[i] = 'A' + i % 3;
+	aText[3000] = '!';
+	aText[3001] = 0;
+	Expect(aText);
+	EXPECT_EQ(NumFinished, 1);
+}
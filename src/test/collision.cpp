@@ -0,0 +1,441 @@
+#include <gtest/gtest.h>
+
+#include <base/system.h>
+#include <engine/map.h>
+#include <engine/shared/config.h>
+#include <game/collision.h>
+#include <game/layers.h>
+#include <game/mapitems.h>
+#include <game/prng.h>
+#include <test/test.h>
+
+#include <cmath>
+#include <vector>
+
+namespace {
+
+// a map with one group that contains the game layer and optionally the
+// tele and front layers
+class CTestMap : public IMap
+{
+public:
+	enum
+	{
+		LAYER_GAME,
+		LAYER_TELE,
+		LAYER_FRONT,
+		NUM_LAYERS,
+	};
+
+	CMapItemGroup m_Group;
+	CMapItemLayerTilemap m_aLayers[NUM_LAYERS];
+	std::vector<CTile> m_vTiles;
+	std::vector<CTeleTile> m_vTeleTiles;
+	std::vector<CTile> m_vFrontTiles;
+
+	CTestMap(int Width, int Height)
+	{
+		mem_zero(&m_Group, sizeof(m_Group));
+		m_Group.m_Version = CMapItemGroup::CURRENT_VERSION;
+		m_Group.m_StartLayer = 0;
+		m_Group.m_NumLayers = 1;
+
+		static const int s_aFlags[NUM_LAYERS] = {TILESLAYERFLAG_GAME, TILESLAYERFLAG_TELE, TILESLAYERFLAG_FRONT};
+		for(int i = 0; i < NUM_LAYERS; i++)
+		{
+			CMapItemLayerTilemap &Layer = m_aLayers[i];
+			mem_zero(&Layer, sizeof(Layer));
+			Layer.m_Layer.m_Type = LAYERTYPE_TILES;
+			Layer.m_Version = 3;
+			Layer.m_Width = Width;
+			Layer.m_Height = Height;
+			Layer.m_Flags = s_aFlags[i];
+			Layer.m_Data = 0;
+		}
+		m_aLayers[LAYER_TELE].m_Tele = LAYER_TELE;
+		m_aLayers[LAYER_FRONT].m_Front = LAYER_FRONT;
+
+		m_vTiles.resize((size_t)Width * Height);
+		mem_zero(m_vTiles.data(), m_vTiles.size() * sizeof(CTile));
+		m_vTeleTiles.resize((size_t)Width * Height);
+		mem_zero(m_vTeleTiles.data(), m_vTeleTiles.size() * sizeof(CTeleTile));
+		m_vFrontTiles.resize((size_t)Width * Height);
+		mem_zero(m_vFrontTiles.data(), m_vFrontTiles.size() * sizeof(CTile));
+	}
+
+	int GetDataSize(int Index) const override
+	{
+		switch(Index)
+		{
+		case LAYER_GAME: return m_vTiles.size() * sizeof(CTile);
+		case LAYER_TELE: return m_vTeleTiles.size() * sizeof(CTeleTile);
+		case LAYER_FRONT: return m_vFrontTiles.size() * sizeof(CTile);
+		default: return 0;
+		}
+	}
+	void *GetData(int Index) override
+	{
+		switch(Index)
+		{
+		case LAYER_GAME: return m_vTiles.data();
+		case LAYER_TELE: return m_vTeleTiles.data();
+		case LAYER_FRONT: return m_vFrontTiles.data();
+		default: return nullptr;
+		}
+	}
+	void *GetDataSwapped(int Index) override { return GetData(Index); }
+	const char *GetDataString(int Index) override { return nullptr; }
+	void UnloadData(int Index) override {}
+	int NumData() const override { return NUM_LAYERS; }
+
+	int GetItemSize(int Index) override { return Index == 0 ? sizeof(m_Group) : sizeof(CMapItemLayerTilemap); }
+	void *GetItem(int Index, int *pType = nullptr, int *pID = nullptr) override
+	{
+		if(pType)
+			*pType = Index == 0 ? MAPITEMTYPE_GROUP : MAPITEMTYPE_LAYER;
+		if(pID)
+			*pID = 0;
+		return Index == 0 ? (void *)&m_Group : (void *)&m_aLayers[Index - 1];
+	}
+	void GetType(int Type, int *pStart, int *pNum) override
+	{
+		*pStart = Type == MAPITEMTYPE_LAYER ? 1 : 0;
+		*pNum = Type == MAPITEMTYPE_GROUP ? 1 : Type == MAPITEMTYPE_LAYER ? m_Group.m_NumLayers : 0;
+	}
+	int FindItemIndex(int Type, int ID) override { return -1; }
+	void *FindItem(int Type, int ID) override { return nullptr; }
+	int NumItems() const override { return 1 + m_Group.m_NumLayers; }
+};
+
+class Collision : public ::testing::Test
+{
+protected:
+	CTestMap m_Map;
+	CLayers m_Layers;
+	CCollision m_Collision;
+	CPrng m_Prng;
+
+	Collision() :
+		m_Map(100, 80)
+	{
+		uint64_t aSeed[2] = {3, 4};
+		m_Prng.Seed(aSeed);
+
+		static const int s_aIndices[] = {TILE_SOLID, TILE_NOHOOK, TILE_NOLASER, TILE_THROUGH, TILE_THROUGH_ALL, TILE_THROUGH_DIR, TILE_FREEZE, TILE_UNFREEZE};
+		for(CTile &Tile : m_Map.m_vTiles)
+		{
+			if(m_Prng.RandomBits() % 8 == 0)
+			{
+				Tile.m_Index = s_aIndices[m_Prng.RandomBits() % std::size(s_aIndices)];
+				Tile.m_Flags = (m_Prng.RandomBits() % 4) * ROTATION_90;
+			}
+		}
+		m_Layers.InitBackground(&m_Map);
+		m_Collision.Init(&m_Layers);
+	}
+
+	void AddTeleAndFrontLayers()
+	{
+		static const int s_aTeleTypes[] = {TILE_TELEIN, TILE_TELEINEVIL, TILE_TELEINWEAPON, TILE_TELEINHOOK, TILE_TELEOUT};
+		for(CTeleTile &Tile : m_Map.m_vTeleTiles)
+		{
+			if(m_Prng.RandomBits() % 16 == 0)
+			{
+				Tile.m_Type = s_aTeleTypes[m_Prng.RandomBits() % std::size(s_aTeleTypes)];
+				Tile.m_Number = 1 + m_Prng.RandomBits() % 3;
+			}
+		}
+		static const int s_aFrontIndices[] = {TILE_NOLASER, TILE_THROUGH, TILE_THROUGH_ALL, TILE_THROUGH_DIR, TILE_THROUGH_CUT, TILE_FREEZE, TILE_DEATH};
+		for(CTile &Tile : m_Map.m_vFrontTiles)
+		{
+			if(m_Prng.RandomBits() % 8 == 0)
+			{
+				Tile.m_Index = s_aFrontIndices[m_Prng.RandomBits() % std::size(s_aFrontIndices)];
+				Tile.m_Flags = (m_Prng.RandomBits() % 4) * ROTATION_90;
+			}
+		}
+		m_Map.m_Group.m_NumLayers = CTestMap::NUM_LAYERS;
+		m_Layers.InitBackground(&m_Map);
+		m_Collision.Init(&m_Layers);
+	}
+
+	float RandomCoord(float Size)
+	{
+		return (float)m_Prng.RandomBits() / 0xffffffffu * (Size + 400.0f) - 200.0f;
+	}
+
+	vec2 RandomPos()
+	{
+		return vec2(RandomCoord(m_Map.m_aLayers[CTestMap::LAYER_GAME].m_Width * 32), RandomCoord(m_Map.m_aLayers[CTestMap::LAYER_GAME].m_Height * 32));
+	}
+
+	vec2 RandomLineEnd(vec2 Pos0)
+	{
+		switch(m_Prng.RandomBits() % 4)
+		{
+		case 0: // degenerate
+			return Pos0;
+		case 1: // vertical
+			return vec2(Pos0.x, RandomCoord(m_Map.m_aLayers[CTestMap::LAYER_GAME].m_Height * 32));
+		case 2: // short
+			return Pos0 + vec2((float)m_Prng.RandomBits() / 0xffffffffu * 64.0f - 32.0f, (float)m_Prng.RandomBits() / 0xffffffffu * 64.0f - 32.0f);
+		default:
+			return RandomPos();
+		}
+	}
+
+	// the implementations from before the lines were walked tile by tile, sampling every unit
+	int RefIntersectLine(vec2 Pos0, vec2 Pos1, vec2 *pOutCollision, vec2 *pOutBeforeCollision) const
+	{
+		float Distance = distance(Pos0, Pos1);
+		int End(Distance + 1);
+		vec2 Last = Pos0;
+		for(int i = 0; i <= End; i++)
+		{
+			float a = i / (float)End;
+			vec2 Pos = mix(Pos0, Pos1, a);
+			int ix = round_to_int(Pos.x);
+			int iy = round_to_int(Pos.y);
+			if(m_Collision.CheckPoint(ix, iy))
+			{
+				*pOutCollision = Pos;
+				*pOutBeforeCollision = Last;
+				return m_Collision.GetCollisionAt(ix, iy);
+			}
+			Last = Pos;
+		}
+		*pOutCollision = Pos1;
+		*pOutBeforeCollision = Pos1;
+		return 0;
+	}
+
+	int RefIntersectLineTeleWeapon(vec2 Pos0, vec2 Pos1, vec2 *pOutCollision, vec2 *pOutBeforeCollision, int *pTeleNr) const
+	{
+		float Distance = distance(Pos0, Pos1);
+		int End(Distance + 1);
+		vec2 Last = Pos0;
+		for(int i = 0; i <= End; i++)
+		{
+			float a = i / (float)End;
+			vec2 Pos = mix(Pos0, Pos1, a);
+			int ix = round_to_int(Pos.x);
+			int iy = round_to_int(Pos.y);
+
+			int Index = m_Collision.GetPureMapIndex(Pos);
+			if(g_Config.m_SvOldTeleportWeapons)
+				*pTeleNr = m_Collision.IsTeleport(Index);
+			else
+				*pTeleNr = m_Collision.IsTeleportWeapon(Index);
+			if(*pTeleNr)
+			{
+				*pOutCollision = Pos;
+				*pOutBeforeCollision = Last;
+				return TILE_TELEINWEAPON;
+			}
+
+			if(m_Collision.CheckPoint(ix, iy))
+			{
+				*pOutCollision = Pos;
+				*pOutBeforeCollision = Last;
+				return m_Collision.GetCollisionAt(ix, iy);
+			}
+			Last = Pos;
+		}
+		*pOutCollision = Pos1;
+		*pOutBeforeCollision = Pos1;
+		return 0;
+	}
+
+	int RefIntersectLineTeleHook(vec2 Pos0, vec2 Pos1, vec2 *pOutCollision, vec2 *pOutBeforeCollision, int *pTeleNr) const
+	{
+		float Distance = distance(Pos0, Pos1);
+		int End(Distance + 1);
+		vec2 Last = Pos0;
+		int dx = 0, dy = 0;
+		ThroughOffset(Pos0, Pos1, &dx, &dy);
+		for(int i = 0; i <= End; i++)
+		{
+			float a = i / (float)End;
+			vec2 Pos = mix(Pos0, Pos1, a);
+			int ix = round_to_int(Pos.x);
+			int iy = round_to_int(Pos.y);
+
+			int Index = m_Collision.GetPureMapIndex(Pos);
+			if(g_Config.m_SvOldTeleportHook)
+				*pTeleNr = m_Collision.IsTeleport(Index);
+			else
+				*pTeleNr = m_Collision.IsTeleportHook(Index);
+			if(*pTeleNr)
+			{
+				*pOutCollision = Pos;
+				*pOutBeforeCollision = Last;
+				return TILE_TELEINHOOK;
+			}
+
+			int hit = 0;
+			if(m_Collision.CheckPoint(ix, iy))
+			{
+				if(!m_Collision.IsThrough(ix, iy, dx, dy, Pos0, Pos1))
+					hit = m_Collision.GetCollisionAt(ix, iy);
+			}
+			else if(m_Collision.IsHookBlocker(ix, iy, Pos0, Pos1))
+			{
+				hit = TILE_NOHOOK;
+			}
+			if(hit)
+			{
+				*pOutCollision = Pos;
+				*pOutBeforeCollision = Last;
+				return hit;
+			}
+			Last = Pos;
+		}
+		*pOutCollision = Pos1;
+		*pOutBeforeCollision = Pos1;
+		return 0;
+	}
+
+	int RefIntersectNoLaser(vec2 Pos0, vec2 Pos1, vec2 *pOutCollision, vec2 *pOutBeforeCollision) const
+	{
+		float d = distance(Pos0, Pos1);
+		vec2 Last = Pos0;
+		for(int i = 0, id = std::ceil(d); i < id; i++)
+		{
+			float a = (int)i / d;
+			vec2 Pos = mix(Pos0, Pos1, a);
+			int Nx = clamp(round_to_int(Pos.x) / 32, 0, m_Collision.GetWidth() - 1);
+			int Ny = clamp(round_to_int(Pos.y) / 32, 0, m_Collision.GetHeight() - 1);
+			if(m_Collision.GetIndex(Nx, Ny) == TILE_SOLID || m_Collision.GetIndex(Nx, Ny) == TILE_NOHOOK || m_Collision.GetIndex(Nx, Ny) == TILE_NOLASER || m_Collision.GetFIndex(Nx, Ny) == TILE_NOLASER)
+			{
+				*pOutCollision = Pos;
+				*pOutBeforeCollision = Last;
+				if(m_Collision.GetFIndex(Nx, Ny) == TILE_NOLASER)
+					return m_Collision.GetFCollisionAt(Pos.x, Pos.y);
+				else
+					return m_Collision.GetCollisionAt(Pos.x, Pos.y);
+			}
+			Last = Pos;
+		}
+		*pOutCollision = Pos1;
+		*pOutBeforeCollision = Pos1;
+		return 0;
+	}
+
+	std::vector<int> RefGetMapIndices(vec2 PrevPos, vec2 Pos, unsigned MaxIndices) const
+	{
+		std::vector<int> vIndices;
+		float d = distance(PrevPos, Pos);
+		int End(d + 1);
+		if(!d)
+			return m_Collision.GetMapIndices(PrevPos, Pos, MaxIndices);
+		int LastIndex = 0;
+		for(int i = 0; i < End; i++)
+		{
+			float a = i / d;
+			vec2 Tmp = mix(PrevPos, Pos, a);
+			int Nx = clamp((int)Tmp.x / 32, 0, m_Collision.GetWidth() - 1);
+			int Ny = clamp((int)Tmp.y / 32, 0, m_Collision.GetHeight() - 1);
+			int Index = Ny * m_Collision.GetWidth() + Nx;
+			if(m_Collision.TileExists(Index) && LastIndex != Index)
+			{
+				if(MaxIndices && vIndices.size() > MaxIndices)
+					return vIndices;
+				vIndices.push_back(Index);
+				LastIndex = Index;
+			}
+		}
+		return vIndices;
+	}
+
+	void ExpectSameAsSampling(int NumLines)
+	{
+		for(int i = 0; i < NumLines; i++)
+		{
+			vec2 Pos0 = RandomPos();
+			vec2 Pos1 = RandomLineEnd(Pos0);
+			vec2 aOut[2], aBefore[2];
+			int aTeleNr[2];
+
+			int Expected = RefIntersectLine(Pos0, Pos1, &aOut[0], &aBefore[0]);
+			EXPECT_EQ(m_Collision.IntersectLine(Pos0, Pos1, &aOut[1], &aBefore[1]), Expected);
+			EXPECT_EQ(aOut[0], aOut[1]);
+			EXPECT_EQ(aBefore[0], aBefore[1]);
+
+			Expected = RefIntersectLineTeleHook(Pos0, Pos1, &aOut[0], &aBefore[0], &aTeleNr[0]);
+			EXPECT_EQ(m_Collision.IntersectLineTeleHook(Pos0, Pos1, &aOut[1], &aBefore[1], &aTeleNr[1]), Expected);
+			EXPECT_EQ(aOut[0], aOut[1]);
+			EXPECT_EQ(aBefore[0], aBefore[1]);
+			EXPECT_EQ(aTeleNr[0], aTeleNr[1]);
+
+			Expected = RefIntersectLineTeleWeapon(Pos0, Pos1, &aOut[0], &aBefore[0], &aTeleNr[0]);
+			EXPECT_EQ(m_Collision.IntersectLineTeleWeapon(Pos0, Pos1, &aOut[1], &aBefore[1], &aTeleNr[1]), Expected);
+			EXPECT_EQ(aOut[0], aOut[1]);
+			EXPECT_EQ(aBefore[0], aBefore[1]);
+			EXPECT_EQ(aTeleNr[0], aTeleNr[1]);
+
+			Expected = RefIntersectNoLaser(Pos0, Pos1, &aOut[0], &aBefore[0]);
+			EXPECT_EQ(m_Collision.IntersectNoLaser(Pos0, Pos1, &aOut[1], &aBefore[1]), Expected);
+			EXPECT_EQ(aOut[0], aOut[1]);
+			EXPECT_EQ(aBefore[0], aBefore[1]);
+
+			for(unsigned MaxIndices : {0u, 3u})
+				EXPECT_EQ(m_Collision.GetMapIndices(Pos0, Pos1, MaxIndices), RefGetMapIndices(Pos0, Pos1, MaxIndices));
+
+			if(HasFailure())
+			{
+				ADD_FAILURE() << "line " << Pos0.x << "," << Pos0.y << " -> " << Pos1.x << "," << Pos1.y;
+				break;
+			}
+		}
+	}
+};
+
+}
+
+TEST_F(Collision, IntersectLineMatchesSampling)
+{
+	ExpectSameAsSampling(2000);
+}
+
+TEST_F(Collision, IntersectLineMatchesSamplingTeleFront)
+{
+	AddTeleAndFrontLayers();
+	const int OldTeleportHook = g_Config.m_SvOldTeleportHook;
+	const int OldTeleportWeapons = g_Config.m_SvOldTeleportWeapons;
+	for(int Old = 0; Old <= 1 && !HasFailure(); Old++)
+	{
+		g_Config.m_SvOldTeleportHook = Old;
+		g_Config.m_SvOldTeleportWeapons = Old;
+		ExpectSameAsSampling(2000);
+	}
+	g_Config.m_SvOldTeleportHook = OldTeleportHook;
+	g_Config.m_SvOldTeleportWeapons = OldTeleportWeapons;
+}
+
+TEST_F(Collision, DISABLED_IntersectLineBenchmark)
+{
+	const int NUM_LINES = 50000;
+	std::vector<vec2> vLines;
+	for(int i = 0; i < NUM_LINES; i++)
+	{
+		vLines.push_back(RandomPos());
+		vLines.push_back(RandomPos());
+	}
+
+	vec2 Out, Before;
+	int Hits = 0;
+	int64_t Start = time_get();
+	for(int i = 0; i < NUM_LINES; i++)
+		Hits += RefIntersectLine(vLines[i * 2], vLines[i * 2 + 1], &Out, &Before) != 0;
+	int64_t Sampled = time_get() - Start;
+
+	int WalkedHits = 0;
+	Start = time_get();
+	for(int i = 0; i < NUM_LINES; i++)
+		WalkedHits += m_Collision.IntersectLine(vLines[i * 2], vLines[i * 2 + 1], &Out, &Before) != 0;
+	int64_t Walked = time_get() - Start;
+
+	EXPECT_EQ(Hits, WalkedHits);
+	RecordDuration("sampled", Sampled);
+	RecordDuration("walked", Walked);
+}
@@ -0,0 +1,209 @@
+#include "test.h"
+#include <gtest/gtest.h>
+
+#include <base/system.h>
+#include <engine/server/databases/connection.h>
+#include <engine/server/databases/connection_pool.h>
+#include <engine/shared/config.h>
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+using namespace std::chrono_literals;
+
+struct CTestQuery : ISqlData
+{
+	CTestQuery(int Value, std::atomic_bool *pRelease, std::atomic_int *pRunning, std::vector<int> *pvOrder) :
+		ISqlData(std::make_shared<ISqlResult>()),
+		m_Value(Value),
+		m_pRelease(pRelease),
+		m_pRunning(pRunning),
+		m_pvOrder(pvOrder)
+	{
+	}
+
+	int m_Value;
+	// the query waits until it is set, if given
+	std::atomic_bool *m_pRelease;
+	std::atomic_int *m_pRunning;
+	std::vector<int> *m_pvOrder;
+};
+
+static bool TestRead(IDbConnection *pSqlServer, const ISqlData *pGameData, char *pError, int ErrorSize)
+{
+	const CTestQuery *pQuery = static_cast<const CTestQuery *>(pGameData);
+	if(pQuery->m_pRunning)
+		(*pQuery->m_pRunning)++;
+	while(pQuery->m_pRelease && !*pQuery->m_pRelease)
+		std::this_thread::sleep_for(1ms);
+	if(pQuery->m_pRunning)
+		(*pQuery->m_pRunning)--;
+	return pSqlServer->PrepareStatement("SELECT COUNT(*) FROM record_race", pError, ErrorSize);
+}
+
+static bool TestWrite(IDbConnection *pSqlServer, const ISqlData *pGameData, Write w, char *pError, int ErrorSize)
+{
+	const CTestQuery *pQuery = static_cast<const CTestQuery *>(pGameData);
+	while(pQuery->m_pRelease && !*pQuery->m_pRelease)
+		std::this_thread::sleep_for(1ms);
+	if(pQuery->m_pvOrder)
+		pQuery->m_pvOrder->push_back(pQuery->m_Value);
+	return pSqlServer->PrepareStatement("SELECT COUNT(*) FROM record_race", pError, ErrorSize);
+}
+
+static bool WaitCompleted(const std::shared_ptr<ISqlResult> &pResult)
+{
+	for(int i = 0; i < 10000 && !pResult->m_Completed; i++)
+		std::this_thread::sleep_for(1ms);
+	return pResult->m_Completed;
+}
+
+class ConnectionPool : public ::testing::Test
+{
+protected:
+	CTestInfo m_Info;
+	char m_aFilename[64];
+	int m_OldReadWorkers;
+	std::unique_ptr<CDbConnectionPool> m_pPool;
+
+	void SetUp() override
+	{
+		m_OldReadWorkers = g_Config.m_SvSqlReadWorkers;
+		g_Config.m_SvSqlReadWorkers = 2;
+		m_Info.Filename(m_aFilename, sizeof(m_aFilename), ".sqlite");
+		m_pPool = std::make_unique<CDbConnectionPool>();
+		m_pPool->RegisterSqliteDatabase(CDbConnectionPool::READ, m_aFilename);
+		m_pPool->RegisterSqliteDatabase(CDbConnectionPool::WRITE, m_aFilename);
+	}
+
+	void TearDown() override
+	{
+		m_pPool.reset();
+		g_Config.m_SvSqlReadWorkers = m_OldReadWorkers;
+		char aBuf[IO_MAX_PATH_LENGTH];
+		fs_remove(m_aFilename);
+		str_format(aBuf, sizeof(aBuf), "%s-wal", m_aFilename);
+		fs_remove(aBuf);
+		str_format(aBuf, sizeof(aBuf), "%s-shm", m_aFilename);
+		fs_remove(aBuf);
+	}
+
+	std::shared_ptr<ISqlResult> Read(std::atomic_bool *pRelease = nullptr, std::atomic_int *pRunning = nullptr)
+	{
+		auto pQuery = std::make_unique<CTestQuery>(0, pRelease, pRunning, nullptr);
+		std::shared_ptr<ISqlResult> pResult = pQuery->m_pResult;
+		m_pPool->Execute(TestRead, std::move(pQuery), "test read");
+		return pResult;
+	}
+
+	std::shared_ptr<ISqlResult> Write(int Value = 0, std::vector<int> *pvOrder = nullptr, std::atomic_bool *pRelease = nullptr)
+	{
+		auto pQuery = std::make_unique<CTestQuery>(Value, pRelease, nullptr, pvOrder);
+		std::shared_ptr<ISqlResult> pResult = pQuery->m_pResult;
+		m_pPool->ExecuteWrite(TestWrite, std::move(pQuery), "test write");
+		return pResult;
+	}
+};
+
+TEST_F(ConnectionPool, SlowReadDoesNotBlockWrites)
+{
+	std::atomic_bool Release{false};
+	std::shared_ptr<ISqlResult> pSlowRead = Read(&Release);
+	std::shared_ptr<ISqlResult> pWrite = Write();
+	std::shared_ptr<ISqlResult> pRead = Read();
+
+	EXPECT_TRUE(WaitCompleted(pWrite));
+	EXPECT_TRUE(pWrite->m_Success);
+	EXPECT_TRUE(WaitCompleted(pRead));
+	EXPECT_TRUE(pRead->m_Success);
+	EXPECT_FALSE(pSlowRead->m_Completed);
+
+	Release = true;
+	EXPECT_TRUE(WaitCompleted(pSlowRead));
+	EXPECT_TRUE(pSlowRead->m_Success);
+}
+
+TEST_F(ConnectionPool, ReadsWaitForEarlierWrites)
+{
+	std::atomic_bool Release{false};
+	std::shared_ptr<ISqlResult> pEarlierRead = Read();
+	std::shared_ptr<ISqlResult> pSlowWrite = Write(0, nullptr, &Release);
+	std::shared_ptr<ISqlResult> pLaterRead = Read();
+
+	EXPECT_TRUE(WaitCompleted(pEarlierRead));
+	std::this_thread::sleep_for(50ms);
+	EXPECT_FALSE(pSlowWrite->m_Completed);
+	EXPECT_FALSE(pLaterRead->m_Completed);
+
+	Release = true;
+	EXPECT_TRUE(WaitCompleted(pLaterRead));
+	EXPECT_TRUE(pLaterRead->m_Success);
+	EXPECT_TRUE(pSlowWrite->m_Completed);
+}
+
+TEST_F(ConnectionPool, ReadsRunInParallel)
+{
+	std::atomic_bool Release{false};
+	std::atomic_int Running{0};
+	std::shared_ptr<ISqlResult> pFirst = Read(&Release, &Running);
+	std::shared_ptr<ISqlResult> pSecond = Read(&Release, &Running);
+	for(int i = 0; i < 10000 && Running < 2; i++)
+		std::this_thread::sleep_for(1ms);
+	EXPECT_EQ(Running, 2);
+
+	Release = true;
+	EXPECT_TRUE(WaitCompleted(pFirst));
+	EXPECT_TRUE(WaitCompleted(pSecond));
+}
+
+TEST_F(ConnectionPool, WritesInOrder)
+{
+	std::vector<int> vOrder;
+	std::vector<std::shared_ptr<ISqlResult>> vpResults;
+	for(int i = 0; i < 50; i++)
+	{
+		vpResults.push_back(Write(i, &vOrder));
+		if(i % 10 == 0)
+			Read();
+	}
+	for(auto &pResult : vpResults)
+		ASSERT_TRUE(WaitCompleted(pResult));
+
+	ASSERT_EQ(vOrder.size(), 50u);
+	for(int i = 0; i < 50; i++)
+		EXPECT_EQ(vOrder[i], i);
+}
+
+TEST_F(ConnectionPool, ShutdownDismissesReads)
+{
+	// keep both read workers busy until the pool is shut down
+	std::atomic_bool Release{false};
+	std::atomic_int Running{0};
+	std::shared_ptr<ISqlResult> pFirst = Read(&Release, &Running);
+	std::shared_ptr<ISqlResult> pSecond = Read(&Release, &Running);
+	for(int i = 0; i < 10000 && Running < 2; i++)
+		std::this_thread::sleep_for(1ms);
+	std::vector<std::shared_ptr<ISqlResult>> vpReads;
+	for(int i = 0; i < 10; i++)
+		vpReads.push_back(Read());
+	std::shared_ptr<ISqlResult> pWrite = Write();
+
+	std::thread Releaser([&]() {
+		std::this_thread::sleep_for(50ms);
+		Release = true;
+	});
+	m_pPool->OnShutdown();
+	Releaser.join();
+
+	EXPECT_TRUE(pFirst->m_Completed);
+	EXPECT_TRUE(pSecond->m_Completed);
+	EXPECT_TRUE(pWrite->m_Completed);
+	EXPECT_TRUE(pWrite->m_Success);
+	for(auto &pRead : vpReads)
+	{
+		EXPECT_TRUE(pRead->m_Completed);
+		EXPECT_FALSE(pRead->m_Success);
+	}
+}
@@ -0,0 +1,126 @@
+#include <gtest/gtest.h>
+
+#include <base/system.h>
+#include <engine/console.h>
+#include <engine/shared/config.h>
+#include <test/test.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+static void CountCallback(IConsole::IResult *pResult, void *pUserData)
+{
+	*static_cast<int *>(pUserData) += pResult->NumArguments() ? pResult->GetInteger(0) : 1;
+}
+
+TEST(Console, FindsCommandsIgnoringCase)
+{
+	std::unique_ptr<IConsole> pConsole = CreateConsole(CFGFLAG_SERVER);
+	int Count = 0;
+	pConsole->Register("sv_test_command", "?i[value]", CFGFLAG_SERVER, CountCallback, &Count, "");
+
+	ASSERT_TRUE(pConsole->GetCommandInfo("SV_Test_Command", CFGFLAG_SERVER, false));
+	EXPECT_STREQ(pConsole->GetCommandInfo("SV_Test_Command", CFGFLAG_SERVER, false)->m_pName, "sv_test_command");
+	EXPECT_FALSE(pConsole->GetCommandInfo("sv_test_command", CFGFLAG_CLIENT, false));
+	EXPECT_FALSE(pConsole->GetCommandInfo("sv_test_comman", CFGFLAG_SERVER, false));
+
+	pConsole->ExecuteLine("SV_TEST_COMMAND 3; sv_test_command 4");
+	EXPECT_EQ(Count, 7);
+}
+
+TEST(Console, SameNameDifferentFlags)
+{
+	std::unique_ptr<IConsole> pConsole = CreateConsole(CFGFLAG_SERVER);
+	int ServerCount = 0;
+	int ClientCount = 0;
+	pConsole->Register("shared", "?i", CFGFLAG_SERVER, CountCallback, &ServerCount, "");
+	pConsole->Register("shared", "?i", CFGFLAG_CLIENT, CountCallback, &ClientCount, "");
+
+	pConsole->ExecuteLine("shared 2");
+	EXPECT_EQ(ServerCount, 2);
+	EXPECT_EQ(ClientCount, 0);
+
+	pConsole->SetFlagMask(CFGFLAG_CLIENT);
+	pConsole->ExecuteLine("shared 5");
+	EXPECT_EQ(ServerCount, 2);
+	EXPECT_EQ(ClientCount, 5);
+}
+
+TEST(Console, TempCommands)
+{
+	std::unique_ptr<IConsole> pConsole = CreateConsole(CFGFLAG_SERVER);
+	pConsole->RegisterTemp("temp_a", "", CFGFLAG_SERVER, "");
+	pConsole->RegisterTemp("temp_b", "", CFGFLAG_SERVER, "");
+	EXPECT_TRUE(pConsole->GetCommandInfo("temp_a", CFGFLAG_SERVER, true));
+	EXPECT_FALSE(pConsole->GetCommandInfo("temp_a", CFGFLAG_SERVER, false));
+
+	pConsole->DeregisterTemp("temp_a");
+	EXPECT_FALSE(pConsole->GetCommandInfo("temp_a", CFGFLAG_SERVER, true));
+	EXPECT_TRUE(pConsole->GetCommandInfo("temp_b", CFGFLAG_SERVER, true));
+
+	// reuses the memory of temp_a
+	pConsole->RegisterTemp("temp_c", "", CFGFLAG_SERVER, "");
+	EXPECT_TRUE(pConsole->GetCommandInfo("temp_c", CFGFLAG_SERVER, true));
+	EXPECT_FALSE(pConsole->GetCommandInfo("temp_a", CFGFLAG_SERVER, true));
+
+	pConsole->DeregisterTempAll();
+	EXPECT_FALSE(pConsole->GetCommandInfo("temp_b", CFGFLAG_SERVER, true));
+	EXPECT_FALSE(pConsole->GetCommandInfo("temp_c", CFGFLAG_SERVER, true));
+	EXPECT_TRUE(pConsole->GetCommandInfo("echo", CFGFLAG_SERVER, false));
+}
+
+TEST(Console, ManyCommands)
+{
+	const int NUM_COMMANDS = 300;
+
+	std::unique_ptr<IConsole> pConsole = CreateConsole(CFGFLAG_SERVER);
+	std::vector<std::string> vNames;
+	vNames.reserve(NUM_COMMANDS);
+	int Count = 0;
+	for(int i = 0; i < NUM_COMMANDS; i++)
+	{
+		char aName[32];
+		str_format(aName, sizeof(aName), "sv_setting_%d", i);
+		vNames.emplace_back(aName);
+		pConsole->Register(vNames.back().c_str(), "?i", CFGFLAG_SERVER, CountCallback, &Count, "");
+	}
+
+	for(int i = 0; i < NUM_COMMANDS; i++)
+	{
+		ASSERT_TRUE(pConsole->GetCommandInfo(vNames[i].c_str(), CFGFLAG_SERVER, false));
+		pConsole->ExecuteLine((vNames[i] + " " + std::to_string(i)).c_str());
+	}
+	EXPECT_EQ(Count, NUM_COMMANDS * (NUM_COMMANDS - 1) / 2);
+	EXPECT_FALSE(pConsole->GetCommandInfo("sv_setting_300", CFGFLAG_SERVER, false));
+}
+
+TEST(Console, DISABLED_ExecuteConfigBenchmark)
+{
+	const int NUM_COMMANDS = 1500;
+	const int NUM_LINES = 5000;
+
+	std::unique_ptr<IConsole> pConsole = CreateConsole(CFGFLAG_SERVER);
+	std::vector<std::string> vNames;
+	vNames.reserve(NUM_COMMANDS);
+	int Count = 0;
+	for(int i = 0; i < NUM_COMMANDS; i++)
+	{
+		char aName[32];
+		str_format(aName, sizeof(aName), "sv_setting_%d", (i * 7919) % NUM_COMMANDS);
+		vNames.emplace_back(aName);
+		pConsole->Register(vNames.back().c_str(), "?i", CFGFLAG_SERVER, CountCallback, &Count, "");
+	}
+
+	std::vector<std::string> vLines;
+	for(int i = 0; i < NUM_LINES; i++)
+		vLines.push_back(vNames[(i * 31) % NUM_COMMANDS] + " 1");
+
+	int64_t Start = time_get();
+	for(const std::string &Line : vLines)
+		pConsole->ExecuteLine(Line.c_str());
+	int64_t Executed = time_get() - Start;
+
+	EXPECT_EQ(Count, NUM_LINES);
+	RecordDuration("execute", Executed);
+}
@@ -1,7 +1,9 @@
 #include "test.h"
 #include <gtest/gtest.h>
 #include <memory>
+#include <vector>
 
+#include <engine/engine.h>
 #include <engine/shared/datafile.h>
 #include <engine/storage.h>
 #include <game/mapitems_ex.h>
@@ -105,3 +107,109 @@ TEST(Datafile, StringData)
 		pStorage->RemoveFile(Info.m_aFilename, IStorage::TYPE_SAVE);
 	}
 }
+
+TEST(Datafile, PreloadData)
+{
+	auto pStorage = std::unique_ptr<IStorage>(CreateLocalStorage());
+	auto pEngine = std::unique_ptr<IEngine>(CreateTestEngine("ddnet-test", 4));
+	CTestInfo Info;
+
+	const int NUM_DATA = 64;
+	std::vector<std::vector<int>> vvData(NUM_DATA);
+	{
+		CDataFileWriter Writer;
+		Writer.Open(pStorage.get(), Info.m_aFilename);
+		for(int i = 0; i < NUM_DATA; i++)
+		{
+			for(int j = 0; j < 1000 + i * 100; j++)
+				vvData[i].push_back(i * j);
+			EXPECT_EQ(Writer.AddData(vvData[i].size() * sizeof(int), vvData[i].data()), i);
+		}
+		Writer.Finish();
+	}
+
+	CDataFileReader Lazy;
+	ASSERT_TRUE(Lazy.Open(pStorage.get(), Info.m_aFilename, IStorage::TYPE_ALL));
+	CDataFileReader Preloaded;
+	ASSERT_TRUE(Preloaded.Open(pStorage.get(), Info.m_aFilename, IStorage::TYPE_ALL, true));
+	EXPECT_EQ(Lazy.Sha256(), Preloaded.Sha256());
+	EXPECT_EQ(Lazy.Crc(), Preloaded.Crc());
+
+	// already loaded data is kept
+	const void *pFirst = Preloaded.GetData(0);
+	Preloaded.PreloadData(pEngine.get());
+	EXPECT_EQ(Preloaded.GetData(0), pFirst);
+
+	for(int i = 0; i < NUM_DATA; i++)
+	{
+		const int Size = vvData[i].size() * sizeof(int);
+		ASSERT_EQ(Preloaded.GetDataSize(i), Size);
+		ASSERT_EQ(Lazy.GetDataSize(i), Size);
+		EXPECT_EQ(mem_comp(Preloaded.GetData(i), vvData[i].data(), Size), 0);
+		EXPECT_EQ(mem_comp(Lazy.GetData(i), vvData[i].data(), Size), 0);
+	}
+
+	Preloaded.UnloadData(1);
+	EXPECT_EQ(mem_comp(Preloaded.GetData(1), vvData[1].data(), vvData[1].size() * sizeof(int)), 0);
+
+	Lazy.Close();
+	Preloaded.Close();
+
+	if(!HasFailure())
+	{
+		pStorage->RemoveFile(Info.m_aFilename, IStorage::TYPE_SAVE);
+	}
+}
+
+TEST(Datafile, TruncatedWhileOpen)
+{
+	auto pStorage = std::unique_ptr<IStorage>(CreateLocalStorage());
+	CTestInfo Info;
+
+	for(bool Mmap : {false, true})
+	{
+		const int aItem[] = {1, 2, 3, 4};
+		// not compressible, so that the last data isn't in the buffer of the file
+		std::vector<int> vData(10000);
+		for(size_t i = 0; i < vData.size(); i++)
+			vData[i] = i * 2654435761u;
+		{
+			CDataFileWriter Writer;
+			Writer.Open(pStorage.get(), Info.m_aFilename);
+			Writer.AddItem(MAPITEMTYPE_TEST, 0, sizeof(aItem), aItem);
+			for(int i = 0; i < 3; i++)
+				Writer.AddData(vData.size() * sizeof(int), vData.data());
+			Writer.Finish();
+		}
+
+		CDataFileReader Lazy;
+		ASSERT_TRUE(Lazy.Open(pStorage.get(), Info.m_aFilename, IStorage::TYPE_ALL, Mmap));
+		ASSERT_TRUE(Lazy.GetData(0));
+		CDataFileReader Preloaded;
+		ASSERT_TRUE(Preloaded.Open(pStorage.get(), Info.m_aFilename, IStorage::TYPE_ALL, Mmap));
+		Preloaded.PreloadData(nullptr);
+
+		IOHANDLE File = pStorage->OpenFile(Info.m_aFilename, IOFLAG_WRITE, IStorage::TYPE_SAVE);
+		ASSERT_TRUE(File);
+		io_close(File);
+
+		// the items and the loaded data don't point into the file anymore
+		for(CDataFileReader *pReader : {&Lazy, &Preloaded})
+		{
+			const int *pItem = (const int *)pReader->FindItem(MAPITEMTYPE_TEST, 0);
+			ASSERT_TRUE(pItem);
+			EXPECT_EQ(mem_comp(pItem, aItem, sizeof(aItem)), 0);
+			EXPECT_EQ(mem_comp(pReader->GetData(0), vData.data(), vData.size() * sizeof(int)), 0);
+		}
+		EXPECT_EQ(mem_comp(Preloaded.GetData(2), vData.data(), vData.size() * sizeof(int)), 0);
+		EXPECT_FALSE(Lazy.GetData(2));
+
+		Lazy.Close();
+		Preloaded.Close();
+	}
+
+	if(!HasFailure())
+	{
+		pStorage->RemoveFile(Info.m_aFilename, IStorage::TYPE_SAVE);
+	}
+}
@@ -0,0 +1,220 @@
+#include "test.h"
+#include <gtest/gtest.h>
+
+#include <base/system.h>
+#include <engine/shared/config.h>
+#include <engine/shared/demo.h>
+#include <engine/shared/network.h>
+#include <engine/shared/snapshot.h>
+#include <engine/storage.h>
+
+#include <memory>
+#include <vector>
+
+static const int TEST_FIRST_TICK = 100;
+static const int TEST_NUM_TICKS = 3000;
+static const int TEST_KEYFRAME_INTERVAL = 50;
+
+class CTestDemoListener : public CDemoPlayer::IListener
+{
+public:
+	int m_SnapshotTick = -1;
+
+	void OnDemoPlayerSnapshot(void *pData, int Size) override
+	{
+		const int *pTick = (const int *)((const CSnapshot *)pData)->FindItem(1, 0);
+		m_SnapshotTick = pTick ? *pTick : -1;
+	}
+	void OnDemoPlayerMessage(void *pData, int Size) override {}
+};
+
+static void RecordTestDemo(IStorage *pStorage, CSnapshotDelta *pDelta, const char *pFilename)
+{
+	const int OldInterval = g_Config.m_DemoKeyframeInterval;
+	g_Config.m_DemoKeyframeInterval = TEST_KEYFRAME_INTERVAL;
+
+	CDemoRecorder Recorder(pDelta);
+	unsigned char aMapData[16] = {0};
+	ASSERT_EQ(Recorder.Start(pStorage, nullptr, pFilename, "0.6 626fce9a778df4d4", "test", SHA256_ZEROED, 0, "client", sizeof(aMapData), aMapData), 0);
+	g_Config.m_DemoKeyframeInterval = OldInterval;
+
+	char aData[CSnapshot::MAX_SIZE];
+	CSnapshotBuilder Builder;
+	for(int Tick = TEST_FIRST_TICK; Tick < TEST_FIRST_TICK + TEST_NUM_TICKS; Tick++)
+	{
+		Builder.Init();
+		int *pItem = (int *)Builder.NewItem(1, 0, 2 * sizeof(int));
+		pItem[0] = Tick;
+		pItem[1] = Tick / 10;
+		Recorder.RecordSnapshot(Tick, aData, Builder.Finish(aData));
+	}
+	EXPECT_TRUE(Recorder.IsRecording());
+	Recorder.Stop();
+	EXPECT_FALSE(Recorder.IsRecording());
+
+	const CDemoRecorder::CWriterStats Stats = Recorder.WriterStats();
+	EXPECT_EQ(Stats.m_NumChunks, TEST_NUM_TICKS);
+	EXPECT_GE(Stats.m_MaxQueued, 1);
+}
+
+TEST(Demo, KeyFrameIndex)
+{
+	CNetBase::Init();
+	auto pStorage = std::unique_ptr<IStorage>(CreateLocalStorage());
+	CTestInfo Info;
+	CSnapshotDelta Delta;
+	RecordTestDemo(pStorage.get(), &Delta, Info.m_aFilename);
+
+	// an empty chunk after the index hides it like in demos without one
+	char aNoIndexFilename[IO_MAX_PATH_LENGTH];
+	Info.Filename(aNoIndexFilename, sizeof(aNoIndexFilename), "-noindex.demo");
+	{
+		void *pDemo;
+		unsigned DemoSize;
+		ASSERT_TRUE(pStorage->ReadFile(Info.m_aFilename, IStorage::TYPE_SAVE, &pDemo, &DemoSize));
+		IOHANDLE File = pStorage->OpenFile(aNoIndexFilename, IOFLAG_WRITE, IStorage::TYPE_SAVE);
+		ASSERT_TRUE(File);
+		const unsigned char EmptyChunk = 0;
+		io_write(File, pDemo, DemoSize);
+		io_write(File, &EmptyChunk, sizeof(EmptyChunk));
+		io_close(File);
+		free(pDemo);
+	}
+
+	CDemoPlayer Indexed(&Delta, false);
+	ASSERT_EQ(Indexed.Load(pStorage.get(), nullptr, Info.m_aFilename, IStorage::TYPE_SAVE), 0);
+	CDemoPlayer Scanned(&Delta, false);
+	ASSERT_EQ(Scanned.Load(pStorage.get(), nullptr, aNoIndexFilename, IStorage::TYPE_SAVE), 0);
+	EXPECT_TRUE(Indexed.KeyFramesFromIndex());
+	EXPECT_FALSE(Scanned.KeyFramesFromIndex());
+
+	EXPECT_EQ(Indexed.BaseInfo()->m_FirstTick, TEST_FIRST_TICK);
+	EXPECT_EQ(Indexed.BaseInfo()->m_LastTick, TEST_FIRST_TICK + TEST_NUM_TICKS - 1);
+	EXPECT_EQ(Scanned.BaseInfo()->m_FirstTick, Indexed.BaseInfo()->m_FirstTick);
+	EXPECT_EQ(Scanned.BaseInfo()->m_LastTick, Indexed.BaseInfo()->m_LastTick);
+
+	const int NumKeyFrames = (TEST_NUM_TICKS + TEST_KEYFRAME_INTERVAL) / (TEST_KEYFRAME_INTERVAL + 1);
+	ASSERT_EQ(Indexed.KeyFrames().size(), (size_t)NumKeyFrames);
+	ASSERT_EQ(Scanned.KeyFrames().size(), Indexed.KeyFrames().size());
+	for(int i = 0; i < NumKeyFrames; i++)
+	{
+		EXPECT_EQ(Indexed.KeyFrames()[i].m_Tick, TEST_FIRST_TICK + i * (TEST_KEYFRAME_INTERVAL + 1));
+		EXPECT_EQ(Indexed.KeyFrames()[i].m_Tick, Scanned.KeyFrames()[i].m_Tick);
+		EXPECT_EQ(Indexed.KeyFrames()[i].m_Filepos, Scanned.KeyFrames()[i].m_Filepos);
+	}
+
+	CTestDemoListener Listener;
+	Indexed.SetListener(&Listener);
+	for(int Wanted : {TEST_FIRST_TICK + 1777, TEST_FIRST_TICK + 10, TEST_FIRST_TICK + TEST_NUM_TICKS - 2, TEST_FIRST_TICK + 51})
+	{
+		ASSERT_EQ(Indexed.SetPos(Wanted), 0);
+		EXPECT_EQ(Indexed.BaseInfo()->m_CurrentTick, Wanted - 1);
+		EXPECT_EQ(Listener.m_SnapshotTick, Wanted - 1);
+	}
+
+	// the index chunks are skipped during playback
+	Indexed.Unpause();
+	while(Indexed.IsPlaying() && !Indexed.BaseInfo()->m_Paused)
+		Indexed.Update(false);
+	EXPECT_TRUE(Indexed.IsPlaying());
+	EXPECT_EQ(Indexed.BaseInfo()->m_CurrentTick, TEST_FIRST_TICK + TEST_NUM_TICKS - 1);
+
+	Indexed.Stop();
+	Scanned.Stop();
+
+	if(!HasFailure())
+	{
+		pStorage->RemoveFile(Info.m_aFilename, IStorage::TYPE_SAVE);
+		pStorage->RemoveFile(aNoIndexFilename, IStorage::TYPE_SAVE);
+	}
+}
+
+TEST(Demo, StopInBackground)
+{
+	CNetBase::Init();
+	auto pStorage = std::unique_ptr<IStorage>(CreateLocalStorage());
+	CTestInfo Info;
+	CSnapshotDelta Delta;
+	char aKeptFilename[IO_MAX_PATH_LENGTH];
+	char aRenamedFilename[IO_MAX_PATH_LENGTH];
+	char aRemovedFilename[IO_MAX_PATH_LENGTH];
+	Info.Filename(aKeptFilename, sizeof(aKeptFilename), "-kept.demo");
+	Info.Filename(aRenamedFilename, sizeof(aRenamedFilename), "-renamed.demo");
+	Info.Filename(aRemovedFilename, sizeof(aRemovedFilename), "-removed.demo");
+
+	const int OldDrop = g_Config.m_DemoWriterDrop;
+	unsigned char aMapData[16] = {0};
+	CDemoRecorder aRecorders[3] = {CDemoRecorder(&Delta), CDemoRecorder(&Delta), CDemoRecorder(&Delta)};
+	const char *apFilenames[] = {aKeptFilename, Info.m_aFilename, aRemovedFilename};
+	for(int i = 0; i < 3; i++)
+	{
+		// the first recording drops snapshots if the shared writer is too slow
+		g_Config.m_DemoWriterDrop = i == 0;
+		ASSERT_EQ(aRecorders[i].Start(pStorage.get(), nullptr, apFilenames[i], "0.6 626fce9a778df4d4", "test", SHA256_ZEROED, 0, "client", sizeof(aMapData), aMapData), 0);
+	}
+	g_Config.m_DemoWriterDrop = OldDrop;
+
+	char aData[CSnapshot::MAX_SIZE];
+	CSnapshotBuilder Builder;
+	for(int Tick = TEST_FIRST_TICK; Tick < TEST_FIRST_TICK + TEST_NUM_TICKS; Tick++)
+	{
+		Builder.Init();
+		int *pItem = (int *)Builder.NewItem(1, 0, 2 * sizeof(int));
+		pItem[0] = Tick;
+		pItem[1] = Tick / 10;
+		const int Size = Builder.Finish(aData);
+		for(auto &Recorder : aRecorders)
+			Recorder.RecordSnapshot(Tick, aData, Size);
+	}
+	aRecorders[0].Stop();
+	aRecorders[1].Stop(IDemoRecorder::EStopMode::KEEP_FILE, aRenamedFilename);
+	aRecorders[2].Stop(IDemoRecorder::EStopMode::REMOVE_FILE);
+	for(auto &Recorder : aRecorders)
+	{
+		EXPECT_FALSE(Recorder.IsRecording());
+		Recorder.WaitUntilWritten();
+	}
+
+	const CDemoRecorder::CWriterStats DropStats = aRecorders[0].WriterStats();
+	EXPECT_EQ(DropStats.m_NumChunks + DropStats.m_NumDropped, TEST_NUM_TICKS);
+	EXPECT_EQ(DropStats.m_NumBlocked, 0);
+	EXPECT_EQ(aRecorders[1].WriterStats().m_NumChunks, TEST_NUM_TICKS);
+	EXPECT_EQ(aRecorders[1].WriterStats().m_NumDropped, 0);
+
+	EXPECT_TRUE(pStorage->FileExists(aKeptFilename, IStorage::TYPE_SAVE));
+	EXPECT_FALSE(pStorage->FileExists(Info.m_aFilename, IStorage::TYPE_SAVE));
+	EXPECT_TRUE(pStorage->FileExists(aRenamedFilename, IStorage::TYPE_SAVE));
+	EXPECT_FALSE(pStorage->FileExists(aRemovedFilename, IStorage::TYPE_SAVE));
+
+	CDemoPlayer Renamed(&Delta, false);
+	ASSERT_EQ(Renamed.Load(pStorage.get(), nullptr, aRenamedFilename, IStorage::TYPE_SAVE), 0);
+	EXPECT_TRUE(Renamed.KeyFramesFromIndex());
+	EXPECT_EQ(Renamed.BaseInfo()->m_FirstTick, TEST_FIRST_TICK);
+	EXPECT_EQ(Renamed.BaseInfo()->m_LastTick, TEST_FIRST_TICK + TEST_NUM_TICKS - 1);
+	Renamed.Stop();
+
+	// dropped snapshots are left out of the deltas
+	CDemoPlayer Kept(&Delta, false);
+	ASSERT_EQ(Kept.Load(pStorage.get(), nullptr, aKeptFilename, IStorage::TYPE_SAVE), 0);
+	CTestDemoListener Listener;
+	Kept.SetListener(&Listener);
+	Kept.Unpause();
+	int LastTick = -1;
+	while(Kept.IsPlaying() && !Kept.BaseInfo()->m_Paused)
+	{
+		Kept.Update(false);
+		if(Listener.m_SnapshotTick != LastTick)
+		{
+			ASSERT_GT(Listener.m_SnapshotTick, LastTick);
+			LastTick = Listener.m_SnapshotTick;
+		}
+	}
+	EXPECT_EQ(LastTick, Kept.BaseInfo()->m_LastTick);
+	Kept.Stop();
+
+	if(!HasFailure())
+	{
+		pStorage->RemoveFile(aKeptFilename, IStorage::TYPE_SAVE);
+		pStorage->RemoveFile(aRenamedFilename, IStorage::TYPE_SAVE);
+	}
+}
@@ -0,0 +1,113 @@
+#include <gtest/gtest.h>
+
+#include <base/system.h>
+#include <game/entity_grid.h>
+#include <game/prng.h>
+
+#include <algorithm>
+#include <vector>
+
+namespace {
+
+struct CTestEntity
+{
+	vec2 m_Pos;
+	float m_Radius;
+	CEntityGrid<CTestEntity>::CLink m_Link;
+};
+
+float RandomCoord(CPrng &Prng)
+{
+	return (float)Prng.RandomBits() / 0xffffffffu * 8000.0f - 1000.0f;
+}
+
+// mirrors the order of the world's entity list, new entities are added in front
+std::vector<CTestEntity *> FindAll(const std::vector<CTestEntity *> &vpList, vec2 Pos, float Radius)
+{
+	std::vector<CTestEntity *> vpResult;
+	for(auto It = vpList.rbegin(); It != vpList.rend(); ++It)
+		if(distance((*It)->m_Pos, Pos) < Radius + (*It)->m_Radius)
+			vpResult.push_back(*It);
+	return vpResult;
+}
+
+}
+
+TEST(EntityGrid, MatchesFullScan)
+{
+	CPrng Prng;
+	uint64_t aSeed[2] = {1, 2};
+	Prng.Seed(aSeed);
+	CEntityGrid<CTestEntity> Grid;
+	std::vector<CTestEntity> vEntities(2000);
+	std::vector<CTestEntity *> vpList;
+
+	for(auto &Entity : vEntities)
+	{
+		Entity.m_Pos = vec2(RandomCoord(Prng), RandomCoord(Prng));
+		Entity.m_Radius = Prng.RandomBits() % 30;
+		Grid.Insert(&Entity, &Entity.m_Link, Entity.m_Pos, Entity.m_Radius);
+		vpList.push_back(&Entity);
+	}
+
+	std::vector<CTestEntity *> vpCandidates;
+	int NumGridQueries = 0;
+	for(int Round = 0; Round < 2000; Round++)
+	{
+		// move, remove and re-add some entities
+		CTestEntity *pEntity = &vEntities[Prng.RandomBits() % vEntities.size()];
+		switch(Prng.RandomBits() % 3)
+		{
+		case 0:
+			pEntity->m_Pos += vec2(RandomCoord(Prng), RandomCoord(Prng)) / 50.0f;
+			Grid.Move(&pEntity->m_Link, pEntity->m_Pos, pEntity->m_Radius);
+			break;
+		case 1:
+			pEntity->m_Pos = vec2(RandomCoord(Prng), RandomCoord(Prng));
+			Grid.Move(&pEntity->m_Link, pEntity->m_Pos, pEntity->m_Radius);
+			break;
+		case 2:
+			Grid.Remove(&pEntity->m_Link);
+			vpList.erase(std::find(vpList.begin(), vpList.end(), pEntity));
+			Grid.Insert(pEntity, &pEntity->m_Link, pEntity->m_Pos, pEntity->m_Radius);
+			vpList.push_back(pEntity);
+			break;
+		}
+		ASSERT_EQ(Grid.NumEntities(), (int)vpList.size());
+
+		const vec2 Pos(RandomCoord(Prng), RandomCoord(Prng));
+		const float Radius = Prng.RandomBits() % 600;
+		if(!Grid.Query(Pos, Pos, Radius, vpCandidates))
+			continue;
+		NumGridQueries++;
+
+		std::vector<CTestEntity *> vpFound;
+		for(CTestEntity *pCandidate : vpCandidates)
+			if(distance(pCandidate->m_Pos, Pos) < Radius + pCandidate->m_Radius)
+				vpFound.push_back(pCandidate);
+		EXPECT_EQ(vpFound, FindAll(vpList, Pos, Radius));
+	}
+	EXPECT_GT(NumGridQueries, 1000);
+}
+
+TEST(EntityGrid, InsertLast)
+{
+	CEntityGrid<CTestEntity> Grid;
+	CTestEntity aEntities[3];
+	for(auto &Entity : aEntities)
+		Entity.m_Pos = vec2(110.0f, 110.0f);
+	Grid.Insert(&aEntities[0], &aEntities[0].m_Link, aEntities[0].m_Pos, 0.0f);
+	Grid.Insert(&aEntities[1], &aEntities[1].m_Link, aEntities[1].m_Pos, 0.0f, true);
+	Grid.Insert(&aEntities[2], &aEntities[2].m_Link, aEntities[2].m_Pos, 0.0f);
+
+	std::vector<CTestEntity *> vpCandidates;
+	ASSERT_TRUE(Grid.Query(vec2(100.0f, 100.0f), vec2(100.0f, 100.0f), 20.0f, vpCandidates));
+	std::vector<CTestEntity *> vpExpected = {&aEntities[2], &aEntities[0], &aEntities[1]};
+	EXPECT_EQ(vpCandidates, vpExpected);
+
+	// copies are not part of the grid
+	CTestEntity Copy = aEntities[0];
+	Grid.Move(&Copy.m_Link, vec2(1000.0f, 1000.0f), 0.0f);
+	ASSERT_TRUE(Grid.Query(vec2(100.0f, 100.0f), vec2(100.0f, 100.0f), 20.0f, vpCandidates));
+	EXPECT_EQ(vpCandidates, vpExpected);
+}
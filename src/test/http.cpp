@@ -0,0 +1,243 @@
+#include <gtest/gtest.h>
+
+#include <base/system.h>
+#include <engine/shared/config.h>
+#include <engine/shared/http.h>
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Minimal HTTP/1.1 server with keep-alive, answers every request with
+// its path as the body.
+class CTestHttpServer
+{
+	NETSOCKET m_Socket = nullptr;
+	int m_Port = 0;
+	std::atomic<bool> m_Stop{false};
+	std::thread m_AcceptThread;
+	std::mutex m_ConnectionsMutex;
+	std::vector<std::thread> m_vConnectionThreads;
+
+	void AcceptLoop()
+	{
+		while(!m_Stop)
+		{
+			if(net_socket_read_wait(m_Socket, 10000) <= 0)
+				continue;
+			NETSOCKET Client;
+			NETADDR ClientAddr;
+			if(net_tcp_accept(m_Socket, &Client, &ClientAddr) < 0)
+				continue;
+			m_NumConnections++;
+			std::lock_guard<std::mutex> Lock(m_ConnectionsMutex);
+			m_vConnectionThreads.emplace_back([this, Client]() { ServeConnection(Client); });
+		}
+	}
+
+	void ServeConnection(NETSOCKET Client)
+	{
+		int Open = ++m_NumOpenConnections;
+		int MaxOpen = m_MaxOpenConnections;
+		while(Open > MaxOpen && !m_MaxOpenConnections.compare_exchange_weak(MaxOpen, Open))
+		{
+		}
+
+		std::string Buffer;
+		bool Closed = false;
+		while(!m_Stop && !Closed)
+		{
+			size_t HeaderEnd = Buffer.find("\r\n\r\n");
+			if(HeaderEnd == std::string::npos)
+			{
+				if(net_socket_read_wait(Client, 10000) <= 0)
+					continue;
+				char aBuf[4096];
+				int Size = net_tcp_recv(Client, aBuf, sizeof(aBuf));
+				if(Size <= 0)
+					break;
+				Buffer.append(aBuf, Size);
+				continue;
+			}
+
+			std::string Head = Buffer.substr(0, HeaderEnd);
+			std::string Path = Head.substr(Head.find(' ') + 1);
+			Path = Path.substr(0, Path.find(' '));
+			Buffer.erase(0, HeaderEnd + 4);
+			if(Path == "/hang")
+			{
+				while(!m_Stop)
+					std::this_thread::sleep_for(std::chrono::milliseconds(1));
+				break;
+			}
+			if(Path == "/slow")
+				std::this_thread::sleep_for(std::chrono::milliseconds(20));
+
+			const bool Missing = Path == "/missing";
+			char aResponse[512];
+			str_format(aResponse, sizeof(aResponse), "HTTP/1.1 %s\r\nContent-Length: %d\r\nContent-Type: text/plain\r\n\r\n%s",
+				Missing ? "404 Not Found" : "200 OK", Missing ? 0 : (int)Path.size(), Missing ? "" : Path.c_str());
+			Closed = net_tcp_send(Client, aResponse, str_length(aResponse)) < 0;
+		}
+		m_NumOpenConnections--;
+		net_tcp_close(Client);
+	}
+
+public:
+	std::atomic<int> m_NumConnections{0};
+	std::atomic<int> m_NumOpenConnections{0};
+	std::atomic<int> m_MaxOpenConnections{0};
+
+	bool Start()
+	{
+		for(int Try = 0; Try < 20 && !m_Socket; Try++)
+		{
+			NETADDR BindAddr;
+			net_addr_from_str(&BindAddr, "127.0.0.1");
+			m_Port = 20000 + secure_rand_below(30000);
+			BindAddr.port = m_Port;
+			m_Socket = net_tcp_create(BindAddr);
+		}
+		if(!m_Socket || net_tcp_listen(m_Socket, 16) != 0)
+			return false;
+		m_AcceptThread = std::thread([this]() { AcceptLoop(); });
+		return true;
+	}
+
+	~CTestHttpServer()
+	{
+		m_Stop = true;
+		if(m_AcceptThread.joinable())
+			m_AcceptThread.join();
+		for(auto &Thread : m_vConnectionThreads)
+			Thread.join();
+		if(m_Socket)
+			net_tcp_close(m_Socket);
+	}
+
+	std::string Url(const char *pPath) const
+	{
+		char aUrl[128];
+		str_format(aUrl, sizeof(aUrl), "http://127.0.0.1:%d%s", m_Port, pPath);
+		return aUrl;
+	}
+};
+
+class Http : public ::testing::Test
+{
+protected:
+	CTestHttpServer m_Server;
+	CHttp m_Http;
+	int m_OldAllowInsecure;
+
+	void SetUp() override
+	{
+		static const bool s_InitFailed = HttpInit(nullptr);
+		ASSERT_FALSE(s_InitFailed);
+		ASSERT_TRUE(m_Server.Start());
+		ASSERT_FALSE(m_Http.Init());
+		m_OldAllowInsecure = g_Config.m_HttpAllowInsecure;
+		g_Config.m_HttpAllowInsecure = 1;
+	}
+
+	void TearDown() override
+	{
+		m_Http.Shutdown();
+		g_Config.m_HttpAllowInsecure = m_OldAllowInsecure;
+	}
+
+	std::shared_ptr<CHttpRequest> Get(const char *pPath)
+	{
+		std::shared_ptr<CHttpRequest> pRequest = HttpGet(m_Server.Url(pPath).c_str());
+		pRequest->Timeout(CTimeout{2000, 10000, 0, 0});
+		pRequest->LogProgress(HTTPLOG::NONE);
+		return pRequest;
+	}
+
+	static std::string Body(const CHttpRequest *pRequest)
+	{
+		unsigned char *pResult;
+		size_t ResultLength;
+		pRequest->Result(&pResult, &ResultLength);
+		return pResult ? std::string((const char *)pResult, ResultLength) : std::string();
+	}
+};
+
+TEST_F(Http, Get)
+{
+	std::shared_ptr<CHttpRequest> pRequest = Get("/hello");
+	m_Http.Run(pRequest);
+	pRequest->Wait();
+	EXPECT_TRUE(pRequest->Done());
+	EXPECT_EQ(pRequest->State(), HTTP_DONE);
+	EXPECT_EQ(Body(pRequest.get()), "/hello");
+}
+
+TEST_F(Http, Error)
+{
+	std::shared_ptr<CHttpRequest> pRequest = Get("/missing");
+	m_Http.Run(pRequest);
+	pRequest->Wait();
+	EXPECT_EQ(pRequest->State(), HTTP_ERROR);
+	EXPECT_EQ(Body(pRequest.get()), "");
+}
+
+TEST_F(Http, ReusesConnection)
+{
+	for(int i = 0; i < 10; i++)
+	{
+		char aPath[32];
+		str_format(aPath, sizeof(aPath), "/request%d", i);
+		std::shared_ptr<CHttpRequest> pRequest = Get(aPath);
+		m_Http.Run(pRequest);
+		pRequest->Wait();
+		EXPECT_EQ(pRequest->State(), HTTP_DONE);
+		EXPECT_EQ(Body(pRequest.get()), aPath);
+	}
+	EXPECT_EQ(m_Server.m_NumConnections, 1);
+}
+
+TEST_F(Http, LimitsConnectionsPerHost)
+{
+	std::vector<std::shared_ptr<CHttpRequest>> vpRequests;
+	for(int i = 0; i < 24; i++)
+	{
+		vpRequests.push_back(Get("/slow"));
+		m_Http.Run(vpRequests.back());
+	}
+	for(auto &pRequest : vpRequests)
+	{
+		pRequest->Wait();
+		EXPECT_EQ(pRequest->State(), HTTP_DONE);
+		EXPECT_EQ(Body(pRequest.get()), "/slow");
+	}
+	EXPECT_GT(m_Server.m_MaxOpenConnections, 1);
+	EXPECT_LE(m_Server.m_MaxOpenConnections, (int)CHttp::MAX_HOST_CONNECTIONS);
+}
+
+TEST_F(Http, Abort)
+{
+	std::shared_ptr<CHttpRequest> pRequest = Get("/hang");
+	m_Http.Run(pRequest);
+	while(m_Server.m_NumConnections == 0)
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	pRequest->Abort();
+	pRequest->Wait();
+	EXPECT_EQ(pRequest->State(), HTTP_ABORTED);
+}
+
+TEST_F(Http, ShutdownAbortsRunningRequests)
+{
+	std::shared_ptr<CHttpRequest> pRequest = Get("/hang");
+	m_Http.Run(pRequest);
+	m_Http.Shutdown(std::chrono::milliseconds(50));
+	EXPECT_EQ(pRequest->State(), HTTP_ABORTED);
+
+	std::shared_ptr<CHttpRequest> pLate = Get("/hello");
+	m_Http.Run(pLate);
+	EXPECT_EQ(pLate->State(), HTTP_ABORTED);
+}
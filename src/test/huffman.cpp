@@ -1,7 +1,11 @@
 #include <gtest/gtest.h>
 
 #include <base/system.h>
+#include <engine/shared/compression.h>
 #include <engine/shared/huffman.h>
+#include <test/test.h>
+
+#include <vector>
 
 TEST(Huffman, CompressionShouldNotChangeData)
 {
@@ -46,3 +50,129 @@ TEST(Huffman, CompressionCompatible)
 	EXPECT_EQ(match, 0) << "The compression is not compatible with older/other implementations anymore";
 	EXPECT_EQ(Size, 15);
 }
+
+// packets shaped like game traffic: mostly variable-int packed snapshot
+// deltas with many zeros and small values, plus some text
+static std::vector<std::vector<unsigned char>> GeneratePayloads(int NumPayloads)
+{
+	std::vector<std::vector<unsigned char>> vvPayloads;
+	unsigned State = 1;
+	auto Random = [&State]() {
+		State = State * 1664525u + 1013904223u;
+		return State >> 8;
+	};
+	for(int p = 0; p < NumPayloads; p++)
+	{
+		std::vector<unsigned char> vPayload;
+		const unsigned Size = p % 16 == 0 ? Random() % 1400 : Random() % 300;
+		while(vPayload.size() < Size)
+		{
+			const unsigned Kind = Random() % 16;
+			if(Kind == 0)
+			{
+				const char *pText = "nameless tee";
+				vPayload.insert(vPayload.end(), pText, pText + str_length(pText) + 1);
+			}
+			else
+			{
+				int Value = 0;
+				if(Kind > 9)
+					Value = (int)(Random() % 64) - 32;
+				else if(Kind > 7)
+					Value = (int)(Random() % 4096) - 2048;
+				else if(Kind == 7)
+					Value = (int)Random();
+				unsigned char aBuf[CVariableInt::MAX_BYTES_PACKED];
+				unsigned char *pEnd = CVariableInt::Pack(aBuf, Value, sizeof(aBuf));
+				vPayload.insert(vPayload.end(), aBuf, pEnd);
+			}
+		}
+		vPayload.resize(Size);
+		vvPayloads.push_back(vPayload);
+	}
+	return vvPayloads;
+}
+
+TEST(Huffman, CompressionCompatiblePayloads)
+{
+	CHuffman Huffman;
+	Huffman.Init();
+
+	const std::vector<std::vector<unsigned char>> vvPayloads = GeneratePayloads(500);
+	unsigned Hash = 2166136261u;
+	int TotalSize = 0;
+	for(const auto &vPayload : vvPayloads)
+	{
+		unsigned char aCompressed[4096];
+		const int Size = Huffman.Compress(vPayload.data(), vPayload.size(), aCompressed, sizeof(aCompressed));
+		ASSERT_GT(Size, 0);
+		for(int i = 0; i < Size; i++)
+			Hash = (Hash ^ aCompressed[i]) * 16777619u;
+		TotalSize += Size;
+
+		unsigned char aDecompressed[2048];
+		ASSERT_EQ(Huffman.Decompress(aCompressed, Size, aDecompressed, sizeof(aDecompressed)), (int)vPayload.size());
+		EXPECT_EQ(mem_comp(aDecompressed, vPayload.data(), vPayload.size()), 0);
+	}
+	EXPECT_EQ(TotalSize, 97878);
+	EXPECT_EQ(Hash, 0xd06df6b3u) << "The compression is not compatible with older/other implementations anymore";
+}
+
+TEST(Huffman, DecompressTruncated)
+{
+	CHuffman Huffman;
+	Huffman.Init();
+
+	const std::vector<std::vector<unsigned char>> vvPayloads = GeneratePayloads(100);
+	for(const auto &vPayload : vvPayloads)
+	{
+		unsigned char aCompressed[4096];
+		const int Size = Huffman.Compress(vPayload.data(), vPayload.size(), aCompressed, sizeof(aCompressed));
+		ASSERT_GT(Size, 0);
+
+		unsigned char aDecompressed[2048];
+		for(int Truncated = 0; Truncated < Size; Truncated++)
+			EXPECT_LE(Huffman.Decompress(aCompressed, Truncated, aDecompressed, vPayload.size()), (int)vPayload.size());
+		if(!vPayload.empty())
+		{
+			EXPECT_EQ(Huffman.Decompress(aCompressed, Size, aDecompressed, vPayload.size() - 1), -1);
+		}
+		EXPECT_EQ(Huffman.Compress(vPayload.data(), vPayload.size(), aCompressed, Size - 1), -1);
+	}
+}
+
+TEST(Huffman, DISABLED_Benchmark)
+{
+	CHuffman Huffman;
+	Huffman.Init();
+
+	const std::vector<std::vector<unsigned char>> vvPayloads = GeneratePayloads(2000);
+	std::vector<std::vector<unsigned char>> vvCompressed;
+	int64_t NumBytes = 0;
+	for(const auto &vPayload : vvPayloads)
+	{
+		std::vector<unsigned char> vCompressed(4096);
+		vCompressed.resize(Huffman.Compress(vPayload.data(), vPayload.size(), vCompressed.data(), vCompressed.size()));
+		vvCompressed.push_back(vCompressed);
+		NumBytes += vPayload.size();
+	}
+
+	const int NUM_ITERATIONS = 20;
+	unsigned char aBuffer[4096];
+	int Check = 0;
+	int64_t Start = time_get();
+	for(int n = 0; n < NUM_ITERATIONS; n++)
+		for(const auto &vPayload : vvPayloads)
+			Check += Huffman.Compress(vPayload.data(), vPayload.size(), aBuffer, sizeof(aBuffer));
+	const int64_t CompressTime = time_get() - Start;
+	Start = time_get();
+	for(int n = 0; n < NUM_ITERATIONS; n++)
+		for(const auto &vCompressed : vvCompressed)
+			Check += Huffman.Decompress(vCompressed.data(), vCompressed.size(), aBuffer, sizeof(aBuffer));
+	const int64_t DecompressTime = time_get() - Start;
+	EXPECT_GT(Check, 0);
+
+	RecordProperty("bytes", NumBytes * NUM_ITERATIONS);
+	RecordDuration("compress", CompressTime);
+	RecordDuration("decompress", DecompressTime);
+}
@@ -48,3 +48,57 @@ TEST(Net, Ipv4AndIpv6Work)
 	net_udp_close(Socket1);
 	net_udp_close(Socket2);
 }
+
+TEST(Net, BatchedSend)
+{
+	NETADDR Bindaddr = {};
+	NETSOCKET Socket1;
+	NETSOCKET Socket2;
+
+	Bindaddr.type = NETTYPE_IPV4 | NETTYPE_IPV6;
+	Socket2 = net_udp_create(Bindaddr);
+	do
+	{
+		Bindaddr.port = secure_rand() % 64511 + 1024;
+	} while(!(Socket1 = net_udp_create(Bindaddr)));
+
+	NETADDR TargetV4;
+	NETADDR TargetV6;
+	ASSERT_FALSE(net_addr_from_str(&TargetV4, "127.0.0.1"));
+	ASSERT_FALSE(net_addr_from_str(&TargetV6, "[::1]"));
+	TargetV4.port = Bindaddr.port;
+	TargetV6.port = Bindaddr.port;
+
+	net_udp_set_send_batching(Socket2, true);
+	EXPECT_EQ(net_udp_send(Socket2, &TargetV4, "abc", 3), 3);
+	EXPECT_EQ(net_udp_send(Socket2, &TargetV4, "defg", 4), 4);
+	EXPECT_EQ(net_udp_send(Socket2, &TargetV6, "hi", 2), 2);
+	EXPECT_EQ(net_socket_read_wait(Socket1, 0), 0);
+	EXPECT_EQ(net_udp_flush(Socket2), 3);
+	EXPECT_EQ(net_udp_flush(Socket2), 0);
+
+	const char *apExpected[] = {"abc", "defg", "hi"};
+	int aReceived[3] = {0};
+	for(int i = 0; i < 3; i++)
+	{
+		NETADDR Addr;
+		unsigned char *pData;
+		int Bytes = net_udp_recv(Socket1, &Addr, &pData);
+		while(Bytes <= 0 && net_socket_read_wait(Socket1, 10000000) == 1)
+			Bytes = net_udp_recv(Socket1, &Addr, &pData);
+		ASSERT_GT(Bytes, 0);
+		for(int j = 0; j < 3; j++)
+			if(Bytes == str_length(apExpected[j]) && mem_comp(pData, apExpected[j], Bytes) == 0)
+				aReceived[j]++;
+	}
+	for(int Received : aReceived)
+		EXPECT_EQ(Received, 1);
+
+	// disabling batching sends the remaining packets
+	EXPECT_EQ(net_udp_send(Socket2, &TargetV4, "jkl", 3), 3);
+	net_udp_set_send_batching(Socket2, false);
+	EXPECT_EQ(net_socket_read_wait(Socket1, 10000000), 1);
+
+	net_udp_close(Socket1);
+	net_udp_close(Socket2);
+}
@@ -5,10 +5,15 @@
 #include <engine/server/databases/connection.h>
 #include <engine/server/databases/connection_pool.h>
 #include <engine/shared/config.h>
+#include <game/server/scorecache.h>
 #include <game/server/scoreworker.h>
+#include <test/test.h>
 
 #include <sqlite3.h>
 
+#include <chrono>
+#include <thread>
+
 #if defined(CONF_TEST_MYSQL)
 int DummyMysqlInit = (MysqlInit(), 1);
 #endif
@@ -583,6 +588,239 @@ TEST_P(RandomMap, UnfinishedDoesntExist)
 	EXPECT_STREQ(m_pRandomMapResult->m_aMessage, "You have no more unfinished maps on this server!");
 }
 
+struct CachedScore : public Score
+{
+	CScoreCache m_Cache;
+
+	void Finish(const char *pName, const char *pServer, float Time)
+	{
+		str_copy(g_Config.m_SvSqlServerName, pServer, sizeof(g_Config.m_SvSqlServerName));
+		CSqlScoreData ScoreData(std::make_shared<CScorePlayerResult>());
+		str_copy(ScoreData.m_aMap, "Kobra 3", sizeof(ScoreData.m_aMap));
+		str_copy(ScoreData.m_aGameUuid, "8d300ecf-5873-4297-bee5-95668fdff320", sizeof(ScoreData.m_aGameUuid));
+		str_copy(ScoreData.m_aName, pName, sizeof(ScoreData.m_aName));
+		ScoreData.m_ClientID = 0;
+		ScoreData.m_Time = Time;
+		str_copy(ScoreData.m_aTimestamp, "2021-11-24 19:24:08", sizeof(ScoreData.m_aTimestamp));
+		for(int i = 0; i < NUM_CHECKPOINTS; i++)
+			ScoreData.m_aCurrentTimeCp[i] = 0;
+		str_copy(ScoreData.m_aRequestingPlayer, pName, sizeof(ScoreData.m_aRequestingPlayer));
+		ASSERT_FALSE(CScoreWorker::SaveScore(m_pConn, &ScoreData, Write::NORMAL, m_aError, sizeof(m_aError))) << m_aError;
+		m_Cache.SaveScore(pName, pServer, Time);
+	}
+
+	void TeamFinish(std::vector<std::string> vNames, float Time)
+	{
+		CSqlTeamScoreData TeamScoreData;
+		str_copy(TeamScoreData.m_aMap, "Kobra 3", sizeof(TeamScoreData.m_aMap));
+		str_copy(TeamScoreData.m_aGameUuid, "8d300ecf-5873-4297-bee5-95668fdff320", sizeof(TeamScoreData.m_aGameUuid));
+		TeamScoreData.m_Size = vNames.size();
+		for(unsigned i = 0; i < vNames.size(); i++)
+			str_copy(TeamScoreData.m_aaNames[i], vNames[i].c_str(), sizeof(TeamScoreData.m_aaNames[i]));
+		TeamScoreData.m_Time = Time;
+		str_copy(TeamScoreData.m_aTimestamp, "2021-11-24 19:24:08", sizeof(TeamScoreData.m_aTimestamp));
+		TeamScoreData.m_TeamrankUuid = RandomUuid();
+		ASSERT_FALSE(CScoreWorker::SaveTeamScore(m_pConn, &TeamScoreData, Write::NORMAL, m_aError, sizeof(m_aError))) << m_aError;
+		m_Cache.SaveTeamScore(vNames, Time, TeamScoreData.m_TeamrankUuid);
+	}
+
+	void Load()
+	{
+		auto pResult = std::make_shared<CScoreCacheResult>();
+		CSqlScoreCacheRequest Request(pResult);
+		str_copy(Request.m_aMap, "Kobra 3", sizeof(Request.m_aMap));
+		str_copy(Request.m_aServer, "GER", sizeof(Request.m_aServer));
+		ASSERT_FALSE(CScoreCache::Load(m_pConn, &Request, m_aError, sizeof(m_aError))) << m_aError;
+		m_Cache = std::move(pResult->m_Cache);
+	}
+
+	void ExpectSameAnswer(bool (*pfnWorker)(IDbConnection *, const ISqlData *, char *, int), void (CScoreCache::*pfnCache)(const CSqlPlayerRequest *, CScorePlayerResult *) const, const char *pName, int Offset, const char *pServer)
+	{
+		auto pExpected = std::make_shared<CScorePlayerResult>();
+		CSqlPlayerRequest Request(pExpected);
+		str_copy(Request.m_aName, pName, sizeof(Request.m_aName));
+		str_copy(Request.m_aMap, "Kobra 3", sizeof(Request.m_aMap));
+		str_copy(Request.m_aRequestingPlayer, "brainless tee", sizeof(Request.m_aRequestingPlayer));
+		str_copy(Request.m_aServer, pServer, sizeof(Request.m_aServer));
+		Request.m_Offset = Offset;
+		ASSERT_FALSE(pfnWorker(m_pConn, &Request, m_aError, sizeof(m_aError))) << m_aError;
+
+		CScorePlayerResult Cached;
+		(m_Cache.*pfnCache)(&Request, &Cached);
+		EXPECT_EQ(Cached.m_MessageKind, pExpected->m_MessageKind);
+		for(int i = 0; i < CScorePlayerResult::MAX_MESSAGES; i++)
+			EXPECT_STREQ(Cached.m_Data.m_aaMessages[i], pExpected->m_Data.m_aaMessages[i]) << pName << " " << Offset << " " << pServer;
+	}
+
+	void ExpectSameAnswers()
+	{
+		// the regional ranks are kept for the server name when loading
+		for(const char *pServer : {"GER", "US"})
+		{
+			for(int Regional = 0; Regional <= 1; Regional++)
+			{
+				g_Config.m_SvRegionalRankings = Regional;
+				for(const char *pName : {"tee 0", "tee 3", "tee 7", "brainless tee"})
+					ExpectSameAnswer(CScoreWorker::ShowRank, &CScoreCache::ShowRank, pName, 0, pServer);
+				for(int Offset : {1, 3, 8, -1, -4})
+				{
+					ExpectSameAnswer(CScoreWorker::ShowTop, &CScoreCache::ShowTop, "", Offset, pServer);
+					ExpectSameAnswer(CScoreWorker::ShowTeamTop5, &CScoreCache::ShowTeamTop5, "", Offset, pServer);
+				}
+			}
+		}
+	}
+};
+
+TEST_P(CachedScore, Empty)
+{
+	Load();
+	EXPECT_EQ(m_Cache.NumRanks(), 0);
+	EXPECT_EQ(m_Cache.NumTeamRanks(), 0);
+	ExpectSameAnswers();
+}
+
+TEST_P(CachedScore, SameAsDatabase)
+{
+	for(int i = 0; i < 8; i++)
+	{
+		char aName[MAX_NAME_LENGTH];
+		str_format(aName, sizeof(aName), "tee %d", i);
+		Finish(aName, i % 3 == 0 ? "GER" : "USA", 100.0f + i * 3.5f);
+		Finish(aName, "GER", 130.0f - i * 1.25f);
+	}
+	TeamFinish({"tee 1", "tee 2"}, 90.0f);
+	TeamFinish({"tee 3", "tee 2", "tee 4"}, 95.5f);
+	TeamFinish({"tee 5", "tee 6"}, 120.0f);
+	Load();
+	EXPECT_EQ(m_Cache.NumRanks(), 8);
+	EXPECT_EQ(m_Cache.NumTeamRanks(), 3);
+	ExpectSameAnswers();
+}
+
+TEST_P(CachedScore, WriteThrough)
+{
+	Load();
+	Finish("tee 0", "USA", 100.0f);
+	Finish("tee 3", "GER", 80.123f);
+	Finish("tee 0", "GER", 99.0f);
+	Finish("tee 7", "GER", 101.0f);
+	Finish("tee 3", "USA", 120.0f);
+	TeamFinish({"tee 0", "tee 3"}, 90.0f);
+	TeamFinish({"tee 3", "tee 0"}, 85.0f);
+	TeamFinish({"tee 3", "tee 0"}, 87.0f);
+	TeamFinish({"tee 3", "tee 7"}, 89.0f);
+	EXPECT_EQ(m_Cache.NumRanks(), 3);
+	EXPECT_EQ(m_Cache.NumTeamRanks(), 2);
+	ExpectSameAnswers();
+}
+
+struct ReplayFinishes : public Score
+{
+	// a player joins, finishes and looks at the rank
+	void Replay(int NumFinishes)
+	{
+		const int NUM_PLAYERS = 100;
+		g_Config.m_SvRegionalRankings = false;
+		for(int i = 0; i < NumFinishes; i++)
+		{
+			char aName[MAX_NAME_LENGTH];
+			str_format(aName, sizeof(aName), "tee %d", i % NUM_PLAYERS);
+
+			CSqlPlayerRequest Request(std::make_shared<CScorePlayerResult>());
+			str_copy(Request.m_aMap, "Kobra 3", sizeof(Request.m_aMap));
+			str_copy(Request.m_aRequestingPlayer, aName, sizeof(Request.m_aRequestingPlayer));
+			str_copy(Request.m_aName, "", sizeof(Request.m_aName));
+			str_copy(Request.m_aServer, "GER", sizeof(Request.m_aServer));
+			Request.m_Offset = 0;
+			ASSERT_FALSE(CScoreWorker::LoadPlayerData(m_pConn, &Request, m_aError, sizeof(m_aError))) << m_aError;
+
+			CSqlScoreData ScoreData(std::make_shared<CScorePlayerResult>());
+			str_copy(ScoreData.m_aMap, "Kobra 3", sizeof(ScoreData.m_aMap));
+			str_copy(ScoreData.m_aGameUuid, "8d300ecf-5873-4297-bee5-95668fdff320", sizeof(ScoreData.m_aGameUuid));
+			str_copy(ScoreData.m_aName, aName, sizeof(ScoreData.m_aName));
+			ScoreData.m_ClientID = 0;
+			ScoreData.m_Time = 60.0f + (i * 7 % 1000) * 0.02f;
+			str_copy(ScoreData.m_aTimestamp, "2021-11-24 19:24:08", sizeof(ScoreData.m_aTimestamp));
+			for(int Cp = 0; Cp < NUM_CHECKPOINTS; Cp++)
+				ScoreData.m_aCurrentTimeCp[Cp] = Cp * 2.0f;
+			str_copy(ScoreData.m_aRequestingPlayer, aName, sizeof(ScoreData.m_aRequestingPlayer));
+			ASSERT_FALSE(CScoreWorker::SaveScore(m_pConn, &ScoreData, Write::NORMAL, m_aError, sizeof(m_aError))) << m_aError;
+
+			str_copy(Request.m_aName, aName, sizeof(Request.m_aName));
+			ASSERT_FALSE(CScoreWorker::ShowRank(m_pConn, &Request, m_aError, sizeof(m_aError))) << m_aError;
+		}
+	}
+};
+
+TEST_P(ReplayFinishes, StatementCache)
+{
+	const int NUM_FINISHES = 50;
+	const int64_t Hits = m_pConn->NumStatementCacheHits();
+	const int64_t Misses = m_pConn->NumStatementCacheMisses();
+	Replay(NUM_FINISHES);
+	// only the first finish of each query compiles its statements
+	EXPECT_LE(m_pConn->NumStatementCacheMisses() - Misses, 10);
+	EXPECT_GE(m_pConn->NumStatementCacheHits() - Hits, NUM_FINISHES * 4);
+}
+
+TEST_P(ReplayFinishes, DISABLED_Benchmark)
+{
+	const int64_t Start = time_get();
+	Replay(2000);
+	RecordDuration("replay", time_get() - Start);
+}
+
+TEST(ScoreCache, LoadsAfterQueuedSaves)
+{
+	CTestInfo Info;
+	char aFilename[64];
+	Info.Filename(aFilename, sizeof(aFilename), ".sqlite");
+	const int OldReadWorkers = g_Config.m_SvSqlReadWorkers;
+	g_Config.m_SvSqlReadWorkers = 2;
+	str_copy(g_Config.m_SvSqlServerName, "GER", sizeof(g_Config.m_SvSqlServerName));
+	auto pResult = std::make_shared<CScoreCacheResult>();
+	{
+		CDbConnectionPool Pool;
+		Pool.RegisterSqliteDatabase(CDbConnectionPool::READ, aFilename);
+		Pool.RegisterSqliteDatabase(CDbConnectionPool::WRITE, aFilename);
+
+		// the finishes of the previous round are still queued when the
+		// map is reloaded
+		for(int i = 0; i < 20; i++)
+		{
+			auto pScoreData = std::make_unique<CSqlScoreData>(std::make_shared<CScorePlayerResult>());
+			str_copy(pScoreData->m_aMap, "Kobra 3", sizeof(pScoreData->m_aMap));
+			str_copy(pScoreData->m_aGameUuid, "8d300ecf-5873-4297-bee5-95668fdff320", sizeof(pScoreData->m_aGameUuid));
+			str_format(pScoreData->m_aName, sizeof(pScoreData->m_aName), "tee %d", i);
+			pScoreData->m_ClientID = 0;
+			pScoreData->m_Time = 100.0f + i;
+			str_copy(pScoreData->m_aTimestamp, "2021-11-24 19:24:08", sizeof(pScoreData->m_aTimestamp));
+			for(float &Cp : pScoreData->m_aCurrentTimeCp)
+				Cp = 0.0f;
+			str_copy(pScoreData->m_aRequestingPlayer, pScoreData->m_aName, sizeof(pScoreData->m_aRequestingPlayer));
+			Pool.ExecuteWrite(CScoreWorker::SaveScore, std::move(pScoreData), "save score");
+		}
+		auto pRequest = std::make_unique<CSqlScoreCacheRequest>(pResult);
+		str_copy(pRequest->m_aMap, "Kobra 3", sizeof(pRequest->m_aMap));
+		str_copy(pRequest->m_aServer, "GER", sizeof(pRequest->m_aServer));
+		Pool.Execute(CScoreCache::Load, std::move(pRequest), "load score cache");
+		for(int i = 0; i < 10000 && !pResult->m_Completed; i++)
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+	g_Config.m_SvSqlReadWorkers = OldReadWorkers;
+
+	ASSERT_TRUE(pResult->m_Completed);
+	EXPECT_TRUE(pResult->m_Success);
+	EXPECT_EQ(pResult->m_Cache.NumRanks(), 20);
+	char aBuf[IO_MAX_PATH_LENGTH];
+	fs_remove(aFilename);
+	str_format(aBuf, sizeof(aBuf), "%s-wal", aFilename);
+	fs_remove(aBuf);
+	str_format(aBuf, sizeof(aBuf), "%s-shm", aFilename);
+	fs_remove(aBuf);
+}
+
 auto g_pSqliteConn = CreateSqliteConnection(":memory:", true);
 #if defined(CONF_TEST_MYSQL)
 CMysqlConfig gMysqlConfig{
@@ -624,3 +862,5 @@ INSTANTIATE(MapInfo);
 INSTANTIATE(MapVote);
 INSTANTIATE(Points);
 INSTANTIATE(RandomMap);
+INSTANTIATE(CachedScore);
+INSTANTIATE(ReplayFinishes);
@@ -1,13 +1,20 @@
 #include <gtest/gtest.h>
 #include <memory>
 
+#include <engine/client/serverbrowser.h>
+#include <engine/client/serverbrowser_http.h>
 #include <engine/client/serverbrowser_ping_cache.h>
 #include <engine/console.h>
 #include <engine/engine.h>
+#include <engine/serverbrowser.h>
 #include <engine/shared/config.h>
 #include <engine/storage.h>
 #include <test/test.h>
 
+#include <algorithm>
+#include <string>
+#include <vector>
+
 TEST(ServerBrowser, PingCache)
 {
 	CTestInfo Info;
@@ -97,3 +104,320 @@ TEST(ServerBrowser, PingCache)
 	EXPECT_EQ(pPingCache->GetPing(&OtherLocalhost4, 1), 1337);
 	EXPECT_EQ(pPingCache->GetPing(&OtherLocalhost6, 1), 345);
 }
+
+static std::string ServerListJson(int NumServers, int NumClients)
+{
+	std::string Json = "{\"servers\":[";
+	for(int i = 0; i < NumServers; i++)
+	{
+		char aServer[512];
+		str_format(aServer, sizeof(aServer),
+			"%s{\"addresses\":[\"tw-0.6+udp://127.0.0.1:%d\",\"tw-0.6+udp://127.0.0.3:%d\"],\"location\":\"eu\",\"info\":"
+			"{\"max_clients\":64,\"max_players\":64,\"passworded\":false,\"game_type\":\"DDraceNetwork\",\"name\":\"Server %d\","
+			"\"map\":{\"name\":\"Map %d\"},\"version\":\"0.6.4, 17.4\",\"clients\":[",
+			i == 0 ? "" : ",", 8303 + i, 8303 + i, i, i % 50);
+		Json += aServer;
+		for(int c = 0; c < NumClients; c++)
+		{
+			char aClient[256];
+			str_format(aClient, sizeof(aClient), "%s{\"name\":\"Player %d\",\"clan\":\"Clan\",\"country\":-1,\"score\":%d,\"is_player\":%s,\"skin\":{\"name\":\"default\"}}",
+				c == 0 ? "" : ",", c, c * 10, c % 4 ? "true" : "false");
+			Json += aClient;
+		}
+		Json += "]}}";
+	}
+	Json += "],\"servers_legacy\":[\"127.0.0.2:8303\"]}";
+	return Json;
+}
+
+TEST(ServerBrowser, ParseServerList)
+{
+	std::string Json = ServerListJson(3, 5);
+	std::vector<CServerInfo> vServers;
+	std::vector<NETADDR> vLegacyServers;
+	ASSERT_FALSE(ServerbrowserParseServerList((const unsigned char *)Json.data(), Json.size(), &vServers, &vLegacyServers));
+	ASSERT_EQ(vServers.size(), 3u);
+	ASSERT_EQ(vLegacyServers.size(), 1u);
+	EXPECT_STREQ(vServers[1].m_aName, "Server 1");
+	EXPECT_STREQ(vServers[1].m_aMap, "Map 1");
+	EXPECT_EQ(vServers[1].m_NumAddresses, 2);
+	EXPECT_EQ(vServers[1].m_aAddresses[0].port, 8304);
+	EXPECT_EQ(vServers[1].m_Location, CServerInfo::LOC_EUROPE);
+	EXPECT_EQ(vServers[1].m_NumClients, 5);
+	EXPECT_EQ(vServers[1].m_NumPlayers, 3);
+	EXPECT_STREQ(vServers[1].m_aClients[4].m_aName, "Player 4");
+	EXPECT_EQ(vServers[1].m_aClients[4].m_Score, 40);
+
+	const char aInvalid[] = "{\"servers\":[{\"addresses\":[],\"location\":5}]}";
+	EXPECT_TRUE(ServerbrowserParseServerList((const unsigned char *)aInvalid, str_length(aInvalid), &vServers, &vLegacyServers));
+	const char aTruncated[] = "{\"servers\":[";
+	EXPECT_TRUE(ServerbrowserParseServerList((const unsigned char *)aTruncated, str_length(aTruncated), &vServers, &vLegacyServers));
+}
+
+TEST(ServerBrowser, ServerListCache)
+{
+	std::string Json = ServerListJson(20, 3);
+	std::vector<CServerInfo> vServers;
+	std::vector<NETADDR> vLegacyServers;
+	ASSERT_FALSE(ServerbrowserParseServerList((const unsigned char *)Json.data(), Json.size(), &vServers, &vLegacyServers));
+
+	std::vector<unsigned char> vData;
+	ServerbrowserSerializeServerList(vServers, vLegacyServers, &vData);
+
+	std::vector<CServerInfo> vCachedServers;
+	std::vector<NETADDR> vCachedLegacyServers;
+	ASSERT_FALSE(ServerbrowserDeserializeServerList(vData.data(), vData.size(), &vCachedServers, &vCachedLegacyServers));
+	ASSERT_EQ(vCachedServers.size(), vServers.size());
+	ASSERT_EQ(vCachedLegacyServers.size(), vLegacyServers.size());
+	for(size_t i = 0; i < vServers.size(); i++)
+	{
+		const CServerInfo &Cached = vCachedServers[i];
+		const CServerInfo &Server = vServers[i];
+		ASSERT_EQ(Cached.m_NumAddresses, Server.m_NumAddresses);
+		for(int a = 0; a < Server.m_NumAddresses; a++)
+		{
+			EXPECT_EQ(Cached.m_aAddresses[a], Server.m_aAddresses[a]);
+		}
+		EXPECT_EQ(Cached.m_Location, Server.m_Location);
+		EXPECT_EQ(Cached.m_MaxClients, Server.m_MaxClients);
+		EXPECT_EQ(Cached.m_NumClients, Server.m_NumClients);
+		EXPECT_EQ(Cached.m_MaxPlayers, Server.m_MaxPlayers);
+		EXPECT_EQ(Cached.m_NumPlayers, Server.m_NumPlayers);
+		EXPECT_EQ(Cached.m_ClientScoreKind, Server.m_ClientScoreKind);
+		EXPECT_EQ(Cached.m_Flags, Server.m_Flags);
+		EXPECT_EQ(Cached.m_Latency, Server.m_Latency);
+		EXPECT_STREQ(Cached.m_aGameType, Server.m_aGameType);
+		EXPECT_STREQ(Cached.m_aName, Server.m_aName);
+		EXPECT_STREQ(Cached.m_aMap, Server.m_aMap);
+		EXPECT_STREQ(Cached.m_aVersion, Server.m_aVersion);
+		ASSERT_EQ(Cached.m_NumReceivedClients, Server.m_NumReceivedClients);
+		for(int c = 0; c < Server.m_NumReceivedClients; c++)
+		{
+			EXPECT_STREQ(Cached.m_aClients[c].m_aName, Server.m_aClients[c].m_aName);
+			EXPECT_STREQ(Cached.m_aClients[c].m_aClan, Server.m_aClients[c].m_aClan);
+			EXPECT_EQ(Cached.m_aClients[c].m_Score, Server.m_aClients[c].m_Score);
+			EXPECT_EQ(Cached.m_aClients[c].m_Player, Server.m_aClients[c].m_Player);
+			EXPECT_STREQ(Cached.m_aClients[c].m_aSkin, Server.m_aClients[c].m_aSkin);
+		}
+	}
+	EXPECT_EQ(vCachedLegacyServers[0], vLegacyServers[0]);
+
+	// Broken caches are ignored and leave the output alone.
+	for(size_t Size : {(size_t)0, (size_t)10, vData.size() / 2, vData.size() - 1})
+	{
+		EXPECT_TRUE(ServerbrowserDeserializeServerList(vData.data(), Size, &vCachedServers, &vCachedLegacyServers));
+		EXPECT_EQ(vCachedServers.size(), vServers.size());
+	}
+
+	// Corrupt caches never load out of range bools or enums.
+	for(size_t i = 0; i < vData.size(); i++)
+	{
+		std::vector<unsigned char> vCorrupt = vData;
+		vCorrupt[i] ^= 0x02;
+		std::vector<CServerInfo> vCorruptServers;
+		if(!ServerbrowserDeserializeServerList(vCorrupt.data(), vCorrupt.size(), &vCorruptServers, &vCachedLegacyServers))
+		{
+			for(const CServerInfo &Info : vCorruptServers)
+			{
+				EXPECT_GE(Info.m_Location, (int)CServerInfo::LOC_UNKNOWN);
+				EXPECT_LT(Info.m_Location, (int)CServerInfo::NUM_LOCS);
+				EXPECT_GE(Info.m_ClientScoreKind, CServerInfo::CLIENT_SCORE_KIND_UNSPECIFIED);
+				EXPECT_LE(Info.m_ClientScoreKind, CServerInfo::CLIENT_SCORE_KIND_TIME_BACKCOMPAT);
+				EXPECT_LE(Info.m_NumReceivedClients, SERVERINFO_MAX_CLIENTS);
+			}
+		}
+	}
+	vData[0] ^= 1;
+	EXPECT_TRUE(ServerbrowserDeserializeServerList(vData.data(), vData.size(), &vCachedServers, &vCachedLegacyServers));
+}
+
+TEST(ServerBrowser, DISABLED_ParseServerListBenchmark)
+{
+	std::string Json = ServerListJson(1500, 8);
+	std::vector<CServerInfo> vServers;
+	std::vector<NETADDR> vLegacyServers;
+
+	int64_t Start = time_get();
+	ASSERT_FALSE(ServerbrowserParseServerList((const unsigned char *)Json.data(), Json.size(), &vServers, &vLegacyServers));
+	int64_t Parsed = time_get() - Start;
+
+	std::vector<unsigned char> vData;
+	ServerbrowserSerializeServerList(vServers, vLegacyServers, &vData);
+	std::vector<CServerInfo> vCachedServers;
+	std::vector<NETADDR> vCachedLegacyServers;
+	Start = time_get();
+	ASSERT_FALSE(ServerbrowserDeserializeServerList(vData.data(), vData.size(), &vCachedServers, &vCachedLegacyServers));
+	int64_t Loaded = time_get() - Start;
+
+	EXPECT_EQ(vCachedServers.size(), 1500u);
+	RecordProperty("json_bytes", (int)Json.size());
+	RecordProperty("cache_bytes", (int)vData.size());
+	RecordDuration("parse", Parsed);
+	RecordDuration("load_cache", Loaded);
+}
+
+struct CSortTestServer
+{
+	char m_aName[32];
+	int m_Latency;
+	int m_NumPlayers;
+};
+
+// one info or ping answer of a server list refresh
+struct CSortTestUpdate
+{
+	int m_Index;
+	int m_Latency;
+	int m_NumPlayers;
+};
+
+static std::vector<CSortTestServer> SortTestServers(int NumServers)
+{
+	std::vector<CSortTestServer> vServers(NumServers);
+	for(int i = 0; i < NumServers; i++)
+	{
+		str_format(vServers[i].m_aName, sizeof(vServers[i].m_aName), "server %d", (i * 7919) % 1000);
+		vServers[i].m_Latency = 999;
+		vServers[i].m_NumPlayers = 0;
+	}
+	return vServers;
+}
+
+// every server answers once with its info, some of them get pinged again
+static std::vector<CSortTestUpdate> SortTestBurst(int NumServers)
+{
+	std::vector<CSortTestUpdate> vUpdates;
+	unsigned Seed = 1;
+	auto Random = [&Seed](int Below) {
+		Seed = Seed * 1103515245 + 12345;
+		return (int)((Seed >> 8) % Below);
+	};
+	for(int i = 0; i < NumServers; i++)
+		vUpdates.push_back({(i * 31) % NumServers, 10 + Random(300), Random(5) ? Random(4) : Random(64)});
+	for(int i = 0; i < NumServers / 4; i++)
+	{
+		const CSortTestUpdate &Old = vUpdates[Random(NumServers)];
+		vUpdates.push_back({Old.m_Index, 10 + Random(300), Old.m_NumPlayers});
+	}
+	return vUpdates;
+}
+
+static std::vector<int> SortTestOrder(const CSortedServerIndices &Sorted)
+{
+	std::vector<int> vOrder;
+	for(int i = 0; i < Sorted.Size(); i++)
+		vOrder.push_back(Sorted[i]);
+	return vOrder;
+}
+
+TEST(ServerBrowser, SortedServerIndices)
+{
+	const int NUM_SERVERS = 300;
+	std::vector<CSortTestServer> vServers = SortTestServers(NUM_SERVERS);
+	const std::vector<CSortTestUpdate> vUpdates = SortTestBurst(NUM_SERVERS);
+
+	auto CompareName = [&](int Index1, int Index2) { return str_comp(vServers[Index1].m_aName, vServers[Index2].m_aName) < 0; };
+	auto ComparePing = [&](int Index1, int Index2) { return vServers[Index1].m_Latency < vServers[Index2].m_Latency; };
+	auto ComparePlayers = [&](int Index1, int Index2) { return vServers[Index1].m_NumPlayers > vServers[Index2].m_NumPlayers; };
+	auto Filtered = [&](int Index) { return vServers[Index].m_NumPlayers == 0; };
+	const size_t UPDATES_PER_BATCH = 20;
+
+	auto Check = [&](auto Compare) {
+		auto ExpectSorted = [&](const CSortedServerIndices &Sorted) {
+			for(int i = 1; i < Sorted.Size(); i++)
+				ASSERT_FALSE(Compare(Sorted[i], Sorted[i - 1])) << "servers " << Sorted[i - 1] << " and " << Sorted[i];
+		};
+		vServers = SortTestServers(NUM_SERVERS);
+		CSortedServerIndices Sorted;
+		for(size_t Batch = 0; Batch < vUpdates.size(); Batch += UPDATES_PER_BATCH)
+		{
+			// like CServerBrowser::SortChanged, the keys of all servers of
+			// a batch change before the first one is moved
+			std::vector<int> vChanged;
+			for(size_t i = Batch; i < std::min(Batch + UPDATES_PER_BATCH, vUpdates.size()); i++)
+			{
+				const CSortTestUpdate &Update = vUpdates[i];
+				vServers[Update.m_Index].m_Latency = Update.m_Latency;
+				vServers[Update.m_Index].m_NumPlayers = Update.m_NumPlayers;
+				if(std::find(vChanged.begin(), vChanged.end(), Update.m_Index) == vChanged.end())
+					vChanged.push_back(Update.m_Index);
+			}
+			Sorted.RemoveMany(vChanged);
+			for(int Index : vChanged)
+			{
+				if(!Filtered(Index))
+					Sorted.Insert(Index, Compare);
+			}
+			ExpectSorted(Sorted);
+		}
+
+		CSortedServerIndices Expected;
+		for(int i = 0; i < NUM_SERVERS; i++)
+			if(!Filtered(i))
+				Expected.Add(i);
+		Expected.Sort(Compare);
+		EXPECT_GT(Expected.Size(), 0);
+		EXPECT_EQ(SortTestOrder(Sorted), SortTestOrder(Expected));
+	};
+	Check(CompareName);
+	Check(ComparePing);
+	Check(ComparePlayers);
+
+	CSortedServerIndices Sorted;
+	EXPECT_FALSE(Sorted.Remove(0));
+	Sorted.Add(0);
+	EXPECT_TRUE(Sorted.Remove(0));
+	EXPECT_EQ(Sorted.Size(), 0);
+}
+
+TEST(ServerBrowser, DISABLED_SortRefreshBurstBenchmark)
+{
+	// servers answer over many frames, the list is brought up to date once per frame
+	const int NUM_SERVERS = 2500;
+	const int UPDATES_PER_FRAME = 20;
+	std::vector<CSortTestServer> vServers = SortTestServers(NUM_SERVERS);
+	const std::vector<CSortTestUpdate> vUpdates = SortTestBurst(NUM_SERVERS);
+	auto Compare = [&](int Index1, int Index2) { return vServers[Index1].m_Latency < vServers[Index2].m_Latency; };
+
+	CSortedServerIndices Full;
+	int64_t Start = time_get();
+	for(size_t Frame = 0; Frame < vUpdates.size(); Frame += UPDATES_PER_FRAME)
+	{
+		for(size_t i = Frame; i < std::min(Frame + UPDATES_PER_FRAME, vUpdates.size()); i++)
+		{
+			vServers[vUpdates[i].m_Index].m_Latency = vUpdates[i].m_Latency;
+			vServers[vUpdates[i].m_Index].m_NumPlayers = vUpdates[i].m_NumPlayers;
+		}
+		Full.Clear();
+		for(int i = 0; i < NUM_SERVERS; i++)
+			Full.Add(i);
+		Full.Sort(Compare);
+	}
+	int64_t Resorted = time_get() - Start;
+
+	vServers = SortTestServers(NUM_SERVERS);
+	CSortedServerIndices Incremental;
+	for(int i = 0; i < NUM_SERVERS; i++)
+		Incremental.Add(i);
+	Incremental.Sort(Compare);
+	Start = time_get();
+	for(size_t Frame = 0; Frame < vUpdates.size(); Frame += UPDATES_PER_FRAME)
+	{
+		std::vector<int> vChanged;
+		for(size_t i = Frame; i < std::min(Frame + UPDATES_PER_FRAME, vUpdates.size()); i++)
+		{
+			vServers[vUpdates[i].m_Index].m_Latency = vUpdates[i].m_Latency;
+			vServers[vUpdates[i].m_Index].m_NumPlayers = vUpdates[i].m_NumPlayers;
+			if(std::find(vChanged.begin(), vChanged.end(), vUpdates[i].m_Index) == vChanged.end())
+				vChanged.push_back(vUpdates[i].m_Index);
+		}
+		Incremental.RemoveMany(vChanged);
+		for(int Index : vChanged)
+			Incremental.Insert(Index, Compare);
+	}
+	int64_t Moved = time_get() - Start;
+
+	EXPECT_EQ(SortTestOrder(Incremental), SortTestOrder(Full));
+	RecordDuration("full_resort", Resorted);
+	RecordDuration("move_single", Moved);
+}
@@ -0,0 +1,388 @@
+#include <gtest/gtest.h>
+
+#include <base/system.h>
+#include <engine/shared/compression.h>
+#include <engine/shared/snapshot.h>
+#include <engine/shared/snapshot_simd.h>
+#include <test/test.h>
+
+#include <algorithm>
+#include <iterator>
+#include <memory>
+#include <vector>
+
+static const int NUM_BENCHMARK_ITERATIONS = 200;
+// the builder keeps one item slot in reserve
+static const int MAX_BUILDER_ITEMS = CSnapshot::MAX_ITEMS - 1;
+
+static int BuildSnapshot(CSnapshot *pSnapshot, int NumItems, int Seed)
+{
+	CSnapshotBuilder Builder;
+	Builder.Init();
+	for(int i = 0; i < NumItems; i++)
+	{
+		// spread the items over a few types, like a busy server would
+		const int Type = 1 + i % 8;
+		const int ID = i / 8 + (Seed % 3 == 0 && i % 5 == 0 ? 512 : 0);
+		int *pData = (int *)Builder.NewItem(Type, ID, 6 * sizeof(int));
+		if(!pData)
+			return -1;
+		for(int d = 0; d < 6; d++)
+			pData[d] = i * 16 + d + (d == 0 ? Seed : 0);
+	}
+	return Builder.Finish(pSnapshot);
+}
+
+static std::vector<char> BuildIndex(const CSnapshot *pSnapshot)
+{
+	std::vector<char> vIndexData(CSnapshotIndex::TotalSize(pSnapshot->NumItems()));
+	((CSnapshotIndex *)vIndexData.data())->Build(pSnapshot);
+	return vIndexData;
+}
+
+// item order is not preserved by deltas, so compare by key
+static void ExpectSameItems(const CSnapshot *pExpected, const CSnapshot *pActual)
+{
+	ASSERT_EQ(pActual->NumItems(), pExpected->NumItems());
+	for(int i = 0; i < pExpected->NumItems(); i++)
+	{
+		const CSnapshotItem *pItem = pExpected->GetItem(i);
+		const int Index = pActual->GetItemIndex(pItem->Key());
+		ASSERT_GE(Index, 0);
+		ASSERT_EQ(pActual->GetItemSize(Index), pExpected->GetItemSize(i));
+		EXPECT_EQ(mem_comp(pActual->GetItem(Index)->Data(), pItem->Data(), pExpected->GetItemSize(i)), 0);
+	}
+}
+
+TEST(Snapshot, IndexMatchesLinearLookup)
+{
+	std::vector<char> vData(CSnapshot::MAX_SIZE);
+	CSnapshot *pSnapshot = (CSnapshot *)vData.data();
+	ASSERT_GT(BuildSnapshot(pSnapshot, MAX_BUILDER_ITEMS, 0), 0);
+	ASSERT_EQ(pSnapshot->NumItems(), MAX_BUILDER_ITEMS);
+
+	std::vector<char> vIndexData = BuildIndex(pSnapshot);
+	const CSnapshotIndex *pIndex = (const CSnapshotIndex *)vIndexData.data();
+
+	for(int i = 0; i < pSnapshot->NumItems(); i++)
+	{
+		const int Key = pSnapshot->GetItem(i)->Key();
+		EXPECT_EQ(pSnapshot->GetItemIndex(Key, pIndex), i);
+		EXPECT_EQ(pSnapshot->GetItemIndex(Key, pIndex), pSnapshot->GetItemIndex(Key));
+	}
+	EXPECT_EQ(pSnapshot->GetItemIndex((9 << 16) | 1, pIndex), -1);
+	EXPECT_EQ(pSnapshot->GetItemIndex((1 << 16) | 4000, pIndex), -1);
+	EXPECT_EQ(pSnapshot->FindItem(3, 7, pIndex), pSnapshot->FindItem(3, 7));
+	EXPECT_EQ(pSnapshot->FindItem(3, 4000, pIndex), nullptr);
+}
+
+TEST(Snapshot, IndexInsertRejectsDuplicates)
+{
+	std::vector<char> vIndexData(CSnapshotIndex::TotalSize(4));
+	CSnapshotIndex *pIndex = (CSnapshotIndex *)vIndexData.data();
+	pIndex->Init(4);
+	EXPECT_TRUE(pIndex->Insert(1, 0));
+	EXPECT_TRUE(pIndex->Insert(2, 1));
+	EXPECT_FALSE(pIndex->Insert(1, 2));
+	EXPECT_EQ(pIndex->GetItemIndex(1), 0);
+	EXPECT_EQ(pIndex->GetItemIndex(2), 1);
+	EXPECT_EQ(pIndex->GetItemIndex(3), -1);
+}
+
+TEST(Snapshot, DeltaRoundtrip)
+{
+	std::vector<char> vFrom(CSnapshot::MAX_SIZE);
+	std::vector<char> vTo(CSnapshot::MAX_SIZE);
+	std::vector<char> vResult(CSnapshot::MAX_SIZE);
+	std::vector<char> vDelta(CSnapshot::MAX_SIZE);
+	std::vector<char> vDeltaIndexed(CSnapshot::MAX_SIZE);
+	CSnapshot *pFrom = (CSnapshot *)vFrom.data();
+	CSnapshot *pTo = (CSnapshot *)vTo.data();
+	CSnapshot *pResult = (CSnapshot *)vResult.data();
+
+	ASSERT_GT(BuildSnapshot(pFrom, 900, 1), 0);
+	const int ToSize = BuildSnapshot(pTo, 900, 3);
+	ASSERT_GT(ToSize, 0);
+
+	std::vector<char> vFromIndex = BuildIndex(pFrom);
+	std::vector<char> vToIndex = BuildIndex(pTo);
+	const CSnapshotIndex *pFromIndex = (const CSnapshotIndex *)vFromIndex.data();
+	const CSnapshotIndex *pToIndex = (const CSnapshotIndex *)vToIndex.data();
+
+	std::unique_ptr<CSnapshotDelta> pDelta = std::make_unique<CSnapshotDelta>();
+	const int DeltaSize = pDelta->CreateDelta(pFrom, pTo, vDelta.data());
+	ASSERT_GT(DeltaSize, 0);
+	ASSERT_EQ(pDelta->CreateDelta(pFrom, pTo, vDeltaIndexed.data(), pFromIndex, pToIndex), DeltaSize);
+	EXPECT_EQ(mem_comp(vDelta.data(), vDeltaIndexed.data(), DeltaSize), 0);
+
+	EXPECT_EQ(pDelta->UnpackDelta(pFrom, pResult, vDelta.data(), DeltaSize), ToSize);
+	ExpectSameItems(pTo, pResult);
+
+	std::fill(vResult.begin(), vResult.end(), 0);
+	EXPECT_EQ(pDelta->UnpackDelta(pFrom, pResult, vDelta.data(), DeltaSize, pFromIndex), ToSize);
+	ExpectSameItems(pTo, pResult);
+}
+
+TEST(Snapshot, DISABLED_BenchmarkDeltaFullSnapshot)
+{
+	std::vector<char> vFrom(CSnapshot::MAX_SIZE);
+	std::vector<char> vTo(CSnapshot::MAX_SIZE);
+	std::vector<char> vResult(CSnapshot::MAX_SIZE);
+	std::vector<char> vDelta(CSnapshot::MAX_SIZE);
+	CSnapshot *pFrom = (CSnapshot *)vFrom.data();
+	CSnapshot *pTo = (CSnapshot *)vTo.data();
+	CSnapshot *pResult = (CSnapshot *)vResult.data();
+
+	ASSERT_GT(BuildSnapshot(pFrom, MAX_BUILDER_ITEMS, 1), 0);
+	ASSERT_GT(BuildSnapshot(pTo, MAX_BUILDER_ITEMS, 2), 0);
+	std::vector<char> vFromIndex = BuildIndex(pFrom);
+	std::vector<char> vToIndex = BuildIndex(pTo);
+	const CSnapshotIndex *pFromIndex = (const CSnapshotIndex *)vFromIndex.data();
+	const CSnapshotIndex *pToIndex = (const CSnapshotIndex *)vToIndex.data();
+
+	std::unique_ptr<CSnapshotDelta> pDelta = std::make_unique<CSnapshotDelta>();
+
+	// lookup of every item, linear scan vs. index
+	int Found = 0;
+	int64_t Start = time_get();
+	for(int i = 0; i < pTo->NumItems(); i++)
+		Found += pFrom->GetItemIndex(pTo->GetItem(i)->Key()) >= 0;
+	const int64_t LookupLinear = time_get() - Start;
+	Start = time_get();
+	for(int n = 0; n < NUM_BENCHMARK_ITERATIONS; n++)
+		for(int i = 0; i < pTo->NumItems(); i++)
+			Found += pFrom->GetItemIndex(pTo->GetItem(i)->Key(), pFromIndex) >= 0;
+	const int64_t LookupIndexed = (time_get() - Start) / NUM_BENCHMARK_ITERATIONS;
+	EXPECT_EQ(Found, (NUM_BENCHMARK_ITERATIONS + 1) * pTo->NumItems());
+
+	// delta creation, indices built per call vs. cached indices
+	int DeltaSize = 0;
+	Start = time_get();
+	for(int n = 0; n < NUM_BENCHMARK_ITERATIONS; n++)
+		DeltaSize = pDelta->CreateDelta(pFrom, pTo, vDelta.data());
+	const int64_t CreateUncached = (time_get() - Start) / NUM_BENCHMARK_ITERATIONS;
+	Start = time_get();
+	for(int n = 0; n < NUM_BENCHMARK_ITERATIONS; n++)
+		DeltaSize = pDelta->CreateDelta(pFrom, pTo, vDelta.data(), pFromIndex, pToIndex);
+	const int64_t CreateCached = (time_get() - Start) / NUM_BENCHMARK_ITERATIONS;
+	ASSERT_GT(DeltaSize, 0);
+
+	Start = time_get();
+	for(int n = 0; n < NUM_BENCHMARK_ITERATIONS; n++)
+		EXPECT_GT(pDelta->UnpackDelta(pFrom, pResult, vDelta.data(), DeltaSize), 0);
+	const int64_t UnpackUncached = (time_get() - Start) / NUM_BENCHMARK_ITERATIONS;
+	Start = time_get();
+	for(int n = 0; n < NUM_BENCHMARK_ITERATIONS; n++)
+		EXPECT_GT(pDelta->UnpackDelta(pFrom, pResult, vDelta.data(), DeltaSize, pFromIndex), 0);
+	const int64_t UnpackCached = (time_get() - Start) / NUM_BENCHMARK_ITERATIONS;
+
+	RecordDuration("lookup_linear", LookupLinear);
+	RecordDuration("lookup_indexed", LookupIndexed);
+	RecordDuration("create_delta_uncached", CreateUncached);
+	RecordDuration("create_delta_cached", CreateCached);
+	RecordDuration("unpack_delta_uncached", UnpackUncached);
+	RecordDuration("unpack_delta_cached", UnpackCached);
+}
+
+// the loops CSnapshotSimd replaced, kept as reference
+static int DiffItemReference(const int *pPast, const int *pCurrent, int *pOut, int Size)
+{
+	int Needed = 0;
+	for(int i = 0; i < Size; i++)
+	{
+		pOut[i] = (unsigned)pCurrent[i] - (unsigned)pPast[i];
+		Needed |= pOut[i];
+	}
+	return Needed;
+}
+
+static int UndiffItemReference(const int *pPast, const int *pDiff, int *pOut, int Size)
+{
+	int DataRate = 0;
+	for(int i = 0; i < Size; i++)
+	{
+		pOut[i] = (unsigned)pPast[i] + (unsigned)pDiff[i];
+		if(pDiff[i] == 0)
+			DataRate += 1;
+		else
+		{
+			unsigned char aBuf[CVariableInt::MAX_BYTES_PACKED];
+			unsigned char *pEnd = CVariableInt::Pack(aBuf, pDiff[i], sizeof(aBuf));
+			DataRate += (int)(pEnd - (unsigned char *)aBuf) * 8;
+		}
+	}
+	return DataRate;
+}
+
+static unsigned CrcReference(const CSnapshot *pSnapshot)
+{
+	unsigned Crc = 0;
+	for(int i = 0; i < pSnapshot->NumItems(); i++)
+		for(int b = 0; b < pSnapshot->GetItemSize(i) / (int)sizeof(int32_t); b++)
+			Crc += pSnapshot->GetItem(i)->Data()[b];
+	return Crc;
+}
+
+static void FillRandom(std::vector<int> &vData, unsigned &State)
+{
+	static const int s_aEdgeValues[] = {0, 0, 0, 1, -1, 63, 64, -64, -65, 8191, 8192, -8193, (1 << 20) - 1, 1 << 20, (1 << 27) - 1, 1 << 27, 2147483647, (-2147483647 - 1)};
+	for(int &Value : vData)
+	{
+		State = State * 1664525u + 1013904223u;
+		if(State % 3 == 0)
+			Value = s_aEdgeValues[(State >> 8) % std::size(s_aEdgeValues)];
+		else
+			Value = (int)(State ^ (State >> 13)) >> ((State >> 24) % 31);
+	}
+}
+
+TEST(SnapshotSimd, MatchesReference)
+{
+	unsigned State = 1;
+	ASSERT_TRUE(CSnapshotSimd::IsSupported(CSnapshotSimd::IMPL_SCALAR));
+	for(int Impl = 0; Impl < CSnapshotSimd::NUM_IMPLS; Impl++)
+	{
+		const CSnapshotSimd *pSimd = CSnapshotSimd::Get(Impl);
+		if(!pSimd)
+			continue;
+		for(int Size = 0; Size < 70; Size++)
+		{
+			std::vector<int> vPast(Size), vCurrent(Size), vExpected(Size), vActual(Size);
+			FillRandom(vPast, State);
+			FillRandom(vCurrent, State);
+			if(Size % 4 == 0)
+				vCurrent = vPast;
+
+			EXPECT_EQ(pSimd->m_pfnDiff(vPast.data(), vCurrent.data(), vActual.data(), Size), DiffItemReference(vPast.data(), vCurrent.data(), vExpected.data(), Size)) << pSimd->m_pName << " " << Size;
+			EXPECT_EQ(vActual, vExpected) << pSimd->m_pName << " " << Size;
+
+			EXPECT_EQ(pSimd->m_pfnUndiff(vPast.data(), vCurrent.data(), vActual.data(), Size), UndiffItemReference(vPast.data(), vCurrent.data(), vExpected.data(), Size)) << pSimd->m_pName << " " << Size;
+			EXPECT_EQ(vActual, vExpected) << pSimd->m_pName << " " << Size;
+
+			unsigned Sum = 0;
+			for(int Value : vCurrent)
+				Sum += Value;
+			EXPECT_EQ(pSimd->m_pfnSum(vCurrent.data(), Size), Sum) << pSimd->m_pName << " " << Size;
+		}
+	}
+}
+
+TEST(SnapshotSimd, Crc)
+{
+	std::vector<char> vData(CSnapshot::MAX_SIZE);
+	CSnapshot *pSnapshot = (CSnapshot *)vData.data();
+	ASSERT_GT(BuildSnapshot(pSnapshot, 0, 0), 0);
+	EXPECT_EQ(pSnapshot->Crc(), 0u);
+	for(int NumItems : {1, 7, 100, MAX_BUILDER_ITEMS})
+	{
+		ASSERT_GT(BuildSnapshot(pSnapshot, NumItems, NumItems), 0);
+		EXPECT_EQ(pSnapshot->Crc(), CrcReference(pSnapshot));
+	}
+}
+
+TEST(SnapshotSimd, DISABLED_Benchmark)
+{
+	const int NUM_VALUES = 1 << 14;
+	std::vector<int> vPast(NUM_VALUES), vCurrent(NUM_VALUES), vOut(NUM_VALUES);
+	unsigned State = 2;
+	FillRandom(vPast, State);
+	FillRandom(vCurrent, State);
+
+	// typical item sizes are small, so process the data in chunks of 10 values
+	const int ITEM_SIZE = 10;
+	for(int Impl = 0; Impl < CSnapshotSimd::NUM_IMPLS; Impl++)
+	{
+		const CSnapshotSimd *pSimd = CSnapshotSimd::Get(Impl);
+		if(!pSimd)
+			continue;
+
+		int Needed = 0;
+		int64_t Start = time_get();
+		for(int n = 0; n < NUM_BENCHMARK_ITERATIONS; n++)
+			for(int i = 0; i + ITEM_SIZE <= NUM_VALUES; i += ITEM_SIZE)
+				Needed |= pSimd->m_pfnDiff(&vPast[i], &vCurrent[i], &vOut[i], ITEM_SIZE);
+		const int64_t Diff = (time_get() - Start) / NUM_BENCHMARK_ITERATIONS;
+
+		int DataRate = 0;
+		Start = time_get();
+		for(int n = 0; n < NUM_BENCHMARK_ITERATIONS; n++)
+			for(int i = 0; i + ITEM_SIZE <= NUM_VALUES; i += ITEM_SIZE)
+				DataRate += pSimd->m_pfnUndiff(&vPast[i], &vCurrent[i], &vOut[i], ITEM_SIZE);
+		const int64_t Undiff = (time_get() - Start) / NUM_BENCHMARK_ITERATIONS;
+
+		unsigned Sum = 0;
+		Start = time_get();
+		for(int n = 0; n < NUM_BENCHMARK_ITERATIONS; n++)
+			Sum += pSimd->m_pfnSum(vCurrent.data(), NUM_VALUES);
+		const int64_t Crc = (time_get() - Start) / NUM_BENCHMARK_ITERATIONS;
+
+		EXPECT_NE(Needed, 0);
+		EXPECT_GT(DataRate, 0);
+		EXPECT_EQ(Sum, pSimd->m_pfnSum(vCurrent.data(), NUM_VALUES) * NUM_BENCHMARK_ITERATIONS);
+		char aName[64];
+		str_format(aName, sizeof(aName), "%s_diff", pSimd->m_pName);
+		RecordDuration(aName, Diff);
+		str_format(aName, sizeof(aName), "%s_undiff", pSimd->m_pName);
+		RecordDuration(aName, Undiff);
+		str_format(aName, sizeof(aName), "%s_crc", pSimd->m_pName);
+		RecordDuration(aName, Crc);
+	}
+}
+
+TEST(SnapshotStorage, AddGetPurge)
+{
+	std::vector<char> vData(CSnapshot::MAX_SIZE);
+	CSnapshot *pSnapshot = (CSnapshot *)vData.data();
+	const int Size = BuildSnapshot(pSnapshot, 100, 0);
+	ASSERT_GT(Size, 0);
+
+	CSnapshotStorage Storage;
+	EXPECT_EQ(Storage.First(), nullptr);
+	EXPECT_EQ(Storage.Get(0, nullptr, nullptr, nullptr), -1);
+
+	// more ticks than the initial ring size, with a gap every 7 ticks
+	std::vector<int> vTicks;
+	for(int Tick = 1; Tick < 1000; Tick++)
+	{
+		if(Tick % 7 == 0)
+			continue;
+		Storage.Add(Tick, Tick, Size, pSnapshot, 0, nullptr);
+		vTicks.push_back(Tick);
+	}
+
+	for(int Tick = 0; Tick < 1001; Tick++)
+	{
+		const CSnapshot *pStored = nullptr;
+		const CSnapshotIndex *pIndex = nullptr;
+		int64_t Tagtime = -1;
+		if(Tick == 0 || Tick == 1000 || Tick % 7 == 0)
+		{
+			EXPECT_EQ(Storage.Get(Tick, &Tagtime, &pStored, nullptr, &pIndex), -1);
+			continue;
+		}
+		ASSERT_EQ(Storage.Get(Tick, &Tagtime, &pStored, nullptr, &pIndex), Size);
+		EXPECT_EQ(Tagtime, Tick);
+		EXPECT_EQ(mem_comp(pStored, pSnapshot, Size), 0);
+		EXPECT_EQ(pStored->GetItemIndex(pSnapshot->GetItem(42)->Key(), pIndex), 42);
+	}
+
+	size_t i = 0;
+	for(CSnapshotStorage::CHolder *pHolder = Storage.First(); pHolder; pHolder = Storage.Next(pHolder))
+		EXPECT_EQ(pHolder->m_Tick, vTicks[i++]);
+	EXPECT_EQ(i, vTicks.size());
+
+	Storage.PurgeUntil(500);
+	ASSERT_NE(Storage.First(), nullptr);
+	EXPECT_EQ(Storage.First()->m_Tick, 500);
+	EXPECT_EQ(Storage.Get(499, nullptr, nullptr, nullptr), -1);
+	EXPECT_EQ(Storage.Get(500, nullptr, nullptr, nullptr), Size);
+	EXPECT_EQ(Storage.Last()->m_Tick, 999);
+
+	// keeps working after being emptied
+	Storage.PurgeUntil(2000);
+	EXPECT_EQ(Storage.First(), nullptr);
+	Storage.Add(5, 0, Size, pSnapshot, 0, nullptr);
+	EXPECT_EQ(Storage.Get(5, nullptr, nullptr, nullptr), Size);
+	Storage.PurgeAll();
+	EXPECT_EQ(Storage.Last(), nullptr);
+}
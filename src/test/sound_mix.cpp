@@ -0,0 +1,121 @@
+#include <gtest/gtest.h>
+
+#include <base/system.h>
+#include <engine/client/sound_mix.h>
+#include <test/test.h>
+
+#include <algorithm>
+#include <limits>
+#include <vector>
+
+static unsigned NextRandom(unsigned &State)
+{
+	State = State * 1103515245 + 12345;
+	return State >> 8;
+}
+
+// the loops CSoundMix replaced, kept as reference
+static void MixReference(int *pOut, const short *pIn, unsigned Frames, int Channels, int VolumeL, int VolumeR)
+{
+	const short *pInL = pIn;
+	const short *pInR = Channels == 1 ? pIn : pIn + 1;
+	for(unsigned s = 0; s < Frames; s++)
+	{
+		*pOut++ += (*pInL) * VolumeL;
+		*pOut++ += (*pInR) * VolumeR;
+		pInL += Channels;
+		pInR += Channels;
+	}
+}
+
+static void ClipReference(const int *pMix, short *pOut, unsigned Num, int MasterVol)
+{
+	for(unsigned i = 0; i < Num; i++)
+		pOut[i] = std::clamp<int>(((pMix[i] * MasterVol) / 101) >> 8, std::numeric_limits<short>::min(), std::numeric_limits<short>::max());
+}
+
+TEST(SoundMix, MatchesReference)
+{
+	unsigned State = 1;
+	ASSERT_TRUE(CSoundMix::Get(CSoundMix::IMPL_SCALAR));
+	for(int Impl = 0; Impl < CSoundMix::NUM_IMPLS; Impl++)
+	{
+		const CSoundMix *pMix = CSoundMix::Get(Impl);
+		if(!pMix)
+			continue;
+		for(unsigned Frames = 0; Frames < 40; Frames++)
+		{
+			for(int Channels = 1; Channels <= 2; Channels++)
+			{
+				std::vector<short> vIn(Frames * Channels);
+				for(short &Sample : vIn)
+					Sample = NextRandom(State);
+				std::vector<int> vExpected(Frames * 2);
+				for(int &Value : vExpected)
+					Value = (int)(NextRandom(State) % 2000000) - 1000000;
+				std::vector<int> vActual = vExpected;
+
+				const int VolumeL = NextRandom(State) % 256;
+				const int VolumeR = Frames % 5 == 0 ? 0 : NextRandom(State) % 256;
+				MixReference(vExpected.data(), vIn.data(), Frames, Channels, VolumeL, VolumeR);
+				(Channels == 1 ? pMix->m_pfnMixMono : pMix->m_pfnMixStereo)(vActual.data(), vIn.data(), Frames, VolumeL, VolumeR);
+				EXPECT_EQ(vActual, vExpected) << pMix->m_pName << " " << Frames << " " << Channels;
+
+				// values that don't overflow the reference
+				const int MasterVol = NextRandom(State) % 101;
+				std::vector<short> vExpectedOut(Frames * 2), vActualOut(Frames * 2);
+				for(int &Value : vExpected)
+					Value = (int)(NextRandom(State) % 40000000) - 20000000;
+				ClipReference(vExpected.data(), vExpectedOut.data(), Frames * 2, MasterVol);
+				pMix->m_pfnClip(vExpected.data(), vActualOut.data(), Frames * 2, MasterVol);
+				EXPECT_EQ(vActualOut, vExpectedOut) << pMix->m_pName << " " << Frames << " " << MasterVol;
+			}
+		}
+
+		// many loud voices saturate
+		const int aLoud[8] = {std::numeric_limits<int>::max(), std::numeric_limits<int>::min(), 900000000, -900000000, 8000000, -8000000, 255, -255};
+		short aOut[8];
+		pMix->m_pfnClip(aLoud, aOut, 8, 100);
+		const short aExpected[8] = {32767, -32768, 32767, -32768, 30940, -30941, 0, -1};
+		for(int i = 0; i < 8; i++)
+			EXPECT_EQ(aOut[i], aExpected[i]) << pMix->m_pName << " " << i;
+	}
+}
+
+TEST(SoundMix, DISABLED_Benchmark)
+{
+	// 64 voices of 20ms at 48kHz
+	const unsigned FRAMES = 960;
+	const int NUM_VOICES = 64;
+	const int NUM_ITERATIONS = 200;
+
+	unsigned State = 1;
+	std::vector<short> vSamples(FRAMES * 2 * NUM_VOICES);
+	for(short &Sample : vSamples)
+		Sample = NextRandom(State);
+	std::vector<int> vMix(FRAMES * 2);
+	std::vector<short> vOut(FRAMES * 2);
+
+	for(int Impl = 0; Impl < CSoundMix::NUM_IMPLS; Impl++)
+	{
+		const CSoundMix *pMix = CSoundMix::Get(Impl);
+		if(!pMix)
+			continue;
+
+		int64_t Start = time_get();
+		for(int n = 0; n < NUM_ITERATIONS; n++)
+		{
+			std::fill(vMix.begin(), vMix.end(), 0);
+			for(int Voice = 0; Voice < NUM_VOICES; Voice++)
+			{
+				if(Voice % 2)
+					pMix->m_pfnMixStereo(vMix.data(), &vSamples[Voice * FRAMES * 2], FRAMES, 40, 30);
+				else
+					pMix->m_pfnMixMono(vMix.data(), &vSamples[Voice * FRAMES * 2], FRAMES, 40, 30);
+			}
+			pMix->m_pfnClip(vMix.data(), vOut.data(), FRAMES * 2, 80);
+		}
+		const int64_t Mixed = (time_get() - Start) / NUM_ITERATIONS;
+		RecordDuration(pMix->m_pName, Mixed);
+	}
+}
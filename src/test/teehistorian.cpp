@@ -1,14 +1,20 @@
+#include "test.h"
 #include <gtest/gtest.h>
 
 #include <base/detect.h>
 #include <engine/external/json-parser/json.h>
 #include <engine/server.h>
 #include <engine/shared/config.h>
+#include <engine/shared/teehistorian_reader.h>
 #include <game/gamecore.h>
 #include <game/server/teehistorian.h>
 
+#include <algorithm>
+#include <iterator>
 #include <vector>
 
+#include <zlib.h>
+
 void RegisterGameUuids(CUuidManager *pManager);
 
 class TeeHistorian : public ::testing::Test
@@ -223,6 +229,71 @@ protected:
 		Char.m_Y = y;
 		m_TH.RecordPlayer(ClientID, &Char);
 	}
+
+	// Moving players that leave and join again, chat, save and load. The
+	// x position of a player is the current tick.
+	void SynthesizeGame(int NumTicks)
+	{
+		const int NUM_PLAYERS = 16;
+		const char aMessage[] = "chat message";
+		CNetObj_PlayerInput Input;
+		mem_zero(&Input, sizeof(Input));
+
+		for(int i = 0; i < NUM_PLAYERS; i++)
+			m_TH.RecordPlayerJoin(i, CTeeHistorian::PROTOCOL_6);
+		for(int t = 1; t <= NumTicks; t++)
+		{
+			// the server is empty sometimes
+			if(t % 10000 == 0)
+				t += 50;
+			Tick(t);
+			// one player is away for a bit every minute
+			const int Away = t / 3000 % NUM_PLAYERS;
+			const bool IsAway = t % 3000 <= 100;
+			for(int i = 0; i < NUM_PLAYERS; i++)
+			{
+				if((i == Away && IsAway) || (t / 64 + i) % 8 == 0)
+					DeadPlayer(i);
+				else
+					Player(i, t, i * 100 + t % 7);
+			}
+			Inputs();
+			for(int i = 0; i < NUM_PLAYERS; i++)
+			{
+				if((i == Away && IsAway) || (t + i) % 4 != 0)
+					continue;
+				Input.m_Direction = (t / 4 + i) % 3 - 1;
+				Input.m_TargetX = t % 200 - 100;
+				Input.m_TargetY = i;
+				Input.m_Jump = t / 4 % 2;
+				m_TH.RecordPlayerInput(i, i + 1, &Input);
+			}
+			if(t % 3000 == 0)
+				m_TH.RecordPlayerDrop(Away, "timeout");
+			else if(t % 3000 == 100)
+				m_TH.RecordPlayerJoin(Away, CTeeHistorian::PROTOCOL_6);
+			if(t % 20 == 0)
+				m_TH.RecordPlayerMessage(t / 20 % NUM_PLAYERS, aMessage, sizeof(aMessage));
+			const int Team = t / 1000 % 8;
+			if(t % 1000 == 500 && t / 1000 % 2 == 0)
+				m_TH.RecordTeamSaveSuccess(Team, CalculateUuid("save"), "team save");
+			else if(t % 1000 == 500)
+				m_TH.RecordTeamLoadSuccess(Team, CalculateUuid("save"), "team save");
+			else if(t % 1000 == 700 && t / 1000 % 2 == 0)
+				m_TH.RecordTeamSaveFailure(Team);
+			else if(t % 1000 == 700)
+				m_TH.RecordTeamLoadFailure(Team);
+		}
+		Finish();
+	}
+
+	void WriteFile(const char *pFilename)
+	{
+		IOHANDLE File = io_open(pFilename, IOFLAG_WRITE);
+		ASSERT_TRUE(File);
+		io_write(File, m_vBuffer.data(), m_vBuffer.size());
+		io_close(File);
+	}
 };
 
 TEST_F(TeeHistorian, Empty)
@@ -857,3 +928,332 @@ TEST_F(TeeHistorian, PrevGameUuid)
 	EXPECT_STREQ(JsonPrevGameUuid, "fe19c218-f555-4002-a273-126c59ccc17a");
 	json_value_free(pJson);
 }
+
+static std::vector<unsigned char> ReadGzip(const char *pFilename)
+{
+	std::vector<unsigned char> vData;
+	gzFile File = gzopen(pFilename, "rb");
+	if(!File)
+		return vData;
+	unsigned char aBuf[4096];
+	int Read;
+	while((Read = gzread(File, aBuf, sizeof(aBuf))) > 0)
+		vData.insert(vData.end(), aBuf, aBuf + Read);
+	gzclose(File);
+	return vData;
+}
+
+TEST_F(TeeHistorian, Compressed)
+{
+	for(int t = 0; t < 100; t++)
+	{
+		Tick(t);
+		for(int i = 0; i < 8; i++)
+			Player(i, t * i, t);
+	}
+	Finish();
+
+	CTestInfo Info;
+	IOHANDLE File = io_open(Info.m_aFilename, IOFLAG_WRITE);
+	ASSERT_TRUE(File);
+	CTeeHistorianCompressor Compressor(6, 0);
+	ASSERT_TRUE(Compressor.Init());
+	ASYNCIO *pAio = aio_new_writer(File, CTeeHistorianCompressor::Write, &Compressor);
+	for(size_t i = 0; i < m_vBuffer.size(); i += 100)
+		aio_write(pAio, m_vBuffer.data() + i, minimum(m_vBuffer.size() - i, (size_t)100));
+	aio_close(pAio);
+	aio_wait(pAio);
+	EXPECT_EQ(aio_error(pAio), 0);
+	aio_free(pAio);
+
+	EXPECT_EQ(Compressor.BytesIn(), (int64_t)m_vBuffer.size());
+	EXPECT_LT(Compressor.BytesOut(), Compressor.BytesIn());
+	EXPECT_GT(Compressor.NumFlushes(), 0);
+	EXPECT_EQ(ReadGzip(Info.m_aFilename), m_vBuffer);
+	fs_remove(Info.m_aFilename);
+}
+
+TEST_F(TeeHistorian, CompressedReadableAfterFlush)
+{
+	Tick(1);
+	Player(0, 1, 2);
+	Finish();
+
+	CTestInfo Info;
+	IOHANDLE File = io_open(Info.m_aFilename, IOFLAG_WRITE);
+	ASSERT_TRUE(File);
+	CTeeHistorianCompressor Compressor(6, 0);
+	ASSERT_TRUE(Compressor.Init());
+	ASSERT_EQ(CTeeHistorianCompressor::Write(File, m_vBuffer.data(), m_vBuffer.size(), 0, &Compressor), 0);
+	// simulate a crash, the stream isn't finished
+	io_close(File);
+
+	EXPECT_EQ(ReadGzip(Info.m_aFilename), m_vBuffer);
+	fs_remove(Info.m_aFilename);
+}
+
+struct CReadRecord
+{
+	int m_Type;
+	int m_Tick;
+	int64_t m_Offset;
+	int m_ClientID;
+	CTeeHistorianReader::CPlayer m_Player;
+};
+
+static std::vector<CReadRecord> ReadRecords(CTeeHistorianReader *pReader, size_t MaxRecords = -1)
+{
+	std::vector<CReadRecord> vRecords;
+	CTeeHistorianReader::CRecord Record;
+	while(vRecords.size() < MaxRecords && pReader->Next(&Record))
+	{
+		CReadRecord Read = {Record.m_Type, Record.m_Tick, Record.m_Offset, Record.m_ClientID, {}};
+		if(Record.m_ClientID >= 0 && Record.m_ClientID < MAX_CLIENTS)
+			Read.m_Player = pReader->State().m_aPlayers[Record.m_ClientID];
+		vRecords.push_back(Read);
+	}
+	return vRecords;
+}
+
+static void ExpectSameRecords(const CReadRecord *pExpected, const CReadRecord *pGot, int Num)
+{
+	for(int i = 0; i < Num; i++)
+	{
+		const CReadRecord &Expected = pExpected[i];
+		const CReadRecord &Got = pGot[i];
+		ASSERT_EQ(Got.m_Type, Expected.m_Type);
+		ASSERT_EQ(Got.m_Tick, Expected.m_Tick);
+		ASSERT_EQ(Got.m_Offset, Expected.m_Offset);
+		ASSERT_EQ(Got.m_ClientID, Expected.m_ClientID);
+		ASSERT_EQ(Got.m_Player.m_Alive, Expected.m_Player.m_Alive);
+		ASSERT_EQ(Got.m_Player.m_X, Expected.m_Player.m_X);
+		ASSERT_EQ(Got.m_Player.m_Y, Expected.m_Player.m_Y);
+		ASSERT_EQ(Got.m_Player.m_HasInput, Expected.m_Player.m_HasInput);
+		ASSERT_EQ(mem_comp(Got.m_Player.m_aInput, Expected.m_Player.m_aInput, sizeof(Got.m_Player.m_aInput)), 0);
+	}
+}
+
+TEST_F(TeeHistorian, Reader)
+{
+	SynthesizeGame(25000);
+	CTestInfo Info;
+	WriteFile(Info.m_aFilename);
+
+	CTeeHistorianReader Reader;
+	ASSERT_TRUE(Reader.Open(Info.m_aFilename));
+	EXPECT_TRUE(str_startswith(Reader.Header(), "{\"comment\":\"teehistorian@ddnet.tw\""));
+	const std::vector<CReadRecord> vRecords = ReadRecords(&Reader);
+	EXPECT_FALSE(Reader.Error());
+	EXPECT_TRUE(Reader.Finished());
+	EXPECT_EQ(Reader.State().m_Offset, (int64_t)m_vBuffer.size());
+	EXPECT_EQ(Reader.State().m_Tick, 25000);
+	for(const auto &Record : vRecords)
+	{
+		if(Record.m_Type == CTeeHistorianReader::RECORD_PLAYER_DIFF || Record.m_Type == CTeeHistorianReader::RECORD_PLAYER_NEW)
+		{
+			ASSERT_EQ(Record.m_Player.m_X, Record.m_Tick);
+		}
+	}
+
+	// filtered reading returns the same records
+	const unsigned FilterMask = CTeeHistorianReader::RecordMask(CTeeHistorianReader::RECORD_JOIN) | CTeeHistorianReader::RecordMask(CTeeHistorianReader::RECORD_DROP);
+	std::vector<CReadRecord> vExpectedFiltered;
+	std::copy_if(vRecords.begin(), vRecords.end(), std::back_inserter(vExpectedFiltered), [&](const CReadRecord &Record) {
+		return FilterMask & CTeeHistorianReader::RecordMask(Record.m_Type);
+	});
+	ASSERT_TRUE(Reader.Open(Info.m_aFilename));
+	CTeeHistorianReader::CRecord Filtered;
+	size_t NumFiltered = 0;
+	while(Reader.Next(&Filtered, FilterMask))
+	{
+		ASSERT_LT(NumFiltered, vExpectedFiltered.size());
+		EXPECT_EQ(Filtered.m_Type, vExpectedFiltered[NumFiltered].m_Type);
+		EXPECT_EQ(Filtered.m_Tick, vExpectedFiltered[NumFiltered].m_Tick);
+		EXPECT_EQ(Filtered.m_ClientID, vExpectedFiltered[NumFiltered].m_ClientID);
+		NumFiltered++;
+	}
+	EXPECT_TRUE(Reader.Finished());
+	EXPECT_EQ(NumFiltered, vExpectedFiltered.size());
+
+	ASSERT_TRUE(Reader.Open(Info.m_aFilename));
+	CTeeHistorianIndex Built;
+	ASSERT_TRUE(Built.Build(&Reader, 100));
+	EXPECT_EQ(Built.LastTick(), 25000);
+	EXPECT_EQ(Built.Size(), (int64_t)m_vBuffer.size());
+
+	char aIndexFilename[IO_MAX_PATH_LENGTH];
+	str_format(aIndexFilename, sizeof(aIndexFilename), "%s.index", Info.m_aFilename);
+	ASSERT_TRUE(Built.Save(aIndexFilename));
+	CTeeHistorianIndex Index;
+	ASSERT_TRUE(Index.Load(aIndexFilename, Reader));
+	EXPECT_EQ(Index.NumKeyframes(), Built.NumKeyframes());
+	EXPECT_EQ(Index.LastTick(), Built.LastTick());
+	EXPECT_EQ(Index.Size(), Built.Size());
+
+	// 16 joins, 8 drops, 9 joins after being away, 25 saves or loads and failures
+	ASSERT_EQ(Index.Events().size(), Built.Events().size());
+	std::vector<int> vNumEvents(CTeeHistorianIndex::NUM_EVENTS);
+	for(size_t i = 0; i < Index.Events().size(); i++)
+	{
+		const CTeeHistorianIndex::CEvent &Event = Index.Events()[i];
+		EXPECT_EQ(Event.m_Type, Built.Events()[i].m_Type);
+		EXPECT_EQ(Event.m_Tick, Built.Events()[i].m_Tick);
+		EXPECT_EQ(Event.m_Offset, Built.Events()[i].m_Offset);
+		EXPECT_EQ(Event.m_ID, Built.Events()[i].m_ID);
+		vNumEvents[Event.m_Type]++;
+	}
+	EXPECT_EQ(vNumEvents[CTeeHistorianIndex::EVENT_JOIN], 16 + 9);
+	EXPECT_EQ(vNumEvents[CTeeHistorianIndex::EVENT_DROP], 8);
+	EXPECT_EQ(vNumEvents[CTeeHistorianIndex::EVENT_SAVE_SUCCESS] + vNumEvents[CTeeHistorianIndex::EVENT_LOAD_SUCCESS], 25);
+	EXPECT_EQ(vNumEvents[CTeeHistorianIndex::EVENT_SAVE_FAILURE] + vNumEvents[CTeeHistorianIndex::EVENT_LOAD_FAILURE], 25);
+	const auto FirstDrop = std::find_if(Index.Events().begin(), Index.Events().end(), [](const CTeeHistorianIndex::CEvent &Event) {
+		return Event.m_Type == CTeeHistorianIndex::EVENT_DROP;
+	});
+	ASSERT_NE(FirstDrop, Index.Events().end());
+	EXPECT_EQ(FirstDrop->m_Tick, 3000);
+	EXPECT_EQ(FirstDrop->m_ID, 1);
+
+	for(int Tick : {0, 1, 99, 100, 101, 3000, 9999, 10000, 10025, 10050, 10051, 24999, 25000})
+	{
+		ASSERT_TRUE(Index.Seek(&Reader, Tick));
+		const auto Expected = std::find_if(vRecords.begin(), vRecords.end(), [&](const CReadRecord &Record) {
+			return Record.m_Tick >= Tick;
+		});
+		const std::vector<CReadRecord> vGot = ReadRecords(&Reader, 500);
+		ASSERT_EQ(vGot.size(), minimum<size_t>(500, vRecords.end() - Expected));
+		ExpectSameRecords(&*Expected, vGot.data(), vGot.size());
+	}
+	EXPECT_FALSE(Index.Seek(&Reader, 25001));
+
+	// stops before the first record of the stop tick
+	const unsigned DropMask = CTeeHistorianReader::RecordMask(CTeeHistorianReader::RECORD_DROP);
+	CTeeHistorianReader::CRecord Record;
+	ASSERT_TRUE(Index.Seek(&Reader, 3001));
+	EXPECT_FALSE(Reader.Next(&Record, DropMask, 3050));
+	EXPECT_FALSE(Reader.Error());
+	EXPECT_LT(Reader.State().m_Tick, 3050);
+	ASSERT_TRUE(Index.Seek(&Reader, 2900));
+	ASSERT_TRUE(Reader.Next(&Record, DropMask, 3001));
+	EXPECT_EQ(Record.m_Tick, 3000);
+
+	// the index of another game is rejected
+	m_GameInfo.m_GameUuid = CalculateUuid("other@ddnet.tw");
+	Reset(&m_GameInfo);
+	SynthesizeGame(25000);
+	char aOtherFilename[IO_MAX_PATH_LENGTH];
+	Info.Filename(aOtherFilename, sizeof(aOtherFilename), "-other");
+	WriteFile(aOtherFilename);
+	CTeeHistorianReader OtherReader;
+	ASSERT_TRUE(OtherReader.Open(aOtherFilename));
+	CTeeHistorianIndex OtherIndex;
+	EXPECT_FALSE(OtherIndex.Load(aIndexFilename, OtherReader));
+
+	fs_remove(aIndexFilename);
+	fs_remove(aOtherFilename);
+	fs_remove(Info.m_aFilename);
+}
+
+TEST_F(TeeHistorian, ReaderCompressed)
+{
+	SynthesizeGame(3000);
+	CTestInfo Info;
+	gzFile File = gzopen(Info.m_aFilename, "wb");
+	ASSERT_TRUE(File);
+	ASSERT_EQ(gzwrite(File, m_vBuffer.data(), m_vBuffer.size()), (int)m_vBuffer.size());
+	gzclose(File);
+
+	CTeeHistorianReader Reader;
+	ASSERT_TRUE(Reader.Open(Info.m_aFilename));
+	const std::vector<CReadRecord> vRecords = ReadRecords(&Reader);
+	EXPECT_TRUE(Reader.Finished());
+	EXPECT_EQ(Reader.State().m_Offset, (int64_t)m_vBuffer.size());
+
+	ASSERT_TRUE(Reader.Open(Info.m_aFilename));
+	CTeeHistorianIndex Index;
+	ASSERT_TRUE(Index.Build(&Reader));
+	ASSERT_TRUE(Index.Seek(&Reader, 2000));
+	const auto Expected = std::find_if(vRecords.begin(), vRecords.end(), [](const CReadRecord &Record) {
+		return Record.m_Tick >= 2000;
+	});
+	const std::vector<CReadRecord> vGot = ReadRecords(&Reader);
+	ASSERT_EQ(vGot.size(), (size_t)(vRecords.end() - Expected));
+	ExpectSameRecords(&*Expected, vGot.data(), vGot.size());
+	fs_remove(Info.m_aFilename);
+}
+
+TEST_F(TeeHistorian, DISABLED_ReaderBenchmark)
+{
+	// two hours
+	const int NUM_TICKS = 2 * 60 * 60 * SERVER_TICK_SPEED;
+	SynthesizeGame(NUM_TICKS);
+	CTestInfo Info;
+	WriteFile(Info.m_aFilename);
+
+	CTeeHistorianReader Reader;
+	ASSERT_TRUE(Reader.Open(Info.m_aFilename));
+	CTeeHistorianReader::CRecord Record;
+	int NumRecords = 0;
+	int64_t Start = time_get();
+	while(Reader.Next(&Record))
+		NumRecords++;
+	const int64_t ReadTime = time_get() - Start;
+	EXPECT_TRUE(Reader.Finished());
+
+	ASSERT_TRUE(Reader.Open(Info.m_aFilename));
+	int NumFiltered = 0;
+	const unsigned FilterMask = CTeeHistorianReader::RecordMask(CTeeHistorianReader::RECORD_JOIN) | CTeeHistorianReader::RecordMask(CTeeHistorianReader::RECORD_DROP);
+	Start = time_get();
+	while(Reader.Next(&Record, FilterMask))
+		NumFiltered++;
+	const int64_t FilterTime = time_get() - Start;
+
+	ASSERT_TRUE(Reader.Open(Info.m_aFilename));
+	CTeeHistorianIndex Index;
+	Start = time_get();
+	ASSERT_TRUE(Index.Build(&Reader));
+	const int64_t BuildTime = time_get() - Start;
+
+	char aIndexFilename[IO_MAX_PATH_LENGTH];
+	str_format(aIndexFilename, sizeof(aIndexFilename), "%s.index", Info.m_aFilename);
+	ASSERT_TRUE(Index.Save(aIndexFilename));
+	Start = time_get();
+	ASSERT_TRUE(Index.Load(aIndexFilename, Reader));
+	const int64_t LoadTime = time_get() - Start;
+	IOHANDLE IndexFile = io_open(aIndexFilename, IOFLAG_READ);
+	ASSERT_TRUE(IndexFile);
+	const int64_t IndexSize = io_length(IndexFile);
+	io_close(IndexFile);
+
+	// read one second at random ticks
+	const int NUM_SEEKS = 200;
+	int64_t Seed = 1;
+	Start = time_get();
+	for(int i = 0; i < NUM_SEEKS; i++)
+	{
+		Seed = (Seed * 1103515245 + 12345) % 2147483648;
+		const int Tick = Seed % NUM_TICKS;
+		ASSERT_TRUE(Index.Seek(&Reader, Tick));
+		while(Reader.Next(&Record) && Record.m_Tick < Tick + SERVER_TICK_SPEED)
+		{
+			if(Record.m_Type == CTeeHistorianReader::RECORD_PLAYER_DIFF)
+			{
+				ASSERT_EQ(Reader.State().m_aPlayers[Record.m_ClientID].m_X, Record.m_Tick);
+			}
+		}
+	}
+	const int64_t SeekTime = time_get() - Start;
+
+	RecordProperty("bytes", (int)m_vBuffer.size());
+	RecordProperty("records", NumRecords);
+	RecordProperty("filtered_records", NumFiltered);
+	RecordProperty("keyframes", Index.NumKeyframes());
+	RecordProperty("index_bytes", (int)IndexSize);
+	RecordDuration("read", ReadTime);
+	RecordDuration("read_filtered", FilterTime);
+	RecordDuration("build_index", BuildTime);
+	RecordDuration("load_index", LoadTime);
+	RecordDuration("seek_and_read_second", SeekTime / NUM_SEEKS);
+
+	fs_remove(aIndexFilename);
+	fs_remove(Info.m_aFilename);
+}
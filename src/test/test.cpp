@@ -132,6 +132,13 @@ CTestInfo::~CTestInfo()
 	}
 }
 
+void RecordDuration(const char *pName, int64_t Duration)
+{
+	char aDuration[32];
+	str_format(aDuration, sizeof(aDuration), "%.1fus", Duration * 1000000.0 / time_freq());
+	::testing::Test::RecordProperty(pName, aDuration);
+}
+
 int main(int argc, const char **argv)
 {
 	CCmdlineFix CmdlineFix(&argc, &argv);
@@ -2,6 +2,7 @@
 #define TEST_TEST_H
 
 #include <cstddef>
+#include <cstdint>
 
 class IStorage;
 
@@ -16,4 +17,8 @@ public:
 	char m_aFilenamePrefix[128];
 	char m_aFilename[128];
 };
+
+// Records a duration measured with time_get() as a property of the running
+// test, benchmarks are disabled and report their timings this way.
+void RecordDuration(const char *pName, int64_t Duration);
 #endif // TEST_TEST_H
@@ -0,0 +1,209 @@
+#include <base/logger.h>
+#include <base/system.h>
+#include <engine/shared/teehistorian_reader.h>
+
+#include <climits>
+#include <cstdio>
+
+static const char *TOOL_NAME = "teehistorian_index";
+
+static void IndexFilename(const char *pFilename, char *pBuf, int BufSize)
+{
+	str_format(pBuf, BufSize, "%s.index", pFilename);
+}
+
+static bool OpenReader(CTeeHistorianReader *pReader, const char *pFilename)
+{
+	if(!pReader->Open(pFilename))
+	{
+		dbg_msg(TOOL_NAME, "failed to open teehistorian '%s'", pFilename);
+		return false;
+	}
+	return true;
+}
+
+// loads the sidecar index or builds it in memory if there is none or it
+// belongs to another file
+static bool LoadIndex(CTeeHistorianIndex *pIndex, const char *pFilename)
+{
+	CTeeHistorianReader Reader;
+	if(!OpenReader(&Reader, pFilename))
+		return false;
+
+	char aIndexFilename[IO_MAX_PATH_LENGTH];
+	IndexFilename(pFilename, aIndexFilename, sizeof(aIndexFilename));
+	if(pIndex->Load(aIndexFilename, Reader))
+		return true;
+
+	if(fs_is_file(aIndexFilename))
+		dbg_msg(TOOL_NAME, "index '%s' doesn't belong to '%s', reading the whole file", aIndexFilename, pFilename);
+	else
+		dbg_msg(TOOL_NAME, "no index '%s', reading the whole file", aIndexFilename);
+	if(!pIndex->Build(&Reader))
+	{
+		dbg_msg(TOOL_NAME, "failed to read '%s'", pFilename);
+		return false;
+	}
+	return true;
+}
+
+static int Index(const char *pFilename, int KeyframeInterval)
+{
+	CTeeHistorianReader Reader;
+	if(!OpenReader(&Reader, pFilename))
+		return -1;
+
+	CTeeHistorianIndex Index;
+	const int64_t StartTime = time_get();
+	if(!Index.Build(&Reader, KeyframeInterval))
+	{
+		dbg_msg(TOOL_NAME, "failed to read '%s'", pFilename);
+		return -1;
+	}
+
+	char aIndexFilename[IO_MAX_PATH_LENGTH];
+	IndexFilename(pFilename, aIndexFilename, sizeof(aIndexFilename));
+	if(!Index.Save(aIndexFilename))
+	{
+		dbg_msg(TOOL_NAME, "failed to write '%s'", aIndexFilename);
+		return -1;
+	}
+	dbg_msg(TOOL_NAME, "wrote '%s' ticks=%d keyframes=%d events=%d finished=%d time=%.3fs",
+		aIndexFilename, Index.LastTick(), Index.NumKeyframes(), (int)Index.Events().size(), Reader.Finished(),
+		(time_get() - StartTime) / (double)time_freq());
+	return 0;
+}
+
+static int Events(const char *pFilename)
+{
+	CTeeHistorianIndex Index;
+	if(!LoadIndex(&Index, pFilename))
+		return -1;
+	for(const auto &Event : Index.Events())
+		printf("%d %s %d\n", Event.m_Tick, CTeeHistorianIndex::EventName(Event.m_Type), Event.m_ID);
+	return 0;
+}
+
+static void PrintRecord(const CTeeHistorianReader &Reader, const CTeeHistorianReader::CRecord &Record)
+{
+	const char *pName = CTeeHistorianReader::RecordName(Record.m_Type);
+	switch(Record.m_Type)
+	{
+	case CTeeHistorianReader::RECORD_PLAYER_DIFF:
+	case CTeeHistorianReader::RECORD_PLAYER_NEW:
+	{
+		const CTeeHistorianReader::CPlayer &Player = Reader.State().m_aPlayers[Record.m_ClientID];
+		printf("%d %s cid=%d x=%d y=%d\n", Record.m_Tick, pName, Record.m_ClientID, Player.m_X, Player.m_Y);
+		break;
+	}
+	case CTeeHistorianReader::RECORD_INPUT_DIFF:
+	case CTeeHistorianReader::RECORD_INPUT_NEW:
+	{
+		const int *pInput = Reader.State().m_aPlayers[Record.m_ClientID].m_aInput;
+		printf("%d %s cid=%d %d %d %d %d %d %d %d %d %d %d\n", Record.m_Tick, pName, Record.m_ClientID,
+			pInput[0], pInput[1], pInput[2], pInput[3], pInput[4],
+			pInput[5], pInput[6], pInput[7], pInput[8], pInput[9]);
+		break;
+	}
+	case CTeeHistorianReader::RECORD_TICK_SKIP:
+		printf("%d %s dt=%d\n", Record.m_Tick, pName, Record.m_Dt);
+		break;
+	case CTeeHistorianReader::RECORD_DROP:
+		printf("%d %s cid=%d reason='%s'\n", Record.m_Tick, pName, Record.m_ClientID, Record.m_pString);
+		break;
+	case CTeeHistorianReader::RECORD_CONSOLE_COMMAND:
+	{
+		printf("%d %s cid=%d flags=%d cmd='%s'", Record.m_Tick, pName, Record.m_ClientID, Record.m_FlagMask, Record.m_pString);
+		const char *pArg = (const char *)Record.m_pData;
+		for(int i = 0; i < Record.m_NumArgs; i++)
+		{
+			printf(" '%s'", pArg);
+			pArg += str_length(pArg) + 1;
+		}
+		printf("\n");
+		break;
+	}
+	case CTeeHistorianReader::RECORD_MESSAGE:
+		printf("%d %s cid=%d size=%d\n", Record.m_Tick, pName, Record.m_ClientID, Record.m_DataSize);
+		break;
+	case CTeeHistorianReader::RECORD_EX:
+	{
+		char aUuid[UUID_MAXSTRSIZE];
+		FormatUuid(Record.m_ExUuid, aUuid, sizeof(aUuid));
+		const char *pExName = Record.m_ExType != UUID_UNKNOWN ? g_UuidManager.GetName(Record.m_ExType) : aUuid;
+		printf("%d %s %s size=%d\n", Record.m_Tick, pName, pExName, Record.m_DataSize);
+		break;
+	}
+	default:
+		if(Record.m_ClientID >= 0)
+			printf("%d %s cid=%d\n", Record.m_Tick, pName, Record.m_ClientID);
+		else
+			printf("%d %s\n", Record.m_Tick, pName);
+	}
+}
+
+static int Dump(const char *pFilename, int StartTick, int EndTick, unsigned TypeMask)
+{
+	CTeeHistorianReader Reader;
+	if(!OpenReader(&Reader, pFilename))
+		return -1;
+	if(StartTick > 0)
+	{
+		CTeeHistorianIndex Index;
+		if(!LoadIndex(&Index, pFilename))
+			return -1;
+		if(!Index.Seek(&Reader, StartTick))
+			return Reader.Error() ? -1 : 0;
+	}
+
+	// stop at the end tick instead of decoding the rest of the file
+	const int StopTick = EndTick == INT_MAX ? INT_MAX : EndTick + 1;
+	CTeeHistorianReader::CRecord Record;
+	while(Reader.Next(&Record, TypeMask, StopTick))
+		PrintRecord(Reader, Record);
+	if(Reader.Error())
+	{
+		dbg_msg(TOOL_NAME, "failed to read '%s'", pFilename);
+		return -1;
+	}
+	return 0;
+}
+
+int main(int argc, const char *argv[])
+{
+	CCmdlineFix CmdlineFix(&argc, &argv);
+	log_set_global_logger_default();
+
+	if(argc >= 3 && argc <= 4 && str_comp(argv[1], "index") == 0)
+	{
+		const int KeyframeInterval = argc == 4 ? str_toint(argv[3]) : (int)CTeeHistorianIndex::DEFAULT_KEYFRAME_INTERVAL;
+		if(KeyframeInterval <= 0)
+		{
+			dbg_msg(TOOL_NAME, "invalid keyframe interval '%s'", argv[3]);
+			return -1;
+		}
+		return Index(argv[2], KeyframeInterval);
+	}
+	if(argc == 3 && str_comp(argv[1], "events") == 0)
+	{
+		return Events(argv[2]);
+	}
+	if(argc >= 3 && argc <= 6 && str_comp(argv[1], "dump") == 0)
+	{
+		const int StartTick = argc >= 4 ? str_toint(argv[3]) : 0;
+		const int EndTick = argc >= 5 ? str_toint(argv[4]) : INT_MAX;
+		unsigned TypeMask = CTeeHistorianReader::ALL_RECORDS;
+		if(argc >= 6 && !CTeeHistorianReader::ParseRecordMask(argv[5], &TypeMask))
+		{
+			dbg_msg(TOOL_NAME, "invalid record types '%s'", argv[5]);
+			return -1;
+		}
+		return Dump(argv[2], StartTick, EndTick, TypeMask);
+	}
+
+	dbg_msg("usage", "%s index <teehistorian> [keyframe interval]", argv[0]);
+	dbg_msg("usage", "%s events <teehistorian>", argv[0]);
+	dbg_msg("usage", "%s dump <teehistorian> [start tick] [end tick] [record types]", argv[0]);
+	dbg_msg("usage", "record types are comma separated, e.g. join,drop,console_command");
+	return -1;
+}